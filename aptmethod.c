@@ -16,10 +16,11 @@
 #include <config.h>
 
 #include <errno.h>
-#include <sys/select.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
+#include <sys/time.h>
+#include <signal.h>
 #include <fcntl.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -38,6 +39,7 @@
 #include "uncompression.h"
 #include "aptmethod.h"
 #include "filecntl.h"
+#include "eventloop.h"
 
 struct tobedone {
 	/*@null@*/
@@ -50,17 +52,19 @@ struct tobedone {
 	/* callback and its data: */
 	queue_callback *callback;
 	/*@null@*/void *privdata1, *privdata2;
+	/* the expected size (0 if not known) */
+	off_t size;
 	/* there is no fallback or that was already used */
 	bool lasttry;
+	/* index files are requested before all other files */
+	bool index;
 };
 
-struct aptmethod {
-	/*@only@*/ /*@null@*/
-	struct aptmethod *next;
-	char *name;
-	char *baseuri;
-	/*@null@*/char *fallbackbaseuri;
-	/*@null@*/char *config;
+/* one process of a method */
+struct methodworker {
+	/*@null@*/
+	struct methodworker *next;
+	/*@dependent@*/struct aptmethod *method;
 	int mstdin, mstdout;
 	pid_t child;
 
@@ -71,9 +75,18 @@ struct aptmethod {
 		ams_failed
 	} status;
 
-	/*@null@*/struct tobedone *tobedone;
-	/*@null@*//*@dependent@*/struct tobedone *lasttobedone;
-	/*@null@*//*@dependent@*/const struct tobedone *nexttosend;
+	/* the requests sent to this process and not yet answered: */
+	/*@null@*/struct tobedone *sent;
+	/*@null@*//*@dependent@*/struct tobedone *lastsent;
+	int sentcount;
+	off_t sentsize;
+	/* when the process last said something or the file of the
+	 * first request last changed its size (to notice stalls) */
+	double progresstime;
+	/*@null@*//*@dependent@*/const struct tobedone *progresstodo;
+	off_t progresssize;
+	/* stopped because of a stall, so its exit is no error */
+	bool killed;
 	/* what is currently read: */
 	/*@null@*/char *inputbuffer;
 	size_t input_size, alreadyread;
@@ -82,10 +95,52 @@ struct aptmethod {
 	size_t alreadywritten, output_length;
 };
 
+struct aptmethod {
+	/*@only@*/ /*@null@*/
+	struct aptmethod *next;
+	/*@dependent@*/struct aptmethodrun *run;
+	char *name;
+	char *baseuri;
+	/*@null@*/char *fallbackbaseuri;
+	char *config;
+	/* the number of processes to start at most */
+	unsigned int maxworkers;
+	/* the method said it must only run once */
+	bool singleinstance;
+	/* a process died, do not start new ones in this run */
+	bool failed;
+	/*@null@*/struct methodworker *workers;
+	/* the requests not yet sent to any process (index files first): */
+	/*@null@*/struct tobedone *queue;
+	/*@null@*//*@dependent@*/struct tobedone *lastqueued, *lastqueuedindex;
+	unsigned int queued;
+	/* statistics of the current aptmethod_download call */
+	unsigned int filesgot;
+	unsigned long long bytesgot, lastbytesgot;
+};
+
 struct aptmethodrun {
 	struct aptmethod *methods;
+	/* the number of requests sent to any process and not yet answered */
+	unsigned int inflight;
+	/* when the current aptmethod_download call started and when
+	 * statistics were printed and stalls were looked for the last time */
+	double starttime, laststats, laststallcheck;
 };
 
+/* with multiple processes per method, each only gets a few files
+ * at the same time (and only one if that is big), so that the others
+ * can take the rest of the queue */
+#define WORKER_MAXSENT 8
+#define WORKER_MAXSENTSIZE ((off_t)(1024*1024))
+
+static double now(void) {
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
 static void todo_free(/*@only@*/ struct tobedone *todo) {
 	free(todo->filename);
 	free(todo->uri);
@@ -102,88 +157,132 @@ static void free_todolist(/*@only@*/ struct tobedone *todo) {
 	}
 }
 
+static void worker_free(/*@only@*/struct methodworker *worker) {
+	free(worker->inputbuffer);
+	free(worker->command);
+	free_todolist(worker->sent);
+	free(worker);
+}
+
+static void worker_closepipes(struct methodworker *worker) {
+	if (worker->mstdin >= 0) {
+		(void)events_watch(worker->mstdin, 0, NULL, NULL);
+		(void)close(worker->mstdin);
+		if (verbose > 30)
+			fprintf(stderr, "Closing stdin of %d\n",
+					(int)worker->child);
+	}
+	worker->mstdin = -1;
+	if (worker->mstdout >= 0) {
+		(void)events_watch(worker->mstdout, 0, NULL, NULL);
+		(void)close(worker->mstdout);
+		if (verbose > 30)
+			fprintf(stderr, "Closing stdout of %d\n",
+					(int)worker->child);
+	}
+	worker->mstdout = -1;
+}
+
+/* forget about a process no longer running,
+ * what was requested from it is not received any more */
+static void worker_remove(struct methodworker *worker) {
+	struct aptmethod *method = worker->method;
+	struct methodworker **w_p;
+
+	assert (worker->child <= 0);
+	for (w_p = &method->workers ; *w_p != worker ; w_p = &(*w_p)->next)
+		assert (*w_p != NULL);
+	*w_p = worker->next;
+	assert (method->run->inflight >= (unsigned int)worker->sentcount);
+	method->run->inflight -= worker->sentcount;
+	worker_closepipes(worker);
+	worker_free(worker);
+}
+
 static void aptmethod_free(/*@only@*/struct aptmethod *method) {
 	if (method == NULL)
 		return;
+	while (method->workers != NULL) {
+		struct methodworker *w = method->workers;
+
+		method->workers = w->next;
+		worker_free(w);
+	}
 	free(method->name);
 	free(method->baseuri);
 	free(method->config);
 	free(method->fallbackbaseuri);
-	free(method->inputbuffer);
-	free(method->command);
 
-	free_todolist(method->tobedone);
+	free_todolist(method->queue);
 
 	free(method);
 }
 
-retvalue aptmethod_shutdown(struct aptmethodrun *run) {
-	retvalue result = RET_OK, r;
-	struct aptmethod *method, *lastmethod, **method_ptr;
-
-	/* first get rid of everything not running: */
-	method_ptr = &run->methods;
-	while (*method_ptr != NULL) {
+static struct methodworker *findworker(const struct aptmethodrun *run, pid_t pid) {
+	struct aptmethod *method;
+	struct methodworker *worker;
 
-		if ((*method_ptr)->child > 0) {
-			if (verbose > 10)
-				fprintf(stderr,
-"Still waiting for %d\n", (int)(*method_ptr)->child);
-			method_ptr = &(*method_ptr)->next;
-			continue;
-		} else {
-			/*@only@*/ struct aptmethod *h;
-			h = (*method_ptr);
-			*method_ptr = h->next;
-			h->next = NULL;
-			aptmethod_free(h);
+	for (method = run->methods ; method != NULL ; method = method->next) {
+		for (worker = method->workers ; worker != NULL ;
+		                                worker = worker->next) {
+			if (worker->child == pid)
+				return worker;
 		}
 	}
+	return NULL;
+}
 
-	/* finally get rid of all the processes: */
+retvalue aptmethod_shutdown(struct aptmethodrun *run) {
+	retvalue result = RET_OK, r;
+	struct aptmethod *method;
+	struct methodworker *worker, *next;
+	int running = 0;
+
+	/* first get rid of everything not running and
+	 * close the pipes of all the processes: */
 	for (method = run->methods ; method != NULL ; method = method->next) {
-		if (method->mstdin >= 0) {
-			(void)close(method->mstdin);
-			if (verbose > 30)
-				fprintf(stderr, "Closing stdin of %d\n",
-						(int)method->child);
-		}
-		method->mstdin = -1;
-		if (method->mstdout >= 0) {
-			(void)close(method->mstdout);
-			if (verbose > 30)
-				fprintf(stderr, "Closing stdout of %d\n",
-						(int)method->child);
+		for (worker = method->workers ; worker != NULL ;
+		                                worker = next) {
+			next = worker->next;
+			if (worker->child <= 0) {
+				worker_remove(worker);
+				continue;
+			}
+			if (verbose > 10)
+				fprintf(stderr,
+"Still waiting for %d\n", (int)worker->child);
+			running++;
+			worker_closepipes(worker);
 		}
-		method->mstdout = -1;
 	}
-	while (run->methods != NULL || uncompress_running()) {
+	/* then wait for all the processes to finish: */
+	while (running > 0 || uncompress_running()) {
 		pid_t pid;int status;
 
 		pid = wait(&status);
-		lastmethod = NULL; method = run->methods;
-		while (method != NULL) {
-			if (method->child == pid) {
-				struct aptmethod *next = method->next;
-
-				if (lastmethod != NULL) {
-					lastmethod->next = next;
-				} else
-					run->methods = next;
-
-				aptmethod_free(method);
-				pid = -1;
-				break;
-			} else {
-				lastmethod = method;
-				method = method->next;
-			}
+		if (pid < 0) {
+			int e = errno;
+			if (e == EINTR)
+				continue;
+			fprintf(stderr,
+"Error %d waiting for child processes: %s\n", e, strerror(e));
+			result = RET_ERRNO(e);
+			break;
 		}
-		if (pid > 0) {
+		worker = findworker(run, pid);
+		if (worker != NULL) {
+			worker->child = -1;
+			running--;
+		} else {
 			r = uncompress_checkpid(pid, status);
 			RET_UPDATE(result, r);
 		}
 	}
+	while (run->methods != NULL) {
+		method = run->methods;
+		run->methods = method->next;
+		aptmethod_free(method);
+	}
 	free(run);
 	return result;
 }
@@ -200,17 +299,15 @@ retvalue aptmethod_initialize_run(struct aptmethodrun **run) {
 	return RET_OK;
 }
 
-retvalue aptmethod_newmethod(struct aptmethodrun *run, const char *uri, const char *fallbackuri, const struct strlist *config, struct aptmethod **m) {
+retvalue aptmethod_newmethod(struct aptmethodrun *run, const char *uri, const char *fallbackuri, const struct strlist *config, unsigned int workers, struct aptmethod **m) {
 	struct aptmethod *method;
 	const char *p;
 
 	method = zNEW(struct aptmethod);
 	if (FAILEDTOALLOC(method))
 		return RET_ERROR_OOM;
-	method->mstdin = -1;
-	method->mstdout = -1;
-	method->child = -1;
-	method->status = ams_notstarted;
+	method->run = run;
+	method->maxworkers = (workers == 0)?1:workers;
 	p = uri;
 	while (*p != '\0' && (*p == '_' || *p == '-' ||
 		(*p>='a' && *p<='z') || (*p>='A' && *p<='Z') ||
@@ -279,25 +376,13 @@ retvalue aptmethod_newmethod(struct aptmethodrun *run, const char *uri, const ch
 
 /**************************Fire up a method*****************************/
 
-inline static retvalue aptmethod_startup(struct aptmethod *method) {
+static retvalue worker_startup(struct aptmethod *method) {
+	struct methodworker *worker;
 	pid_t f;
 	int mstdin[2];
 	int mstdout[2];
 	int r;
 
-	/* When there is nothing to get, there is no reason to startup
-	 * the method. */
-	if (method->tobedone == NULL) {
-		return RET_NOTHING;
-	}
-
-	/* when we are already running, we are already ready...*/
-	if (method->child > 0) {
-		return RET_OK;
-	}
-
-	method->status = ams_waitforcapabilities;
-
 	r = pipe(mstdin);
 	if (r < 0) {
 		int e = errno;
@@ -367,7 +452,6 @@ inline static retvalue aptmethod_startup(struct aptmethod *method) {
 		exit(255);
 	}
 	/* the main program continues... */
-	method->child = f;
 	if (verbose > 10)
 		fprintf(stderr,
 "Method '%s' started as %d\n", method->baseuri, (int)f);
@@ -375,32 +459,92 @@ inline static retvalue aptmethod_startup(struct aptmethod *method) {
 	(void)close(mstdout[1]);
 	markcloseonexec(mstdin[1]);
 	markcloseonexec(mstdout[0]);
-	method->mstdin = mstdin[1];
-	method->mstdout = mstdout[0];
-	method->inputbuffer = NULL;
-	method->input_size = 0;
-	method->alreadyread = 0;
-	method->command = NULL;
-	method->output_length = 0;
-	method->alreadywritten = 0;
+	worker = zNEW(struct methodworker);
+	if (FAILEDTOALLOC(worker)) {
+		/* it will notice and exit, its pid is ignored later */
+		(void)close(mstdin[1]);
+		(void)close(mstdout[0]);
+		return RET_ERROR_OOM;
+	}
+	worker->method = method;
+	worker->child = f;
+	worker->status = ams_waitforcapabilities;
+	worker->progresstime = now();
+	worker->mstdin = mstdin[1];
+	worker->mstdout = mstdout[0];
+	worker->next = method->workers;
+	method->workers = worker;
 	return RET_OK;
 }
 
+/* start another process if there are requests and the running ones
+ * are all busy */
+static retvalue startworkers(struct aptmethod *method) {
+	const struct methodworker *worker;
+	unsigned int running = 0;
+	retvalue r;
+
+	if (method->queue == NULL || method->failed)
+		return RET_NOTHING;
+	if (global.maxdownloads > 0 &&
+			method->run->inflight >= global.maxdownloads)
+		return RET_NOTHING;
+	for (worker = method->workers ; worker != NULL ;
+	                                worker = worker->next) {
+		if (worker->child <= 0)
+			continue;
+		if (worker->status == ams_waitforcapabilities ||
+				(worker->status == ams_ok &&
+				 worker->sentcount == 0))
+			return RET_NOTHING;
+		running++;
+	}
+	if (running >= method->maxworkers)
+		return RET_NOTHING;
+	r = worker_startup(method);
+	if (RET_WAS_ERROR(r))
+		method->failed = true;
+	return r;
+}
+
 /**************************how to add files*****************************/
 
 static inline void enqueue(struct aptmethod *method, /*@only@*/struct tobedone *todo) {
+	struct tobedone **next_p;
+
+	/* index files are only sorted before the other files,
+	 * otherwise everything is requested in the order it was added */
+	if (!todo->index)
+		next_p = (method->lastqueued == NULL)?
+			&method->queue : &method->lastqueued->next;
+	else if (method->lastqueuedindex == NULL)
+		next_p = &method->queue;
+	else
+		next_p = &method->lastqueuedindex->next;
+	todo->next = *next_p;
+	*next_p = todo;
+	method->queued++;
+	if (todo->next == NULL)
+		method->lastqueued = todo;
+	if (todo->index)
+		method->lastqueuedindex = todo;
+}
+
+static struct tobedone *dequeue(struct aptmethod *method) {
+	struct tobedone *todo = method->queue;
+
+	assert (todo != NULL && method->queued > 0);
+	method->queue = todo->next;
+	method->queued--;
+	if (method->lastqueued == todo)
+		method->lastqueued = NULL;
+	if (method->lastqueuedindex == todo)
+		method->lastqueuedindex = NULL;
 	todo->next = NULL;
-	if (method->lasttobedone == NULL)
-		method->nexttosend = method->lasttobedone = method->tobedone = todo;
-	else {
-		method->lasttobedone->next = todo;
-		method->lasttobedone = todo;
-		if (method->nexttosend == NULL)
-			method->nexttosend = todo;
-	}
+	return todo;
 }
 
-static retvalue enqueuenew(struct aptmethod *method, /*@only@*/char *uri, /*@only@*/char *destfile, queue_callback *callback, void *privdata1, void *privdata2) {
+static retvalue enqueuenew(struct aptmethod *method, /*@only@*/char *uri, /*@only@*/char *destfile, off_t size, bool index, queue_callback *callback, void *privdata1, void *privdata2) {
 	struct tobedone *todo;
 
 	if (FAILEDTOALLOC(destfile)) {
@@ -424,15 +568,17 @@ static retvalue enqueuenew(struct aptmethod *method, /*@only@*/char *uri, /*@onl
 	todo->callback = callback;
 	todo->privdata1 = privdata1;
 	todo->privdata2 = privdata2;
+	todo->size = size;
 	todo->lasttry = method->fallbackbaseuri == NULL;
+	todo->index = index;
 	enqueue(method, todo);
 	return RET_OK;
 }
 
-retvalue aptmethod_enqueue(struct aptmethod *method, const char *origfile, /*@only@*/char *destfile, queue_callback *callback, void *privdata1, void *privdata2) {
+retvalue aptmethod_enqueue(struct aptmethod *method, const char *origfile, /*@only@*/char *destfile, off_t size, queue_callback *callback, void *privdata1, void *privdata2) {
 	return enqueuenew(method,
 			calc_dirconcat(method->baseuri, origfile),
-			destfile, callback, privdata1, privdata2);
+			destfile, size, false, callback, privdata1, privdata2);
 }
 
 retvalue aptmethod_enqueueindex(struct aptmethod *method, const char *suite, const char *origfile, const char *suffix, const char *destfile, const char *downloadsuffix, queue_callback *callback, void *privdata1, void *privdata2) {
@@ -440,7 +586,7 @@ retvalue aptmethod_enqueueindex(struct aptmethod *method, const char *suite, con
 			mprintf("%s/%s/%s%s",
 				method->baseuri, suite, origfile, suffix),
 			mprintf("%s%s", destfile, downloadsuffix),
-			callback, privdata1, privdata2);
+			0, true, callback, privdata1, privdata2);
 }
 
 /*****************what to do with received files************************/
@@ -482,90 +628,88 @@ static retvalue requeue_or_fail(struct aptmethod *method, /*@only@*/struct tobed
 	}
 }
 
-/* look which file could not be received and remove it: */
-static retvalue urierror(struct aptmethod *method, const char *uri, /*@only@*/char *message) {
+/* look which request an answer is for and remove it from the sent ones: */
+static struct tobedone *takesent(struct methodworker *worker, const char *uri) {
 	struct tobedone *todo, *lasttodo;
 
-	lasttodo = NULL; todo = method->tobedone;
+	lasttodo = NULL; todo = worker->sent;
 	while (todo != NULL) {
-		if (strcmp(todo->uri, uri) == 0)  {
-
-			/* remove item: */
-			if (lasttodo == NULL)
-				method->tobedone = todo->next;
-			else
-				lasttodo->next = todo->next;
-			if (method->nexttosend == todo) {
-				/* just in case some method received
-				 * files before we request them ;-) */
-				method->nexttosend = todo->next;
-			}
-			if (method->lasttobedone == todo) {
-				method->lasttobedone = todo->next;
-			}
-			fprintf(stderr,
-"aptmethod error receiving '%s':\n'%s'\n",
-					uri, (message != NULL)?message:"");
-			/* put message in failed items to show it later? */
-			free(message);
-			return requeue_or_fail(method, todo);
+		if (strcmp(todo->uri, uri) != 0)  {
+			lasttodo = todo;
+			todo = todo->next;
+			continue;
 		}
-		lasttodo = todo;
-		todo = todo->next;
+		/* remove item: */
+		if (lasttodo == NULL)
+			worker->sent = todo->next;
+		else
+			lasttodo->next = todo->next;
+		if (worker->lastsent == todo)
+			worker->lastsent = lasttodo;
+		todo->next = NULL;
+		worker->sentcount--;
+		worker->sentsize -= todo->size;
+		assert (worker->method->run->inflight > 0);
+		worker->method->run->inflight--;
+		return todo;
+	}
+	return NULL;
+}
+
+/* look which file could not be received and remove it: */
+static retvalue urierror(struct methodworker *worker, const char *uri, /*@only@*/char *message) {
+	struct tobedone *todo;
+
+	todo = takesent(worker, uri);
+	if (todo != NULL) {
+		fprintf(stderr,
+"aptmethod error receiving '%s':\n'%s'\n",
+				uri, (message != NULL)?message:"");
+		/* put message in failed items to show it later? */
+		free(message);
+		return requeue_or_fail(worker->method, todo);
 	}
 	/* huh? If if have not asked for it, how can there be errors? */
 	fprintf(stderr,
 "Method '%s' reported error with unrequested file '%s':\n'%s'!\n",
-			method->name, uri, message);
+			worker->method->name, uri, message);
 	free(message);
 	return RET_ERROR;
 }
 
 /* look where a received file has to go to: */
-static retvalue uridone(struct aptmethod *method, const char *uri, const char *filename, /*@only@*//*@null@*/struct checksums *checksumsfromapt) {
-	struct tobedone *todo, *lasttodo;
+static retvalue uridone(struct methodworker *worker, const char *uri, const char *filename, /*@only@*//*@null@*/struct checksums *checksumsfromapt) {
+	struct tobedone *todo;
 	retvalue r;
 
-	lasttodo = NULL; todo = method->tobedone;
-	while (todo != NULL) {
-		if (strcmp(todo->uri, uri) != 0)  {
-			lasttodo = todo;
-			todo = todo->next;
-			continue;
-		}
+	todo = takesent(worker, uri);
+	if (todo != NULL) {
+		struct stat s;
 
+		worker->method->filesgot++;
+		if (checksumsfromapt != NULL)
+			worker->method->bytesgot +=
+				checksums_getfilesize(checksumsfromapt);
+		else if (stat(filename, &s) == 0)
+			worker->method->bytesgot += s.st_size;
 		r = todo->callback(qa_got,
 				todo->privdata1, todo->privdata2,
 				todo->uri, filename, todo->filename,
-				checksumsfromapt, method->name);
+				checksumsfromapt, worker->method->name);
 		checksums_free(checksumsfromapt);
-
-		/* remove item: */
-		if (lasttodo == NULL)
-			method->tobedone = todo->next;
-		else
-			lasttodo->next = todo->next;
-		if (method->nexttosend == todo) {
-			/* just in case some method received
-			 * files before we request them ;-) */
-			method->nexttosend = todo->next;
-		}
-		if (method->lasttobedone == todo) {
-			method->lasttobedone = todo->next;
-		}
 		todo_free(todo);
 		return r;
 	}
 	/* huh? */
 	fprintf(stderr,
 "Method '%s' retrieved unexpected file '%s' at '%s'!\n",
-			method->name, uri, filename);
+			worker->method->name, uri, filename);
 	checksums_free(checksumsfromapt);
 	return RET_ERROR;
 }
 
 /***************************Input and Output****************************/
-static retvalue logmessage(const struct aptmethod *method, const char *chunk, const char *type) {
+static retvalue logmessage(const struct methodworker *worker, const char *chunk, const char *type) {
 	retvalue r;
 	char *message;
 
@@ -574,7 +718,7 @@ static retvalue logmessage(const struct aptmethod *method, const char *chunk, co
 		return r;
 	if (RET_IS_OK(r)) {
 		fprintf(stderr, "aptmethod '%s': '%s'\n",
-				method->baseuri, message);
+				worker->method->baseuri, message);
 		free(message);
 		return RET_OK;
 	}
@@ -586,43 +730,49 @@ static retvalue logmessage(const struct aptmethod *method, const char *chunk, co
 		free(message);
 		return RET_OK;
 	}
-	fprintf(stderr, "aptmethod '%s': '%s'\n", method->baseuri, type);
+	fprintf(stderr, "aptmethod '%s': '%s'\n",
+			worker->method->baseuri, type);
 	return RET_OK;
 }
-static inline retvalue gotcapabilities(struct aptmethod *method, const char *chunk) {
+static inline retvalue gotcapabilities(struct methodworker *worker, const char *chunk) {
 	retvalue r;
 
 	r = chunk_gettruth(chunk, "Single-Instance");
 	if (RET_WAS_ERROR(r))
 		return r;
-// TODO: what to do with this?
-//	if (r != RET_NOTHING) {
-//		fprintf(stderr, "WARNING: Single-instance not yet supported!\n");
-//	}
+	if (r != RET_NOTHING) {
+		/* no more processes than this one, whatever
+		 * DownloadWorkers says (no others can be running yet,
+		 * as those are only started once this one is busy) */
+		if (verbose > 1 && worker->method->maxworkers > 1)
+			fprintf(stderr,
+"Method '%s' is single-instance, not starting more than one process.\n",
+					worker->method->name);
+		worker->method->singleinstance = true;
+		worker->method->maxworkers = 1;
+	}
 	r = chunk_gettruth(chunk, "Send-Config");
 	if (RET_WAS_ERROR(r))
 		return r;
 	if (r != RET_NOTHING) {
-		assert(method->command == NULL);
-		method->alreadywritten = 0;
-		method->command = method->config;
-		method->config = NULL;
-		method->output_length = strlen(method->command);
+		assert(worker->command == NULL);
+		worker->alreadywritten = 0;
+		worker->command = strdup(worker->method->config);
+		if (FAILEDTOALLOC(worker->command))
+			return RET_ERROR_OOM;
+		worker->output_length = strlen(worker->command);
 		if (verbose > 11) {
 			fprintf(stderr, "Sending config: '%s'\n",
-					method->command);
+					worker->command);
 		}
-	} else {
-		free(method->config);
-		method->config = NULL;
 	}
-	method->status = ams_ok;
+	worker->status = ams_ok;
 	return RET_OK;
 }
 
-static inline retvalue goturidone(struct aptmethod *method, const char *chunk) {
+static inline retvalue goturidone(struct methodworker *worker, const char *chunk) {
 	static const char * const method_hash_names[cs_COUNT] =
-		{ "MD5-Hash", "SHA1-Hash", "SHA256-Hash",
+		{ "MD5-Hash", "SHA1-Hash", "SHA256-Hash", "SHA512-Hash",
 		  "Size" };
 	retvalue result, r;
 	char *uri, *filename;
@@ -636,9 +786,9 @@ static inline retvalue goturidone(struct aptmethod *method, const char *chunk) {
 	if (r == RET_NOTHING) {
 		fprintf(stderr,
 "Missing URI header in uridone received from '%s' method!\n",
-				method->name);
+				worker->method->name);
 		r = RET_ERROR;
-		method->status = ams_failed;
+		worker->status = ams_failed;
 	}
 	if (RET_WAS_ERROR(r))
 		return r;
@@ -651,11 +801,11 @@ static inline retvalue goturidone(struct aptmethod *method, const char *chunk) {
 		if (r == RET_NOTHING) {
 			fprintf(stderr,
 "Missing Filename header in uridone received from '%s' method!\n",
-					method->name);
-			r = urierror(method, uri, strdup(
+					worker->method->name);
+			r = urierror(worker, uri, strdup(
 "<no error but missing Filename from apt-method>"));
 		} else {
-			r = urierror(method, uri, mprintf(
+			r = urierror(worker, uri, mprintf(
 "<File not there, apt-method suggests '%s' instead>", altfilename));
 			free(altfilename);
 		}
@@ -692,20 +842,20 @@ static inline retvalue goturidone(struct aptmethod *method, const char *chunk) {
 		/* ignore errors, we can recompute them from the file */
 		(void)checksums_init(&checksums, hashes);
 	}
-	r = uridone(method, uri, filename, checksums);
+	r = uridone(worker, uri, filename, checksums);
 	free(uri);
 	free(filename);
 	return r;
 }
 
-static inline retvalue goturierror(struct aptmethod *method, const char *chunk) {
+static inline retvalue goturierror(struct methodworker *worker, const char *chunk) {
 	retvalue r;
 	char *uri, *message;
 
 	r = chunk_getvalue(chunk, "URI", &uri);
 	if (r == RET_NOTHING) {
 		fprintf(stderr,
-"Missing URI header in urierror received from '%s' method!\n", method->name);
+"Missing URI header in urierror received from '%s' method!\n", worker->method->name);
 		r = RET_ERROR;
 	}
 	if (RET_WAS_ERROR(r))
@@ -720,12 +870,12 @@ static inline retvalue goturierror(struct aptmethod *method, const char *chunk)
 		return r;
 	}
 
-	r = urierror(method, uri, message);
+	r = urierror(worker, uri, message);
 	free(uri);
 	return r;
 }
 
-static inline retvalue parsereceivedblock(struct aptmethod *method, const char *input) {
+static inline retvalue parsereceivedblock(struct methodworker *worker, const char *input) {
 	const char *p;
 	retvalue r;
 #define OVERLINE {while (*p != '\0' && *p != '\n') p++; if (*p == '\n') p++; }
@@ -734,7 +884,7 @@ static inline retvalue parsereceivedblock(struct aptmethod *method, const char *
 		input++;
 	if (*input == '\0') {
 		fprintf(stderr,
-"Unexpected number of newlines from '%s' method!\n", method->name);
+"Unexpected number of newlines from '%s' method!\n", worker->method->name);
 		return RET_NOTHING;
 	}
 	p = input;
@@ -748,19 +898,19 @@ static inline retvalue parsereceivedblock(struct aptmethod *method, const char *
 						fprintf(stderr, "Got '%s'\n",
 								input);
 					}
-					return gotcapabilities(method, input);
+					return gotcapabilities(worker, input);
 				/* 101 Log */
 				case '1':
 					if (verbose > 10) {
 						OVERLINE;
-						return logmessage(method, p, "101");
+						return logmessage(worker, p, "101");
 					}
 					return RET_OK;
 				/* 102 Status */
 				case '2':
 					if (verbose > 5) {
 						OVERLINE;
-						return logmessage(method, p, "102");
+						return logmessage(worker, p, "102");
 					}
 					return RET_OK;
 				default:
@@ -775,13 +925,13 @@ static inline retvalue parsereceivedblock(struct aptmethod *method, const char *
 				case '0':
 					if (verbose > 5) {
 						OVERLINE;
-						return logmessage(method, p, "start");
+						return logmessage(worker, p, "start");
 					}
 					return RET_OK;
 				/* 201 URI Done */
 				case '1':
 					OVERLINE;
-					return goturidone(method, p);
+					return goturidone(worker, p);
 				default:
 					fprintf(stderr,
 "Error or unsupported message received: '%s'\n",
@@ -793,12 +943,12 @@ static inline retvalue parsereceivedblock(struct aptmethod *method, const char *
 			switch (*(input+2)) {
 				case '0':
 					OVERLINE;
-					r = goturierror(method, p);
+					r = goturierror(worker, p);
 					break;
 				case '1':
 					OVERLINE;
-					(void)logmessage(method, p, "general error");
-					method->status = ams_failed;
+					(void)logmessage(worker, p, "general error");
+					worker->status = ams_failed;
 					r = RET_ERROR;
 					break;
 				default:
@@ -813,68 +963,76 @@ static inline retvalue parsereceivedblock(struct aptmethod *method, const char *
 		default:
 			fprintf(stderr,
 "Unexpected data from '%s' method: '%s'\n",
-					method->name, input);
+					worker->method->name, input);
 			return RET_ERROR;
 	}
 }
 
-static retvalue receivedata(struct aptmethod *method) {
+static retvalue receivedata(struct methodworker *worker) {
 	retvalue result;
 	ssize_t r;
 	char *p;
 	int consecutivenewlines;
 
-	assert (method->status != ams_ok || method->tobedone != NULL);
-	if (method->status != ams_waitforcapabilities
-			&& method->status != ams_ok)
+	assert (worker->status != ams_ok || worker->sent != NULL);
+	if (worker->status != ams_waitforcapabilities
+			&& worker->status != ams_ok)
 		return RET_NOTHING;
 
 	/* First look if we have enough room to read.. */
-	if (method->alreadyread + 1024 >= method->input_size) {
+	if (worker->alreadyread + 1024 >= worker->input_size) {
 		char *newptr;
 
-		if (method->input_size >= (size_t)128000) {
+		if (worker->input_size >= (size_t)128000) {
 			fprintf(stderr,
 "Ridiculously long answer from method!\n");
-			method->status = ams_failed;
+			worker->status = ams_failed;
 			return RET_ERROR;
 		}
 
-		newptr = realloc(method->inputbuffer, method->alreadyread+1024);
+		newptr = realloc(worker->inputbuffer, worker->alreadyread+1024);
 		if (FAILEDTOALLOC(newptr)) {
 			return RET_ERROR_OOM;
 		}
-		method->inputbuffer = newptr;
-		method->input_size = method->alreadyread + 1024;
+		worker->inputbuffer = newptr;
+		worker->input_size = worker->alreadyread + 1024;
 	}
-	assert (method->inputbuffer != NULL);
+	assert (worker->inputbuffer != NULL);
 	/* then read as much as the pipe is able to fill of our buffer */
 
-	r = read(method->mstdout, method->inputbuffer + method->alreadyread,
-			method->input_size - method->alreadyread - 1);
+	r = read(worker->mstdout, worker->inputbuffer + worker->alreadyread,
+			worker->input_size - worker->alreadyread - 1);
 
 	if (r < 0) {
 		int e = errno;
+		if (e == EAGAIN || e == EINTR)
+			return RET_NOTHING;
 		fprintf(stderr, "Error %d reading pipe from aptmethod: %s\n",
 				e, strerror(e));
-		method->status = ams_failed;
+		worker->status = ams_failed;
 		return RET_ERRNO(e);
 	}
-	method->alreadyread += r;
+	if (r == 0) {
+		/* it is about to exit, nothing more to read or write */
+		worker->status = ams_failed;
+		return RET_NOTHING;
+	}
+	worker->progresstime = now();
+	worker->alreadyread += r;
 
 	result = RET_NOTHING;
 	while(true) {
 		retvalue res;
 
-		r = method->alreadyread;
-		p = method->inputbuffer;
+		r = worker->alreadyread;
+		p = worker->inputbuffer;
 		consecutivenewlines = 0;
 
 		while (r > 0) {
 			if (*p == '\0') {
 				fprintf(stderr,
 "Unexpected Zeroes in method output!\n");
-				method->status = ams_failed;
+				worker->status = ams_failed;
 				return RET_ERROR;
 			} else if (*p == '\n') {
 				consecutivenewlines++;
@@ -889,33 +1047,48 @@ static retvalue receivedata(struct aptmethod *method) {
 			return result;
 		}
 		*p ='\0'; p++; r--;
-		res = parsereceivedblock(method, method->inputbuffer);
+		res = parsereceivedblock(worker, worker->inputbuffer);
 		if (r > 0)
-			memmove(method->inputbuffer, p, r);
-		method->alreadyread = r;
+			memmove(worker->inputbuffer, p, r);
+		worker->alreadyread = r;
 		RET_UPDATE(result, res);
 	}
 }
 
-static retvalue senddata(struct aptmethod *method) {
+/* if this process should get the next request now */
+static bool worker_cantake(const struct methodworker *worker) {
+	const struct aptmethod *method = worker->method;
+
+	if (worker->status != ams_ok || method->queue == NULL)
+		return false;
+	if (global.maxdownloads > 0 &&
+			method->run->inflight >= global.maxdownloads)
+		return false;
+	if (method->maxworkers <= 1 || worker->sentcount == 0)
+		return true;
+	return worker->sentcount < WORKER_MAXSENT &&
+		worker->sentsize + method->queue->size <= WORKER_MAXSENTSIZE;
+}
+
+static retvalue senddata(struct methodworker *worker) {
 	size_t l;
 	ssize_t r;
 
-	if (method->status != ams_ok)
+	if (worker->status != ams_ok)
 		return RET_NOTHING;
 
-	if (method->command == NULL) {
-		const struct tobedone *todo;
+	if (worker->command == NULL) {
+		struct tobedone *todo;
 
 		/* nothing queued to send, nothing to be queued...*/
-		todo = method->nexttosend;
-		if (todo == NULL)
+		if (!worker_cantake(worker))
 			return RET_OK;
 
 		if (interrupted())
 			return RET_ERROR_INTERRUPTED;
 
-		method->alreadywritten = 0;
+		todo = worker->method->queue;
+		worker->alreadywritten = 0;
 		// TODO: make sure this is already checked for earlier...
 		assert (strchr(todo->uri, '\n') == NULL &&
 		        strchr(todo->filename, '\n') == NULL);
@@ -925,35 +1098,43 @@ static retvalue senddata(struct aptmethod *method) {
 		 * but this is done elsewhere already
 		unlink(todo->filename);
 		*/
-		method->command = mprintf(
+		worker->command = mprintf(
 			 "600 URI Acquire\nURI: %s\nFilename: %s\n\n",
 			 todo->uri, todo->filename);
-		if (FAILEDTOALLOC(method->command)) {
+		if (FAILEDTOALLOC(worker->command)) {
 			return RET_ERROR_OOM;
 		}
-		method->output_length = strlen(method->command);
-		method->nexttosend = method->nexttosend->next;
+		worker->output_length = strlen(worker->command);
+		todo = dequeue(worker->method);
+		if (worker->lastsent == NULL)
+			worker->sent = todo;
+		else
+			worker->lastsent->next = todo;
+		worker->lastsent = todo;
+		worker->sentcount++;
+		worker->sentsize += todo->size;
+		worker->method->run->inflight++;
 	}
 
 
-	l = method->output_length - method->alreadywritten;
+	l = worker->output_length - worker->alreadywritten;
 
-	r = write(method->mstdin, method->command + method->alreadywritten, l);
+	r = write(worker->mstdin, worker->command + worker->alreadywritten, l);
 	if (r < 0) {
 		int e = errno;
 
 		fprintf(stderr, "Error %d writing to pipe: %s\n",
 				e, strerror(e));
 		//TODO: disable the whole method??
-		method->status = ams_failed;
+		worker->status = ams_failed;
 		return RET_ERRNO(e);
 	} else if ((size_t)r < l) {
-		method->alreadywritten += r;
+		worker->alreadywritten += r;
 		return RET_OK;
 	}
 
-	free(method->command);
-	method->command = NULL;
+	free(worker->command);
+	worker->command = NULL;
 	return RET_OK;
 }
 
@@ -962,14 +1143,11 @@ static retvalue checkchilds(struct aptmethodrun *run) {
 	retvalue result = RET_OK, r;
 
 	while ((child = waitpid(-1, &status, WNOHANG)) > 0) {
+		struct methodworker *worker;
 		struct aptmethod *method;
 
-		for (method = run->methods ; method != NULL ;
-		                             method = method->next) {
-			if (method->child == child)
-				break;
-		}
-		if (method == NULL) {
+		worker = findworker(run, child);
+		if (worker == NULL) {
 			/* perhaps an uncompressor terminated */
 			r = uncompress_checkpid(child, status);
 			if (RET_IS_OK(r))
@@ -985,18 +1163,17 @@ static retvalue checkchilds(struct aptmethodrun *run) {
 				continue;
 			}
 		}
-		/* Make sure we do not cope with this child any more */
-		if (method->mstdin != -1) {
-			(void)close(method->mstdin);
-			method->mstdin = -1;
-		}
-		if (method->mstdout != -1) {
-			(void)close(method->mstdout);
-			method->mstdout = -1;
+		method = worker->method;
+		/* Make sure we do not cope with this child any more,
+		 * and do not start new ones for this method in this run */
+		worker->child = -1;
+		if (worker->killed) {
+			/* stopped because of a stall, so expected */
+			worker_remove(worker);
+			continue;
 		}
-		method->child = -1;
-		if (method->status != ams_failed)
-			method->status = ams_notstarted;
+		worker_remove(worker);
+		method->failed = true;
 
 		/* say something if it exited unnormal: */
 		if (WIFEXITED(status)) {
@@ -1008,114 +1185,262 @@ static retvalue checkchilds(struct aptmethodrun *run) {
 "Method %s://%s exited with non-zero exit code %d!\n",
 					method->name, method->baseuri,
 					exitcode);
-				method->status = ams_notstarted;
 				result = RET_ERROR;
 			}
 		} else {
 			fprintf(stderr, "Method %s://%s exited unnormally!\n",
 					method->name, method->baseuri);
-			method->status = ams_notstarted;
 			result = RET_ERROR;
 		}
 	}
 	return result;
 }
 
-/* *workleft is always set, even when return indicated error.
- * (workleft < 0 when critical)*/
-static retvalue readwrite(struct aptmethodrun *run, /*@out@*/int *workleft) {
-	int maxfd, v;
-	fd_set readfds, writefds;
+/* stop a process where nothing happened for too long:
+ * the request it is working on fails (so the fallback is tried),
+ * the other requests sent to it are queued again */
+static retvalue stopworker(struct methodworker *worker) {
+	struct aptmethod *method = worker->method;
+	struct tobedone *todo, *next;
+	retvalue r;
+
+	todo = worker->sent;
+	assert (todo != NULL);
+	fprintf(stderr,
+"Nothing received for '%s' for %u seconds, stopping method process %d!\n",
+			todo->uri, global.stalltimeout, (int)worker->child);
+	(void)kill(worker->child, SIGTERM);
+	worker->killed = true;
+	worker->status = ams_failed;
+	worker_closepipes(worker);
+	free(worker->command);
+	worker->command = NULL;
+	assert (method->run->inflight >= (unsigned int)worker->sentcount);
+	method->run->inflight -= worker->sentcount;
+	worker->sent = NULL;
+	worker->lastsent = NULL;
+	worker->sentcount = 0;
+	worker->sentsize = 0;
+	worker->progresstodo = NULL;
+	next = todo->next;
+	todo->next = NULL;
+	r = requeue_or_fail(method, todo);
+	while (next != NULL) {
+		todo = next;
+		next = todo->next;
+		enqueue(method, todo);
+	}
+	return r;
+}
+
+static retvalue checkstalled(struct aptmethodrun *run, double t) {
 	struct aptmethod *method;
-	retvalue result, r;
+	struct methodworker *worker;
+	retvalue result = RET_NOTHING, r;
 
-	/* First calculate what to look at: */
-	FD_ZERO(&readfds);
-	FD_ZERO(&writefds);
-	maxfd = 0;
-	*workleft = 0;
-	for (method = run->methods ; method != NULL ; method = method->next) {
-		if (method->status == ams_ok &&
-		    (method->command != NULL || method->nexttosend != NULL)) {
-			FD_SET(method->mstdin, &writefds);
-			if (method->mstdin > maxfd)
-				maxfd = method->mstdin;
-			(*workleft)++;
-			if (verbose > 19)
-				fprintf(stderr, "want to write to '%s'\n",
-						method->baseuri);
+	for (method = run->methods ; method != NULL ; method = method->next)
+	for (worker = method->workers ; worker != NULL ;
+	                                worker = worker->next) {
+		struct stat s;
+
+		if (worker->child <= 0 || worker->status != ams_ok ||
+				worker->sent == NULL)
+			continue;
+		if (worker->progresstodo != worker->sent) {
+			worker->progresstodo = worker->sent;
+			worker->progresssize = -1;
+			worker->progresstime = t;
+			continue;
 		}
-		if (method->status == ams_waitforcapabilities ||
-				(method->status == ams_ok &&
-				method->tobedone != NULL)) {
-			FD_SET(method->mstdout, &readfds);
-			if (method->mstdout > maxfd)
-				maxfd = method->mstdout;
-			(*workleft)++;
-			if (verbose > 19)
-				fprintf(stderr, "want to read from '%s'\n",
-						method->baseuri);
+		if (stat(worker->sent->filename, &s) == 0 &&
+				s.st_size != worker->progresssize) {
+			worker->progresssize = s.st_size;
+			worker->progresstime = t;
+			continue;
 		}
+		if (t - worker->progresstime < global.stalltimeout)
+			continue;
+		r = stopworker(worker);
+		RET_UPDATE(result, r);
 	}
+	return result;
+}
 
-	if (*workleft == 0)
-		return RET_NOTHING;
+static void printstats(struct aptmethodrun *run, double t) {
+	struct aptmethod *method;
+	const struct methodworker *worker;
 
-	// TODO: think about a timeout...
-	v = select(maxfd + 1, &readfds, &writefds, NULL, NULL);
-	if (v < 0) {
-		int e = errno;
-		//TODO: handle (e == EINTR) && interrupted() specially
-		fprintf(stderr, "Select returned error %d: %s\n",
-				e, strerror(e));
-		*workleft = -1;
-		// TODO: what to do here?
-		return RET_ERRNO(e);
+	for (method = run->methods ; method != NULL ; method = method->next) {
+		unsigned int processes = 0, sent = 0;
+		double interval = t - run->laststats;
+
+		for (worker = method->workers ; worker != NULL ;
+		                                worker = worker->next) {
+			if (worker->child <= 0)
+				continue;
+			processes++;
+			sent += worker->sentcount;
+		}
+		if (processes == 0 && method->filesgot == 0 &&
+				method->queued == 0)
+			continue;
+		printf(
+"%s: got %u files, %llu bytes (%.0f bytes/s, %.0f bytes/s in the last %.0f s), %u queued, %u requested from %u processes\n",
+			method->baseuri, method->filesgot, method->bytesgot,
+			(t > run->starttime) ?
+				method->bytesgot / (t - run->starttime) : 0.0,
+			(interval > 0) ? (method->bytesgot
+				- method->lastbytesgot) / interval : 0.0,
+			interval, method->queued, sent, processes);
+		method->lastbytesgot = method->bytesgot;
 	}
+	run->laststats = t;
+}
 
-	result = RET_NOTHING;
+static retvalue worker_readable(void *privdata, UNUSED(int fd), UNUSED(int events)) {
+	return receivedata(privdata);
+}
 
-	maxfd = 0;
-	for (method = run->methods ; method != NULL ; method = method->next) {
-		if (method->mstdout != -1 &&
-				FD_ISSET(method->mstdout, &readfds)) {
-			r = receivedata(method);
-			RET_UPDATE(result, r);
+static retvalue worker_writable(void *privdata, UNUSED(int fd), UNUSED(int events)) {
+	return senddata(privdata);
+}
+
+/* tell the event loop what to look at,
+ * workleft is the number of descriptors to watch */
+static retvalue watchworkers(struct aptmethodrun *run, /*@out@*/int *workleft) {
+	struct aptmethod *method;
+	struct methodworker *worker;
+	retvalue r;
+
+	*workleft = 0;
+	for (method = run->methods ; method != NULL ; method = method->next)
+	for (worker = method->workers ; worker != NULL ;
+	                                worker = worker->next) {
+		bool want;
+
+		/* wait for stopped ones to exit, so others can be started */
+		if (worker->killed) {
+			(*workleft)++;
+			continue;
 		}
-		if (method->mstdin != -1 &&
-				FD_ISSET(method->mstdin, &writefds)) {
-			r = senddata(method);
-			RET_UPDATE(result, r);
+		if (worker->mstdin >= 0) {
+			want = worker->status == ams_ok &&
+				(worker->command != NULL ||
+				 worker_cantake(worker));
+			r = events_watch(worker->mstdin,
+					want ? EVENT_WRITE : 0,
+					worker_writable, worker);
+			if (RET_WAS_ERROR(r))
+				return r;
+			if (want) {
+				(*workleft)++;
+				if (verbose > 19)
+					fprintf(stderr,
+"want to write to '%s'\n", method->baseuri);
+			}
+		}
+		if (worker->mstdout >= 0) {
+			want = worker->status == ams_waitforcapabilities ||
+				(worker->status == ams_ok &&
+				 worker->sent != NULL);
+			r = events_watch(worker->mstdout,
+					want ? EVENT_READ : 0,
+					worker_readable, worker);
+			if (RET_WAS_ERROR(r))
+				return r;
+			if (want) {
+				(*workleft)++;
+				if (verbose > 19)
+					fprintf(stderr,
+"want to read from '%s'\n", method->baseuri);
+			}
 		}
 	}
-	return result;
+	return RET_OK;
+}
+
+/* nothing of the methods is to be looked at while not downloading
+ * (other users of the event loop might dispatch events otherwise) */
+static void unwatchworkers(struct aptmethodrun *run) {
+	struct aptmethod *method;
+	struct methodworker *worker;
+
+	for (method = run->methods ; method != NULL ; method = method->next)
+	for (worker = method->workers ; worker != NULL ;
+	                                worker = worker->next) {
+		if (worker->mstdin >= 0)
+			(void)events_watch(worker->mstdin, 0, NULL, NULL);
+		if (worker->mstdout >= 0)
+			(void)events_watch(worker->mstdout, 0, NULL, NULL);
+	}
 }
 
 retvalue aptmethod_download(struct aptmethodrun *run) {
 	struct aptmethod *method;
 	retvalue result, r;
-	int workleft;
+	int workleft, timeout;
+	double t;
 
 	result = RET_NOTHING;
 
-	/* fire up all methods, removing those that do not work: */
 	for (method = run->methods; method != NULL ; method = method->next) {
-		r = aptmethod_startup(method);
-		/* do not remove failed methods here any longer,
-		 * and not remove methods having nothing to do,
-		 * as this breaks when no index files are downloaded
-		 * due to all already being in place... */
-		RET_UPDATE(result, r);
+		method->failed = false;
+		method->filesgot = 0;
+		method->bytesgot = 0;
+		method->lastbytesgot = 0;
 	}
+	run->starttime = run->laststats = run->laststallcheck = now();
+	/* only wake up regularly if there is something to look at */
+	if (global.stalltimeout > 0 || global.downloadstats > 0)
+		timeout = 1000;
+	else
+		timeout = -1;
+	/* also wake up when an uncompressor (or method) exits */
+	r = events_catchchildren(true);
+	if (RET_WAS_ERROR(r))
+		return r;
 	/* waiting for them to finish: */
-	do {
-	  r = checkchilds(run);
-	  RET_UPDATE(result, r);
-	  r = readwrite(run, &workleft);
-	  RET_UPDATE(result, r);
-	  // TODO: check interrupted here...
-	} while (workleft > 0 || uncompress_running());
-
+	while (true) {
+		r = checkchilds(run);
+		RET_UPDATE(result, r);
+		/* fire up processes for methods with something to do
+		 * (another one if all running ones are busy and there may
+		 * be more), not removing failed methods or those with
+		 * nothing to do, as this breaks when no index files are
+		 * downloaded due to all already being in place... */
+		for (method = run->methods; method != NULL ;
+		                            method = method->next) {
+			r = startworkers(method);
+			RET_UPDATE(result, r);
+		}
+		t = now();
+		if (global.stalltimeout > 0 && t - run->laststallcheck >= 1) {
+			run->laststallcheck = t;
+			r = checkstalled(run, t);
+			RET_UPDATE(result, r);
+		}
+		if (global.downloadstats > 0 &&
+				t - run->laststats >= global.downloadstats)
+			printstats(run, t);
+		r = watchworkers(run, &workleft);
+		RET_UPDATE(result, r);
+		if (RET_WAS_ERROR(r))
+			break;
+		if (workleft == 0 && !uncompress_running())
+			break;
+		if (interrupted()) {
+			RET_UPDATE(result, RET_ERROR_INTERRUPTED);
+			break;
+		}
+		r = events_dispatch(timeout, &result);
+		if (RET_WAS_ERROR(r)) {
+			RET_UPDATE(result, r);
+			break;
+		}
+	}
+	unwatchworkers(run);
+	if (global.downloadstats > 0)
+		printstats(run, now());
+	(void)events_catchchildren(false);
 	return result;
 }
-
@@ -16,9 +16,10 @@ enum queue_action { qa_abort, qa_got, qa_error };
 typedef retvalue queue_callback(enum queue_action, void *, void *, const char * /*uri*/, const char * /*gotfilename*/, const char * /*wantedfilename*/, /*@null@*/const struct checksums *, const char * /*methodname*/);
 
 retvalue aptmethod_initialize_run(/*@out@*/struct aptmethodrun **);
-retvalue aptmethod_newmethod(struct aptmethodrun *, const char * /*uri*/, const char * /*fallbackuri*/, const struct strlist * /*config*/, /*@out@*/struct aptmethod **);
+retvalue aptmethod_newmethod(struct aptmethodrun *, const char * /*uri*/, const char * /*fallbackuri*/, const struct strlist * /*config*/, unsigned int /*workers*/, /*@out@*/struct aptmethod **);
 
-retvalue aptmethod_enqueue(struct aptmethod *, const char * /*origfile*/, /*@only@*/char */*destfile*/, queue_callback *, void *, void *);
+/* size is the expected size of the file (0 if unknown) */
+retvalue aptmethod_enqueue(struct aptmethod *, const char * /*origfile*/, /*@only@*/char */*destfile*/, off_t /*size*/, queue_callback *, void *, void *);
 retvalue aptmethod_enqueueindex(struct aptmethod *, const char * /*suite*/, const char * /*origfile*/, const char *, const char * /*destfile*/, const char *, queue_callback *, void *, void *);
 
 retvalue aptmethod_download(struct aptmethodrun *);
@@ -256,38 +256,34 @@ static struct aa_source_package *find_source(struct floodlist *list, const char
 /* Before anything else is done the current state of one target is read into
  * the list: list->list points to the first in the sorted list,
  * list->last to the last one inserted */
-static retvalue save_package_version(struct floodlist *list, const char *packagename, const char *chunk) {
+static retvalue save_package_version(struct floodlist *list, const char *packagename, const struct target_metadata *md) {
 	char *version, *source, *sourceversion;
-	architecture_t architecture;
 	struct aa_source_package *src;
 	retvalue r;
 	struct aa_package_data *package;
 
-	r = list->target->getarchitecture(chunk, &architecture);
-	if (RET_WAS_ERROR(r))
-		return r;
-
-	r = list->target->getsourceandversion(chunk, packagename,
-			&source, &sourceversion);
-	if (RET_WAS_ERROR(r))
-		return r;
+	source = strdup(md->source);
+	sourceversion = strdup(md->sourceversion);
+	if (FAILEDTOALLOC(source) || FAILEDTOALLOC(sourceversion)) {
+		free(source);
+		free(sourceversion);
+		return RET_ERROR_OOM;
+	}
 
 	r = find_or_add_source(list, source, sourceversion, &src);
 	source = NULL; sourceversion = NULL; // just to be sure
 	if (RET_WAS_ERROR(r))
 		return r;
 
-	r = list->target->getversion(chunk, &version);
-	if (RET_WAS_ERROR(r))
-		return r;
-
-
-	if (architecture != architecture_all) {
-		free(version);
+	if (md->architecture != architecture_all) {
 		src->has_sibling = true;
 		return RET_NOTHING;
 	}
 
+	version = strdup(md->version);
+	if (FAILEDTOALLOC(version))
+		return RET_ERROR_OOM;
+
 	package = zNEW(struct aa_package_data);
 	if (FAILEDTOALLOC(package)) {
 		free(version);
@@ -328,7 +324,8 @@ static retvalue save_package_version(struct floodlist *list, const char *package
 static retvalue floodlist_initialize(struct floodlist **fl, struct target *t) {
 	struct floodlist *list;
 	retvalue r, r2;
-	const char *packagename, *controlchunk;
+	const char *packagename;
+	struct target_metadata md;
 	struct target_cursor iterator;
 
 	list = zNEW(struct floodlist);
@@ -339,13 +336,16 @@ static retvalue floodlist_initialize(struct floodlist **fl, struct target *t) {
 
 	/* Begin with the packages currently in the archive */
 
-	r = target_openiterator(t, READONLY, &iterator);
+	r = target_openmetadata(t, READONLY,
+			TMD_VERSION|TMD_SOURCE|TMD_ARCHITECTURE, &iterator);
 	if (RET_WAS_ERROR(r)) {
 		floodlist_free(list);
 		return r;
 	}
-	while (target_nextpackage(&iterator, &packagename, &controlchunk)) {
-		r2 = save_package_version(list, packagename, controlchunk);
+	while ((r2 = target_nextmetadata(&iterator, &packagename, &md))
+			!= RET_NOTHING) {
+		if (RET_IS_OK(r2))
+			r2 = save_package_version(list, packagename, &md);
 		RET_UPDATE(r, r2);
 		if (RET_WAS_ERROR(r2))
 			break;
@@ -362,6 +362,24 @@ static retvalue floodlist_initialize(struct floodlist **fl, struct target *t) {
 	return RET_OK;
 }
 
+/* compare version (parsed when first needed) with other */
+static retvalue aa_versioncmp(struct dpkgversion *parsed, bool *isparsed, const char *version, const char *other, /*@out@*/int *versioncmp_p) {
+	struct dpkgversion parsedother;
+	retvalue r;
+
+	if (!*isparsed) {
+		r = dpkgversion_parse(parsed, version);
+		if (RET_WAS_ERROR(r))
+			return r;
+		*isparsed = true;
+	}
+	r = dpkgversion_parse(&parsedother, other);
+	if (RET_WAS_ERROR(r))
+		return r;
+	*versioncmp_p = dpkgversion_cmp(parsed, &parsedother);
+	return RET_OK;
+}
+
 static retvalue floodlist_trypackage(struct floodlist *list, const char *packagename_const, /*@only@*/char *version, const char *chunk) {
 	retvalue r;
 	struct aa_package_data *current, *insertafter;
@@ -477,6 +495,8 @@ static retvalue floodlist_trypackage(struct floodlist *list, const char *package
 		struct checksumsarray origfiles;
 		char *source, *sourceversion;
 		struct aa_source_package *src;
+		struct dpkgversion parsed;
+		bool isparsed = false;
 		int versioncmp;
 
 		list->last = current;
@@ -485,8 +505,8 @@ static retvalue floodlist_trypackage(struct floodlist *list, const char *package
 			/* it has a new and that has a binary sibling,
 			 * which means this becomes the new version
 			 * exactly when it is newer than the old newest */
-			r = dpkgversions_cmp(version, current->new_version,
-					&versioncmp);
+			r = aa_versioncmp(&parsed, &isparsed, version,
+					current->new_version, &versioncmp);
 			if (RET_WAS_ERROR(r)) {
 				free(version);
 				return r;
@@ -498,8 +518,8 @@ static retvalue floodlist_trypackage(struct floodlist *list, const char *package
 		} else if (current->old_version != NULL) {
 			/* if it is older than the old one, we will
 			 * always discard it */
-			r = dpkgversions_cmp(version, current->old_version,
-					&versioncmp);
+			r = aa_versioncmp(&parsed, &isparsed, version,
+					current->old_version, &versioncmp);
 			if (RET_WAS_ERROR(r)) {
 				free(version);
 				return r;
@@ -533,8 +553,8 @@ static retvalue floodlist_trypackage(struct floodlist *list, const char *package
 			} else {
 				/* the new one has no sibling and the old one
 				 * has not too, take the newer one: */
-				r = dpkgversions_cmp(version,
-						current->new_version,
+				r = aa_versioncmp(&parsed, &isparsed,
+						version, current->new_version,
 						&versioncmp);
 				if (RET_WAS_ERROR(r)) {
 					free(version);
@@ -39,7 +39,7 @@
 #include "debfile.h"
 
 static const char * const deb_checksum_headers[cs_COUNT] = {
-	"MD5sum", "SHA1", "SHA256", "Size"};
+	"MD5sum", "SHA1", "SHA256", "SHA512", "Size"};
 
 static char *calc_binary_basename(const char *name, const char *version, architecture_t arch, packagetype_t packagetype) {
 	const char *v;
@@ -492,11 +492,18 @@ void binaries_debdone(struct deb_headers *pkg) {
 
 retvalue binaries_readdeb(struct deb_headers *deb, const char *filename, bool needssourceversion) {
 	retvalue r;
-	char *architecture;
 
 	r = extractcontrol(&deb->control, filename);
 	if (RET_WAS_ERROR(r))
 		return r;
+	return binaries_parsedeb(deb, filename, needssourceversion);
+}
+
+retvalue binaries_parsedeb(struct deb_headers *deb, const char *filename, bool needssourceversion) {
+	retvalue r;
+	char *architecture;
+
+	assert (deb->control != NULL);
 	/* first look for fields that should be there */
 
 	r = chunk_getname(deb->control, "Package", &deb->name, false);
@@ -45,6 +45,8 @@ struct deb_headers {
  * - no checks for sanity of values, left to the caller */
 
 retvalue binaries_readdeb(struct deb_headers *, const char *filename, bool /*needssourceversion*/);
+/* the same with the control chunk already extracted into deb->control */
+retvalue binaries_parsedeb(struct deb_headers *, const char *filename, bool /*needssourceversion*/);
 void binaries_debdone(struct deb_headers *);
 
 retvalue binaries_calcfilekeys(component_t, const struct deb_headers *, packagetype_t, /*@out@*/struct strlist *);
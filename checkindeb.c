@@ -18,6 +18,7 @@
 #include <errno.h>
 #include <assert.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/wait.h>
 #include <unistd.h>
 #include <stdlib.h>
@@ -40,6 +41,11 @@
 #include "tracking.h"
 #include "override.h"
 #include "log.h"
+#include "debfile.h"
+#include "jobs.h"
+#include "globals.h"
+#include "contents.h"
+#include "filelist.h"
 
 /* This file includes the code to include binaries, i.e.
    to create the chunk for the Packages.gz-file and
@@ -74,15 +80,21 @@ void deb_free(/*@only@*/struct debpackage *pkg) {
 }
 
 /* read the data from a .deb, make some checks and extract some data */
-static retvalue deb_read(/*@out@*/struct debpackage **pkg, const char *filename, bool needssourceversion) {
+static retvalue deb_read(/*@out@*/struct debpackage **pkg, const char *filename, /*@null@*//*@only@*/char *control, bool needssourceversion) {
 	retvalue r;
 	struct debpackage *deb;
 
 	deb = zNEW(struct debpackage);
-	if (FAILEDTOALLOC(deb))
+	if (FAILEDTOALLOC(deb)) {
+		free(control);
 		return RET_ERROR_OOM;
+	}
 
-	r = binaries_readdeb(&deb->deb, filename, needssourceversion);
+	if (control != NULL) {
+		deb->deb.control = control;
+		r = binaries_parsedeb(&deb->deb, filename, needssourceversion);
+	} else
+		r = binaries_readdeb(&deb->deb, filename, needssourceversion);
 	if (RET_IS_OK(r))
 		r = properpackagename(deb->deb.name);
 	if (RET_IS_OK(r))
@@ -238,7 +250,7 @@ retvalue deb_prepare(/*@out@*/struct debpackage **deb, component_t forcecomponen
 
 	/* First taking a closer look in the file: */
 
-	r = deb_read(&pkg, debfilename, true);
+	r = deb_read(&pkg, debfilename, NULL, true);
 	if (RET_WAS_ERROR(r)) {
 		return r;
 	}
@@ -306,32 +318,129 @@ retvalue deb_addprepared(const struct debpackage *pkg, const struct atomlist *fo
 			pkg->deb.control);
 }
 
+/* reading the .deb only once (see ingestdeb), with everything only known
+ * after reading the control chunk decided in deb_ingestdecide */
+struct debingest {
+	component_t forcecomponent;
+	const struct atomlist *forcearchitectures;
+	const char *forcesection, *forcepriority;
+	packagetype_t packagetype;
+	struct distribution *distribution;
+	const char *debfilename;
+	bool needssourceversion;
+	/* the results: */
+	/*@null@*/struct debpackage *pkg;
+	const struct overridedata *oinfo;
+	/* where it is copied to, NULL if already in the pool */
+	/*@null@*/char *fullfilename;
+};
+
+static retvalue deb_ingestdecide(void *data, char *control, const char **destination_p, bool *wantfilelist_p) {
+	struct debingest *d = data;
+	retvalue r;
+
+	r = deb_read(&d->pkg, d->debfilename, control, d->needssourceversion);
+	if (RET_WAS_ERROR(r)) {
+		d->pkg = NULL;
+		return r;
+	}
+	r = deb_preparelocation(d->pkg, d->forcecomponent,
+			d->forcearchitectures, d->forcesection,
+			d->forcepriority, d->packagetype, d->distribution,
+			&d->oinfo, d->debfilename);
+	if (RET_WAS_ERROR(r))
+		return r;
+	r = files_preparenew(d->pkg->filekey, &d->fullfilename);
+	if (RET_WAS_ERROR(r))
+		return r;
+	*destination_p = d->fullfilename;
+	*wantfilelist_p = d->fullfilename != NULL &&
+		contents_needsfilelist(d->distribution, d->packagetype,
+				d->pkg->component);
+	return RET_OK;
+}
+
+/* add what ingestdeb read to the database */
+static retvalue deb_ingested(struct debingest *d, struct checksums **checksums_p, /*@null@*/const char *filelist, size_t filelistsize) {
+	const char *filekey = d->pkg->filekey;
+	struct checksums *checksums;
+	bool improves;
+	retvalue r;
+
+	if (d->fullfilename != NULL) {
+		r = files_add_checksums(filekey, *checksums_p);
+		if (RET_IS_OK(r) && filelist != NULL)
+			r = filelist_cache(filekey, filelist, filelistsize);
+		return r;
+	}
+	/* already in the pool, so nothing is copied */
+	r = files_preincludeknown(d->debfilename, filekey, *checksums_p,
+			NULL, &checksums, &improves);
+	if (RET_WAS_ERROR(r))
+		return r;
+	assert (r == RET_NOTHING);
+	checksums_free(*checksums_p);
+	*checksums_p = checksums;
+	if (improves)
+		return files_replace_checksums(filekey, checksums);
+	return RET_OK;
+}
+
+/* the same by reading it multiple times, for what ingestdeb cannot read */
+static retvalue deb_readandpreinclude(struct debingest *d, struct checksums **checksums_p) {
+	retvalue r;
+
+	r = deb_read(&d->pkg, d->debfilename, NULL, d->needssourceversion);
+	if (RET_WAS_ERROR(r)) {
+		d->pkg = NULL;
+		return r;
+	}
+	r = deb_preparelocation(d->pkg, d->forcecomponent,
+			d->forcearchitectures, d->forcesection,
+			d->forcepriority, d->packagetype, d->distribution,
+			&d->oinfo, d->debfilename);
+	if (RET_WAS_ERROR(r))
+		return r;
+	return files_preinclude(d->debfilename, d->pkg->filekey, checksums_p);
+}
+
 /* insert the given .deb into the mirror in <component> in the <distribution>
  * putting things with architecture of "all" into <d->architectures> (and also
  * causing error, if it is not one of them otherwise)
  * if component is NULL, guessing it from the section. */
 retvalue deb_add(component_t forcecomponent, const struct atomlist *forcearchitectures, const char *forcesection, const char *forcepriority, packagetype_t packagetype, struct distribution *distribution, const char *debfilename, int delete, /*@null@*/trackingdb tracks) {
+	struct debingest d;
 	struct debpackage *pkg;
 	retvalue r;
 	struct trackingdata trackingdata;
 	const struct overridedata *oinfo;
-	char *control;
+	char *control, *filelist = NULL;
+	size_t filelistsize;
 	struct checksums *checksums;
 
 	causingfile = debfilename;
 
-	r = deb_read(&pkg, debfilename, tracks != NULL);
-	if (RET_WAS_ERROR(r)) {
-		return r;
-	}
-	r = deb_preparelocation(pkg, forcecomponent, forcearchitectures,
-			forcesection, forcepriority, packagetype, distribution,
-			&oinfo, debfilename);
-	if (RET_WAS_ERROR(r)) {
-		deb_free(pkg);
-		return r;
-	}
-	r = files_preinclude(debfilename, pkg->filekey, &checksums);
+	memset(&d, 0, sizeof(d));
+	d.forcecomponent = forcecomponent;
+	d.forcearchitectures = forcearchitectures;
+	d.forcesection = forcesection;
+	d.forcepriority = forcepriority;
+	d.packagetype = packagetype;
+	d.distribution = distribution;
+	d.debfilename = debfilename;
+	d.needssourceversion = tracks != NULL;
+	r = ingestdeb(debfilename, deb_ingestdecide, &d,
+			&checksums, &filelist, &filelistsize);
+	if (RET_IS_OK(r)) {
+		r = deb_ingested(&d, &checksums, filelist, filelistsize);
+		free(filelist);
+		if (RET_WAS_ERROR(r))
+			checksums_free(checksums);
+	} else if (r == RET_NOTHING)
+		r = deb_readandpreinclude(&d, &checksums);
+	free(d.fullfilename);
+	pkg = d.pkg;
+	oinfo = d.oinfo;
 	if (RET_WAS_ERROR(r)) {
 		deb_free(pkg);
 		return r;
@@ -378,3 +487,486 @@ retvalue deb_add(component_t forcecomponent, const struct atomlist *forcearchite
 
 	return r;
 }
+
+/* Including many files at once is done in three steps, so the expensive
+ * part can be done in worker processes (with --checksum-jobs) and the
+ * database is changed at the end with everything sorted:
+ * 1) extract the control chunk and read the checksums (and if needed the
+ *    list of files) of every file,
+ * 2) parse them, decide where they go and copy them into the pool,
+ * 3) add the new files and then the packages to the database. */
+
+#define DEBBATCHSIZE 16
+
+struct debfile {
+	const char *filename;
+	/* taken before step 1, to notice changes before copying */
+	struct stat stat;
+	/* from step 1: */
+	/*@null@*/char *control;
+	/*@null@*/struct checksums *checksums;
+	bool wantfilelist;
+	/*@null@*/char *filelist;
+	size_t filelistsize;
+	/* from step 2: */
+	/*@null@*/struct debpackage *pkg;
+	const struct overridedata *oinfo;
+	bool newinpool, improves, added;
+	retvalue result;
+};
+
+struct debbatch {
+	struct debfile *files;
+	size_t count, batches;
+};
+
+static inline size_t debbatchstart(const struct debbatch *batch, size_t i) {
+	return (batch->count * i) / batch->batches;
+}
+
+static retvalue debfile_keepcontrol(void *data, char *control, const char **destination_p, bool *wantfilelist_p) {
+	struct debfile *file = data;
+
+	file->control = control;
+	*destination_p = NULL;
+	*wantfilelist_p = file->wantfilelist;
+	return RET_OK;
+}
+
+static retvalue debfile_read(struct debfile *file) {
+	retvalue r;
+
+	r = ingestdeb(file->filename, debfile_keepcontrol, file,
+			&file->checksums, &file->filelist,
+			&file->filelistsize);
+	if (r != RET_NOTHING) {
+		if (RET_WAS_ERROR(r)) {
+			free(file->control);
+			file->control = NULL;
+			file->checksums = NULL;
+			file->filelist = NULL;
+		}
+		return r;
+	}
+	r = extractcontrol(&file->control, file->filename);
+	if (RET_WAS_ERROR(r)) {
+		file->control = NULL;
+		return r;
+	}
+	r = checksums_read(file->filename, &file->checksums);
+	if (r == RET_NOTHING) {
+		fprintf(stderr, "Could not open '%s'!\n", file->filename);
+		r = RET_ERROR_MISSING;
+	}
+	if (RET_WAS_ERROR(r)) {
+		free(file->control);
+		file->control = NULL;
+		file->checksums = NULL;
+	}
+	return r;
+}
+
+static retvalue debbatch_run(void *data, size_t i, int fd) {
+	struct debbatch *batch = data;
+	size_t j, end = debbatchstart(batch, i + 1);
+	retvalue r;
+
+	for (j = debbatchstart(batch, i) ; j < end ; j++) {
+		struct debfile *file = &batch->files[j];
+		const char *combined;
+		size_t len;
+		int result;
+
+		result = debfile_read(file);
+		if (result == RET_ERROR_OOM)
+			return RET_ERROR_OOM;
+		r = jobs_write(fd, &result, sizeof(result));
+		if (RET_IS_OK(result) && RET_IS_OK(r))
+			r = jobs_write(fd, file->control,
+					strlen(file->control) + 1);
+		if (RET_IS_OK(result) && RET_IS_OK(r)) {
+			r = checksums_getcombined(file->checksums,
+					&combined, &len);
+			if (RET_IS_OK(r))
+				r = jobs_write(fd, combined, len + 1);
+		}
+		/* the list of files (if read) with its size before it */
+		if (RET_IS_OK(result) && RET_IS_OK(r)) {
+			len = (file->filelist == NULL)?0:file->filelistsize;
+			r = jobs_write(fd, &len, sizeof(len));
+			if (RET_IS_OK(r) && len > 0)
+				r = jobs_write(fd, file->filelist, len);
+		}
+		if (RET_WAS_ERROR(r))
+			return r;
+	}
+	return RET_OK;
+}
+
+static retvalue debbatch_done(void *data, size_t i, const char *output, size_t len) {
+	struct debbatch *batch = data;
+	size_t j, end = debbatchstart(batch, i + 1);
+	retvalue r;
+
+	for (j = debbatchstart(batch, i) ; j < end ; j++) {
+		struct debfile *file = &batch->files[j];
+		int status;
+		size_t l;
+
+		if (len < sizeof(status))
+			break;
+		memcpy(&status, output, sizeof(status));
+		output += sizeof(status);
+		len -= sizeof(status);
+		file->result = (retvalue)status;
+		if (!RET_IS_OK(file->result))
+			continue;
+		l = strnlen(output, len);
+		if (l >= len)
+			break;
+		file->control = strndup(output, l);
+		if (FAILEDTOALLOC(file->control))
+			return RET_ERROR_OOM;
+		output += l + 1;
+		len -= l + 1;
+		l = strnlen(output, len);
+		if (l >= len)
+			break;
+		r = checksums_setall(&file->checksums, output, l);
+		if (RET_WAS_ERROR(r))
+			return r;
+		output += l + 1;
+		len -= l + 1;
+		if (len < sizeof(l))
+			break;
+		memcpy(&l, output, sizeof(l));
+		output += sizeof(l);
+		len -= sizeof(l);
+		if (l > len)
+			break;
+		if (l > 0) {
+			file->filelist = malloc(l);
+			if (FAILEDTOALLOC(file->filelist))
+				return RET_ERROR_OOM;
+			memcpy(file->filelist, output, l);
+			file->filelistsize = l;
+			output += l;
+			len -= l;
+		}
+	}
+	if (j < end || len != 0) {
+		fprintf(stderr,
+"Internal Error: malformed output of worker process reading .deb files!\n");
+		return RET_ERROR_INTERNAL;
+	}
+	return RET_OK;
+}
+
+static retvalue debbatch_read(struct debbatch *batch) {
+	size_t i;
+
+	if (global.checksumjobs > 1 && batch->count > 1) {
+		batch->batches = (batch->count + DEBBATCHSIZE - 1)
+			/ DEBBATCHSIZE;
+		return jobs_run(global.checksumjobs, batch->batches,
+				debbatch_run, debbatch_done, batch);
+	}
+	for (i = 0 ; i < batch->count ; i++) {
+		if (interrupted())
+			return RET_ERROR_INTERRUPTED;
+		batch->files[i].result = debfile_read(&batch->files[i]);
+		if (batch->files[i].result == RET_ERROR_OOM)
+			return RET_ERROR_OOM;
+	}
+	return RET_OK;
+}
+
+/* remove a file only this run copied into the pool, while it is not yet
+ * in the database */
+static void debfile_removenew(struct debfile *file) {
+	char *fullfilename;
+
+	if (!file->newinpool)
+		return;
+	fullfilename = files_calcfullfilename(file->pkg->filekey);
+	if (FAILEDTOALLOC(fullfilename))
+		return;
+	deletefile(fullfilename);
+	free(fullfilename);
+	file->newinpool = false;
+}
+
+/* copy into the pool (or compare with the file already there or with the
+ * file of the same name from this batch) and complete the control chunk */
+static retvalue debfile_place(struct debfile *file, /*@null@*/const struct debfile *same) {
+	struct debpackage *pkg = file->pkg;
+	struct checksums *checksums;
+	char *control;
+	bool improves;
+	retvalue r;
+
+	if (same != NULL) {
+		if (!checksums_check(same->checksums, file->checksums,
+					&improves)) {
+			fprintf(stderr,
+"ERROR: '%s' cannot be included as '%s', as '%s' is put there, too, but:\n",
+				file->filename, pkg->filekey, same->filename);
+			checksums_printdifferences(stderr, same->checksums,
+					file->checksums);
+			return RET_ERROR_WRONG_MD5;
+		}
+		checksums = checksums_dup(same->checksums);
+		if (FAILEDTOALLOC(checksums))
+			return RET_ERROR_OOM;
+	} else {
+		r = files_preincludeknown(file->filename, pkg->filekey,
+				file->checksums, &file->stat,
+				&checksums, &file->improves);
+		if (RET_WAS_ERROR(r))
+			return r;
+		file->newinpool = RET_IS_OK(r);
+	}
+	checksums_free(file->checksums);
+	file->checksums = checksums;
+
+	r = binaries_complete(&pkg->deb, pkg->filekey, checksums, file->oinfo,
+			pkg->deb.section, pkg->deb.priority, &control);
+	if (RET_WAS_ERROR(r)) {
+		/* it will not get into checksums.db */
+		debfile_removenew(file);
+		return r;
+	}
+	free(pkg->deb.control); pkg->deb.control = control;
+	return RET_OK;
+}
+
+static int debfile_comparefilekeys(const void *a, const void *b) {
+	const struct debfile *f1 = *(const struct debfile * const *)a;
+	const struct debfile *f2 = *(const struct debfile * const *)b;
+	int c = strcmp(f1->pkg->filekey, f2->pkg->filekey);
+
+	if (c != 0)
+		return c;
+	return (f1 < f2) ? -1 : (f1 > f2);
+}
+
+static int debfile_comparenames(const void *a, const void *b) {
+	const struct debfile *f1 = *(const struct debfile * const *)a;
+	const struct debfile *f2 = *(const struct debfile * const *)b;
+	int c = strcmp(f1->pkg->deb.name, f2->pkg->deb.name);
+
+	if (c != 0)
+		return c;
+	return (f1 < f2) ? -1 : (f1 > f2);
+}
+
+static void debbatch_removenew(struct debfile **sorted, size_t count) {
+	size_t i;
+
+	for (i = 0 ; i < count ; i++)
+		debfile_removenew(sorted[i]);
+}
+
+static retvalue debbatch_add(struct debfile **sorted, size_t count, const struct atomlist *forcearchitectures, packagetype_t packagetype, struct distribution *distribution, /*@null@*/trackingdb tracks) {
+	const struct debfile *same = NULL;
+	retvalue r;
+	size_t i;
+
+	/* first all files into checksums.db (sorted by filekey) */
+	for (i = 0 ; i < count ; i++) {
+		struct debfile *file = sorted[i];
+
+		if (same != NULL && strcmp(same->pkg->filekey,
+					file->pkg->filekey) == 0) {
+			if (RET_WAS_ERROR(same->result))
+				file->result = same->result;
+			continue;
+		}
+		same = file;
+		if (file->newinpool) {
+			r = files_add_checksums(file->pkg->filekey,
+					file->checksums);
+			if (RET_WAS_ERROR(r))
+				debfile_removenew(file);
+			else if (RET_IS_OK(r) && file->filelist != NULL &&
+					contents_needsfilelist(distribution,
+						packagetype,
+						file->pkg->component))
+				r = filelist_cache(file->pkg->filekey,
+						file->filelist,
+						file->filelistsize);
+		} else if (file->improves)
+			r = files_replace_checksums(file->pkg->filekey,
+					file->checksums);
+		else
+			r = RET_NOTHING;
+		if (RET_WAS_ERROR(r))
+			file->result = r;
+		if (r == RET_ERROR_OOM)
+			return r;
+	}
+	/* then all packages sorted by name */
+	qsort(sorted, count, sizeof(struct debfile *), debfile_comparenames);
+	for (i = 0 ; i < count ; i++) {
+		struct debfile *file = sorted[i];
+		struct trackingdata trackingdata;
+
+		if (RET_WAS_ERROR(file->result))
+			continue;
+		if (interrupted())
+			return RET_ERROR_INTERRUPTED;
+		causingfile = file->filename;
+		if (tracks != NULL) {
+			assert(file->pkg->deb.sourceversion != NULL);
+			r = trackingdata_summon(tracks, file->pkg->deb.source,
+					file->pkg->deb.sourceversion,
+					&trackingdata);
+			if (RET_WAS_ERROR(r)) {
+				file->result = r;
+				if (r == RET_ERROR_OOM)
+					return r;
+				continue;
+			}
+		}
+		r = deb_addprepared(file->pkg, forcearchitectures,
+				packagetype, distribution,
+				(tracks != NULL)?&trackingdata:NULL);
+		RET_UPDATE(distribution->status, r);
+		if (tracks != NULL) {
+			retvalue r2;
+			r2 = trackingdata_finish(tracks, &trackingdata);
+			RET_ENDUPDATE(r, r2);
+		}
+		file->result = r;
+		file->added = true;
+		if (r == RET_ERROR_OOM)
+			return r;
+	}
+	return RET_OK;
+}
+
+/* the same as deb_add for many files at once */
+retvalue deb_addfiles(component_t forcecomponent, const struct atomlist *forcearchitectures, const char *forcesection, const char *forcepriority, packagetype_t packagetype, struct distribution *distribution, const struct strlist *debfilenames, int delete, trackingdb tracks) {
+	struct debbatch batch;
+	struct debfile **sorted;
+	const struct debfile *same;
+	const struct atomlist *components;
+	bool wantfilelists = false;
+	size_t i, count;
+	int j;
+	retvalue result, r;
+
+	batch.count = debfilenames->count;
+	batch.batches = 0;
+	batch.files = nzNEW(batch.count, struct debfile);
+	if (FAILEDTOALLOC(batch.files))
+		return RET_ERROR_OOM;
+	sorted = nNEW(batch.count, struct debfile *);
+	if (FAILEDTOALLOC(sorted)) {
+		free(batch.files);
+		return RET_ERROR_OOM;
+	}
+	components = (packagetype == pt_udeb)?&distribution->udebcomponents:
+		&distribution->components;
+	for (j = 0 ; j < components->count ; j++) {
+		if (contents_needsfilelist(distribution, packagetype,
+					components->atoms[j]))
+			wantfilelists = true;
+	}
+	for (i = 0 ; i < batch.count ; i++) {
+		batch.files[i].filename = debfilenames->values[i];
+		batch.files[i].wantfilelist = wantfilelists;
+		batch.files[i].result = RET_ERROR;
+		/* if this fails, reading the file will tell why */
+		if (stat(batch.files[i].filename, &batch.files[i].stat) != 0)
+			memset(&batch.files[i].stat, 0,
+					sizeof(batch.files[i].stat));
+	}
+
+	result = debbatch_read(&batch);
+
+	count = 0;
+	for (i = 0 ; i < batch.count && !RET_WAS_ERROR(result) ; i++) {
+		struct debfile *file = &batch.files[i];
+
+		if (RET_WAS_ERROR(file->result))
+			continue;
+		if (interrupted()) {
+			result = RET_ERROR_INTERRUPTED;
+			break;
+		}
+		causingfile = file->filename;
+		r = deb_read(&file->pkg, file->filename, file->control,
+				tracks != NULL);
+		file->control = NULL;
+		if (RET_IS_OK(r))
+			r = deb_preparelocation(file->pkg, forcecomponent,
+					forcearchitectures, forcesection,
+					forcepriority, packagetype,
+					distribution, &file->oinfo,
+					file->filename);
+		file->result = r;
+		if (RET_IS_OK(r))
+			sorted[count++] = file;
+		else if (r == RET_ERROR_OOM)
+			result = r;
+	}
+	if (!RET_WAS_ERROR(result)) {
+		qsort(sorted, count, sizeof(struct debfile *),
+				debfile_comparefilekeys);
+		same = NULL;
+		for (i = 0 ; i < count ; i++) {
+			struct debfile *file = sorted[i];
+
+			if (interrupted()) {
+				result = RET_ERROR_INTERRUPTED;
+				break;
+			}
+			if (same != NULL && strcmp(same->pkg->filekey,
+						file->pkg->filekey) != 0)
+				same = NULL;
+			causingfile = file->filename;
+			file->result = debfile_place(file, same);
+			if (file->result == RET_ERROR_OOM) {
+				result = RET_ERROR_OOM;
+				break;
+			}
+			if (same == NULL && RET_IS_OK(file->result))
+				same = file;
+		}
+		if (RET_WAS_ERROR(result))
+			/* nothing is in the database yet, so remove them */
+			debbatch_removenew(sorted, count);
+	}
+	if (!RET_WAS_ERROR(result)) {
+		size_t k = 0;
+
+		for (i = 0 ; i < count ; i++) {
+			if (RET_IS_OK(sorted[i]->result))
+				sorted[k++] = sorted[i];
+		}
+		result = debbatch_add(sorted, k, forcearchitectures,
+				packagetype, distribution, tracks);
+	}
+	causingfile = NULL;
+
+	if (!RET_WAS_ERROR(result))
+		result = RET_NOTHING;
+	for (i = 0 ; i < batch.count ; i++) {
+		struct debfile *file = &batch.files[i];
+
+		if (file->added && RET_IS_OK(file->result) && delete >= D_MOVE)
+			deletefile(file->filename);
+		else if (file->added && file->result == RET_NOTHING &&
+				delete >= D_DELETE)
+			deletefile(file->filename);
+		RET_UPDATE(result, file->result);
+		free(file->control);
+		free(file->filelist);
+		checksums_free(file->checksums);
+		deb_free(file->pkg);
+	}
+	free(sorted);
+	free(batch.files);
+	return result;
+}
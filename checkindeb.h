@@ -19,6 +19,9 @@
  * package. (forcesection and forcepriority have higher priority than the
  * information there), */
 retvalue deb_add(component_t, const struct atomlist * /*forcearchitectures*/, /*@null@*/const char * /*forcesection*/, /*@null@*/const char * /*forcepriority*/, packagetype_t, struct distribution *, const char * /*debfilename*/, int /*delete*/, /*@null@*/trackingdb);
+/* the same for many files at once, reading them in parallel with
+ * --checksum-jobs and changing the database at the end */
+retvalue deb_addfiles(component_t, const struct atomlist * /*forcearchitectures*/, /*@null@*/const char * /*forcesection*/, /*@null@*/const char * /*forcepriority*/, packagetype_t, struct distribution *, const struct strlist * /*debfilenames*/, int /*delete*/, /*@null@*/trackingdb);
 
 /* in two steps */
 struct debpackage;
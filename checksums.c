@@ -27,6 +27,11 @@
 #include <assert.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/time.h>
+#include <sys/ioctl.h>
+#ifdef HAVE_LINUX_FS_H
+#include <linux/fs.h>
+#endif
 
 #define CHECKSUMS_CONTEXT visible
 #include "error.h"
@@ -36,15 +41,16 @@
 #include "names.h"
 #include "dirs.h"
 #include "configparser.h"
+#include "shaext.h"
 
 const char * const changes_checksum_names[] = {
-	"Files", "Checksums-Sha1", "Checksums-Sha256"
+	"Files", "Checksums-Sha1", "Checksums-Sha256", "Checksums-Sha512"
 };
 const char * const source_checksum_names[] = {
-	"Files", "Checksums-Sha1", "Checksums-Sha256"
+	"Files", "Checksums-Sha1", "Checksums-Sha256", "Checksums-Sha512"
 };
 const char * const release_checksum_names[cs_hashCOUNT] = {
-	"MD5Sum", "SHA1", "SHA256"
+	"MD5Sum", "SHA1", "SHA256", "SHA512"
 };
 
 
@@ -73,9 +79,17 @@ struct checksums {
 #define checksums_hashpart(c, t) ((c)->representation + (c)->parts[t].ofs)
 #define checksums_totallength(c) ((c)->parts[cs_length].ofs + (c)->parts[cs_length].len)
 
+/* the type of an extended hash from its character in the representation,
+ * cs_md5sum if it is not (yet) known */
+static inline enum checksumtype extendedtype(char typeid) {
+	if (typeid < '1' || typeid >= '1' + (cs_hashCOUNT - cs_firstEXTENDED))
+		return cs_md5sum;
+	return cs_firstEXTENDED + (typeid - '1');
+}
+
 
 static const char * const hash_name[cs_COUNT] =
-	{ "md5", "sha1", "sha256", "size" };
+	{ "md5", "sha1", "sha256", "sha512", "size" };
 
 void checksums_free(struct checksums *checksums) {
 	free(checksums);
@@ -272,6 +286,7 @@ retvalue checksums_parse(struct checksums **checksums_p, const char *combinedche
 	const char *p = combinedchecksum;
 	/*@dependent@*/char *d;
 	char type;
+	enum checksumtype cs;
 	/*@dependent@*/const char *start;
 
 	n = malloc(sizeof(struct checksums) + len + 1);
@@ -295,18 +310,13 @@ retvalue checksums_parse(struct checksums **checksums_p, const char *combinedche
 		*(d++) = ':';
 		*(d++) = type;
 		*(d++) = ':';
-		if (type == '1') {
+		cs = extendedtype(type);
+		if (cs != cs_md5sum) {
 			start = d;
-			n->parts[cs_sha1sum].ofs = d - n->representation;
+			n->parts[cs].ofs = d - n->representation;
 			while (*p != ' ' && *p != '\0')
 				*(d++) = *(p++);
-			n->parts[cs_sha1sum].len = (hashlen_t)(d - start);
-		} else if (type == '2') {
-			start = d;
-			n->parts[cs_sha256sum].ofs = d - n->representation;
-			while (*p != ' ' && *p != '\0')
-				*(d++) = *(p++);
-			n->parts[cs_sha256sum].len = (hashlen_t)(d - start);
+			n->parts[cs].len = (hashlen_t)(d - start);
 		} else {
 			while (*p != ' ' && *p != '\0')
 				*(d++) = *(p++);
@@ -500,6 +510,7 @@ retvalue checksums_combine(struct checksums **checksums_p, const struct checksum
 	const char *o, *b, *start;
 	char /*@dependent@*/ *d;
 	char typeid;
+	enum checksumtype cs;
 
 	n = malloc(sizeof(struct checksums)+ len + 1);
 	if (FAILEDTOALLOC(n))
@@ -514,18 +525,13 @@ retvalue checksums_combine(struct checksums **checksums_p, const struct checksum
 			typeid = *o;
 			*(d++) = *(o++);
 			*(d++) = *(o++);
-			if (typeid == '1') {
+			cs = extendedtype(typeid);
+			if (cs != cs_md5sum) {
 				start = d;
-				n->parts[cs_sha1sum].ofs = d - n->representation;
+				n->parts[cs].ofs = d - n->representation;
 				while (*o != ' ' && *o != '\0')
 					*(d++) = *(o++);
-				n->parts[cs_sha1sum].len = (hashlen_t)(d - start);
-			} else if (typeid == '2') {
-				start = d;
-				n->parts[cs_sha256sum].ofs = d - n->representation;
-				while (*o != ' ' && *o != '\0')
-					*(d++) = *(o++);
-				n->parts[cs_sha256sum].len = (hashlen_t)(d - start);
+				n->parts[cs].len = (hashlen_t)(d - start);
 			} else
 				while (*o != ' ' && *o != '\0')
 					*(d++) = *(o++);
@@ -545,22 +551,15 @@ retvalue checksums_combine(struct checksums **checksums_p, const struct checksum
 			typeid = *b;
 			*(d++) = *(b++);
 			*(d++) = *(b++);
-			if (typeid == '1') {
-				if (improvedhashes != NULL)
-					improvedhashes[cs_sha1sum] = true;
-				start = d;
-				n->parts[cs_sha1sum].ofs = d - n->representation;
-				while (*b != ' ' && *b != '\0')
-					*(d++) = *(b++);
-				n->parts[cs_sha1sum].len = (hashlen_t)(d - start);
-			} else if (typeid == '2') {
+			cs = extendedtype(typeid);
+			if (cs != cs_md5sum) {
 				if (improvedhashes != NULL)
-					improvedhashes[cs_sha256sum] = true;
+					improvedhashes[cs] = true;
 				start = d;
-				n->parts[cs_sha256sum].ofs = d - n->representation;
+				n->parts[cs].ofs = d - n->representation;
 				while (*b != ' ' && *b != '\0')
 					*(d++) = *(b++);
-				n->parts[cs_sha256sum].len = (hashlen_t)(d - start);
+				n->parts[cs].len = (hashlen_t)(d - start);
 			} else
 				while (*b != ' ' && *b != '\0')
 					*(d++) = *(b++);
@@ -807,7 +806,7 @@ retvalue checksumsarray_parse(struct checksumsarray *out, const struct strlist l
 	return RET_OK;
 }
 
-retvalue checksumsarray_genfilelist(const struct checksumsarray *a, char **md5_p, char **sha1_p, char **sha256_p) {
+retvalue checksumsarray_genfilelist(const struct checksumsarray *a, char **md5_p, char **sha1_p, char **sha256_p, char **sha512_p) {
 	size_t lens[cs_hashCOUNT];
 	bool missing[cs_hashCOUNT];
 	char *filelines[cs_hashCOUNT];
@@ -882,6 +881,7 @@ retvalue checksumsarray_genfilelist(const struct checksumsarray *a, char **md5_p
 	*md5_p = filelines[cs_md5sum];
 	*sha1_p = filelines[cs_sha1sum];
 	*sha256_p = filelines[cs_sha256sum];
+	*sha512_p = filelines[cs_sha512sum];
 	return RET_OK;
 }
 
@@ -1139,14 +1139,24 @@ void checksumscontext_init(struct checksumscontext *context) {
 	MD5Init(&context->md5);
 	SHA1Init(&context->sha1);
 	SHA256Init(&context->sha256);
+	SHA512Init(&context->sha512);
 }
 
+/* all hashes are computed for a small part of the data after the other,
+ * so the data only has to be read from memory once */
+#define CHECKSUMS_CHUNKSIZE 8192
+
 void checksumscontext_update(struct checksumscontext *context, const unsigned char *data, size_t len) {
-	MD5Update(&context->md5, data, len);
-// TODO: sha1 and sha256 share quite some stuff,
-// the code can most likely be combined with quite some synergies..
-	SHA1Update(&context->sha1, data, len);
-	SHA256Update(&context->sha256, data, len);
+	while (len > 0) {
+		size_t l = (len > CHECKSUMS_CHUNKSIZE)?CHECKSUMS_CHUNKSIZE:len;
+
+		MD5Update(&context->md5, data, l);
+		SHA1Update(&context->sha1, data, l);
+		SHA256Update(&context->sha256, data, l);
+		SHA512Update(&context->sha512, data, l);
+		data += l;
+		len -= l;
+	}
 }
 
 static const char tab[16] = {'0', '1', '2', '3', '4', '5', '6', '7',
@@ -1155,13 +1165,15 @@ static const char tab[16] = {'0', '1', '2', '3', '4', '5', '6', '7',
 retvalue checksums_from_context(struct checksums **out, struct checksumscontext *context) {
 #define MD5_DIGEST_SIZE 16
 	unsigned char md5buffer[MD5_DIGEST_SIZE], sha1buffer[SHA1_DIGEST_SIZE],
-		      sha256buffer[SHA256_DIGEST_SIZE];
+		      sha256buffer[SHA256_DIGEST_SIZE],
+		      sha512buffer[SHA512_DIGEST_SIZE];
 	char *d;
 	unsigned int i;
 	struct checksums *n;
 
 	n = malloc(sizeof(struct checksums) + 2*MD5_DIGEST_SIZE
-			+ 2*SHA1_DIGEST_SIZE + 2*SHA256_DIGEST_SIZE + 30);
+			+ 2*SHA1_DIGEST_SIZE + 2*SHA256_DIGEST_SIZE
+			+ 2*SHA512_DIGEST_SIZE + 30);
 	if (FAILEDTOALLOC(n))
 		return RET_ERROR_OOM;
 	memset(n, 0, sizeof(struct checksums));
@@ -1190,6 +1202,18 @@ retvalue checksums_from_context(struct checksums **out, struct checksumscontext
 	}
 	*(d++) = ' ';
 
+	*(d++) = ':';
+	*(d++) = '3';
+	*(d++) = ':';
+	n->parts[cs_sha512sum].ofs = d - n->representation;
+	n->parts[cs_sha512sum].len = 2*SHA512_DIGEST_SIZE;
+	SHA512Final(&context->sha512, sha512buffer);
+	for (i = 0 ; i < SHA512_DIGEST_SIZE ; i++) {
+		*(d++) = tab[sha512buffer[i] >> 4];
+		*(d++) = tab[sha512buffer[i] & 0xF];
+	}
+	*(d++) = ' ';
+
 	n->parts[cs_md5sum].ofs = d - n->representation;
 	assert (d - n->representation == n->parts[cs_md5sum].ofs);
 	n->parts[cs_md5sum].len = 2*MD5_DIGEST_SIZE;
@@ -1203,7 +1227,7 @@ retvalue checksums_from_context(struct checksums **out, struct checksumscontext
 	assert (d - n->representation == n->parts[cs_length].ofs);
 	n->parts[cs_length].len = (hashlen_t)snprintf(d,
 			2*MD5_DIGEST_SIZE + 2*SHA1_DIGEST_SIZE
-			+ 2*SHA256_DIGEST_SIZE + 30
+			+ 2*SHA256_DIGEST_SIZE + 2*SHA512_DIGEST_SIZE + 30
 			- (d - n->representation), "%lld",
 			(long long)context->sha1.count);
 	assert (strlen(d) == n->parts[cs_length].len);
@@ -1214,7 +1238,8 @@ retvalue checksums_from_context(struct checksums **out, struct checksumscontext
 bool checksums_iscomplete(const struct checksums *checksums) {
 	return checksums->parts[cs_md5sum].len != 0 &&
 	    checksums->parts[cs_sha1sum].len != 0 &&
-	    checksums->parts[cs_sha256sum].len != 0;
+	    checksums->parts[cs_sha256sum].len != 0 &&
+	    checksums->parts[cs_sha512sum].len != 0;
 }
 
 /* Collect missing checksums.
@@ -1228,7 +1253,7 @@ retvalue checksums_complete(struct checksums **checksums_p, const char *fullfile
 
 retvalue checksums_read(const char *fullfilename, /*@out@*/struct checksums **checksums_p) {
 	struct checksumscontext context;
-	static const size_t bufsize = 16384;
+	static const size_t bufsize = 262144;
 	unsigned char *buffer = malloc(bufsize);
 	ssize_t sizeread;
 	int e, i;
@@ -1252,6 +1277,10 @@ retvalue checksums_read(const char *fullfilename, /*@out@*/struct checksums **ch
 		free(buffer);
 		return RET_ERRNO(e);
 	}
+#ifdef HAVE_POSIX_FADVISE
+	/* ask for more read-ahead, as the file is read only once */
+	(void)posix_fadvise(infd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
 	do {
 		sizeread = read(infd, buffer, bufsize);
 		if (sizeread < 0) {
@@ -1381,6 +1410,152 @@ retvalue checksums_copyfile(const char *destination, const char *source, bool de
 	return checksums_from_context(checksums_p, &context);
 }
 
+static retvalue clonefile_data(int outfd, int infd, off_t size, const char *destination, const char *source) {
+	static const size_t bufsize = 262144;
+	unsigned char *buffer;
+	ssize_t sizeread, written;
+	off_t done = 0;
+	int e;
+
+#ifdef FICLONE
+	/* share the blocks if both are on the same copy-on-write fs */
+	if (size > 0 && ioctl(outfd, FICLONE, infd) == 0)
+		return RET_OK;
+#endif
+#ifdef HAVE_COPY_FILE_RANGE
+	/* otherwise let the kernel copy, falling back to reading and
+	 * writing on any error (which then reports real errors) */
+	while (done < size) {
+		ssize_t got = copy_file_range(infd, NULL, outfd, NULL,
+				(size_t)(size - done), 0);
+		if (got <= 0)
+			break;
+		done += got;
+	}
+	if (done == size)
+		return RET_OK;
+#endif
+	buffer = malloc(bufsize);
+	if (FAILEDTOALLOC(buffer))
+		return RET_ERROR_OOM;
+	while ((sizeread = read(infd, buffer, bufsize)) != 0) {
+		const unsigned char *start = buffer;
+
+		if (sizeread < 0) {
+			e = errno;
+			if (e == EINTR)
+				continue;
+			fprintf(stderr, "Error %d while reading %s: %s\n",
+					e, source, strerror(e));
+			free(buffer);
+			return RET_ERRNO(e);
+		}
+		done += sizeread;
+		while (sizeread > 0) {
+			written = write(outfd, start, (size_t)sizeread);
+			if (written < 0) {
+				e = errno;
+				if (e == EINTR)
+					continue;
+				fprintf(stderr,
+"Error %d while writing to %s: %s\n",
+						e, destination, strerror(e));
+				free(buffer);
+				return RET_ERRNO(e);
+			}
+			sizeread -= written;
+			start += written;
+		}
+	}
+	free(buffer);
+	if (done != size) {
+		fprintf(stderr, "'%s' changed while copying it to '%s'!\n",
+				source, destination);
+		return RET_ERROR_WRONG_MD5;
+	}
+	return RET_OK;
+}
+
+/* st_mtime and st_ctime only have seconds everywhere, but together with
+ * the inode a change or a replacement since reading is still noticed */
+static inline bool stat_unchanged(const struct stat *now, const struct stat *then) {
+	return now->st_dev == then->st_dev && now->st_ino == then->st_ino &&
+		now->st_size == then->st_size &&
+		now->st_mtime == then->st_mtime &&
+		now->st_ctime == then->st_ctime;
+}
+
+retvalue checksums_clonefile(const char *destination, const char *source, const struct checksums *checksums, const struct stat *readstat) {
+	off_t size = checksums_getfilesize(checksums);
+	struct stat s;
+	retvalue r;
+	int e, infd, outfd;
+
+	infd = open(source, O_RDONLY|O_NOCTTY);
+	if (infd < 0) {
+		e = errno;
+		fprintf(stderr, "Error %d opening '%s': %s\n",
+				e, source, strerror(e));
+		return RET_ERRNO(e);
+	}
+	if (fstat(infd, &s) != 0) {
+		e = errno;
+		fprintf(stderr, "Error %d getting information about '%s': %s\n",
+				e, source, strerror(e));
+		(void)close(infd);
+		return RET_ERRNO(e);
+	}
+	if (s.st_size != size) {
+		fprintf(stderr,
+"'%s' changed after reading its checksums (size is now %llu instead of %llu)!\n",
+				source, (unsigned long long)s.st_size,
+				(unsigned long long)size);
+		(void)close(infd);
+		return RET_ERROR_WRONG_MD5;
+	}
+	if (readstat != NULL && !stat_unchanged(&s, readstat)) {
+		fprintf(stderr,
+"'%s' was changed or replaced after reading its checksums!\n",
+				source);
+		(void)close(infd);
+		return RET_ERROR_WRONG_MD5;
+	}
+	/* never write into another hardlink of a file already there */
+	if (unlink(destination) != 0 && errno != ENOENT) {
+		e = errno;
+		fprintf(stderr, "Error %d deleting '%s': %s\n",
+				e, destination, strerror(e));
+		(void)close(infd);
+		return RET_ERRNO(e);
+	}
+	outfd = open(destination, O_NOCTTY|O_WRONLY|O_CREAT|O_EXCL, 0666);
+	if (outfd < 0) {
+		e = errno;
+		fprintf(stderr, "Error %d creating '%s': %s\n",
+				e, destination, strerror(e));
+		(void)close(infd);
+		return RET_ERRNO(e);
+	}
+	r = clonefile_data(outfd, infd, size, destination, source);
+	/* a copy (unlike a reflink) might have got a later version */
+	if (RET_IS_OK(r) && readstat != NULL && (fstat(infd, &s) != 0 ||
+				!stat_unchanged(&s, readstat))) {
+		fprintf(stderr, "'%s' changed while copying it to '%s'!\n",
+				source, destination);
+		r = RET_ERROR_WRONG_MD5;
+	}
+	(void)close(infd);
+	if (close(outfd) != 0 && !RET_WAS_ERROR(r)) {
+		e = errno;
+		fprintf(stderr, "Error %d writing to %s: %s\n",
+				e, destination, strerror(e));
+		r = RET_ERRNO(e);
+	}
+	if (RET_WAS_ERROR(r))
+		deletefile(destination);
+	return r;
+}
+
 retvalue checksums_linkorcopyfile(const char *destination, const char *source, struct checksums **checksums_p) {
 	int i;
 	retvalue r;
@@ -1477,5 +1652,89 @@ const struct constant hashes_constants[cs_hashCOUNT+1] = {
 	{"md5", cs_md5sum},
 	{"sha1", cs_sha1sum},
 	{"sha256", cs_sha256sum},
+	{"sha512", cs_sha512sum},
 	{NULL, 0}
 }, *hashnames = hashes_constants;
+
+enum benchmarkhash { bh_md5, bh_sha1, bh_sha256, bh_sha512, bh_all };
+
+static double benchmark(enum benchmarkhash what, const unsigned char *buffer, size_t buffersize, unsigned int megabytes) {
+	struct checksumscontext context;
+	unsigned char digest[SHA512_DIGEST_SIZE];
+	struct timeval start, end;
+	unsigned long long total = 0, wanted;
+	double secs;
+
+	wanted = ((unsigned long long)megabytes) << 20;
+	checksumscontext_init(&context);
+	gettimeofday(&start, NULL);
+	while (total < wanted) {
+		switch (what) {
+			case bh_md5:
+				MD5Update(&context.md5, buffer, buffersize);
+				break;
+			case bh_sha1:
+				SHA1Update(&context.sha1, buffer, buffersize);
+				break;
+			case bh_sha256:
+				SHA256Update(&context.sha256,
+						buffer, buffersize);
+				break;
+			case bh_sha512:
+				SHA512Update(&context.sha512,
+						buffer, buffersize);
+				break;
+			case bh_all:
+				checksumscontext_update(&context,
+						buffer, buffersize);
+				break;
+		}
+		total += buffersize;
+	}
+	MD5Final(digest, &context.md5);
+	SHA1Final(&context.sha1, digest);
+	SHA256Final(&context.sha256, digest);
+	SHA512Final(&context.sha512, digest);
+	gettimeofday(&end, NULL);
+	secs = (end.tv_sec - start.tv_sec)
+		+ (end.tv_usec - start.tv_usec) / 1000000.0;
+	if (secs <= 0)
+		return 0;
+	return total / secs / (1024 * 1024);
+}
+
+retvalue checksums_benchmark(unsigned int megabytes) {
+	/* the size checksums_read uses */
+	static const size_t buffersize = 262144;
+	static const char * const names[] = {
+		"md5", "sha1", "sha256", "sha512",
+		"all (as when reading a file)"
+	};
+	enum benchmarkhash what;
+	unsigned char *buffer;
+	size_t i;
+
+	buffer = malloc(buffersize);
+	if (FAILEDTOALLOC(buffer))
+		return RET_ERROR_OOM;
+	for (i = 0 ; i < buffersize ; i++)
+		buffer[i] = (unsigned char)(i * 7 + (i >> 8));
+
+	for (what = bh_md5 ; what <= bh_all ; what++) {
+		double rate;
+
+		rate = benchmark(what, buffer, buffersize, megabytes);
+		printf("%s: %.1f MiB/s", names[what], rate);
+		if ((what == bh_sha1 || what == bh_sha256 || what == bh_all)
+				&& shaext_usable()) {
+			shaext_enable(false);
+			rate = benchmark(what, buffer, buffersize, megabytes);
+			shaext_enable(true);
+			printf(" (with SHA extensions, %.1f MiB/s without)",
+					rate);
+		}
+		putchar('\n');
+	}
+	free(buffer);
+	return RET_OK;
+}
@@ -16,6 +16,7 @@ enum checksumtype {
 #define cs_firstEXTENDED cs_sha1sum
 		cs_sha1sum,
 		cs_sha256sum,
+		cs_sha512sum,
 #define cs_hashCOUNT cs_length
 		/* must be last but one */
 		cs_length,
@@ -23,6 +24,7 @@ enum checksumtype {
 		cs_COUNT };
 
 struct checksums;
+struct stat;
 
 extern const char * const changes_checksum_names[];
 extern const char * const source_checksum_names[];
@@ -64,6 +66,11 @@ bool checksums_matches(const struct checksums *, enum checksumtype, const char *
 
 /* Copy file <origin> to file <destination>, calculating checksums */
 retvalue checksums_copyfile(const char * /*destination*/, const char * /*origin*/, bool /*deletetarget*/, /*@out@*/struct checksums **);
+/* Copy file <origin> with already known checksums to <destination>
+ * (sharing the data if the filesystem can do that), checking that the file
+ * was not changed since the stat taken before reading the checksums
+ * (only its size, if there is none) */
+retvalue checksums_clonefile(const char * /*destination*/, const char * /*origin*/, const struct checksums *, /*@null@*/const struct stat *);
 retvalue checksums_hardlink(const char * /*directory*/, const char * /*filekey*/, const char * /*sourcefilename*/, const struct checksums *);
 
 retvalue checksums_linkorcopyfile(const char * /*destination*/, const char * /*origin*/, /*@out@*/struct checksums **);
@@ -97,6 +104,9 @@ retvalue checksums_complete(struct checksums **, const char * /*fullfilename*/);
 
 void checksums_printdifferences(FILE *, const struct checksums * /*expected*/, const struct checksums * /*got*/);
 
+/* print the speed of the hash implementations (for __benchmarkhashes) */
+retvalue checksums_benchmark(unsigned int /*megabytes*/);
+
 retvalue checksums_combine(struct checksums **, const struct checksums *, /*@null@*/bool[cs_hashCOUNT]);
 
 typedef /*@only@*/ struct checksums *ownedchecksums;
@@ -107,7 +117,7 @@ struct checksumsarray {
 void checksumsarray_move(/*@out@*/struct checksumsarray *, /*@special@*/struct checksumsarray *array)/*@requires maxSet(array->names.values) >= array->names.count /\ maxSet(array->checksums) >= array->names.count @*/ /*@releases array->checksums, array->names.values @*/;
 void checksumsarray_done(/*@special@*/struct checksumsarray *array) /*@requires maxSet(array->names.values) >= array->names.count /\ maxSet(array->checksums) >= array->names.count @*/ /*@releases array->checksums, array->names.values @*/;
 retvalue checksumsarray_parse(/*@out@*/struct checksumsarray *, const struct strlist [cs_hashCOUNT], const char * /*filenametoshow*/);
-retvalue checksumsarray_genfilelist(const struct checksumsarray *, /*@out@*/char **, /*@out@*/char **, /*@out@*/char **);
+retvalue checksumsarray_genfilelist(const struct checksumsarray *, /*@out@*/char **, /*@out@*/char **, /*@out@*/char **, /*@out@*/char **);
 retvalue checksumsarray_include(struct checksumsarray *, /*@only@*/char *, const struct checksums *);
 void checksumsarray_resetunsupported(const struct checksumsarray *, bool[cs_hashCOUNT]);
 
@@ -125,11 +135,15 @@ struct configiterator;
 #ifndef REPREPRO_SHA256_H
 #include "sha256.h"
 #endif
+#ifndef REPREPRO_SHA512_H
+#include "sha512.h"
+#endif
 
 struct checksumscontext {
 	struct MD5Context md5;
 	struct SHA1_Context sha1;
 	struct SHA256_Context sha256;
+	struct SHA512_Context sha512;
 };
 
 void checksumscontext_init(/*@out@*/struct checksumscontext *);
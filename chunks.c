@@ -90,19 +90,14 @@ static retvalue chunk_getcontent(const char *chunk, const char *name, char **val
 */
 
 /* look for name in chunk. returns RET_NOTHING if not found */
-retvalue chunk_getvalue(const char *chunk, const char *name, char **value) {
-	const char *field;
-	char *val;
+/* the value chunk_getvalue returns for a field (without copying it) */
+static size_t getvaluelimits(const char *field, const char **start_p) {
 	const char *b, *e;
 
-	assert(value != NULL);
-	field = chunk_getfield(name, chunk);
-	if (field == NULL)
-		return RET_NOTHING;
-
 	b = field;
-	/* jump over spaces at the beginning */
-	if (xisspace(*b))
+	/* jump over spaces at the beginning (but not into the next line
+	 * if the value is empty) */
+	if (xisspace(*b) && *b != '\n')
 		b++;
 	/* search for the end */
 	e = b;
@@ -111,16 +106,61 @@ retvalue chunk_getvalue(const char *chunk, const char *name, char **value) {
 	/* remove trailing spaces */
 	while (e > b && xisspace(*e))
 		e--;
-	if (!xisspace(*e))
-		val = strndup(b, e - b + 1);
+	*start_p = b;
+	if (xisspace(*e))
+		return 0;
+	else if (*e == '\0')
+		return e - b;
 	else
-		val = strdup("");
+		return e - b + 1;
+}
+
+retvalue chunk_getvalue(const char *chunk, const char *name, char **value) {
+	const char *field;
+	char *val;
+	const char *b;
+	size_t len;
+
+	assert(value != NULL);
+	field = chunk_getfield(name, chunk);
+	if (field == NULL)
+		return RET_NOTHING;
+
+	len = getvaluelimits(field, &b);
+	val = strndup(b, len);
 	if (FAILEDTOALLOC(val))
 		return RET_ERROR_OOM;
 	*value = val;
 	return RET_OK;
 }
 
+void chunk_findvalues(const char **position_p, struct chunkvalue *values, int count, int wanted) {
+	const char *p = *position_p;
+	int i;
+
+	while (*p != '\0' && values[wanted].value == NULL) {
+		/* only a quick check, strncasecmp decides */
+		char c = *p | 0x20;
+
+		for (i = 0 ; i < count ; i++) {
+			struct chunkvalue *v = &values[i];
+
+			if (v->value != NULL || v->first != c ||
+					strncasecmp(p, v->name, v->namelen) != 0
+					|| p[v->namelen] != ':')
+				continue;
+			v->len = getvaluelimits(p + v->namelen + 1, &v->value);
+		}
+		p = strchr(p, '\n');
+		if (p == NULL) {
+			p = *position_p + strlen(*position_p);
+			break;
+		}
+		p++;
+	}
+	*position_p = p;
+}
+
 retvalue chunk_getextralinelist(const char *chunk, const char *name, struct strlist *strlist) {
 	retvalue r;
 	const char *f, *b, *e;
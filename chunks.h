@@ -9,6 +9,21 @@
 #include "strlist.h"
 #endif
 
+/* get the values (as chunk_getvalue would, but without copying them)
+ * of multiple fields while looking at every line only once:
+ * Continue at *position (initially the chunk) until values[wanted]
+ * is found or the chunk ends, setting the other values found on the
+ * way. (The caller sets name, namelen, first (the first character
+ * of name | 0x20) and value to NULL) */
+struct chunkvalue {
+	/*@dependent@*/const char *name;
+	size_t namelen;
+	char first;
+	/*@null@*//*@dependent@*/const char *value;
+	size_t len;
+};
+void chunk_findvalues(const char ** /*position*/, struct chunkvalue *, int /*count*/, int /*wanted*/);
+
 /* look for name in chunk. returns RET_NOTHING if not found */
 retvalue chunk_getvalue(const char *, const char *, /*@out@*/char **);
 retvalue chunk_getextralinelist(const char *, const char *, /*@out@*/struct strlist *);
@@ -40,9 +40,10 @@
 retvalue contentsoptions_parse(struct distribution *distribution, struct configiterator *iter) {
 	enum contentsflags {
 		cf_disable, cf_dummy, cf_udebs, cf_nodebs,
-		cf_uncompressed, cf_gz, cf_bz2,
+		cf_uncompressed, cf_gz, cf_bz2, cf_xz, cf_zstd,
 		cf_percomponent, cf_allcomponents,
 		cf_compatsymlink, cf_nocompatsymlink,
+		cf_incremental,
 		cf_COUNT
 	};
 	bool flags[cf_COUNT];
@@ -56,6 +57,9 @@ retvalue contentsoptions_parse(struct distribution *distribution, struct configi
 		{"allcomponents", cf_allcomponents},
 		{"compatsymlink", cf_compatsymlink},
 		{"nocompatsymlink", cf_nocompatsymlink},
+		{"incremental", cf_incremental},
+		{".zst", cf_zstd},
+		{".xz", cf_xz},
 		{".bz2", cf_bz2},
 		{".gz", cf_gz},
 		{".", cf_uncompressed},
@@ -104,6 +108,26 @@ retvalue contentsoptions_parse(struct distribution *distribution, struct configi
 			config_filename(iter), config_line(iter));
 		flags[cf_bz2] = false;
 	}
+#endif
+#ifndef HAVE_LIBLZMA
+	if (flags[cf_xz]) {
+		fprintf(stderr,
+"Warning: Ignoring request to generate .xz'ed Contents files.\n"
+"(xz support disabled at build time.)\n"
+"Request was in %s in the Contents header ending in line %u\n",
+			config_filename(iter), config_line(iter));
+		flags[cf_xz] = false;
+	}
+#endif
+#ifndef HAVE_LIBZSTD
+	if (flags[cf_zstd]) {
+		fprintf(stderr,
+"Warning: Ignoring request to generate .zst'ed Contents files.\n"
+"(zstd support disabled at build time.)\n"
+"Request was in %s in the Contents header ending in line %u\n",
+			config_filename(iter), config_line(iter));
+		flags[cf_zstd] = false;
+	}
 #endif
 	distribution->contents.compressions = 0;
 	if (flags[cf_uncompressed])
@@ -113,8 +137,17 @@ retvalue contentsoptions_parse(struct distribution *distribution, struct configi
 #ifdef HAVE_LIBBZ2
 	if (flags[cf_bz2])
 		distribution->contents.compressions |= IC_FLAG(ic_bzip2);
+#endif
+#ifdef HAVE_LIBLZMA
+	if (flags[cf_xz])
+		distribution->contents.compressions |= IC_FLAG(ic_xz);
+#endif
+#ifdef HAVE_LIBZSTD
+	if (flags[cf_zstd])
+		distribution->contents.compressions |= IC_FLAG(ic_zstd);
 #endif
 	distribution->contents.flags.udebs = flags[cf_udebs];
+	distribution->contents.flags.incremental = flags[cf_incremental];
 	distribution->contents.flags.nodebs = flags[cf_nodebs];
 	if (flags[cf_allcomponents])
 		distribution->contents.flags.allcomponents = true;
@@ -175,12 +208,446 @@ static retvalue addpackagetocontents(UNUSED(struct distribution *di), UNUSED(str
 	return r;
 }
 
+static retvalue addtargetcontents(struct target *target, struct filelist_list *contents) {
+	struct target_cursor iterator IFSTUPIDCC(=TARGET_CURSOR_ZERO);
+	retvalue result, r;
+
+	result = target_openiterator(target, READONLY, &iterator);
+	if (RET_IS_OK(result)) {
+		const char *package, *control;
+
+		while (target_nextpackage(&iterator, &package, &control)) {
+			r = addpackagetocontents(target->distribution,
+					target, package, control, contents);
+			RET_UPDATE(result, r);
+			if (RET_WAS_ERROR(r))
+				break;
+		}
+		r = target_closeiterator(&iterator);
+		RET_ENDUPDATE(result, r);
+	}
+	return result;
+}
+
+/* Incremental Contents generation:
+ * For every target a table in contents.index.db maps each file to the sorted
+ * list of packages containing it. Every modification of the packages of
+ * a target is recorded (see contents_recordchange), so that only the
+ * file lists of those have to be applied to that table.
+ * The empty key marks the table as up to date, it is removed with the first
+ * change of a target (so that a table not updated because of errors,
+ * interruptions or because no export happened is regenerated next time). */
+
+struct contentschange {
+	/*@null@*/struct contentschange *next;
+	bool add;
+	char *filekey;
+	/* section/packagename */
+	char package[];
+};
+
+static const char uptodatekey[] = "";
+
+void contents_freechanges(struct target *target) {
+	while (target->contentschanges != NULL) {
+		struct contentschange *c = target->contentschanges;
+
+		target->contentschanges = c->next;
+		free(c->filekey);
+		free(c);
+	}
+}
+
+static retvalue markindexchanged(struct target *target) {
+	struct table *table;
+	bool exists, incremental;
+	retvalue r, r2;
+
+	assert (target->contentsindex == cis_untouched);
+
+	target->contentsindex = cis_invalid;
+	incremental = target->distribution->contents.flags.incremental &&
+		contents_needsfilelist(target->distribution,
+				target->packagetype, target->component);
+	if (!incremental) {
+		/* nothing to record, only an index left from when this
+		 * was generated incrementally must no longer be trusted */
+		r = database_hascontentsindex(&exists);
+		if (RET_WAS_ERROR(r) || !exists)
+			return r;
+	}
+	r = database_opencontentsindex(target->identifier, false, false,
+			&table);
+	if (!RET_IS_OK(r))
+		return r;
+	r = table_deleterecord(table, uptodatekey, true);
+	r2 = table_close(table);
+	RET_ENDUPDATE(r, r2);
+	if (r == RET_OK && incremental)
+		target->contentsindex = cis_changed;
+	return r;
+}
+
+static retvalue recordpackage(struct target *target, const char *packagename, const char *control, bool add) {
+	struct contentschange *c;
+	char *section, *filekey;
+	size_t section_len, name_len;
+	retvalue r;
+
+	/* packages without those are not in Contents files, see above */
+	r = chunk_getvalue(control, "Section", &section);
+	if (!RET_IS_OK(r))
+		return r;
+	r = chunk_getvalue(control, "Filename", &filekey);
+	if (!RET_IS_OK(r)) {
+		free(section);
+		return r;
+	}
+	section_len = strlen(section);
+	name_len = strlen(packagename);
+	c = malloc(sizeof(struct contentschange) + section_len + name_len + 2);
+	if (FAILEDTOALLOC(c)) {
+		free(section);
+		free(filekey);
+		return RET_ERROR_OOM;
+	}
+	c->add = add;
+	c->filekey = filekey;
+	memcpy(c->package, section, section_len);
+	c->package[section_len] = '/';
+	memcpy(c->package + section_len + 1, packagename, name_len + 1);
+	free(section);
+	/* prepended, so the list is in reverse order */
+	c->next = target->contentschanges;
+	target->contentschanges = c;
+	return RET_OK;
+}
+
+retvalue contents_recordchange(struct target *target, const char *packagename, const char *oldcontrol, const char *newcontrol) {
+	retvalue r = RET_OK;
+
+	if (target->packagetype == pt_dsc)
+		return RET_NOTHING;
+	if (target->contentsindex == cis_untouched) {
+		r = markindexchanged(target);
+		if (RET_WAS_ERROR(r))
+			return r;
+	}
+	if (target->contentsindex != cis_changed)
+		return RET_OK;
+	if (oldcontrol != NULL)
+		r = recordpackage(target, packagename, oldcontrol, false);
+	if (newcontrol != NULL && !RET_WAS_ERROR(r))
+		r = recordpackage(target, packagename, newcontrol, true);
+	if (RET_WAS_ERROR(r)) {
+		/* as long as the packages database is fine, it is enough
+		 * to regenerate the index the next time */
+		target->contentsindex = cis_invalid;
+		contents_freechanges(target);
+		if (r != RET_ERROR_OOM)
+			return RET_OK;
+	}
+	return r;
+}
+
+struct indexedit {
+	char *filename;
+	size_t seq;
+	const struct contentschange *change;
+};
+
+struct indexedits {
+	struct indexedit *edits;
+	size_t count, size;
+	/*@dependent@*/const struct contentschange *current;
+	size_t seq;
+};
+
+static retvalue collectedit(void *data, const char *filename, size_t len) {
+	struct indexedits *e = data;
+	struct indexedit *n;
+
+	if (e->count >= e->size) {
+		size_t newsize = (e->size == 0)?1024:(2 * e->size);
+
+		n = realloc(e->edits, newsize * sizeof(struct indexedit));
+		if (FAILEDTOALLOC(n))
+			return RET_ERROR_OOM;
+		e->edits = n;
+		e->size = newsize;
+	}
+	n = &e->edits[e->count];
+	n->filename = strndup(filename, len);
+	if (FAILEDTOALLOC(n->filename))
+		return RET_ERROR_OOM;
+	n->seq = e->seq;
+	n->change = e->current;
+	e->count++;
+	return RET_OK;
+}
+
+static int editcompare(const void *a, const void *b) {
+	const struct indexedit *ea = a, *eb = b;
+	int c;
+
+	c = strcmp(ea->filename, eb->filename);
+	if (c != 0)
+		return c;
+	if (ea->seq < eb->seq)
+		return -1;
+	return (ea->seq > eb->seq)?1:0;
+}
+
+/* in the lists packages are sorted by name (as generated by iterating over
+ * the packages database) */
+static inline const char *packagepart(const char *p) {
+	const char *slash = strrchr(p, '/');
+
+	return (slash == NULL)?p:slash + 1;
+}
+
+/* apply all changes for one file, RET_NOTHING if the table does not fit */
+static retvalue applyedits(struct table *table, const struct indexedit *edits, size_t count) {
+	struct strlist list;
+	char *olddata, *newdata, *p, *n;
+	size_t i;
+	int ofs;
+	retvalue r;
+
+	r = table_getrecord(table, edits[0].filename, &olddata);
+	if (RET_WAS_ERROR(r))
+		return r;
+	if (r == RET_NOTHING)
+		olddata = NULL;
+	strlist_init(&list);
+	for (p = olddata ; p != NULL ; p = n) {
+		n = strchr(p, ',');
+		if (n != NULL)
+			*(n++) = '\0';
+		r = strlist_add_dup(&list, p);
+		if (RET_WAS_ERROR(r)) {
+			free(olddata);
+			strlist_done(&list);
+			return r;
+		}
+	}
+	free(olddata);
+	for (i = 0 ; i < count ; i++) {
+		const char *package = edits[i].change->package;
+
+		/* a file listed twice in the same package */
+		if (i > 0 && edits[i].seq == edits[i-1].seq)
+			continue;
+		ofs = strlist_ofs(&list, package);
+		if (!edits[i].change->add) {
+			if (ofs < 0) {
+				strlist_done(&list);
+				return RET_NOTHING;
+			}
+			free(list.values[ofs]);
+			list.count--;
+			memmove(list.values + ofs, list.values + ofs + 1,
+				(list.count - ofs) * sizeof(char *));
+			continue;
+		}
+		if (ofs >= 0) {
+			strlist_done(&list);
+			return RET_NOTHING;
+		}
+		r = strlist_add_dup(&list, package);
+		if (RET_WAS_ERROR(r)) {
+			strlist_done(&list);
+			return r;
+		}
+		/* move to its place */
+		for (ofs = list.count - 1 ; ofs > 0 ; ofs--) {
+			char *h = list.values[ofs - 1];
+
+			if (strcmp(packagepart(h), packagepart(package)) <= 0)
+				break;
+			list.values[ofs - 1] = list.values[ofs];
+			list.values[ofs] = h;
+		}
+	}
+	if (list.count == 0) {
+		strlist_done(&list);
+		r = table_deleterecord(table, edits[0].filename, true);
+		if (r == RET_NOTHING)
+			r = RET_OK;
+		return r;
+	}
+	newdata = strlist_concat(&list, "", ",", "");
+	strlist_done(&list);
+	if (FAILEDTOALLOC(newdata))
+		return RET_ERROR_OOM;
+	r = table_adduniqsizedrecord(table, edits[0].filename,
+			newdata, strlen(newdata) + 1, true, false);
+	free(newdata);
+	return r;
+}
+
+/* apply the recorded changes to the index,
+ * returns RET_NOTHING if that is not possible and needs regeneration */
+static retvalue applychanges(struct target *target, struct table *table) {
+	struct contentschange *c, *reversed = NULL;
+	struct indexedits e;
+	size_t i, j;
+	retvalue r;
+
+	/* get the changes in the order they happened */
+	while (target->contentschanges != NULL) {
+		c = target->contentschanges;
+		target->contentschanges = c->next;
+		c->next = reversed;
+		reversed = c;
+	}
+	target->contentschanges = reversed;
+
+	memset(&e, 0, sizeof(e));
+	r = RET_OK;
+	for (c = target->contentschanges ; c != NULL ; c = c->next) {
+		e.current = c;
+		e.seq++;
+		/* the file of a removed package might already be deleted,
+		 * so only look in the cache for it */
+		r = filelist_foreachfile(c->filekey, !c->add,
+				collectedit, &e);
+		if (!RET_IS_OK(r))
+			break;
+	}
+	if (RET_IS_OK(r)) {
+		if (verbose > 2)
+			printf(" applying %llu changes of %llu files to the Contents index of '%s'...\n",
+					(unsigned long long)e.seq,
+					(unsigned long long)e.count,
+					target->identifier);
+		/* sorted to modify each entry (in the sorted table)
+		 * only once */
+		qsort(e.edits, e.count, sizeof(struct indexedit), editcompare);
+		for (i = 0 ; RET_IS_OK(r) && i < e.count ; i = j) {
+			for (j = i + 1 ; j < e.count ; j++) {
+				if (strcmp(e.edits[i].filename,
+						e.edits[j].filename) != 0)
+					break;
+			}
+			r = applyedits(table, e.edits + i, j - i);
+		}
+	}
+	for (i = 0 ; i < e.count ; i++)
+		free(e.edits[i].filename);
+	free(e.edits);
+	return r;
+}
+
+static retvalue regenerateindex(struct target *target, struct table **table_p) {
+	struct filelist_list *contents;
+	struct table *table;
+	retvalue r, r2;
+
+	if (verbose > 2)
+		printf(" regenerating the Contents index of '%s'...\n",
+				target->identifier);
+	r = database_dropcontentsindex(target->identifier);
+	if (RET_WAS_ERROR(r))
+		return r;
+	r = filelist_init(&contents);
+	if (RET_WAS_ERROR(r))
+		return r;
+	r = addtargetcontents(target, contents);
+	if (RET_WAS_ERROR(r)) {
+		filelist_free(contents);
+		return r;
+	}
+	r = database_opencontentsindex(target->identifier, false, true,
+			&table);
+	if (RET_WAS_ERROR(r)) {
+		filelist_free(contents);
+		return r;
+	}
+	r = filelist_store(contents, table);
+	filelist_free(contents);
+	if (RET_WAS_ERROR(r)) {
+		r2 = table_close(table);
+		RET_UPDATE(r, r2);
+		return r;
+	}
+	*table_p = table;
+	return RET_OK;
+}
+
+static bool indexisuptodate(struct target *target) {
+	struct table *table;
+	bool uptodate;
+	retvalue r;
+
+	r = database_opencontentsindex(target->identifier, false, false,
+			&table);
+	if (!RET_IS_OK(r))
+		return false;
+	uptodate = table_recordexists(table, uptodatekey);
+	(void)table_close(table);
+	return uptodate;
+}
+
+/* make sure the index of the target reflects its current packages */
+static retvalue updateindex(struct target *target) {
+	struct table *table = NULL;
+	retvalue r, r2;
+
+	if (target->contentsindex != cis_invalid) {
+		r = database_opencontentsindex(target->identifier,
+				false, false, &table);
+		if (RET_WAS_ERROR(r))
+			return r;
+		if (r == RET_NOTHING)
+			table = NULL;
+	}
+	if (table != NULL && target->contentsindex == cis_untouched) {
+		/* not changed in this run, so nothing to do if it was
+		 * up to date before */
+		if (table_recordexists(table, uptodatekey))
+			return table_close(table);
+		r = table_close(table);
+		table = NULL;
+		if (RET_WAS_ERROR(r))
+			return r;
+	} else if (table != NULL) {
+		assert (target->contentsindex == cis_changed);
+		r = applychanges(target, table);
+		if (r == RET_NOTHING) {
+			if (verbose > 0)
+				printf(
+"Contents index of '%s' does not match, regenerating it.\n",
+					target->identifier);
+			r = table_close(table);
+			table = NULL;
+		}
+		if (RET_WAS_ERROR(r)) {
+			if (table != NULL)
+				(void)table_close(table);
+			return r;
+		}
+	}
+	if (table == NULL) {
+		r = regenerateindex(target, &table);
+		if (RET_WAS_ERROR(r))
+			return r;
+	}
+	r = table_adduniqsizedrecord(table, uptodatekey, "", 1, true, false);
+	r2 = table_close(table);
+	RET_ENDUPDATE(r, r2);
+	if (RET_IS_OK(r)) {
+		contents_freechanges(target);
+		target->contentsindex = cis_untouched;
+	}
+	return r;
+}
+
 static retvalue gentargetcontents(struct target *target, struct release *release, bool onlyneeded, bool symlink) {
 	retvalue result, r;
 	char *contentsfilename;
 	struct filetorelease *file;
 	struct filelist_list *contents;
-	struct target_cursor iterator IFSTUPIDCC(=TARGET_CURSOR_ZERO);
 
 	if (onlyneeded && target->saved_wasmodified)
 		onlyneeded = false;
@@ -218,25 +685,31 @@ static retvalue gentargetcontents(struct target *target, struct release *release
 	}
 	free(contentsfilename);
 
+	if (target->distribution->contents.flags.incremental) {
+		struct table *table;
+
+		result = updateindex(target);
+		if (!RET_WAS_ERROR(result))
+			result = database_opencontentsindex(target->identifier,
+					true, false, &table);
+		if (!RET_WAS_ERROR(result)) {
+			result = filelist_writestored(&table, 1, file);
+			r = table_close(table);
+			RET_UPDATE(result, r);
+		}
+		if (RET_WAS_ERROR(result))
+			release_abortfile(file);
+		else
+			result = release_finishfile(release, file);
+		return result;
+	}
+
 	r = filelist_init(&contents);
 	if (RET_WAS_ERROR(r)) {
 		release_abortfile(file);
 		return r;
 	}
-	result = target_openiterator(target, READONLY, &iterator);
-	if (RET_IS_OK(result)) {
-		const char *package, *control;
-
-		while (target_nextpackage(&iterator, &package, &control)) {
-			r = addpackagetocontents(target->distribution,
-					target, package, control, contents);
-			RET_UPDATE(result, r);
-			if (RET_WAS_ERROR(r))
-				break;
-		}
-		r = target_closeiterator(&iterator);
-		RET_ENDUPDATE(result, r);
-	}
+	result = addtargetcontents(target, contents);
 	if (!RET_WAS_ERROR(result))
 		result = filelist_write(contents, file);
 	if (RET_WAS_ERROR(result))
@@ -247,26 +720,88 @@ static retvalue gentargetcontents(struct target *target, struct release *release
 	return result;
 }
 
-static retvalue genarchcontents(struct distribution *distribution, architecture_t architecture, packagetype_t type, struct release *release, bool onlyneeded) {
-	retvalue result = RET_NOTHING, r;
-	char *contentsfilename;
-	struct filetorelease *file;
-	struct filelist_list *contents;
-	const struct atomlist *components;
+static retvalue writemergedcontents(struct distribution *distribution, const struct atomlist *components, architecture_t architecture, packagetype_t type, struct filetorelease *file) {
 	struct target *target;
-	bool combinedonlyifneeded;
+	struct table **tables;
+	int count, i;
+	retvalue result, r;
 
+	count = 0;
+	for (target=distribution->targets; target!=NULL; target=target->next) {
+		if (target->architecture != architecture
+				|| target->packagetype != type
+				|| !atomlist_in(components, target->component))
+			continue;
+		r = updateindex(target);
+		if (RET_WAS_ERROR(r))
+			return r;
+		count++;
+	}
+	tables = nzNEW(count, struct table *);
+	if (FAILEDTOALLOC(tables))
+		return RET_ERROR_OOM;
+	/* only opened after all are updated, as there should be no
+	 * writing to a database file while another handle to it is open */
+	result = RET_OK;
+	i = 0;
+	for (target=distribution->targets; target!=NULL; target=target->next) {
+		if (target->architecture != architecture
+				|| target->packagetype != type
+				|| !atomlist_in(components, target->component))
+			continue;
+		assert (i < count);
+		r = database_opencontentsindex(target->identifier,
+				true, false, &tables[i]);
+		if (RET_WAS_ERROR(r)) {
+			result = r;
+			break;
+		}
+		i++;
+	}
+	if (!RET_WAS_ERROR(result))
+		result = filelist_writestored(tables, count, file);
+	while (i > 0) {
+		r = table_close(tables[--i]);
+		RET_UPDATE(result, r);
+	}
+	free(tables);
+	return result;
+}
+
+static const struct atomlist *contentscomponents(const struct distribution *distribution, packagetype_t type) {
 	if (type == pt_udeb) {
 		if (distribution->contents_components_set)
-			components = &distribution->contents_ucomponents;
+			return &distribution->contents_ucomponents;
 		else
-			components = &distribution->udebcomponents;
+			return &distribution->udebcomponents;
 	} else {
 		if (distribution->contents_components_set)
-			components = &distribution->contents_components;
+			return &distribution->contents_components;
 		else
-			components = &distribution->components;
+			return &distribution->components;
 	}
+}
+
+bool contents_needsfilelist(const struct distribution *distribution, packagetype_t type, component_t component) {
+	if (!distribution->contents.flags.enabled)
+		return false;
+	if (type == pt_udeb && !distribution->contents.flags.udebs)
+		return false;
+	if (type == pt_deb && distribution->contents.flags.nodebs)
+		return false;
+	return atomlist_in(contentscomponents(distribution, type), component);
+}
+
+static retvalue genarchcontents(struct distribution *distribution, architecture_t architecture, packagetype_t type, struct release *release, bool onlyneeded) {
+	retvalue result = RET_NOTHING, r;
+	char *contentsfilename;
+	struct filetorelease *file;
+	struct filelist_list *contents;
+	const struct atomlist *components;
+	struct target *target;
+	bool combinedonlyifneeded;
+
+	components = contentscomponents(distribution, type);
 
 	if (components->count == 0)
 		return RET_NOTHING;
@@ -325,6 +860,17 @@ static retvalue genarchcontents(struct distribution *distribution, architecture_
 	}
 	free(contentsfilename);
 
+	if (distribution->contents.flags.incremental) {
+		r = writemergedcontents(distribution, components,
+				architecture, type, file);
+		if (RET_WAS_ERROR(r))
+			release_abortfile(file);
+		else
+			r = release_finishfile(release, file);
+		RET_UPDATE(result, r);
+		return result;
+	}
+
 	r = filelist_init(&contents);
 	if (RET_WAS_ERROR(r)) {
 		release_abortfile(file);
@@ -344,6 +890,85 @@ static retvalue genarchcontents(struct distribution *distribution, architecture_
 	return result;
 }
 
+/* the .debs of a target whose file lists will be needed but are not cached */
+static retvalue collectmissing(struct target *target, struct strlist *missing) {
+	struct target_cursor iterator IFSTUPIDCC(=TARGET_CURSOR_ZERO);
+	const struct contentschange *c;
+	const char *package, *control;
+	char *filekey;
+	retvalue result, r;
+
+	if (target->distribution->contents.flags.incremental) {
+		if (target->contentsindex == cis_changed) {
+			/* only the added packages need to be read */
+			for (c = target->contentschanges ; c != NULL ;
+			                                   c = c->next) {
+				if (!c->add)
+					continue;
+				r = filelist_addmissing(missing, c->filekey);
+				if (RET_WAS_ERROR(r))
+					return r;
+			}
+			return RET_OK;
+		}
+		if (target->contentsindex == cis_untouched
+				&& indexisuptodate(target))
+			return RET_NOTHING;
+	}
+	result = target_openiterator(target, READONLY, &iterator);
+	if (!RET_IS_OK(result))
+		return result;
+	while (target_nextpackage(&iterator, &package, &control)) {
+		r = chunk_getvalue(control, "Filename", &filekey);
+		if (!RET_IS_OK(r))
+			continue;
+		r = filelist_addmissing(missing, filekey);
+		free(filekey);
+		RET_UPDATE(result, r);
+		if (RET_WAS_ERROR(r))
+			break;
+	}
+	r = target_closeiterator(&iterator);
+	RET_ENDUPDATE(result, r);
+	return result;
+}
+
+/* with --export-jobs, read all file lists not yet cached in parallel */
+static retvalue prefetchfilelists(struct distribution *distribution, const struct atomlist *architectures, bool onlyneeded) {
+	struct strlist missing;
+	struct target *target;
+	retvalue r;
+
+	strlist_init(&missing);
+	for (target=distribution->targets; target!=NULL; target=target->next) {
+		if (!atomlist_in(architectures, target->architecture)
+				|| target->architecture == architecture_source)
+			continue;
+		if (target->packagetype == pt_deb
+				&& distribution->contents.flags.nodebs)
+			continue;
+		if (target->packagetype == pt_udeb
+				&& !distribution->contents.flags.udebs)
+			continue;
+		if (!atomlist_in(contentscomponents(distribution,
+					target->packagetype),
+					target->component))
+			continue;
+		/* most likely not regenerated, and if it is, the
+		 * file lists are still read when needed */
+		if (onlyneeded && !target->saved_wasmodified)
+			continue;
+		r = collectmissing(target, &missing);
+		if (RET_WAS_ERROR(r)) {
+			strlist_done(&missing);
+			return r;
+		}
+	}
+	r = filelist_prefetch(&missing, global.exportjobs);
+	strlist_done(&missing);
+	return r;
+}
+
 retvalue contents_generate(struct distribution *distribution, struct release *release, bool onlyneeded) {
 	retvalue result, r;
 	int i;
@@ -358,6 +983,12 @@ retvalue contents_generate(struct distribution *distribution, struct release *re
 	} else {
 		architectures = &distribution->architectures;
 	}
+	if (global.exportjobs > 1) {
+		r = prefetchfilelists(distribution, architectures,
+				onlyneeded);
+		if (RET_WAS_ERROR(r))
+			return r;
+	}
 	for (i = 0 ; i < architectures->count ; i++) {
 		architecture_t architecture = architectures->atoms[i];
 
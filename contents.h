@@ -19,6 +19,7 @@ struct contentsoptions {
 		bool percomponent:1;
 		bool allcomponents:1;
 		bool compatsymlink:1;
+		bool incremental:1;
 	} flags;
 	compressionset compressions;
 };
@@ -29,4 +30,13 @@ struct configiterator;
 retvalue contentsoptions_parse(struct distribution *, struct configiterator *);
 retvalue contents_generate(struct distribution *, struct release *, bool /*onlyneeded*/);
 
+/* if the Contents files of the distribution list files of such packages */
+bool contents_needsfilelist(const struct distribution *, packagetype_t, component_t);
+
+struct target;
+/* to be called for every change of a target's packages (with the control
+ * chunk of the package removed and/or of the package added) */
+retvalue contents_recordchange(struct target *, const char * /*packagename*/, /*@null@*/const char * /*oldcontrol*/, /*@null@*/const char * /*newcontrol*/);
+void contents_freechanges(struct target *);
+
 #endif
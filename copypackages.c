@@ -37,6 +37,7 @@
 #include "filecntl.h"
 #include "mprintf.h"
 #include "globmatch.h"
+#include "uncompression.h"
 #include "copypackages.h"
 
 struct target_package_list {
@@ -852,7 +853,7 @@ retvalue copy_from_file(struct distribution *into, component_t component, archit
 						into->codename);
 		return RET_ERROR;
 	}
-	result = indexfile_open(&i, filename, c_none);
+	result = indexfile_open(&i, filename, c_none, NULL);
 	if (!RET_IS_OK(result))
 		return result;
 	result = RET_NOTHING;
@@ -931,6 +932,15 @@ static retvalue restore_from_snapshot(struct distribution *into, const struct at
 					target->exportmode->filename);
 		}
 #endif
+		if (filename != NULL && !isregularfile(filename) &&
+				uncompression_supported(c_xz)) {
+			/* nothing of the above found, try .xz */
+			free(filename);
+			compression = c_xz;
+			filename = mprintf("%s/%s/%s.xz",
+					basedir, target->relativedirectory,
+					target->exportmode->filename);
+		}
 		if (filename != NULL && !isregularfile(filename)) {
 			free(filename);
 			fprintf(stderr,
@@ -946,7 +956,7 @@ static retvalue restore_from_snapshot(struct distribution *into, const struct at
 			result = RET_ERROR_OOM;
 			break;
 		}
-		result = indexfile_open(&i, filename, compression);
+		result = indexfile_open(&i, filename, compression, NULL);
 		if (!RET_IS_OK(result))
 			break;
 		while (indexfile_getnext(i, &packagename, &version, &control,
@@ -62,6 +62,8 @@ static /*@null@*/ char *rdb_version, *rdb_lastsupportedversion,
 
 struct table *rdb_checksums, *rdb_contents;
 struct table *rdb_references;
+/* only set with --db-cache-size */
+static /*@null@*/ DB_ENV *rdb_env = NULL;
 static struct {
 	bool createnewtables;
 } rdb_capabilities;
@@ -171,6 +173,97 @@ static void releaselock(void) {
 	rdb_locked = false;
 }
 
+/*************************/
+/* database environment  */
+/*************************/
+
+#if DB_VERSION_MAJOR == 3
+#define DB_ENV_MEMP_SYNC(env) memp_sync(env, NULL)
+#else
+#define DB_ENV_MEMP_SYNC(env) env->memp_sync(env, NULL)
+#endif
+
+/* Create an environment so that all database files share one cache of the
+ * given size. It is private to this process (the lock file already makes
+ * sure no other process accesses the database), so no region files are
+ * created and nothing is left in the database directory. */
+static retvalue openenvironment(void) {
+	u_int32_t gbytes, bytes;
+	int dbret;
+
+	assert (rdb_env == NULL);
+
+	if (global.dbcachesize == 0)
+		return RET_NOTHING;
+
+	dbret = db_env_create(&rdb_env, 0);
+	if (dbret != 0) {
+		fprintf(stderr, "db_env_create: %s\n", db_strerror(dbret));
+		rdb_env = NULL;
+		return RET_DBERR(dbret);
+	}
+	gbytes = global.dbcachesize / (1024*1024*1024);
+	bytes = global.dbcachesize % (1024*1024*1024);
+	dbret = rdb_env->set_cachesize(rdb_env, gbytes, bytes, 1);
+	if (dbret != 0) {
+		rdb_env->err(rdb_env, dbret, "db_env_set_cachesize(%llu):",
+				(unsigned long long)global.dbcachesize);
+		(void)rdb_env->close(rdb_env, 0);
+		rdb_env = NULL;
+		return RET_DBERR(dbret);
+	}
+	/* no home directory, as all filenames given are complete */
+	dbret = rdb_env->open(rdb_env, NULL,
+			DB_CREATE|DB_INIT_MPOOL|DB_PRIVATE, 0);
+	if (dbret != 0) {
+		rdb_env->err(rdb_env, dbret, "db_env_open:");
+		(void)rdb_env->close(rdb_env, 0);
+		rdb_env = NULL;
+		return RET_DBERR(dbret);
+	}
+	return RET_OK;
+}
+
+/* Tables in an environment are closed without writing their changes,
+ * so that is done here for all of them at once. */
+static retvalue closeenvironment(void) {
+	retvalue result = RET_OK;
+	int dbret;
+
+	if (rdb_env == NULL)
+		return RET_NOTHING;
+
+	dbret = DB_ENV_MEMP_SYNC(rdb_env);
+	if (dbret != 0) {
+		rdb_env->err(rdb_env, dbret, "db_env_memp_sync:");
+		result = RET_DBERR(dbret);
+	}
+	dbret = rdb_env->close(rdb_env, 0);
+	if (dbret != 0) {
+		fprintf(stderr, "db_env_close: %s\n", db_strerror(dbret));
+		RET_UPDATE(result, RET_DBERR(dbret));
+	}
+	rdb_env = NULL;
+	return result;
+}
+
+/* Write the changes only in the cache of the environment to the files,
+ * so that child processes started afterwards have no modified pages
+ * of their own they might write (or that differ from the parent's). */
+retvalue database_sync(void) {
+	int dbret;
+
+	if (rdb_env == NULL)
+		return RET_NOTHING;
+
+	dbret = DB_ENV_MEMP_SYNC(rdb_env);
+	if (dbret != 0) {
+		rdb_env->err(rdb_env, dbret, "db_env_memp_sync:");
+		return RET_DBERR(dbret);
+	}
+	return RET_OK;
+}
+
 static retvalue writeversionfile(void);
 
 retvalue database_close(void) {
@@ -191,6 +284,8 @@ retvalue database_close(void) {
 		RET_UPDATE(result, r);
 		rdb_contents = NULL;
 	}
+	r = closeenvironment();
+	RET_UPDATE(result, r);
 	r = writeversionfile();
 	RET_UPDATE(result, r);
 	if (rdb_locked)
@@ -233,7 +328,7 @@ static retvalue database_opentable(const char *filename, /*@null@*/const char *s
 	if (FAILEDTOALLOC(fullfilename))
 		return RET_ERROR_OOM;
 
-	dbret = db_create(&table, NULL, 0);
+	dbret = db_create(&table, rdb_env, 0);
 	if (dbret != 0) {
 		fprintf(stderr, "db_create: %s\n", db_strerror(dbret));
 		free(fullfilename);
@@ -372,7 +467,7 @@ retvalue database_dropsubtable(const char *table, const char *subtable) {
 	if (FAILEDTOALLOC(filename))
 		return RET_ERROR_OOM;
 
-	if ((dbret = db_create(&db, NULL, 0)) != 0) {
+	if ((dbret = db_create(&db, rdb_env, 0)) != 0) {
 		fprintf(stderr, "db_create: %s %s\n",
 				filename, db_strerror(dbret));
 		free(filename);
@@ -866,6 +961,13 @@ retvalue database_create(struct distribution *alldistributions, bool fast, bool
 		return r;
 	}
 
+	r = openenvironment();
+	if (RET_WAS_ERROR(r)) {
+		releaselock();
+		database_free();
+		return r;
+	}
+
 	if (nopackages) {
 		rdb_nopackages = true;
 		return RET_OK;
@@ -970,7 +1072,8 @@ retvalue table_close(struct table *table) {
 		assert (table->readonly);
 		dbret = 0;
 	} else
-		dbret = table->berkeleydb->close(table->berkeleydb, 0);
+		dbret = table->berkeleydb->close(table->berkeleydb,
+				(rdb_env != NULL)?DB_NOSYNC:0);
 	if (dbret != 0) {
 		fprintf(stderr, "db_close(%s, %s): %s\n",
 				table->name, table->subname,
@@ -1813,6 +1916,71 @@ retvalue database_openpackages(const char *identifier, bool readonly, struct tab
 	return RET_OK;
 }
 
+/* the sorted file->packages lists of a target used to generate Contents
+ * files incrementally */
+retvalue database_opencontentsindex(const char *identifier, bool readonly, bool create, struct table **table_p) {
+	struct table *table IFSTUPIDCC(=NULL);
+	retvalue r;
+
+	r = database_table("contents.index.db", identifier, dbt_BTREE,
+			readonly?DB_RDONLY:(create?DB_CREATE:0), &table);
+	assert (r != RET_NOTHING || !(readonly || create));
+	if (!RET_IS_OK(r))
+		return r;
+	table->verbose = false;
+	*table_p = table;
+	return RET_OK;
+}
+
+retvalue database_hascontentsindex(bool *exists_p) {
+	return database_hasdatabasefile("contents.index.db", exists_p);
+}
+
+retvalue database_dropcontentsindex(const char *identifier) {
+	retvalue r;
+	bool exists;
+
+	r = database_hasdatabasefile("contents.index.db", &exists);
+	if (RET_WAS_ERROR(r))
+		return r;
+	if (!exists)
+		return RET_NOTHING;
+	return database_dropsubtable("contents.index.db", identifier);
+}
+
+/* name, version, source, architecture and filekeys of the packages of
+ * a target, so scans do not have to parse the control data */
+retvalue database_openmetadata(const char *identifier, bool readonly, bool create, struct table **table_p) {
+	struct table *table IFSTUPIDCC(=NULL);
+	retvalue r;
+
+	r = database_table("metadata.db", identifier, dbt_BTREE,
+			readonly?DB_RDONLY:(create?DB_CREATE:0), &table);
+	assert (r != RET_NOTHING || !(readonly || create));
+	if (!RET_IS_OK(r))
+		return r;
+	if (table->berkeleydb == NULL) {
+		/* readonly and not there */
+		(void)table_close(table);
+		return RET_NOTHING;
+	}
+	table->verbose = false;
+	*table_p = table;
+	return RET_OK;
+}
+
+retvalue database_dropmetadata(const char *identifier) {
+	retvalue r;
+	bool exists;
+
+	r = database_hasdatabasefile("metadata.db", &exists);
+	if (RET_WAS_ERROR(r))
+		return r;
+	if (!exists)
+		return RET_NOTHING;
+	return database_dropsubtable("metadata.db", identifier);
+}
+
 /* Get a list of all identifiers having a package list */
 retvalue database_listpackages(struct strlist *identifiers) {
 	return database_listsubtables("packages.db", identifiers);
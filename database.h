@@ -17,6 +17,8 @@ struct cursor;
 
 retvalue database_create(struct distribution *, bool fast, bool /*nopackages*/, bool /*allowunused*/, bool /*readonly*/, size_t /*waitforlock*/, bool /*verbosedb*/);
 retvalue database_close(void);
+/* write out cached changes, to be called before forking worker processes */
+retvalue database_sync(void);
 
 retvalue database_openfiles(void);
 retvalue database_openreferences(void);
@@ -25,6 +27,13 @@ retvalue database_droppackages(const char *);
 retvalue database_openpackages(const char *, bool /*readonly*/, /*@out@*/struct table **);
 retvalue database_openreleasecache(const char *, /*@out@*/struct table **);
 retvalue database_opentracking(const char *, bool /*readonly*/, /*@out@*/struct table **);
+/* returns RET_NOTHING if there is none and neither readonly nor create */
+retvalue database_opencontentsindex(const char *, bool /*readonly*/, bool /*create*/, /*@out@*/struct table **);
+retvalue database_dropcontentsindex(const char *);
+retvalue database_hascontentsindex(/*@out@*/bool *);
+/* returns RET_NOTHING if there is none and not create */
+retvalue database_openmetadata(const char *, bool /*readonly*/, bool /*create*/, /*@out@*/struct table **);
+retvalue database_dropmetadata(const char *);
 retvalue database_translate_filelists(void);
 retvalue database_translate_legacy_checksums(bool /*verbosedb*/);
 bool database_allcreated(void);
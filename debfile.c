@@ -116,9 +116,7 @@ static retvalue read_control_file(char **control, const char *debfile, struct ar
 }
 
 static retvalue read_control_tar(char **control, const char *debfile, struct ar_archive *ar, struct archive *tar) {
-	struct archive_entry *entry;
 	int a;
-	retvalue r;
 
 	archive_read_support_format_tar(tar);
 	archive_read_support_format_gnutar(tar);
@@ -134,6 +132,14 @@ static retvalue read_control_tar(char **control, const char *debfile, struct ar_
 				archive_error_string(tar));
 		return RET_ERROR;
 	}
+	return extractcontrol_fromtar(control, debfile, tar);
+}
+
+retvalue extractcontrol_fromtar(char **control, const char *debfile, struct archive *tar) {
+	struct archive_entry *entry;
+	int a;
+	retvalue r;
+
 	while ((a=archive_read_next_header(tar, &entry)) == ARCHIVE_OK) {
 		if (strcmp(archive_entry_pathname(entry), "./control") != 0 &&
 		    strcmp(archive_entry_pathname(entry), "control") != 0) {
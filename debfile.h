@@ -12,4 +12,21 @@ retvalue extractcontrol(/*@out@*/char **, const char *);
 /* Read a list of files from a .deb file */
 retvalue getfilelist(/*@out@*/char **, /*@out@*/ size_t *, const char *);
 
+/* Read a .deb file only once to get its checksums, control information and
+ * (if wanted) list of files, copying it at the same time.
+ * decide is called with the control chunk (before most of the file is read)
+ * and returns where to copy the file to (NULL for nowhere) and if the list
+ * of files is needed (*filelist is NULL if it could not be read).
+ * Returns RET_NOTHING without calling decide, if the file cannot be read
+ * that way (then the functions above have to be used). */
+typedef retvalue ingest_decide(void *, /*@only@*/char * /*control*/, /*@out@*/const char ** /*destination*/, /*@out@*/bool * /*wantfilelist*/);
+struct checksums;
+retvalue ingestdeb(const char *, ingest_decide *, void *, /*@out@*/struct checksums **, /*@out@*/char ** /*filelist*/, /*@out@*/size_t *);
+
+#ifdef HAVE_LIBARCHIVE
+struct archive;
+/* the control chunk from an already opened control.tar */
+retvalue extractcontrol_fromtar(/*@out@*/char **, const char *, struct archive *);
+#endif
+
 #endif
@@ -24,28 +24,28 @@
 #include <malloc.h>
 #include <string.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <archive.h>
 #include <archive_entry.h>
+#define CHECKSUMS_CONTEXT visible
 #include "error.h"
 #include "uncompression.h"
 #include "ar.h"
 #include "filelist.h"
+#include "checksums.h"
+#include "filecntl.h"
 #include "debfile.h"
 
 #ifndef HAVE_LIBARCHIVE
 #error Why did this file got compiled?
 #endif
 
+static retvalue read_data_entries(/*@out@*/char **, /*@out@*/size_t *, const char *, struct archive *);
+
 static retvalue read_data_tar(/*@out@*/char **list, /*@out@*/size_t *size, const char *debfile, struct ar_archive *ar, struct archive *tar) {
-	struct archive_entry *entry;
-	struct filelistcompressor c;
-	retvalue r;
 	int a, e;
 
-	r = filelistcompressor_setup(&c);
-	if (RET_WAS_ERROR(r))
-		return r;
-
 	archive_read_support_format_tar(tar);
 	archive_read_support_format_gnutar(tar);
 	a = archive_read_open(tar, ar,
@@ -53,7 +53,6 @@ static retvalue read_data_tar(/*@out@*/char **list, /*@out@*/size_t *size, const
 			ar_archivemember_read,
 			ar_archivemember_close);
 	if (a != ARCHIVE_OK) {
-		filelistcompressor_cancel(&c);
 		e = archive_errno(tar);
 		if (e == -EINVAL) /* special code to say there is none */
 			fprintf(stderr,
@@ -65,6 +64,19 @@ static retvalue read_data_tar(/*@out@*/char **list, /*@out@*/size_t *size, const
 				archive_error_string(tar));
 		return RET_ERROR;
 	}
+	return read_data_entries(list, size, debfile, tar);
+}
+
+static retvalue read_data_entries(/*@out@*/char **list, /*@out@*/size_t *size, const char *debfile, struct archive *tar) {
+	struct archive_entry *entry;
+	struct filelistcompressor c;
+	retvalue r;
+	int a, e;
+
+	r = filelistcompressor_setup(&c);
+	if (RET_WAS_ERROR(r))
+		return r;
+
 	while ((a=archive_read_next_header(tar, &entry)) == ARCHIVE_OK) {
 		const char *name = archive_entry_pathname(entry);
 		mode_t mode;
@@ -189,3 +201,392 @@ retvalue getfilelist(/*@out@*/char **filelist, size_t *size, const char *debfile
 "Could not find a data.tar file within '%s'!\n", debfile);
 	return RET_ERROR_MISSING;
 }
+
+/* Reading a .deb only once when including it: everything read is fed
+ * into the checksums and (once it is known where to) copied, while
+ * the ar members are parsed here and given to libarchive. */
+
+#define INGESTBLOCKSIZE 65536
+#define AR_MAGIC "!<arch>\n"
+
+struct ingest {
+	const char *debfile, *destination;
+	int infd, outfd;
+	bool decided;
+	struct checksumscontext context;
+	/* what was read before it was known where to copy it */
+	unsigned char *pending;
+	size_t pendinglen, pendingsize;
+	unsigned char *buffer;
+	/* left in the current ar member */
+	off_t memberleft;
+};
+
+static retvalue ingest_write(struct ingest *in, const unsigned char *data, size_t len) {
+	while (len > 0) {
+		ssize_t written = write(in->outfd, data, len);
+
+		if (written < 0) {
+			int e = errno;
+			if (e == EINTR)
+				continue;
+			fprintf(stderr, "Error %d writing to %s: %s\n",
+					e, in->destination, strerror(e));
+			return RET_ERRNO(e);
+		}
+		data += written;
+		len -= written;
+	}
+	return RET_OK;
+}
+
+/* read the next block (at most maxlen bytes), 0 at end of file */
+static ssize_t ingest_read(struct ingest *in, off_t maxlen, /*@out@*/const unsigned char **data_p, /*@out@*/retvalue *r_p) {
+	size_t len = INGESTBLOCKSIZE;
+	ssize_t got;
+
+	if (maxlen < (off_t)len)
+		len = maxlen;
+	do {
+		got = read(in->infd, in->buffer, len);
+	} while (got < 0 && errno == EINTR && !interrupted());
+	if (got < 0) {
+		int e = errno;
+		fprintf(stderr, "Error %d reading %s: %s\n",
+				e, in->debfile, strerror(e));
+		*r_p = RET_ERRNO(e);
+		return -1;
+	}
+	if (interrupted()) {
+		*r_p = RET_ERROR_INTERRUPTED;
+		return -1;
+	}
+	*r_p = RET_OK;
+	*data_p = in->buffer;
+	checksumscontext_update(&in->context, in->buffer, got);
+	if (in->outfd >= 0) {
+		*r_p = ingest_write(in, in->buffer, got);
+		if (RET_WAS_ERROR(*r_p))
+			return -1;
+	} else if (!in->decided && got > 0) {
+		if (in->pendinglen + got > in->pendingsize) {
+			size_t newsize = 2 * (in->pendinglen + got);
+			unsigned char *n = realloc(in->pending, newsize);
+
+			if (FAILEDTOALLOC(n)) {
+				*r_p = RET_ERROR_OOM;
+				return -1;
+			}
+			in->pending = n;
+			in->pendingsize = newsize;
+		}
+		memcpy(in->pending + in->pendinglen, in->buffer, got);
+		in->pendinglen += got;
+	}
+	return got;
+}
+
+/* RET_NOTHING if the file ended before len bytes were read */
+static retvalue ingest_readall(struct ingest *in, void *buffer, size_t len) {
+	const unsigned char *data;
+	retvalue r;
+
+	while (len > 0) {
+		ssize_t got = ingest_read(in, len, &data, &r);
+
+		if (got < 0)
+			return r;
+		if (got == 0)
+			return RET_NOTHING;
+		memcpy(buffer, data, got);
+		buffer = (char *)buffer + got;
+		len -= got;
+	}
+	return RET_OK;
+}
+
+static retvalue ingest_skip(struct ingest *in, off_t len) {
+	const unsigned char *data;
+	retvalue r;
+
+	while (len > 0) {
+		ssize_t got = ingest_read(in, len, &data, &r);
+
+		if (got < 0)
+			return r;
+		if (got == 0)
+			return RET_NOTHING;
+		len -= got;
+	}
+	return RET_OK;
+}
+
+static retvalue ingest_skiprest(struct ingest *in) {
+	const unsigned char *data;
+	ssize_t got;
+	retvalue r = RET_OK;
+
+	while ((got = ingest_read(in, INGESTBLOCKSIZE, &data, &r)) > 0)
+		;
+	return r;
+}
+
+static ssize_t ingest_archiveread(struct archive *a, void *d, const void **p) {
+	struct ingest *in = d;
+	const unsigned char *data;
+	ssize_t got;
+	retvalue r;
+
+	if (in->memberleft <= 0)
+		return 0;
+	got = ingest_read(in, in->memberleft, &data, &r);
+	if (got < 0) {
+		archive_set_error(a, (r == RET_ERROR_OOM)?ENOMEM:EIO,
+				"Error reading '%s'", in->debfile);
+		return -1;
+	}
+	if (got == 0) {
+		archive_set_error(a, EINVAL, "Premature end of '%s'",
+				in->debfile);
+		return -1;
+	}
+	in->memberleft -= got;
+	*p = data;
+	return got;
+}
+
+/* only use what libarchive can uncompress itself, the rest is left
+ * for the functions using uncompression.c and external programs */
+static bool ingest_setfilter(struct archive *tar, const char *suffix) {
+	int a;
+
+	if (*suffix == '\0')
+		return true;
+#if ARCHIVE_VERSION_NUMBER >= 3000000
+	if (strcmp(suffix, ".gz") == 0)
+		a = archive_read_support_filter_gzip(tar);
+	else if (strcmp(suffix, ".xz") == 0)
+		a = archive_read_support_filter_xz(tar);
+	else if (strcmp(suffix, ".lzma") == 0)
+		a = archive_read_support_filter_lzma(tar);
+	else if (strcmp(suffix, ".bz2") == 0)
+		a = archive_read_support_filter_bzip2(tar);
+#if ARCHIVE_VERSION_NUMBER >= 3003003
+	else if (strcmp(suffix, ".zst") == 0)
+		a = archive_read_support_filter_zstd(tar);
+#endif
+	else
+		return false;
+#else
+	if (strcmp(suffix, ".gz") == 0)
+		a = archive_read_support_compression_gzip(tar);
+	else if (strcmp(suffix, ".bz2") == 0)
+		a = archive_read_support_compression_bzip2(tar);
+	else
+		return false;
+#endif
+	return a == ARCHIVE_OK;
+}
+
+/* RET_NOTHING if libarchive cannot read it */
+static retvalue ingest_control(struct ingest *in, const char *suffix, /*@out@*/char **control) {
+	struct archive *tar;
+	retvalue r;
+
+	tar = archive_read_new();
+	if (FAILEDTOALLOC(tar))
+		return RET_ERROR_OOM;
+	archive_read_support_format_tar(tar);
+	archive_read_support_format_gnutar(tar);
+	if (!ingest_setfilter(tar, suffix) ||
+			archive_read_open(tar, in, NULL,
+				ingest_archiveread, NULL) != ARCHIVE_OK) {
+		archive_read_finish(tar);
+		return RET_NOTHING;
+	}
+	r = extractcontrol_fromtar(control, in->debfile, tar);
+	archive_read_finish(tar);
+	return r;
+}
+
+/* the list of files is not needed, so it being unreadable is no error */
+static void ingest_filelist(struct ingest *in, const char *suffix, /*@out@*/char **filelist, /*@out@*/size_t *size) {
+	struct archive *tar;
+	retvalue r = RET_NOTHING;
+
+	tar = archive_read_new();
+	if (FAILEDTOALLOC(tar))
+		return;
+	archive_read_support_format_tar(tar);
+	archive_read_support_format_gnutar(tar);
+	if (ingest_setfilter(tar, suffix) &&
+			archive_read_open(tar, in, NULL,
+				ingest_archiveread, NULL) == ARCHIVE_OK)
+		r = read_data_entries(filelist, size, in->debfile, tar);
+	archive_read_finish(tar);
+	if (!RET_IS_OK(r))
+		*filelist = NULL;
+}
+
+static retvalue ingest_startcopy(struct ingest *in) {
+	retvalue r;
+
+	in->decided = true;
+	if (in->destination != NULL) {
+		/* never write into another hardlink of a file there */
+		if (unlink(in->destination) != 0 && errno != ENOENT) {
+			int e = errno;
+			fprintf(stderr, "Error %d deleting '%s': %s\n",
+					e, in->destination, strerror(e));
+			return RET_ERRNO(e);
+		}
+		in->outfd = open(in->destination,
+				O_NOCTTY|O_WRONLY|O_CREAT|O_EXCL, 0666);
+		if (in->outfd < 0) {
+			int e = errno;
+			fprintf(stderr, "Error %d creating '%s': %s\n",
+					e, in->destination, strerror(e));
+			return RET_ERRNO(e);
+		}
+		r = ingest_write(in, in->pending, in->pendinglen);
+		if (RET_WAS_ERROR(r))
+			return r;
+	}
+	free(in->pending);
+	in->pending = NULL;
+	in->pendinglen = 0;
+	in->pendingsize = 0;
+	return RET_OK;
+}
+
+/* go through the ar members, only returns RET_NOTHING before
+ * decide was called */
+static retvalue ingest_members(struct ingest *in, ingest_decide *decide, void *privdata, char **filelist, size_t *size) {
+	char magic[sizeof(AR_MAGIC) - 1];
+	bool wantfilelist = false;
+	retvalue r;
+
+	r = ingest_readall(in, magic, sizeof(magic));
+	if (RET_WAS_ERROR(r))
+		return r;
+	if (r == RET_NOTHING || memcmp(magic, AR_MAGIC, sizeof(magic)) != 0)
+		return RET_NOTHING;
+	while (true) {
+		struct ar_header {
+			char name[16];
+			char date[12];
+			char uid[6];
+			char gid[6];
+			char mode[8];
+			char size[11];
+			char magictrailer[1];
+		} header;
+		char name[17], *p;
+		int i;
+
+		r = ingest_readall(in, &header, sizeof(header));
+		if (r != RET_OK)
+			break;
+		/* ah_size ends right before "`\n" */
+		if (header.size[10] != '`' || header.magictrailer[0] != '\n') {
+			r = RET_NOTHING;
+			break;
+		}
+		header.size[10] = '\0';
+		in->memberleft = strtoul(header.size, &p, 10);
+		if (*p != '\0' && *p != ' ') {
+			r = RET_NOTHING;
+			break;
+		}
+		i = sizeof(header.name);
+		while (i > 0 && header.name[i-1] == ' ')
+			i--;
+		if (i > 0 && header.name[i-1] == '/')
+			i--;
+		memcpy(name, header.name, i);
+		name[i] = '\0';
+
+		if (!in->decided && strncmp(name, "control.tar", 11) == 0) {
+			char *control;
+			off_t padding = in->memberleft & 1;
+
+			r = ingest_control(in, name + 11, &control);
+			if (!RET_IS_OK(r))
+				return r;
+			r = decide(privdata, control, &in->destination,
+					&wantfilelist);
+			if (RET_WAS_ERROR(r))
+				return r;
+			in->memberleft += padding;
+			r = ingest_startcopy(in);
+			if (RET_WAS_ERROR(r))
+				return r;
+		} else if (in->decided && wantfilelist && *filelist == NULL &&
+				strncmp(name, "data.tar", 8) == 0) {
+			off_t padding = in->memberleft & 1;
+
+			ingest_filelist(in, name + 8, filelist, size);
+			in->memberleft += padding;
+		} else if ((in->memberleft & 1) != 0)
+			in->memberleft++;
+		r = ingest_skip(in, in->memberleft);
+		if (r != RET_OK)
+			break;
+	}
+	if (RET_WAS_ERROR(r))
+		return r;
+	if (!in->decided)
+		return RET_NOTHING;
+	/* whatever follows is still part of the file */
+	return ingest_skiprest(in);
+}
+
+retvalue ingestdeb(const char *debfile, ingest_decide *decide, void *privdata, struct checksums **checksums_p, char **filelist_p, size_t *size_p) {
+	struct ingest in;
+	char *filelist = NULL;
+	size_t size = 0;
+	retvalue r;
+
+	memset(&in, 0, sizeof(in));
+	in.debfile = debfile;
+	in.outfd = -1;
+	in.buffer = malloc(INGESTBLOCKSIZE);
+	if (FAILEDTOALLOC(in.buffer))
+		return RET_ERROR_OOM;
+	in.infd = open(debfile, O_NOCTTY|O_RDONLY);
+	if (in.infd < 0) {
+		int e = errno;
+		free(in.buffer);
+		if (e == ENOENT)
+			/* let the usual code report that */
+			return RET_NOTHING;
+		fprintf(stderr, "Error %d opening %s: %s\n",
+				e, debfile, strerror(e));
+		return RET_ERRNO(e);
+	}
+#ifdef HAVE_POSIX_FADVISE
+	(void)posix_fadvise(in.infd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+	checksumscontext_init(&in.context);
+	r = ingest_members(&in, decide, privdata, &filelist, &size);
+	(void)close(in.infd);
+	free(in.buffer);
+	free(in.pending);
+	if (in.outfd >= 0 && close(in.outfd) != 0 && !RET_WAS_ERROR(r)) {
+		int e = errno;
+		fprintf(stderr, "Error %d writing to %s: %s\n",
+				e, in.destination, strerror(e));
+		r = RET_ERRNO(e);
+	}
+	if (RET_IS_OK(r))
+		r = checksums_from_context(checksums_p, &in.context);
+	if (!RET_IS_OK(r)) {
+		if (in.outfd >= 0)
+			deletefile(in.destination);
+		free(filelist);
+		return r;
+	}
+	*filelist_p = filelist;
+	*size_p = size;
+	return RET_OK;
+}
@@ -3,6 +3,9 @@
 
 struct diffindex {
 	struct checksums *destination;
+	/* X-Patch-Precedence: merged, i.e. every patch results in the
+	 * current file instead of the one listed next in the history */
+	bool merged;
 	int patchcount;
 	struct diffindex_patch {
 		struct checksums *frompackages;
@@ -40,6 +40,7 @@
 #include "uploaderslist.h"
 #include "configparser.h"
 #include "byhandhook.h"
+#include "jobs.h"
 #include "distribution.h"
 
 static retvalue distribution_free(struct distribution *distribution) {
@@ -789,24 +790,9 @@ retvalue distribution_snapshot(struct distribution *distribution, const char *na
 	return result;
 }
 
-static retvalue export(struct distribution *distribution, bool onlyneeded) {
+static retvalue exportserially(struct distribution *distribution, struct release *release, bool onlyneeded) {
 	struct target *target;
 	retvalue result, r;
-	struct release *release;
-
-	assert (distribution != NULL);
-
-	if (distribution->readonly) {
-		fprintf(stderr,
-"Error: trying to re-export read-only distribution %s\n",
-				distribution->codename);
-		return RET_ERROR;
-	}
-
-	r = release_init(&release, distribution->codename, distribution->suite,
-			distribution->fakecomponentprefix);
-	if (RET_WAS_ERROR(r))
-		return r;
 
 	result = RET_NOTHING;
 	for (target=distribution->targets; target != NULL ;
@@ -828,6 +814,129 @@ static retvalue export(struct distribution *distribution, bool onlyneeded) {
 				break;
 		}
 	}
+	return result;
+}
+
+/* With --export-jobs, the index files of every target are generated
+ * (reading the packages database, compressing and checksumming) in
+ * worker processes. Everything else (the export hooks, the directory
+ * Release files and the list of files for the Release file) is done
+ * in the parent in the order of the targets, so the result does not
+ * depend on which worker finishes first. */
+
+struct exportjobs {
+	struct distribution *distribution;
+	struct release *release;
+	bool onlyneeded;
+	struct target **targets;
+};
+
+static retvalue exportjob_run(void *data, size_t i, int fd) {
+	struct exportjobs *jobs = data;
+	const char *status IFSTUPIDCC(=NULL);
+	retvalue r;
+
+	release_detachentries(jobs->release);
+	r = target_exportfiles(jobs->targets[i], jobs->onlyneeded,
+			jobs->release, &status);
+	if (RET_WAS_ERROR(r))
+		return r;
+	r = jobs_write(fd, status, strlen(status) + 1);
+	if (RET_WAS_ERROR(r))
+		return r;
+	return release_sendentries(jobs->release, fd);
+}
+
+static retvalue exportjob_done(void *data, size_t i, const char *output, size_t len) {
+	struct exportjobs *jobs = data;
+	struct target *target = jobs->targets[i];
+	size_t statuslen;
+	retvalue r;
+
+	statuslen = (output == NULL)?0:strnlen(output, len);
+	if (statuslen == 0 || statuslen >= len) {
+		fprintf(stderr,
+"Internal Error: malformed output of worker process exporting '%s'!\n",
+				target->identifier);
+		return RET_ERROR_INTERNAL;
+	}
+	r = release_receiveentries(jobs->release, output + statuslen + 1,
+			len - statuslen - 1);
+	if (RET_WAS_ERROR(r))
+		return r;
+	r = target_exportdone(target, jobs->release, output);
+	if (RET_WAS_ERROR(r))
+		return r;
+	if (target->exportmode->release != NULL) {
+		r = release_directorydescription(jobs->release,
+				jobs->distribution, target,
+				target->exportmode->release,
+				jobs->onlyneeded);
+		if (RET_WAS_ERROR(r))
+			return r;
+	}
+	return RET_OK;
+}
+
+static retvalue exportinworkers(struct distribution *distribution, struct release *release, bool onlyneeded) {
+	struct exportjobs jobs;
+	struct target *target;
+	size_t count;
+	retvalue result, r;
+
+	result = RET_NOTHING;
+	count = 0;
+	for (target=distribution->targets; target != NULL ;
+	                                   target = target->next) {
+		r = release_mkdir(release, target->relativedirectory);
+		RET_ENDUPDATE(result, r);
+		if (RET_WAS_ERROR(r))
+			return r;
+		count++;
+	}
+	if (count == 0)
+		return result;
+	jobs.distribution = distribution;
+	jobs.release = release;
+	jobs.onlyneeded = onlyneeded;
+	jobs.targets = nNEW(count, struct target *);
+	if (FAILEDTOALLOC(jobs.targets))
+		return RET_ERROR_OOM;
+	count = 0;
+	for (target=distribution->targets; target != NULL ;
+	                                   target = target->next)
+		jobs.targets[count++] = target;
+
+	r = jobs_run(global.exportjobs, count,
+			exportjob_run, exportjob_done, &jobs);
+	free(jobs.targets);
+	RET_UPDATE(result, r);
+	return result;
+}
+
+static retvalue export(struct distribution *distribution, bool onlyneeded) {
+	struct target *target;
+	retvalue result, r;
+	struct release *release;
+
+	assert (distribution != NULL);
+
+	if (distribution->readonly) {
+		fprintf(stderr,
+"Error: trying to re-export read-only distribution %s\n",
+				distribution->codename);
+		return RET_ERROR;
+	}
+
+	r = release_init(&release, distribution->codename, distribution->suite,
+			distribution->fakecomponentprefix);
+	if (RET_WAS_ERROR(r))
+		return r;
+
+	if (global.exportjobs > 1)
+		result = exportinworkers(distribution, release, onlyneeded);
+	else
+		result = exportserially(distribution, release, onlyneeded);
 	if (!RET_WAS_ERROR(result) && distribution->contents.flags.enabled) {
 		r = contents_generate(distribution, release, onlyneeded);
 	}
@@ -279,6 +279,7 @@ retvalue downloadcache_add(struct downloadcache *cache, struct aptmethod *method
 		return r;
 	}
 	r = aptmethod_enqueue(method, orig, fullfilename,
+			checksums_getfilesize(checksums),
 			downloaditem_callback, item, cache);
 	if (RET_WAS_ERROR(r)) {
 		freeitem(item);
@@ -37,19 +37,13 @@
 #define cisalpha(a) (isalpha(a)!=0)
 #define cisdigit(a) (isdigit(a)!=0)
 
-/* from dpkg-db.h.in: */
-
-struct versionrevision {
-  unsigned long epoch;
-  const char *version;
-  const char *revision;
-};
-
-/* from parsehelp.c */
+/* from parsehelp.c (changed to not copy the string but only remember
+ * where the parts end) */
 
 static
-const char *parseversion(struct versionrevision *rversion, const char *string) {
-  char *hyphen, *colon, *eepochcolon;
+const char *parseversion(struct dpkgversion *rversion, const char *string) {
+  const char *hyphen;
+  char *colon, *eepochcolon;
   const char *end, *ptr;
   unsigned long epoch;
 
@@ -76,10 +70,17 @@ const char *parseversion(struct versionrevision *rversion, const char *string) {
   } else {
     rversion->epoch= 0;
   }
-  rversion->version= strndup(string, end - string);
-  hyphen= strrchr(rversion->version,'-');
-  if (hyphen) *hyphen++= 0;
-  rversion->revision= hyphen ? hyphen : "";
+  rversion->version= string;
+  hyphen= memrchr(string, '-', end - string);
+  if (hyphen) {
+    rversion->versionend= hyphen;
+    rversion->revision= hyphen + 1;
+    rversion->revisionend= end;
+  } else {
+    rversion->versionend= end;
+    rversion->revision= end;
+    rversion->revisionend= end;
+  }
 
   return NULL;
 }
@@ -93,59 +94,82 @@ const char *parseversion(struct versionrevision *rversion, const char *string) {
 		: cisalpha((x)) ? (x) \
 		: (x) + 256)
 
-static int verrevcmp(const char *val, const char *ref) {
-  if (!val) val= "";
-  if (!ref) ref= "";
+/* (changed to compare strings given by start and end) */
+#define VAL (val < vend ? *val : 0)
+#define REF (ref < rend ? *ref : 0)
+
+static int verrevcmp(const char *val, const char *vend, const char *ref, const char *rend) {
+  /* own addition: skip a common beginning (as that compares the same),
+   * unless it ends within a number */
+  size_t l= 0;
+  while (val + l < vend && ref + l < rend && val[l] == ref[l]) l++;
+  while (l > 0 && cisdigit(val[l - 1])) l--;
+  val += l; ref += l;
 
-  while (*val || *ref) {
+  while (val < vend || ref < rend) {
     int first_diff= 0;
 
-    while ((*val && !cisdigit(*val)) || (*ref && !cisdigit(*ref))) {
-      int vc= order(*val), rc= order(*ref);
+    while ((val < vend && !cisdigit(*val)) || (ref < rend && !cisdigit(*ref))) {
+      int vc= order(VAL), rc= order(REF);
       if (vc != rc) return vc - rc;
       val++; ref++;
     }
 
-    while (*val == '0') val++;
-    while (*ref == '0') ref++;
-    while (cisdigit(*val) && cisdigit(*ref)) {
+    while (val < vend && *val == '0') val++;
+    while (ref < rend && *ref == '0') ref++;
+    while (val < vend && ref < rend && cisdigit(*val) && cisdigit(*ref)) {
       if (!first_diff) first_diff= *val - *ref;
       val++; ref++;
     }
-    if (cisdigit(*val)) return 1;
-    if (cisdigit(*ref)) return -1;
+    if (val < vend && cisdigit(*val)) return 1;
+    if (ref < rend && cisdigit(*ref)) return -1;
     if (first_diff) return first_diff;
   }
   return 0;
 }
+#undef VAL
+#undef REF
 
-static
-int versioncompare(const struct versionrevision *version,
-                   const struct versionrevision *refversion) {
+int dpkgversion_cmp(const struct dpkgversion *version,
+                   const struct dpkgversion *refversion) {
   int r;
 
   if (version->epoch > refversion->epoch) return 1;
   if (version->epoch < refversion->epoch) return -1;
-  r= verrevcmp(version->version,refversion->version);  if (r) return r;
-  return verrevcmp(version->revision,refversion->revision);
+  r= verrevcmp(version->version, version->versionend,
+               refversion->version, refversion->versionend);
+  if (r) return r;
+  return verrevcmp(version->revision, version->revisionend,
+                   refversion->revision, refversion->revisionend);
 }
 
 /* now own code */
 
-retvalue dpkgversions_cmp(const char *first,const char *second,int *result) {
-	struct versionrevision v1,v2;
+const char *dpkgversion_split(struct dpkgversion *version, const char *string) {
+	return parseversion(version, string);
+}
+
+retvalue dpkgversion_parse(struct dpkgversion *version, const char *string) {
 	const char *m;
 
-	if ((m = parseversion(&v1,first)) != NULL) {
-	   fprintf(stderr,"Error while parsing '%s' as version: %s\n",first,m);
-	   return RET_ERROR;
+	if ((m = parseversion(version, string)) != NULL) {
+		fprintf(stderr, "Error while parsing '%s' as version: %s\n",
+				string, m);
+		return RET_ERROR;
 	}
-	if ((m = parseversion(&v2,second)) != NULL) {
-	   fprintf(stderr,"Error while parsing '%s' as version: %s\n",second,m);
-	   return RET_ERROR;
-	}
-	*result = versioncompare(&v1,&v2);
-	free((char*)v1.version);
-	free((char*)v2.version);
+	return RET_OK;
+}
+
+retvalue dpkgversions_cmp(const char *first,const char *second,int *result) {
+	struct dpkgversion v1,v2;
+	retvalue r;
+
+	r = dpkgversion_parse(&v1, first);
+	if (RET_WAS_ERROR(r))
+		return r;
+	r = dpkgversion_parse(&v2, second);
+	if (RET_WAS_ERROR(r))
+		return r;
+	*result = dpkgversion_cmp(&v1, &v2);
 	return RET_OK;
 }
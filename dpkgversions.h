@@ -10,4 +10,18 @@
  * otherwise RET_OK and result is <0, ==0 or >0, if first is smaller, equal or larger */
 retvalue dpkgversions_cmp(const char *, const char *, /*@out@*/int *);
 
+/* a version split into its parts (pointing into the string parsed,
+ * which must stay around), to compare it multiple times without
+ * parsing it again */
+struct dpkgversion {
+	unsigned long epoch;
+	/*@dependent@*/const char *version, *versionend;
+	/*@dependent@*/const char *revision, *revisionend;
+};
+retvalue dpkgversion_parse(/*@out@*/struct dpkgversion *, const char *);
+/* the same without printing an error, returns why it is no version or NULL */
+/*@null@*/const char *dpkgversion_split(/*@out@*/struct dpkgversion *, const char *);
+/* <0, ==0 or >0, like dpkgversions_cmp */
+int dpkgversion_cmp(const struct dpkgversion *, const struct dpkgversion *);
+
 #endif
@@ -0,0 +1,308 @@
+/*  This file is part of "reprepro"
+ *  Copyright (C) 2026 agent
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+#include <config.h>
+
+#include <errno.h>
+#include <assert.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+
+#include "error.h"
+#include "filecntl.h"
+#include "eventloop.h"
+
+struct watch {
+	int events;
+	event_callback *callback;
+	void *privdata;
+};
+
+/* indexed by file descriptor */
+static struct watch *watches = NULL;
+static int watches_size = 0;
+static int watchcount = 0;
+#ifdef HAVE_SYS_EPOLL_H
+static int epollfd = -1;
+#endif
+
+/* the signal handler for SIGCHLD writes into this pipe */
+static int childpipe[2] = { -1, -1 };
+static unsigned int catchingchildren = 0;
+static struct sigaction oldchildaction;
+
+#ifdef HAVE_SYS_EPOLL_H
+static inline uint32_t epoll_events(int events) {
+	return ((events & EVENT_READ) != 0 ? EPOLLIN : 0)
+		| ((events & EVENT_WRITE) != 0 ? EPOLLOUT : 0);
+}
+
+static retvalue epoll_init(void) {
+	if (epollfd >= 0)
+		return RET_OK;
+	epollfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epollfd < 0) {
+		int e = errno;
+		fprintf(stderr, "Error %d creating epoll instance: %s\n",
+				e, strerror(e));
+		return RET_ERRNO(e);
+	}
+	return RET_OK;
+}
+
+static retvalue epoll_change(int op, int fd, int events) {
+	struct epoll_event ev;
+	retvalue r;
+
+	r = epoll_init();
+	if (RET_WAS_ERROR(r))
+		return r;
+	memset(&ev, 0, sizeof(ev));
+	ev.events = epoll_events(events);
+	ev.data.fd = fd;
+	if (epoll_ctl(epollfd, op, fd, &ev) != 0) {
+		int e = errno;
+		fprintf(stderr, "Error %d watching file descriptor %d: %s\n",
+				e, fd, strerror(e));
+		return RET_ERRNO(e);
+	}
+	return RET_OK;
+}
+#endif
+
+retvalue events_watch(int fd, int events, event_callback *callback, void *privdata) {
+	struct watch *w;
+
+	assert (fd >= 0);
+	if (fd >= watches_size) {
+		int newsize = fd + 64;
+
+		if (events == 0)
+			return RET_NOTHING;
+		w = realloc(watches, newsize * sizeof(struct watch));
+		if (FAILEDTOALLOC(w))
+			return RET_ERROR_OOM;
+		memset(w + watches_size, 0,
+				(newsize - watches_size) * sizeof(struct watch));
+		watches = w;
+		watches_size = newsize;
+	}
+	w = &watches[fd];
+	w->callback = callback;
+	w->privdata = privdata;
+	if (w->events == events)
+		return RET_OK;
+#ifdef HAVE_SYS_EPOLL_H
+	{
+		retvalue r;
+
+		if (events == 0)
+			r = epoll_change(EPOLL_CTL_DEL, fd, 0);
+		else if (w->events == 0)
+			r = epoll_change(EPOLL_CTL_ADD, fd, events);
+		else
+			r = epoll_change(EPOLL_CTL_MOD, fd, events);
+		if (RET_WAS_ERROR(r))
+			return r;
+	}
+#endif
+	if (w->events == 0)
+		watchcount++;
+	else if (events == 0)
+		watchcount--;
+	w->events = events;
+	return RET_OK;
+}
+
+static void drainchildpipe(void) {
+	char buffer[64];
+
+	while (read(childpipe[0], buffer, sizeof(buffer)) > 0)
+		;
+}
+
+static retvalue callwatch(int fd, int happened) {
+	const struct watch *w;
+
+	if (fd == childpipe[0]) {
+		drainchildpipe();
+		return RET_OK;
+	}
+	if (fd >= watches_size)
+		return RET_NOTHING;
+	w = &watches[fd];
+	/* might have been removed by an earlier callback */
+	if (w->events == 0)
+		return RET_NOTHING;
+	happened &= w->events;
+	if (happened == 0)
+		return RET_NOTHING;
+	return w->callback(w->privdata, fd, happened);
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+retvalue events_dispatch(int timeout, retvalue *result_p) {
+	struct epoll_event ev[64];
+	retvalue r;
+	int i, count;
+
+	r = epoll_init();
+	if (RET_WAS_ERROR(r))
+		return r;
+	count = epoll_wait(epollfd, ev, 64, timeout);
+	if (count < 0) {
+		int e = errno;
+		if (e == EINTR)
+			return RET_NOTHING;
+		fprintf(stderr, "Error %d waiting for events: %s\n",
+				e, strerror(e));
+		return RET_ERRNO(e);
+	}
+	for (i = 0 ; i < count ; i++) {
+		int happened;
+
+		if ((ev[i].events & (EPOLLERR|EPOLLHUP)) != 0)
+			happened = EVENT_READ|EVENT_WRITE;
+		else
+			happened = ((ev[i].events & EPOLLIN) != 0 ?
+					EVENT_READ : 0)
+				| ((ev[i].events & EPOLLOUT) != 0 ?
+					EVENT_WRITE : 0);
+		r = callwatch(ev[i].data.fd, happened);
+		RET_UPDATE(*result_p, r);
+	}
+	return (count > 0) ? RET_OK : RET_NOTHING;
+}
+#else
+retvalue events_dispatch(int timeout, retvalue *result_p) {
+	struct pollfd *p;
+	retvalue r;
+	int fd, i, count, ready;
+
+	p = nzNEW(watchcount + 1, struct pollfd);
+	if (FAILEDTOALLOC(p))
+		return RET_ERROR_OOM;
+	count = 0;
+	if (catchingchildren > 0) {
+		p[count].fd = childpipe[0];
+		p[count].events = POLLIN;
+		count++;
+	}
+	for (fd = 0 ; fd < watches_size ; fd++) {
+		if (watches[fd].events == 0)
+			continue;
+		p[count].fd = fd;
+		p[count].events =
+			((watches[fd].events & EVENT_READ) != 0 ? POLLIN : 0)
+			| ((watches[fd].events & EVENT_WRITE) != 0 ?
+				POLLOUT : 0);
+		count++;
+	}
+	ready = poll(p, count, timeout);
+	if (ready < 0) {
+		int e = errno;
+		free(p);
+		if (e == EINTR)
+			return RET_NOTHING;
+		fprintf(stderr, "Error %d waiting for events: %s\n",
+				e, strerror(e));
+		return RET_ERRNO(e);
+	}
+	for (i = 0 ; i < count ; i++) {
+		int happened;
+
+		if ((p[i].revents & (POLLERR|POLLHUP|POLLNVAL)) != 0)
+			happened = EVENT_READ|EVENT_WRITE;
+		else
+			happened = ((p[i].revents & POLLIN) != 0 ?
+					EVENT_READ : 0)
+				| ((p[i].revents & POLLOUT) != 0 ?
+					EVENT_WRITE : 0);
+		if (happened == 0)
+			continue;
+		r = callwatch(p[i].fd, happened);
+		RET_UPDATE(*result_p, r);
+	}
+	free(p);
+	return (ready > 0) ? RET_OK : RET_NOTHING;
+}
+#endif
+
+static void childterminated(UNUSED(int signum)) {
+	int e = errno;
+
+	/* if the pipe is full, there is already something to notice */
+	if (write(childpipe[1], "", 1) < 0)
+		errno = e;
+}
+
+retvalue events_catchchildren(bool enable) {
+	struct sigaction sa;
+
+	if (!enable) {
+		assert (catchingchildren > 0);
+		if (--catchingchildren == 0)
+			(void)sigaction(SIGCHLD, &oldchildaction, NULL);
+		return RET_OK;
+	}
+	if (catchingchildren++ > 0)
+		return RET_OK;
+	if (childpipe[0] < 0) {
+		if (pipe(childpipe) != 0) {
+			int e = errno;
+			fprintf(stderr, "Error %d creating pipe: %s!\n",
+					e, strerror(e));
+			catchingchildren--;
+			return RET_ERRNO(e);
+		}
+		markcloseonexec(childpipe[0]);
+		markcloseonexec(childpipe[1]);
+		(void)fcntl(childpipe[0], F_SETFL, O_NONBLOCK);
+		(void)fcntl(childpipe[1], F_SETFL, O_NONBLOCK);
+#ifdef HAVE_SYS_EPOLL_H
+		{
+			retvalue r;
+
+			r = epoll_change(EPOLL_CTL_ADD, childpipe[0],
+					EVENT_READ);
+			if (RET_WAS_ERROR(r)) {
+				catchingchildren--;
+				return r;
+			}
+		}
+#endif
+	}
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = childterminated;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+	if (sigaction(SIGCHLD, &sa, &oldchildaction) != 0) {
+		int e = errno;
+		fprintf(stderr, "Error %d setting signal handler: %s!\n",
+				e, strerror(e));
+		catchingchildren--;
+		return RET_ERRNO(e);
+	}
+	return RET_OK;
+}
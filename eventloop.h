@@ -0,0 +1,32 @@
+#ifndef REPREPRO_EVENTLOOP_H
+#define REPREPRO_EVENTLOOP_H
+
+#ifndef REPREPRO_ERROR_H
+#include "error.h"
+#endif
+
+/* One place to wait for file descriptors of all the helper processes
+ * (apt methods, notifiers) and for child processes to terminate.
+ * Uses epoll if available (so no FD_SETSIZE limit), poll otherwise. */
+
+#define EVENT_READ 1
+#define EVENT_WRITE 2
+
+/* called with the events that happened (errors and hangups are reported
+ * as all events the descriptor is watched for, so reading or writing
+ * notices them) */
+typedef retvalue event_callback(void *, int /*fd*/, int /*events*/);
+
+/* set which events to watch fd for (0 to no longer watch it, which has to
+ * be done before closing it) */
+retvalue events_watch(int /*fd*/, int /*events*/, event_callback *, void *);
+/* wait up to timeout milliseconds (-1 = unlimited) for events and call
+ * the callbacks, whose return values are merged into *result.
+ * Returns RET_NOTHING if nothing happened (timeout or interrupted by a
+ * signal) and an error only if waiting itself failed */
+retvalue events_dispatch(int /*timeout*/, retvalue * /*result*/);
+/* while enabled, also return from events_dispatch when a child process
+ * terminated (the caller has to look for which one with waitpid) */
+retvalue events_catchchildren(bool);
+
+#endif
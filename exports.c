@@ -46,6 +46,12 @@ static const char *exportdescription(const struct exportmode *mode, char *buffer
 		,"gzipped"
 #ifdef HAVE_LIBBZ2
 		,"bzip2ed"
+#endif
+#ifdef HAVE_LIBLZMA
+		,"xzed"
+#endif
+#ifdef HAVE_LIBZSTD
+		,"zstded"
 #endif
 	};
 	bool needcomma = false,
@@ -183,7 +189,7 @@ retvalue exportmode_set(struct exportmode *mode, struct configiterator *iter) {
 	if (r == RET_NOTHING) {
 		fprintf(stderr,
 "Error parsing %s, line %u, column %u: Unexpected end of field!\n"
-"Compression identifiers ('.', '.gz' or '.bz2') missing.\n",
+"Compression identifiers ('.', '.gz', '.bz2', '.xz' or '.zst') missing.\n",
 			config_filename(iter),
 			config_markerline(iter), config_markercolumn(iter));
 		return RET_ERROR;
@@ -191,7 +197,7 @@ retvalue exportmode_set(struct exportmode *mode, struct configiterator *iter) {
 	if (word[0] != '.') {
 		fprintf(stderr,
 "Error parsing %s, line %u, column %u:\n"
-"Compression extension ('.', '.gz' or '.bz2') expected.\n",
+"Compression extension ('.', '.gz', '.bz2', '.xz' or '.zst') expected.\n",
 			config_filename(iter),
 			config_markerline(iter), config_markercolumn(iter));
 		free(word);
@@ -208,6 +214,16 @@ retvalue exportmode_set(struct exportmode *mode, struct configiterator *iter) {
 		else if (word[1] == 'b' && word[2] == 'z' && word[3] == '2' &&
 				word[4] == '\0')
 			mode->compressions |= IC_FLAG(ic_bzip2);
+#endif
+#ifdef HAVE_LIBLZMA
+		else if (word[1] == 'x' && word[2] == 'z' &&
+				word[3] == '\0')
+			mode->compressions |= IC_FLAG(ic_xz);
+#endif
+#ifdef HAVE_LIBZSTD
+		else if (word[1] == 'z' && word[2] == 's' && word[3] == 't' &&
+				word[4] == '\0')
+			mode->compressions |= IC_FLAG(ic_zstd);
 #endif
 		else {
 			fprintf(stderr,
@@ -453,10 +469,9 @@ static retvalue callexporthook(/*@null@*/const char *hook, const char *relfilena
 	}
 }
 
-retvalue export_target(const char *relativedir, struct target *target,  const struct exportmode *exportmode, struct release *release, bool onlyifmissing, bool snapshot) {
+retvalue export_targetfiles(const char *relativedir, struct target *target,  const struct exportmode *exportmode, struct release *release, bool onlyifmissing, /*@out@*/const char **status_p) {
 	retvalue r;
 	struct filetorelease *file;
-	const char *status;
 	char *relfilename;
 	char buffer[100];
 	const char *chunk;
@@ -479,13 +494,13 @@ retvalue export_target(const char *relativedir, struct target *target,  const st
 				printf("  replacing '%s/%s'%s\n",
 					release_dirofdist(release), relfilename,
 					exportdescription(exportmode, buffer, 100));
-			status = "change";
+			*status_p = "change";
 		} else {
 			if (verbose > 5)
 				printf("  creating '%s/%s'%s\n",
 					release_dirofdist(release), relfilename,
 					exportdescription(exportmode, buffer, 100));
-			status = "new";
+			*status_p = "new";
 		}
 		r = target_openiterator(target, READONLY, &iterator);
 		if (RET_WAS_ERROR(r)) {
@@ -518,19 +533,30 @@ retvalue export_target(const char *relativedir, struct target *target,  const st
 			printf("  keeping old '%s/%s'%s\n",
 				release_dirofdist(release), relfilename,
 				exportdescription(exportmode, buffer, 100));
-		status = "old";
+		*status_p = "old";
 	}
-	if (!snapshot) {
-		int i;
+	free(relfilename);
+	return RET_OK;
+}
 
-		for (i = 0 ; i < exportmode->hooks.count ; i++) {
-			const char *hook = exportmode->hooks.values[i];
+retvalue export_targethooks(const char *relativedir, const struct exportmode *exportmode, struct release *release, const char *status) {
+	retvalue r;
+	char *relfilename;
+	int i;
 
-			r = callexporthook(hook, relfilename, status, release);
-			if (RET_WAS_ERROR(r)) {
-				free(relfilename);
-				return r;
-			}
+	if (exportmode->hooks.count == 0)
+		return RET_OK;
+
+	relfilename = calc_dirconcat(relativedir, exportmode->filename);
+	if (FAILEDTOALLOC(relfilename))
+		return RET_ERROR_OOM;
+	for (i = 0 ; i < exportmode->hooks.count ; i++) {
+		const char *hook = exportmode->hooks.values[i];
+
+		r = callexporthook(hook, relfilename, status, release);
+		if (RET_WAS_ERROR(r)) {
+			free(relfilename);
+			return r;
 		}
 	}
 	free(relfilename);
@@ -22,5 +22,7 @@ struct configiterator;
 retvalue exportmode_set(struct exportmode *, struct configiterator *);
 void exportmode_done(struct exportmode *);
 
-retvalue export_target(const char * /*relativedir*/, struct target *, const struct exportmode *, struct release *, bool /*onlyifmissing*/, bool /*snapshot*/);
+/* generating the index files of a target and calling the hooks afterwards */
+retvalue export_targetfiles(const char * /*relativedir*/, struct target *, const struct exportmode *, struct release *, bool /*onlyifmissing*/, /*@out@*/const char ** /*status_p*/);
+retvalue export_targethooks(const char * /*relativedir*/, const struct exportmode *, struct release *, const char * /*status*/);
 #endif
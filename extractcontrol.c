@@ -236,6 +236,11 @@ retvalue extractcontrol(char **control, const char *debfile) {
 	return r;
 }
 
+retvalue ingestdeb(UNUSED(const char *debfile), UNUSED(ingest_decide *decide), UNUSED(void *privdata), UNUSED(struct checksums **checksums_p), UNUSED(char **filelist_p), UNUSED(size_t *size_p)) {
+	/* without libarchive the files are read by external programs */
+	return RET_NOTHING;
+}
+
 retvalue getfilelist(/*@out@*/char **filelist, /*@out@*/size_t *size, const char *debfile) {
 	fprintf(stderr,
 "Extraction of file list without libarchive currently not implemented.\n");
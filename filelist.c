@@ -26,6 +26,7 @@
 #include "files.h"
 #include "debfile.h"
 #include "filelist.h"
+#include "jobs.h"
 
 struct filelist_package {
 	struct filelist_package *next;
@@ -428,9 +429,39 @@ static retvalue filelist_addfiles(struct filelist_list *list, const struct filel
 	return RET_OK;
 }
 
+/* get the (compressed) file list of a .deb, either from the cache or
+ * by reading the file (in which case it is added to the cache once
+ * the caller called cachefilelist) */
+static retvalue getcachedfilelist(const char *filekey, bool onlycached, /*@out@*/const char **data_p, /*@out@*/size_t *len_p, /*@out@*/char **contents_p) {
+	char *debfilename;
+	retvalue r;
+
+	*contents_p = NULL;
+	r = table_gettemprecord(rdb_contents, filekey, data_p, len_p);
+	if (r != RET_NOTHING || onlycached)
+		return r;
+	if (verbose > 3)
+		printf("Reading filelist for %s\n", filekey);
+	debfilename = files_calcfullfilename(filekey);
+	if (FAILEDTOALLOC(debfilename))
+		return RET_ERROR_OOM;
+	r = getfilelist(contents_p, len_p, debfilename);
+	free(debfilename);
+	if (RET_IS_OK(r)) {
+		(*len_p)--;
+		*data_p = *contents_p;
+	}
+	return r;
+}
+
+static inline retvalue cachefilelist(const char *filekey, const char *contents, size_t len) {
+	return table_adduniqsizedrecord(rdb_contents, filekey,
+			contents, len + 1, true, false);
+}
+
 retvalue filelist_addpackage(struct filelist_list *list, const char *packagename, const char *section, const char *filekey) {
 	const struct filelist_package *package IFSTUPIDCC(=NULL);
-	char *debfilename, *contents = NULL;
+	char *contents;
 	retvalue r;
 	const char *c;
 	size_t len;
@@ -440,28 +471,222 @@ retvalue filelist_addpackage(struct filelist_list *list, const char *packagename
 	if (RET_WAS_ERROR(r))
 		return r;
 
-	r = table_gettemprecord(rdb_contents, filekey, &c, &len);
-	if (r == RET_NOTHING) {
+	r = getcachedfilelist(filekey, false, &c, &len, &contents);
+	if (RET_IS_OK(r)) {
+		r = filelist_addfiles(list, package, filekey, c, len + 1);
+		if (contents != NULL)
+			r = cachefilelist(filekey, contents, len);
+	}
+	free(contents);
+	return r;
+}
+
+/* add the filekey to the list if its file list is not yet cached,
+ * RET_NOTHING if it is */
+retvalue filelist_addmissing(struct strlist *missing, const char *filekey) {
+	if (table_recordexists(rdb_contents, filekey))
+		return RET_NOTHING;
+	return strlist_add_dup(missing, filekey);
+}
+
+/* Reading the file lists of uncached .debs is the slowest part of
+ * generating Contents files for the first time, so this can be done
+ * for all of them in worker processes first. Every worker reads a batch
+ * of .debs and sends the length and data of each file list back, the
+ * parent then stores them in contents.cache.db (so the following
+ * filelist_addpackage calls only need to look them up there). */
+
+struct prefetch {
+	const struct strlist *filekeys;
+	size_t batches;
+};
+
+static inline size_t batchstart(const struct prefetch *p, size_t i) {
+	return (p->filekeys->count * i) / p->batches;
+}
+
+static retvalue prefetch_run(void *data, size_t i, int fd) {
+	const struct prefetch *p = data;
+	size_t j, end = batchstart(p, i + 1);
+	retvalue r;
+
+	for (j = batchstart(p, i) ; j < end ; j++) {
+		const char *filekey = p->filekeys->values[j];
+		char *debfilename, *contents;
+		size_t len;
+
 		if (verbose > 3)
 			printf("Reading filelist for %s\n", filekey);
 		debfilename = files_calcfullfilename(filekey);
 		if (FAILEDTOALLOC(debfilename))
 			return RET_ERROR_OOM;
 		r = getfilelist(&contents, &len, debfilename);
-		len--;
 		free(debfilename);
-		c = contents;
+		if (RET_WAS_ERROR(r))
+			return r;
+		r = jobs_write(fd, &len, sizeof(len));
+		if (RET_IS_OK(r))
+			r = jobs_write(fd, contents, len);
+		free(contents);
+		if (RET_WAS_ERROR(r))
+			return r;
+	}
+	return RET_OK;
+}
+
+static retvalue prefetch_done(void *data, size_t i, const char *output, size_t outputlen) {
+	const struct prefetch *p = data;
+	size_t j, end = batchstart(p, i + 1);
+	retvalue r;
+
+	for (j = batchstart(p, i) ; j < end ; j++) {
+		size_t len;
+
+		if (outputlen < sizeof(len))
+			break;
+		memcpy(&len, output, sizeof(len));
+		output += sizeof(len);
+		outputlen -= sizeof(len);
+		if (len == 0 || len > outputlen
+				|| output[len - 1] != '\0')
+			break;
+		r = cachefilelist(p->filekeys->values[j], output, len - 1);
+		if (RET_WAS_ERROR(r))
+			return r;
+		output += len;
+		outputlen -= len;
+	}
+	if (j < end || outputlen != 0) {
+		fprintf(stderr,
+"Internal Error: malformed output of worker process reading file lists!\n");
+		return RET_ERROR_INTERNAL;
+	}
+	return RET_OK;
+}
+
+static int comparefilekeys(const void *a, const void *b) {
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+retvalue filelist_prefetch(struct strlist *filekeys, unsigned int jobs) {
+	struct prefetch p;
+	int i, count;
+
+	/* the same .deb is usually in many targets */
+	qsort(filekeys->values, filekeys->count, sizeof(char *),
+			comparefilekeys);
+	count = 0;
+	for (i = 0 ; i < filekeys->count ; i++) {
+		if (count > 0 && strcmp(filekeys->values[count - 1],
+					filekeys->values[i]) == 0)
+			free(filekeys->values[i]);
+		else
+			filekeys->values[count++] = filekeys->values[i];
+	}
+	filekeys->count = count;
+	if (count == 0)
+		return RET_NOTHING;
+	if (verbose > 1)
+		printf("Reading file lists of %d packages with %u processes...\n",
+				count, jobs);
+
+	p.filekeys = filekeys;
+	/* more batches than jobs, so that a slow one does not
+	 * keep all the others waiting to be reported */
+	p.batches = 4 * (size_t)jobs;
+	if (p.batches > (size_t)count)
+		p.batches = count;
+	return jobs_run(jobs, p.batches, prefetch_run, prefetch_done, &p);
+}
+
+/* call action with the full filename of every file in the file list */
+static retvalue filelist_decode(const char *filekey, const char *datastart, size_t size, filelist_file_action *action, void *privdata) {
+	const unsigned char *data = (const unsigned char *)datastart;
+	size_t dirlens[256], pathsize = 1024, pathlen = 0;
+	unsigned int depth = 0;
+	char *path;
+	retvalue r = RET_OK;
+
+	path = malloc(pathsize);
+	if (FAILEDTOALLOC(path))
+		return RET_ERROR_OOM;
+	while (*data != '\0') {
+		int d;
+		size_t len;
+
+		if ((size_t)(data - (const unsigned char *)datastart) >= size-1)
+			break;
+		d = *(data++);
+		if (d > 2) {
+			d -= 2;
+			while (d-- > 0 && depth > 0)
+				pathlen = dirlens[--depth];
+			continue;
+		}
+		len = 0;
+		while (*data == 255) {
+			data++;
+			len += 255;
+		}
+		if (*data == 0 || (d == 2 && depth >= 256))
+			break;
+		len += *(data++);
+		if (pathlen + len + 2 > pathsize) {
+			char *n;
+
+			pathsize = pathlen + len + 1024;
+			n = realloc(path, pathsize);
+			if (FAILEDTOALLOC(n)) {
+				free(path);
+				return RET_ERROR_OOM;
+			}
+			path = n;
+		}
+		if (d == 1) {
+			memcpy(path + pathlen, data, len);
+			path[pathlen + len] = '\0';
+			r = action(privdata, path, pathlen + len);
+			if (RET_WAS_ERROR(r)) {
+				free(path);
+				return r;
+			}
+		} else {
+			dirlens[depth++] = pathlen;
+			memcpy(path + pathlen, data, len);
+			pathlen += len;
+			path[pathlen++] = '/';
+		}
+		data += len;
 	}
+	free(path);
+	if ((size_t)(data - (const unsigned char *)datastart) != size-1) {
+		fprintf(stderr, "Corrupted file list data for %s\n", filekey);
+		return RET_ERROR;
+	}
+	return RET_OK;
+}
+
+retvalue filelist_foreachfile(const char *filekey, bool onlycached, filelist_file_action *action, void *privdata) {
+	char *contents;
+	retvalue r;
+	const char *c;
+	size_t len;
+
+	r = getcachedfilelist(filekey, onlycached, &c, &len, &contents);
 	if (RET_IS_OK(r)) {
-		r = filelist_addfiles(list, package, filekey, c, len + 1);
-		if (contents != NULL)
-			r = table_adduniqsizedrecord(rdb_contents, filekey,
-					contents, len + 1, true, false);
+		r = filelist_decode(filekey, c, len + 1, action, privdata);
+		if (contents != NULL && RET_IS_OK(r))
+			r = cachefilelist(filekey, contents, len);
 	}
 	free(contents);
 	return r;
 }
 
+retvalue filelist_cache(const char *filekey, const char *filelist, size_t size) {
+	return table_adduniqsizedrecord(rdb_contents, filekey,
+			filelist, size, true, false);
+}
+
 retvalue fakefilelist(const char *filekey) {
 	return table_adduniqsizedrecord(rdb_contents, filekey,
 			"", 1, true, false);
@@ -553,6 +778,193 @@ retvalue filelist_write(struct filelist_list *list, struct filetorelease *file)
 	return r;
 }
 
+/* Store the collected lists in a table (to be kept for later incremental
+ * updates), with the full filename as key and the comma separated list of
+ * section/package as data */
+
+static retvalue filelist_storefiles(const char *dir, size_t len, struct filelist *files, struct table *table) {
+	retvalue r;
+
+	while (files != NULL) {
+		char *key, *data, *p;
+		size_t datalen, namelen;
+		unsigned int i;
+
+		if (files->nextl != NULL) {
+			r = filelist_storefiles(dir, len, files->nextl, table);
+			if (RET_WAS_ERROR(r))
+				return r;
+		}
+		namelen = strlen(files->name);
+		datalen = 0;
+		for (i = 0 ; i < files->count ; i++)
+			datalen += strlen(files->packages[i]) + 1;
+		key = malloc(len + namelen + 1);
+		data = malloc(datalen);
+		if (FAILEDTOALLOC(key) || FAILEDTOALLOC(data)) {
+			free(key);
+			free(data);
+			return RET_ERROR_OOM;
+		}
+		memcpy(key, dir, len);
+		memcpy(key + len, files->name, namelen + 1);
+		p = data;
+		for (i = 0 ; i < files->count ; i++) {
+			size_t l = strlen(files->packages[i]);
+			if (i > 0)
+				*(p++) = ',';
+			memcpy(p, files->packages[i], l);
+			p += l;
+		}
+		*p = '\0';
+		r = table_adduniqsizedrecord(table, key, data, datalen,
+				true, false);
+		free(key);
+		free(data);
+		if (RET_WAS_ERROR(r))
+			return r;
+		files = files->nextr;
+	}
+	return RET_OK;
+}
+
+static retvalue filelist_storedirs(char **buffer_p, size_t *size_p, size_t ofs, struct dirlist *dir, struct table *table) {
+	retvalue r;
+
+	while (dir != NULL) {
+		size_t len = dir->len;
+
+		if (dir->nextl != NULL) {
+			r = filelist_storedirs(buffer_p, size_p, ofs,
+					dir->nextl, table);
+			if (RET_WAS_ERROR(r))
+				return r;
+		}
+		if (ofs+len+2 >= *size_p) {
+			char *n;
+
+			*size_p += 1024*(1+(len/1024));
+			n = realloc(*buffer_p, *size_p);
+			if (FAILEDTOALLOC(n))
+				return RET_ERROR_OOM;
+			*buffer_p = n;
+		}
+		memcpy((*buffer_p) + ofs, dir->name, len);
+		(*buffer_p)[ofs + len] = '/';
+		r = filelist_storefiles(*buffer_p, ofs+len+1, dir->files, table);
+		if (RET_WAS_ERROR(r))
+			return r;
+		if (dir->subdirs != NULL) {
+			r = filelist_storedirs(buffer_p, size_p, ofs+len+1,
+					dir->subdirs, table);
+			if (RET_WAS_ERROR(r))
+				return r;
+		}
+		dir = dir->nextr;
+	}
+	return RET_OK;
+}
+
+retvalue filelist_store(struct filelist_list *list, struct table *table) {
+	size_t size = 1024;
+	char *buffer = malloc(size);
+	retvalue r;
+
+	if (FAILEDTOALLOC(buffer))
+		return RET_ERROR_OOM;
+	r = filelist_storefiles("", 0, list->root->files, table);
+	if (!RET_WAS_ERROR(r))
+		r = filelist_storedirs(&buffer, &size, 0,
+				list->root->subdirs, table);
+	free(buffer);
+	return r;
+}
+
+/* write a Contents file from one or more tables generated by filelist_store,
+ * (merging the lists for files in multiple tables in the order of tables) */
+retvalue filelist_writestored(struct table **tables, int count, struct filetorelease *file) {
+	struct cursor **cursors;
+	const char **keys, **datas;
+	bool *used;
+	const char *first;
+	int i, active;
+	retvalue result, r;
+
+	cursors = nzNEW(count, struct cursor *);
+	keys = nzNEW(count, const char *);
+	datas = nzNEW(count, const char *);
+	used = nzNEW(count, bool);
+	if (FAILEDTOALLOC(cursors) || FAILEDTOALLOC(keys) ||
+			FAILEDTOALLOC(datas) || FAILEDTOALLOC(used)) {
+		free(cursors); free(keys); free(datas); free(used);
+		return RET_ERROR_OOM;
+	}
+	result = RET_OK;
+	active = 0;
+	for (i = 0 ; i < count ; i++) {
+		r = table_newglobalcursor(tables[i], &cursors[i]);
+		if (RET_WAS_ERROR(r)) {
+			result = r;
+			break;
+		}
+		if (r == RET_NOTHING)
+			cursors[i] = NULL;
+		else if (cursor_nexttemp(tables[i], cursors[i],
+					&keys[i], &datas[i]))
+			active++;
+		else
+			keys[i] = NULL;
+	}
+	if (!RET_WAS_ERROR(result))
+		(void)release_writedata(file, header, sizeof(header) - 1);
+	while (!RET_WAS_ERROR(result) && active > 0) {
+		bool needcomma = false;
+
+		first = NULL;
+		for (i = 0 ; i < count ; i++) {
+			if (keys[i] == NULL)
+				continue;
+			if (first == NULL || strcmp(keys[i], first) < 0)
+				first = keys[i];
+		}
+		assert (first != NULL);
+		for (i = 0 ; i < count ; i++)
+			used[i] = keys[i] != NULL && strcmp(keys[i], first) == 0;
+		/* the empty key is used for bookkeeping */
+		if (first[0] != '\0') {
+			(void)release_writestring(file, first);
+			(void)release_writedata(file, separator_chars,
+					sizeof(separator_chars) - 1);
+			for (i = 0 ; i < count ; i++) {
+				if (!used[i])
+					continue;
+				if (needcomma)
+					(void)release_writestring(file, ",");
+				(void)release_writestring(file, datas[i]);
+				needcomma = true;
+			}
+			(void)release_writestring(file, "\n");
+		}
+		for (i = 0 ; i < count ; i++) {
+			if (!used[i])
+				continue;
+			if (!cursor_nexttemp(tables[i], cursors[i],
+						&keys[i], &datas[i])) {
+				keys[i] = NULL;
+				active--;
+			}
+		}
+	}
+	for (i = 0 ; i < count ; i++) {
+		if (cursors[i] == NULL)
+			continue;
+		r = cursor_close(tables[i], cursors[i]);
+		RET_UPDATE(result, r);
+	}
+	free(cursors); free(keys); free(datas); free(used);
+	return result;
+}
+
 /* helpers for filelist generators to get the preprocessed form */
 
 retvalue filelistcompressor_setup(/*@out@*/struct filelistcompressor *c) {
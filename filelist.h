@@ -4,6 +4,9 @@
 #ifndef REPREPRO_RELEASE_H
 #include "release.h"
 #endif
+#ifndef REPREPRO_STRLIST_H
+#include "strlist.h"
+#endif
 
 struct filelist_list;
 
@@ -13,8 +16,20 @@ retvalue filelist_addpackage(struct filelist_list *, const char *package, const
 
 retvalue filelist_write(struct filelist_list *list, struct filetorelease *file);
 
+/* for incremental Contents generation: */
+retvalue filelist_store(struct filelist_list *, struct table *);
+retvalue filelist_writestored(struct table **, int /*count*/, struct filetorelease *);
+typedef retvalue filelist_file_action(void *, const char * /*filename*/, size_t /*len*/);
+retvalue filelist_foreachfile(const char * /*filekey*/, bool /*onlycached*/, filelist_file_action *, void *);
+
+/* to read the file lists of many .debs in worker processes first: */
+retvalue filelist_addmissing(struct strlist *, const char * /*filekey*/);
+retvalue filelist_prefetch(struct strlist *, unsigned int /*jobs*/);
+
 void filelist_free(/*@only@*/struct filelist_list *);
 
+/* store a list of files read when including the file */
+retvalue filelist_cache(const char * /*filekey*/, const char *, size_t);
 retvalue fakefilelist(const char *filekey);
 retvalue filelists_translate(struct table *, struct table *);
 
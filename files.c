@@ -25,6 +25,7 @@
 #include <unistd.h>
 #include <malloc.h>
 #include <string.h>
+#include <time.h>
 #include "error.h"
 #include "strlist.h"
 #include "filecntl.h"
@@ -38,6 +39,7 @@
 #include "debfile.h"
 #include "pool.h"
 #include "database_p.h"
+#include "jobs.h"
 
 static retvalue files_get_checksums(const char *filekey, /*@out@*/struct checksums **checksums_p) {
 	const char *checksums;
@@ -67,7 +69,7 @@ retvalue files_add_checksums(const char *filekey, const struct checksums *checks
 	return pool_markadded(filekey);
 }
 
-static retvalue files_replace_checksums(const char *filekey, const struct checksums *checksums) {
+retvalue files_replace_checksums(const char *filekey, const struct checksums *checksums) {
 	retvalue r;
 	const char *combined;
 	size_t combinedlen;
@@ -347,116 +349,365 @@ retvalue files_foreach(per_file_action action, void *privdata) {
 	return result;
 }
 
-static retvalue checkpoolfile(const char *fullfilename, const struct checksums *expected, bool *improveable) {
-	struct checksums *actual;
+/* checkpool and collectnewchecksums read every file in the pool, which is
+ * done in rounds of a limited number of files, so that with
+ * --checksum-jobs the files of a round can be read by worker processes
+ * (which send the checksums they got back), while the results are
+ * always processed in the order of the database. */
+
+#define POOLBATCHSIZE 16
+#define POOLBATCHESPERJOB 8
+#define POOLPROGRESSINTERVAL 10
+
+struct poolreader;
+typedef retvalue poolfile_action(struct poolreader *, const char * /*filekey*/, const char * /*fullfilename*/, struct checksums ** /*expected*/, const struct checksums * /*actual*/);
+
+struct poolreader {
+	poolfile_action *action;
+	bool onlyincomplete;
+	bool improveable;
+	/* the combined result of all files */
+	retvalue result;
+	/* the files of the current round */
+	struct poolfile {
+		char *filekey;
+		char *fullfilename;
+		struct checksums *expected;
+	} *files;
+	size_t count, size, batches;
+	/* for progress reports */
+	size_t totalfiles, donefiles;
+	unsigned long long totalsize, donesize;
+	time_t start, lastreport;
+	bool reported;
+};
+
+static void poolreader_progress(struct poolreader *reader, bool last) {
+	time_t now;
+	double secs, rate;
+
+	/* only for long runs, so there is no output depending on timing
+	 * when it is fast anyway */
+	if (verbose <= 0 || (last && !reader->reported))
+		return;
+	now = time(NULL);
+	if (!last && now - reader->lastreport < POOLPROGRESSINTERVAL)
+		return;
+	reader->lastreport = now;
+	reader->reported = true;
+	secs = difftime(now, reader->start);
+	rate = (secs > 0)?(reader->donesize / secs):0;
+	if (last) {
+		printf(
+"Read %lu files (%llu MiB) in %.0f seconds (%.1f MiB/s).\n",
+			(unsigned long)reader->donefiles,
+			reader->donesize >> 20, secs, rate / (1024*1024));
+	} else if (rate > 0) {
+		double left = (reader->totalsize - reader->donesize) / rate;
+
+		printf(
+"Read %lu of %lu files (%llu of %llu MiB, %.1f MiB/s), about %lu:%02lu minutes left...\n",
+			(unsigned long)reader->donefiles,
+			(unsigned long)reader->totalfiles,
+			reader->donesize >> 20, reader->totalsize >> 20,
+			rate / (1024*1024),
+			(unsigned long)left / 60, (unsigned long)left % 60);
+	}
+	(void)fflush(stdout);
+}
+
+static inline size_t batchstart(const struct poolreader *reader, size_t i) {
+	return (reader->count * i) / reader->batches;
+}
+
+static retvalue poolreader_run(void *data, size_t i, int fd) {
+	const struct poolreader *reader = data;
+	size_t j, end = batchstart(reader, i + 1);
+	retvalue r, r2;
+
+	for (j = batchstart(reader, i) ; j < end ; j++) {
+		struct checksums *actual;
+		const char *combined;
+		size_t len;
+		int result;
+
+		r = checksums_read(reader->files[j].fullfilename, &actual);
+		if (r == RET_ERROR_OOM)
+			return r;
+		result = r;
+		r = jobs_write(fd, &result, sizeof(result));
+		if (RET_IS_OK(result) && RET_IS_OK(r)) {
+			r2 = checksums_getcombined(actual, &combined, &len);
+			if (RET_IS_OK(r2))
+				r = jobs_write(fd, combined, len + 1);
+			else
+				r = r2;
+		}
+		if (RET_IS_OK(result))
+			checksums_free(actual);
+		if (RET_WAS_ERROR(r))
+			return r;
+	}
+	return RET_OK;
+}
+
+static void poolreader_process(struct poolreader *reader, struct poolfile *file, retvalue r, const struct checksums *actual) {
+	if (r == RET_NOTHING) {
+		fprintf(stderr, "Missing file '%s'!\n", file->fullfilename);
+		r = RET_ERROR_MISSING;
+	}
+	if (RET_IS_OK(r))
+		r = reader->action(reader, file->filekey, file->fullfilename,
+				&file->expected, actual);
+	RET_UPDATE(reader->result, r);
+	reader->donefiles++;
+	reader->donesize += checksums_getfilesize(file->expected);
+	poolreader_progress(reader, false);
+}
+
+static retvalue poolreader_done(void *data, size_t i, const char *output, size_t len) {
+	struct poolreader *reader = data;
+	size_t j, end = batchstart(reader, i + 1);
 	retvalue r;
-	bool improves;
 
-	r = checksums_read(fullfilename, &actual);
-	if (RET_IS_OK(r)) {
-		if (!checksums_check(expected, actual, &improves)) {
-			fprintf(stderr, "WRONG CHECKSUMS of '%s':\n",
-					fullfilename);
-			checksums_printdifferences(stderr, expected, actual);
-			r = RET_ERROR_WRONG_MD5;
-		} else if (improves)
-			*improveable = true;
+	for (j = batchstart(reader, i) ; j < end ; j++) {
+		struct checksums *actual = NULL;
+		int status;
+
+		if (len < sizeof(status))
+			break;
+		memcpy(&status, output, sizeof(status));
+		output += sizeof(status);
+		len -= sizeof(status);
+		r = (retvalue)status;
+		if (RET_IS_OK(r)) {
+			size_t l = strnlen(output, len);
+
+			if (l >= len)
+				break;
+			r = checksums_setall(&actual, output, l);
+			if (RET_WAS_ERROR(r))
+				return r;
+			output += l + 1;
+			len -= l + 1;
+		}
+		poolreader_process(reader, &reader->files[j], r, actual);
 		checksums_free(actual);
+		if (reader->result == RET_ERROR_OOM)
+			return RET_ERROR_OOM;
 	}
-	return r;
+	if (j < end || len != 0) {
+		fprintf(stderr,
+"Internal Error: malformed output of worker process reading pool files!\n");
+		return RET_ERROR_INTERNAL;
+	}
+	return RET_OK;
 }
 
-retvalue files_checkpool(bool fast) {
+static void poolreader_clear(struct poolreader *reader) {
+	size_t i;
+
+	for (i = 0 ; i < reader->count ; i++) {
+		free(reader->files[i].filekey);
+		free(reader->files[i].fullfilename);
+		checksums_free(reader->files[i].expected);
+	}
+	reader->count = 0;
+}
+
+/* read the files of the current round, only returns errors that should
+ * stop everything, the results of the files are in reader->result */
+static retvalue poolreader_round(struct poolreader *reader) {
+	retvalue result = RET_NOTHING, r;
+	size_t i;
+
+	if (global.checksumjobs > 1 && reader->count > 0) {
+		reader->batches = (reader->count + POOLBATCHSIZE - 1)
+			/ POOLBATCHSIZE;
+		result = jobs_run(global.checksumjobs, reader->batches,
+				poolreader_run, poolreader_done, reader);
+	} else for (i = 0 ; i < reader->count ; i++) {
+		struct checksums *actual = NULL;
+
+		if (interrupted()) {
+			result = RET_ERROR_INTERRUPTED;
+			break;
+		}
+		r = checksums_read(reader->files[i].fullfilename, &actual);
+		poolreader_process(reader, &reader->files[i], r, actual);
+		checksums_free(actual);
+		if (reader->result == RET_ERROR_OOM) {
+			result = RET_ERROR_OOM;
+			break;
+		}
+	}
+	poolreader_clear(reader);
+	return result;
+}
+
+static retvalue poolreader_add(struct poolreader *reader, const char *filekey, /*@only@*/struct checksums *expected) {
+	struct poolfile *file;
+
+	assert (reader->count < reader->size);
+	file = &reader->files[reader->count];
+	file->filekey = strdup(filekey);
+	file->fullfilename = files_calcfullfilename(filekey);
+	if (FAILEDTOALLOC(file->filekey) || FAILEDTOALLOC(file->fullfilename)) {
+		free(file->filekey);
+		free(file->fullfilename);
+		checksums_free(expected);
+		return RET_ERROR_OOM;
+	}
+	file->expected = expected;
+	reader->count++;
+	if (reader->count < reader->size)
+		return RET_OK;
+	return poolreader_round(reader);
+}
+
+/* get the number and total size of the files to read for progress reports */
+static retvalue poolreader_count(struct poolreader *reader) {
 	retvalue result, r;
 	struct cursor *cursor;
 	const char *filekey, *combined;
 	size_t combinedlen;
 	struct checksums *expected;
-	char *fullfilename;
-	bool improveable = false;
 
-	result = RET_NOTHING;
 	r = table_newglobalcursor(rdb_checksums, &cursor);
 	if (!RET_IS_OK(r))
 		return r;
+	result = RET_NOTHING;
 	while (cursor_nexttempdata(rdb_checksums, cursor,
 				&filekey, &combined, &combinedlen)) {
 		r = checksums_setall(&expected, combined, combinedlen);
-		if (RET_WAS_ERROR(r)) {
-			RET_UPDATE(result, r);
+		if (!RET_IS_OK(r))
 			continue;
+		if (!reader->onlyincomplete || !checksums_iscomplete(expected)) {
+			reader->totalfiles++;
+			reader->totalsize += checksums_getfilesize(expected);
 		}
-		fullfilename = files_calcfullfilename(filekey);
-		if (FAILEDTOALLOC(fullfilename)) {
-			result = RET_ERROR_OOM;
+		checksums_free(expected);
+	}
+	r = cursor_close(rdb_checksums, cursor);
+	RET_ENDUPDATE(result, r);
+	return result;
+}
+
+static retvalue files_readpool(struct poolreader *reader) {
+	retvalue result, r;
+	struct cursor *cursor;
+	const char *filekey, *combined;
+	size_t combinedlen;
+	struct checksums *expected;
+
+	reader->start = time(NULL);
+	reader->lastreport = reader->start;
+	if (verbose > 0) {
+		r = poolreader_count(reader);
+		if (RET_WAS_ERROR(r))
+			return r;
+	}
+	reader->size = POOLBATCHSIZE;
+	if (global.checksumjobs > 1)
+		reader->size *= POOLBATCHESPERJOB * global.checksumjobs;
+	reader->files = nNEW(reader->size, struct poolfile);
+	if (FAILEDTOALLOC(reader->files))
+		return RET_ERROR_OOM;
+	reader->count = 0;
+	reader->result = RET_NOTHING;
+
+	result = RET_NOTHING;
+	r = table_newglobalcursor(rdb_checksums, &cursor);
+	if (!RET_IS_OK(r)) {
+		free(reader->files);
+		return r;
+	}
+	while (cursor_nexttempdata(rdb_checksums, cursor,
+				&filekey, &combined, &combinedlen)) {
+		r = checksums_setall(&expected, combined, combinedlen);
+		if (!RET_IS_OK(r)) {
+			RET_UPDATE(reader->result, r);
+			continue;
+		}
+		if (reader->onlyincomplete && checksums_iscomplete(expected)) {
 			checksums_free(expected);
-			break;
+			continue;
 		}
-		if (fast)
-			r = checksums_cheaptest(fullfilename, expected, true);
-		else
-			r = checkpoolfile(fullfilename, expected, &improveable);
-		if (r == RET_NOTHING) {
-			fprintf(stderr, "Missing file '%s'!\n", fullfilename);
-			r = RET_ERROR_MISSING;
+		r = poolreader_add(reader, filekey, expected);
+		if (RET_WAS_ERROR(r)) {
+			result = r;
+			break;
 		}
-		free(fullfilename);
-		checksums_free(expected);
+	}
+	if (!RET_WAS_ERROR(result)) {
+		r = poolreader_round(reader);
 		RET_UPDATE(result, r);
 	}
 	r = cursor_close(rdb_checksums, cursor);
 	RET_ENDUPDATE(result, r);
-	if (improveable && verbose >= 0)
-		printf(
-"There were files with only some of the checksums this version of reprepro\n"
-"can compute recorded. To add those run reprepro collectnewchecksums.\n");
+	poolreader_clear(reader);
+	free(reader->files);
+	poolreader_progress(reader, true);
+	RET_UPDATE(result, reader->result);
 	return result;
 }
 
-retvalue files_collectnewchecksums(void) {
+static retvalue checkpoolfile(struct poolreader *reader, UNUSED(const char *filekey), const char *fullfilename, struct checksums **expected_p, const struct checksums *actual) {
+	bool improves;
+
+	if (!checksums_check(*expected_p, actual, &improves)) {
+		fprintf(stderr, "WRONG CHECKSUMS of '%s':\n", fullfilename);
+		checksums_printdifferences(stderr, *expected_p, actual);
+		return RET_ERROR_WRONG_MD5;
+	}
+	if (improves)
+		reader->improveable = true;
+	return RET_OK;
+}
+
+retvalue files_checkpool(bool fast) {
 	retvalue result, r;
 	struct cursor *cursor;
-	const char *filekey, *all;
-	size_t alllen;
+	const char *filekey, *combined;
+	size_t combinedlen;
 	struct checksums *expected;
 	char *fullfilename;
+	struct poolreader reader;
+
+	if (!fast) {
+		memset(&reader, 0, sizeof(reader));
+		reader.action = checkpoolfile;
+		result = files_readpool(&reader);
+		if (reader.improveable && verbose >= 0)
+			printf(
+"There were files with only some of the checksums this version of reprepro\n"
+"can compute recorded. To add those run reprepro collectnewchecksums.\n");
+		return result;
+	}
 
 	result = RET_NOTHING;
 	r = table_newglobalcursor(rdb_checksums, &cursor);
 	if (!RET_IS_OK(r))
 		return r;
 	while (cursor_nexttempdata(rdb_checksums, cursor,
-				&filekey, &all, &alllen)) {
-		r = checksums_setall(&expected, all, alllen);
-		if (!RET_IS_OK(r)) {
+				&filekey, &combined, &combinedlen)) {
+		r = checksums_setall(&expected, combined, combinedlen);
+		if (RET_WAS_ERROR(r)) {
 			RET_UPDATE(result, r);
 			continue;
 		}
-		if (checksums_iscomplete(expected)) {
-			checksums_free(expected);
-			continue;
-		}
-
 		fullfilename = files_calcfullfilename(filekey);
 		if (FAILEDTOALLOC(fullfilename)) {
 			result = RET_ERROR_OOM;
 			checksums_free(expected);
 			break;
 		}
-		r = checksums_complete(&expected, fullfilename);
+		r = checksums_cheaptest(fullfilename, expected, true);
 		if (r == RET_NOTHING) {
 			fprintf(stderr, "Missing file '%s'!\n", fullfilename);
 			r = RET_ERROR_MISSING;
 		}
-		if (r == RET_ERROR_WRONG_MD5) {
-			fprintf(stderr,
-"ERROR: Cannot collect missing checksums for '%s'\n"
-"as the file in the pool does not match the already recorded checksums\n",
-					filekey);
-		}
 		free(fullfilename);
-		if (RET_IS_OK(r))
-			r = files_replace_checksums(filekey, expected);
 		checksums_free(expected);
 		RET_UPDATE(result, r);
 	}
@@ -465,6 +716,31 @@ retvalue files_collectnewchecksums(void) {
 	return result;
 }
 
+static retvalue collectnewchecksums(UNUSED(struct poolreader *reader), const char *filekey, UNUSED(const char *fullfilename), struct checksums **expected_p, const struct checksums *actual) {
+	retvalue r;
+
+	if (!checksums_check(*expected_p, actual, NULL)) {
+		fprintf(stderr,
+"ERROR: Cannot collect missing checksums for '%s'\n"
+"as the file in the pool does not match the already recorded checksums\n",
+				filekey);
+		return RET_ERROR_WRONG_MD5;
+	}
+	r = checksums_combine(expected_p, actual, NULL);
+	if (RET_IS_OK(r))
+		r = files_replace_checksums(filekey, *expected_p);
+	return r;
+}
+
+retvalue files_collectnewchecksums(void) {
+	struct poolreader reader;
+
+	memset(&reader, 0, sizeof(reader));
+	reader.action = collectnewchecksums;
+	reader.onlyincomplete = true;
+	return files_readpool(&reader);
+}
+
 retvalue files_detect(const char *filekey) {
 	struct checksums *checksums;
 	char *fullfilename;
@@ -619,6 +895,71 @@ retvalue files_preinclude(const char *sourcefilename, const char *filekey, struc
 	return RET_OK;
 }
 
+retvalue files_preincludeknown(const char *sourcefilename, const char *filekey, const struct checksums *realchecksums, const struct stat *readstat, struct checksums **checksums_p, bool *improves_p) {
+	retvalue r;
+	struct checksums *checksums;
+	bool improves;
+	char *fullfilename;
+
+	*improves_p = false;
+	r = files_get_checksums(filekey, &checksums);
+	if (RET_WAS_ERROR(r))
+		return r;
+	if (RET_IS_OK(r)) {
+		if (!checksums_check(checksums, realchecksums, &improves)) {
+			fprintf(stderr,
+"ERROR: '%s' cannot be included as '%s'.\n"
+"Already existing files can only be included again, if they are the same, but:\n",
+				sourcefilename, filekey);
+			checksums_printdifferences(stderr, checksums,
+					realchecksums);
+			checksums_free(checksums);
+			return RET_ERROR_WRONG_MD5;
+		}
+		if (improves) {
+			r = checksums_combine(&checksums, realchecksums, NULL);
+			if (RET_WAS_ERROR(r)) {
+				checksums_free(checksums);
+				return r;
+			}
+			*improves_p = true;
+		}
+		*checksums_p = checksums;
+		return RET_NOTHING;
+	}
+	checksums = checksums_dup(realchecksums);
+	if (FAILEDTOALLOC(checksums))
+		return RET_ERROR_OOM;
+	fullfilename = files_calcfullfilename(filekey);
+	if (FAILEDTOALLOC(fullfilename)) {
+		checksums_free(checksums);
+		return RET_ERROR_OOM;
+	}
+	(void)dirs_make_parent(fullfilename);
+	r = checksums_clonefile(fullfilename, sourcefilename, checksums,
+			readstat);
+	free(fullfilename);
+	if (RET_WAS_ERROR(r)) {
+		checksums_free(checksums);
+		return r;
+	}
+	*checksums_p = checksums;
+	return RET_OK;
+}
+
+retvalue files_preparenew(const char *filekey, char **fullfilename_p) {
+	char *fullfilename;
+
+	if (table_recordexists(rdb_checksums, filekey))
+		return RET_NOTHING;
+	fullfilename = files_calcfullfilename(filekey);
+	if (FAILEDTOALLOC(fullfilename))
+		return RET_ERROR_OOM;
+	(void)dirs_make_parent(fullfilename);
+	*fullfilename_p = fullfilename;
+	return RET_OK;
+}
+
 static retvalue checkimproveorinclude(const char *sourcedir, const char *basefilename, const char *filekey, struct checksums **checksums_p, bool *improving) {
 	retvalue r;
 	struct checksums *checksums = NULL;
@@ -14,9 +14,12 @@
 
 struct checksums;
 struct checksumsarray;
+struct stat;
 
 /* Add file's md5sum to database */
 retvalue files_add_checksums(const char *, const struct checksums *);
+/* Replace the file's checksums with more complete ones */
+retvalue files_replace_checksums(const char *, const struct checksums *);
 
 /* remove file's md5sum from database */
 retvalue files_remove(const char * /*filekey*/);
@@ -49,6 +52,17 @@ retvalue files_checkorimprove(const struct strlist *, struct checksums **);
  *  (the original file is not deleted in that case, even if delete is positive)
  */
 retvalue files_preinclude(const char *sourcefilename, const char *filekey, /*@null@*//*@out@*/struct checksums **);
+/* Like files_preinclude, but with the checksums already read (after
+ * stat'ing the file) and without changing the database:
+ * return RET_OK, if copied (still to be added with files_add_checksums)
+ * return RET_NOTHING, if already there (*checksums are those of the
+ *  database, combined with the new ones if *improves, in which case they
+ *  are still to be stored with files_replace_checksums) */
+retvalue files_preincludeknown(const char *sourcefilename, const char *filekey, const struct checksums *, /*@null@*/const struct stat *, /*@out@*/struct checksums **, /*@out@*/bool *improves);
+/* return RET_OK and where to copy it to (with the directory created),
+ * if there is no file with that filekey in the pool yet, RET_NOTHING if
+ * there is one (which then is to be checked with files_preincludeknown) */
+retvalue files_preparenew(const char *filekey, /*@out@*/char **fullfilename);
 retvalue files_checkincludefile(const char *directory, const char *sourcefilename, const char *filekey, struct checksums **);
 
 typedef retvalue per_file_action(void *data, const char *filekey);
@@ -82,6 +82,31 @@ extern struct global_config {
 	bool onlysmalldeletes;
 	/* verbosity of downloading statistics */
 	int showdownloadpercent;
+	/* number of worker processes to export targets with */
+	unsigned int exportjobs;
+	/* compress index files in child processes */
+	bool parallelcompression;
+	/* size of chunks index files are compressed in (0 = default) */
+	size_t indexbuffersize;
+	/* threads xz and zstd compressors may use (0 = 1) */
+	unsigned int compressionthreads;
+	/* number of worker processes to read pool files with */
+	unsigned int checksumjobs;
+	/* size of the cache shared by all database files
+	 * (0 = every database file has its own default cache) */
+	size_t dbcachesize;
+	/* read downloaded index files compressed instead of unpacking them */
+	bool streamlists;
+	/* files requested from all apt methods at the same time (0 = any) */
+	unsigned int maxdownloads;
+	/* seconds without progress after which a method is stopped (0 = never) */
+	unsigned int stalltimeout;
+	/* seconds between download statistics (0 = none) */
+	unsigned int downloadstats;
+	/* number of worker processes to read update indices with */
+	unsigned int updatejobs;
+	/* keep and use the metadata table of each target */
+	bool metadatacache;
 } global;
 
 enum compression { c_none, c_gzip, c_bzip2, c_lzma, c_xz, c_lunzip, c_COUNT };
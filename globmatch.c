@@ -19,9 +19,9 @@
 #include <limits.h>
 #include <stdint.h>
 #include <string.h>
+#include <stdlib.h>
 #ifdef TEST_GLOBMATCH
 #include <stdio.h>
-#include <stdlib.h>
 #endif
 #include "error.h"
 #include "globmatch.h"
@@ -170,6 +170,144 @@ bool globmatch(const char *string, const char *pattern) {
 	return possible[l];
 }
 
+/* Most patterns only contain '*' (like "lib*" or "*-dev"), they are split
+ * into the literal parts between the stars, which can be looked for with
+ * memcmp and memmem. All others are given to globmatch. */
+
+struct globpattern {
+	/* NULL if only '*' are special */
+	/*@null@*/char *pattern;
+	/* not starting or ending with a '*' */
+	bool anchoredstart, anchoredend;
+	int count;
+	size_t minlen;
+	struct globpart {
+		/*@dependent@*/const char *text;
+		size_t len;
+	} *parts;
+	char *texts;
+};
+
+void globpattern_free(struct globpattern *g) {
+	if (g == NULL)
+		return;
+	free(g->pattern);
+	free(g->parts);
+	free(g->texts);
+	free(g);
+}
+
+retvalue globpattern_compile(struct globpattern **g_p, const char *pattern) {
+	struct globpattern *g;
+	const char *p;
+	char *t;
+
+	g = zNEW(struct globpattern);
+	if (FAILEDTOALLOC(g))
+		return RET_ERROR_OOM;
+	if (strpbrk(pattern, "?[") != NULL) {
+		g->pattern = strdup(pattern);
+		if (FAILEDTOALLOC(g->pattern)) {
+			free(g);
+			return RET_ERROR_OOM;
+		}
+		*g_p = g;
+		return RET_OK;
+	}
+	g->texts = strdup(pattern);
+	/* at most one part more than there are stars */
+	g->parts = nzNEW(strlen(pattern) + 1, struct globpart);
+	if (FAILEDTOALLOC(g->texts) || FAILEDTOALLOC(g->parts)) {
+		globpattern_free(g);
+		return RET_ERROR_OOM;
+	}
+	g->anchoredstart = pattern[0] != '*';
+	g->anchoredend = pattern[0] == '\0' ||
+		pattern[strlen(pattern) - 1] != '*';
+	p = pattern;
+	t = g->texts;
+	do {
+		size_t l = strcspn(p, "*");
+
+		/* empty parts (from the beginning, end or "**")
+		 * only matter if there is no star at all */
+		if (l > 0 || (p == pattern && p[l] == '\0')) {
+			g->parts[g->count].text = t + (p - pattern);
+			g->parts[g->count].len = l;
+			g->count++;
+			g->minlen += l;
+		}
+		p += l;
+		while (*p == '*')
+			p++;
+	} while (*p != '\0');
+	*g_p = g;
+	return RET_OK;
+}
+
+bool globpattern_match(const struct globpattern *g, const char *string, size_t len) {
+	const struct globpart *first, *last;
+	const char *s, *e;
+
+	if (g->pattern != NULL) {
+		char buffer[256];
+		char *copy;
+		bool matches;
+
+		if (len < sizeof(buffer))
+			copy = buffer;
+		else {
+			copy = malloc(len + 1);
+			if (FAILEDTOALLOC(copy))
+				return false;
+		}
+		memcpy(copy, string, len);
+		copy[len] = '\0';
+		matches = globmatch(copy, g->pattern);
+		if (copy != buffer)
+			free(copy);
+		return matches;
+	}
+	if (len < g->minlen)
+		return false;
+	if (g->count == 0)
+		/* only stars */
+		return true;
+	first = g->parts;
+	last = g->parts + g->count - 1;
+	s = string;
+	e = string + len;
+	if (g->anchoredstart) {
+		if (memcmp(s, first->text, first->len) != 0)
+			return false;
+		s += first->len;
+		if (first == last)
+			return !g->anchoredend || s == e;
+		first++;
+	}
+	if (g->anchoredend) {
+		if (memcmp(e - last->len, last->text, last->len) != 0)
+			return false;
+		e -= last->len;
+		if (first == last)
+			return true;
+		last--;
+	}
+	/* the parts in between can be anywhere, in the right order,
+	 * so taking the first place each can be found is enough */
+	for (; first <= last ; first++) {
+		const char *found;
+
+		if ((size_t)(e - s) < first->len)
+			return false;
+		found = memmem(s, e - s, first->text, first->len);
+		if (found == NULL)
+			return false;
+		s = found + first->len;
+	}
+	return true;
+}
+
 #ifdef TEST_GLOBMATCH
 int main(int argc, const char *argv[]) {
 	if (argc != 3) {
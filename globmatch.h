@@ -3,5 +3,12 @@
 
 bool globmatch(const char * /*string*/, const char */*pattern*/);
 
+/* a pattern prepared to be matched against many strings */
+struct globpattern;
+retvalue globpattern_compile(/*@out@*/struct globpattern **, const char * /*pattern*/);
+/* string does not need to be '\0' terminated */
+bool globpattern_match(const struct globpattern *, const char * /*string*/, size_t /*len*/);
+void globpattern_free(/*@null@*//*@only@*/struct globpattern *);
+
 #endif
 
@@ -16,33 +16,96 @@
 #include <config.h>
 
 #include <errno.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <malloc.h>
 #include <string.h>
 #include <stdio.h>
 #include <ctype.h>
+#include <limits.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#define CHECKSUMS_CONTEXT visible
 #include "error.h"
 #include "ignore.h"
 #include "chunks.h"
 #include "names.h"
 #include "uncompression.h"
+#include "checksums.h"
 #include "indexfile.h"
 
 /* the purpose of this code is to read index files, either from a snapshot
  * previously generated or downloaded while updating. */
 
 struct indexfile {
-	struct compressedfile *f;
+	/* NULL if the file is mapped */
+	/*@null@*/struct compressedfile *f;
 	char *filename;
 	int linenumber, startlinenumber;
 	retvalue status;
 	char *buffer;
 	int size, ofs, content;
-	bool failed;
+	bool failed, eof;
+	/* uncompressed files are mapped privately, so chunks can be
+	 * terminated in place and only need copying if they have to
+	 * be normalized (contain '\r' or '\0') */
+	/*@null@*/char *map;
+	size_t mapsize, mapofs;
+	/* the current chunk */
+	/*@dependent@*/const char *chunk;
+	/* checksums of the uncompressed content, if it still needs checking */
+	/*@null@*/const struct checksums *expected;
+	struct checksumscontext context;
 };
 
-retvalue indexfile_open(struct indexfile **file_p, const char *filename, enum compression compression) {
+static retvalue indexfile_map(struct indexfile *f) {
+	struct stat s;
+	int fd, e;
+
+	fd = open(f->filename, O_RDONLY|O_NOCTTY);
+	if (fd < 0) {
+		e = errno;
+		fprintf(stderr, "Error %d opening '%s': %s!\n",
+				e, f->filename, strerror(e));
+		return RET_ERRNO(e);
+	}
+	if (fstat(fd, &s) != 0) {
+		e = errno;
+		fprintf(stderr, "Error %d getting information about '%s': %s\n",
+				e, f->filename, strerror(e));
+		(void)close(fd);
+		return RET_ERRNO(e);
+	}
+	if (!S_ISREG(s.st_mode)) {
+		(void)close(fd);
+		return RET_NOTHING;
+	}
+	f->mapsize = s.st_size;
+	f->mapofs = 0;
+	if (f->mapsize == 0) {
+		/* nothing to map, but also nothing to read */
+		(void)close(fd);
+		f->map = NULL;
+		return RET_OK;
+	}
+	f->map = mmap(NULL, f->mapsize, PROT_READ|PROT_WRITE, MAP_PRIVATE,
+			fd, 0);
+	e = errno;
+	(void)close(fd);
+	if (f->map == MAP_FAILED) {
+		f->map = NULL;
+		/* the normal reading code will do */
+		return RET_NOTHING;
+	}
+	(void)madvise(f->map, f->mapsize, MADV_SEQUENTIAL);
+	return RET_OK;
+}
+
+retvalue indexfile_open(struct indexfile **file_p, const char *filename, enum compression compression, const struct checksums *expected) {
 	struct indexfile *f = zNEW(struct indexfile);
 	retvalue r;
 
@@ -53,6 +116,24 @@ retvalue indexfile_open(struct indexfile **file_p, const char *filename, enum co
 		free(f);
 		return RET_ERROR_OOM;
 	}
+	f->linenumber = 0;
+	f->startlinenumber = 0;
+	f->status = RET_OK;
+	f->expected = expected;
+	if (compression == c_none) {
+		r = indexfile_map(f);
+		if (RET_WAS_ERROR(r)) {
+			free(f->filename);
+			free(f);
+			return r;
+		}
+		if (RET_IS_OK(r)) {
+			if (expected != NULL)
+				checksumscontext_init(&f->context);
+			*file_p = f;
+			return RET_OK;
+		}
+	}
 	r = uncompress_open(&f->f, filename, compression);
 	assert (r != RET_NOTHING);
 	if (RET_WAS_ERROR(r)) {
@@ -60,12 +141,11 @@ retvalue indexfile_open(struct indexfile **file_p, const char *filename, enum co
 		free(f);
 		return RET_ERRNO(errno);
 	}
-	f->linenumber = 0;
-	f->startlinenumber = 0;
-	f->status = RET_OK;
 	f->size = 256*1024;
 	f->ofs = 0;
 	f->content = 0;
+	if (expected != NULL)
+		checksumscontext_init(&f->context);
 	/* +1 for *d = '\0' in eof case */
 	f->buffer = malloc(f->size + 1);
 	if (FAILEDTOALLOC(f->buffer)) {
@@ -81,8 +161,32 @@ retvalue indexfile_open(struct indexfile **file_p, const char *filename, enum co
 retvalue indexfile_close(struct indexfile *f) {
 	retvalue r;
 
-	r = uncompress_close(f->f);
+	if (f->f != NULL)
+		r = uncompress_close(f->f);
+	else {
+		r = RET_OK;
+		if (f->map != NULL)
+			(void)munmap(f->map, f->mapsize);
+	}
+
+	/* only if everything was read there is something to compare */
+	if (f->expected != NULL && f->eof && !f->failed && RET_IS_OK(r)) {
+		struct checksums *got;
+		retvalue r2;
 
+		r2 = checksums_from_context(&got, &f->context);
+		if (RET_IS_OK(r2)) {
+			if (!checksums_check(f->expected, got, NULL)) {
+				fprintf(stderr,
+"Wrong checksum of uncompressed content of '%s':\n", f->filename);
+				checksums_printdifferences(stderr,
+						f->expected, got);
+				r2 = RET_ERROR_WRONG_MD5;
+			}
+			checksums_free(got);
+		}
+		RET_UPDATE(r, r2);
+	}
 	free(f->filename);
 	free(f->buffer);
 	RET_UPDATE(r, f->status);
@@ -91,14 +195,132 @@ retvalue indexfile_close(struct indexfile *f) {
 	return r;
 }
 
+/* everything up to there was processed (and can be checksummed,
+ * which must happen before a chunk end is changed in place) */
+static inline void map_consumed(struct indexfile *f, const char *upto) {
+	size_t ofs = upto - f->map;
+
+	if (f->expected != NULL)
+		checksumscontext_update(&f->context,
+				(const unsigned char *)f->map + f->mapofs,
+				ofs - f->mapofs);
+	f->mapofs = ofs;
+}
+
+/* like indexfile_get below, but from the mapped file into the buffer,
+ * removing all '\r' and replacing '\0' with spaces */
+static retvalue indexfile_copychunk(struct indexfile *f, const char *p) {
+	const char *end = f->map + f->mapsize;
+	bool afternewline = true;
+	int d = 0;
+
+	while (p < end) {
+		char c = *p;
+
+		/* just ignore '\r', even if not line-end... */
+		if (c == '\r') {
+			p++;
+			continue;
+		}
+		if (c == '\n') {
+			f->linenumber++;
+			if (afternewline) {
+				p++;
+				break;
+			}
+			afternewline = true;
+		} else
+			afternewline = false;
+		if (d + 1 >= f->size) {
+			char *n;
+
+			if (f->size >= INT_MAX / 2) {
+				fprintf(stderr,
+"Error parsing %s line %d: Ridiculous long control chunk!\n",
+						f->filename,
+						f->startlinenumber);
+				f->failed = true;
+				return RET_ERROR;
+			}
+			n = realloc(f->buffer, (f->size == 0) ? 65536 :
+					2 * (size_t)f->size);
+			if (FAILEDTOALLOC(n))
+				return RET_ERROR_OOM;
+			f->buffer = n;
+			f->size = (f->size == 0) ? 65536 : 2 * f->size;
+		}
+		f->buffer[d++] = (c == '\0') ? ' ' : c;
+		p++;
+	}
+	if (p >= end)
+		f->eof = true;
+	map_consumed(f, p);
+	if (d > 0 && f->buffer[d - 1] == '\n')
+		d--;
+	f->buffer[d] = '\0';
+	f->chunk = f->buffer;
+	return RET_OK;
+}
+
+static retvalue indexfile_getmapped(struct indexfile *f) {
+	char *p, *q, *end, *nl;
+	size_t len;
+	int lines;
+
+	if (f->failed)
+		return RET_ERROR;
+
+	p = f->map + f->mapofs;
+	end = f->map + f->mapsize;
+	/* skip empty lines */
+	while (p < end && (*p == '\n' || *p == '\r')) {
+		if (*p == '\n')
+			f->linenumber++;
+		p++;
+	}
+	if (p >= end) {
+		map_consumed(f, end);
+		f->eof = true;
+		return RET_NOTHING;
+	}
+	/* look for the end of this chunk only (an empty line, which
+	 * might contain '\r'), so files never having "\n\n" are not
+	 * searched to their end for every chunk */
+	lines = 1;
+	for (q = p ; (q = memchr(q, '\n', end - q)) != NULL ; q = nl) {
+		lines++;
+		nl = q + 1;
+		while (nl < end && *nl == '\r')
+			nl++;
+		if (nl < end && *nl == '\n')
+			break;
+	}
+	if (q == NULL || q[1] != '\n')
+		/* the last one cannot be terminated in place,
+		 * and an "\r\n" line end needs the '\r' removed */
+		return indexfile_copychunk(f, p);
+	len = q - p;
+	if (memchr(p, '\r', len) != NULL || memchr(p, '\0', len) != NULL)
+		return indexfile_copychunk(f, p);
+	f->linenumber += lines;
+	map_consumed(f, q + 2);
+	*q = '\0';
+	f->chunk = p;
+	return RET_OK;
+}
+
 static retvalue indexfile_get(struct indexfile *f) {
 	char *p, *d, *e, *start;
 	bool afternewline, nothingyet;
 	int bytes_read;
 
+	if (f->f == NULL)
+		return indexfile_getmapped(f);
+
 	if (f->failed)
 		return RET_ERROR;
 
+	f->chunk = f->buffer;
 	d = f->buffer;
 	afternewline = true;
 	nothingyet = true;
@@ -168,8 +390,13 @@ static retvalue indexfile_get(struct indexfile *f) {
 		bytes_read = uncompress_read(f->f, d, f->size - f->ofs);
 		if (bytes_read < 0)
 			return RET_ERROR;
-		else if (bytes_read == 0)
+		else if (bytes_read == 0) {
+			f->eof = true;
 			break;
+		}
+		if (f->expected != NULL)
+			checksumscontext_update(&f->context,
+					(const unsigned char *)d, bytes_read);
 		f->content = bytes_read;
 	} while (true);
 
@@ -200,7 +427,7 @@ bool indexfile_getnext(struct indexfile *f, char **name_p, char **version_p, con
 		r = indexfile_get(f);
 		if (!RET_IS_OK(r))
 			break;
-		control = f->buffer;
+		control = f->chunk;
 		r = chunk_getvalue(control, "Package", &packagename);
 		if (r == RET_NOTHING) {
 			fprintf(stderr,
@@ -8,10 +8,16 @@
 #ifndef REPREPRO_TARGET_H
 #include "target.h"
 #endif
+#ifndef REPREPRO_CHECKSUMS_H
+#include "checksums.h"
+#endif
 
 struct indexfile;
 
-retvalue indexfile_open(/*@out@*/struct indexfile **, const char *, enum compression);
+/* if checksums are given, the uncompressed content is checked against them
+ * while reading and indexfile_close fails if the whole file was read
+ * and they do not match */
+retvalue indexfile_open(/*@out@*/struct indexfile **, const char *, enum compression, /*@null@*/const struct checksums *);
 retvalue indexfile_close(/*@only@*/struct indexfile *);
 bool indexfile_getnext(struct indexfile *, /*@out@*/char **, /*@out@*/char **, /*@out@*/const char **, /*@out@*/ architecture_t *, const struct target *, bool allowwrongarchitecture);
 
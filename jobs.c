@@ -0,0 +1,299 @@
+/*  This file is part of "reprepro"
+ *  Copyright (C) 2026 agent
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+#include <config.h>
+
+#include <errno.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/select.h>
+
+#include "error.h"
+#include "filecntl.h"
+#include "database.h"
+#include "jobs.h"
+
+/* The children have their own copy of everything (including the open
+ * database handles, which they must only read from, and never close),
+ * so they return by _exit, with the retvalue encoded in the exit code:
+ * 0 is RET_OK, 1 is RET_NOTHING and 1 - r for all errors r */
+
+static inline int retvalue_to_exitcode(retvalue r) {
+	if (RET_IS_OK(r))
+		return 0;
+	if (r == RET_NOTHING)
+		return 1;
+	if (r < -250)
+		return 251;
+	return 1 - (int)r;
+}
+
+static inline retvalue exitcode_to_retvalue(int status) {
+	if (WIFEXITED(status)) {
+		int code = WEXITSTATUS(status);
+
+		if (code == 0)
+			return RET_OK;
+		if (code == 1)
+			return RET_NOTHING;
+		return (retvalue)(1 - code);
+	} else if (WIFSIGNALED(status)) {
+		fprintf(stderr, "Worker process killed by signal %d!\n",
+				(int)(WTERMSIG(status)));
+		return RET_ERROR;
+	} else {
+		fprintf(stderr,
+"Worker process terminated abnormally. (status is %x)!\n",
+				status);
+		return RET_ERROR;
+	}
+}
+
+struct job {
+	enum { js_waiting, js_running, js_finished, js_done } state;
+	pid_t pid;
+	int fd;
+	retvalue result;
+	char *output;
+	size_t len, size;
+};
+
+retvalue jobs_write(int fd, const void *data, size_t len) {
+	const char *p = data;
+
+	while (len > 0) {
+		ssize_t written = write(fd, p, len);
+		if (written >= 0) {
+			len -= written;
+			p += written;
+		} else {
+			int e = errno;
+			if (e == EAGAIN || e == EINTR)
+				continue;
+			fprintf(stderr,
+"Error %d writing to parent process: %s\n",
+					e, strerror(e));
+			return RET_ERRNO(e);
+		}
+	}
+	return RET_OK;
+}
+
+static retvalue startjob(struct job *job, size_t i, job_run_function *run, void *privdata) {
+	int p[2];
+	retvalue r;
+
+	/* the worker must not see (or write) modified pages still only
+	 * in the parent's database cache */
+	r = database_sync();
+	if (RET_WAS_ERROR(r))
+		return r;
+	if (pipe(p) != 0) {
+		int e = errno;
+		fprintf(stderr, "Error %d creating pipe: %s!\n",
+				e, strerror(e));
+		return RET_ERRNO(e);
+	}
+	/* do not duplicate buffered output */
+	(void)fflush(stdout);
+	(void)fflush(stderr);
+	job->pid = fork();
+	if (job->pid < 0) {
+		int e = errno;
+		(void)close(p[0]);
+		(void)close(p[1]);
+		fprintf(stderr, "Error %d while forking worker process: %s\n",
+				e, strerror(e));
+		return RET_ERRNO(e);
+	}
+	if (job->pid == 0) {
+		(void)close(p[0]);
+		r = run(privdata, i, p[1]);
+		(void)close(p[1]);
+		(void)fflush(stdout);
+		(void)fflush(stderr);
+		_exit(retvalue_to_exitcode(r));
+	}
+	(void)close(p[1]);
+	markcloseonexec(p[0]);
+	job->fd = p[0];
+	job->state = js_running;
+	job->len = 0;
+	job->size = 0;
+	job->output = NULL;
+	return RET_OK;
+}
+
+static void finishjob(struct job *job, retvalue r) {
+	int status;
+	pid_t c;
+
+	if (job->fd >= 0)
+		(void)close(job->fd);
+	job->fd = -1;
+	job->state = js_finished;
+	do {
+		c = waitpid(job->pid, &status, 0);
+		if (c < 0) {
+			int e = errno;
+			if (e == EINTR)
+				continue;
+			fprintf(stderr,
+"Error %d while waiting for worker process to finish: %s\n",
+					e, strerror(e));
+			job->result = RET_ERRNO(e);
+			return;
+		}
+	} while (c != job->pid);
+	if (RET_WAS_ERROR(r))
+		job->result = r;
+	else
+		job->result = exitcode_to_retvalue(status);
+}
+
+/* stop a job whose output is no longer wanted, without leaving a zombie */
+static void killjob(struct job *job) {
+	(void)close(job->fd);
+	job->fd = -1;
+	(void)kill(job->pid, SIGTERM);
+	finishjob(job, RET_ERROR);
+}
+
+static void readjob(struct job *job) {
+	ssize_t got;
+
+	if (job->size - job->len < 1024) {
+		size_t newsize = (job->size == 0)?4096:(2 * job->size);
+		char *n = realloc(job->output, newsize);
+		if (FAILEDTOALLOC(n)) {
+			finishjob(job, RET_ERROR_OOM);
+			return;
+		}
+		job->output = n;
+		job->size = newsize;
+	}
+	got = read(job->fd, job->output + job->len, job->size - job->len);
+	if (got < 0) {
+		int e = errno;
+		if (e == EAGAIN || e == EINTR)
+			return;
+		fprintf(stderr, "Error %d reading from worker process: %s\n",
+				e, strerror(e));
+		finishjob(job, RET_ERRNO(e));
+	} else if (got > 0)
+		job->len += got;
+	else
+		/* end of file, so the child is (about to be) finished */
+		finishjob(job, RET_OK);
+}
+
+retvalue jobs_run(unsigned int parallel, size_t count, job_run_function *run, job_done_function *done, void *privdata) {
+	struct job *jobs;
+	size_t nextstart, nextdone, i;
+	unsigned int running;
+	retvalue result, r;
+
+	if (parallel == 0)
+		parallel = 1;
+	jobs = nzNEW(count, struct job);
+	if (FAILEDTOALLOC(jobs))
+		return RET_ERROR_OOM;
+
+	result = RET_NOTHING;
+	nextstart = 0; nextdone = 0; running = 0;
+	while (nextdone < count) {
+		fd_set readfds;
+		int maxfd, v;
+
+		/* do not start anything new after errors, but still wait
+		 * for the running ones to finish */
+		while (running < parallel && nextstart < count
+				&& !RET_WAS_ERROR(result)) {
+			if (interrupted()) {
+				result = RET_ERROR_INTERRUPTED;
+				break;
+			}
+			r = startjob(&jobs[nextstart], nextstart,
+					run, privdata);
+			if (RET_WAS_ERROR(r)) {
+				result = r;
+				break;
+			}
+			nextstart++;
+			running++;
+		}
+		/* report finished jobs in order */
+		while (nextdone < count && jobs[nextdone].state == js_finished) {
+			struct job *job = &jobs[nextdone];
+
+			if (RET_WAS_ERROR(job->result)) {
+				RET_UPDATE(result, job->result);
+			} else if (!RET_WAS_ERROR(result)) {
+				r = done(privdata, nextdone,
+						job->output, job->len);
+				RET_UPDATE(result, r);
+			}
+			free(job->output);
+			job->output = NULL;
+			job->state = js_done;
+			nextdone++;
+		}
+		if (running == 0)
+			break;
+
+		FD_ZERO(&readfds);
+		maxfd = 0;
+		for (i = nextdone ; i < nextstart ; i++) {
+			if (jobs[i].state != js_running)
+				continue;
+			FD_SET(jobs[i].fd, &readfds);
+			if (jobs[i].fd > maxfd)
+				maxfd = jobs[i].fd;
+		}
+		v = select(maxfd + 1, &readfds, NULL, NULL, NULL);
+		if (v < 0) {
+			int e = errno;
+			if (e == EINTR)
+				continue;
+			fprintf(stderr, "Select returned error %d: %s\n",
+					e, strerror(e));
+			/* no way to know what the children do, so give up */
+			result = RET_ERRNO(e);
+			for (i = nextdone ; i < nextstart ; i++) {
+				if (jobs[i].state == js_running)
+					killjob(&jobs[i]);
+			}
+			break;
+		}
+		for (i = nextdone ; i < nextstart ; i++) {
+			if (jobs[i].state != js_running ||
+					!FD_ISSET(jobs[i].fd, &readfds))
+				continue;
+			readjob(&jobs[i]);
+			if (jobs[i].state == js_finished)
+				running--;
+		}
+	}
+	for (i = 0 ; i < count ; i++)
+		free(jobs[i].output);
+	free(jobs);
+	return result;
+}
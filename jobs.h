@@ -0,0 +1,21 @@
+#ifndef REPREPRO_JOBS_H
+#define REPREPRO_JOBS_H
+
+#ifndef REPREPRO_ERROR_H
+#include "error.h"
+#endif
+
+/* Run independent jobs in forked child processes.
+ * The child calls the run function, which can write its result to the given
+ * file descriptor, the parent calls the done function for every job that
+ * did not fail with the output of the child in the order of the jobs. */
+
+typedef retvalue job_run_function(void *, size_t /*job*/, int /*fd*/);
+typedef retvalue job_done_function(void *, size_t /*job*/, const char * /*output*/, size_t /*len*/);
+
+retvalue jobs_run(unsigned int /*parallel*/, size_t /*count*/, job_run_function *, job_done_function *, void *);
+
+/* write all of the data to fd (to be used in job_run_function) */
+retvalue jobs_write(int, const void *, size_t);
+
+#endif
@@ -19,7 +19,6 @@
 #include <sys/select.h>
 #include <sys/types.h>
 #include <sys/wait.h>
-#include <sys/poll.h>
 #include <sys/stat.h>
 #include <assert.h>
 #include <fcntl.h>
@@ -41,6 +40,7 @@
 #include "configparser.h"
 #include "log.h"
 #include "filecntl.h"
+#include "eventloop.h"
 
 const char *causingfile = NULL;
 command_t causingcommand = atom_unknown;
@@ -443,11 +443,18 @@ static retvalue notificator_parse(struct notificator *n, struct configiterator *
 	int fd;
 } *processes = NULL;
 
+static void notification_closepipe(struct notification_process *p) {
+	if (p->fd < 0)
+		return;
+	(void)events_watch(p->fd, 0, NULL, NULL);
+	(void)close(p->fd);
+	p->fd = -1;
+}
+
 static void notification_process_free(/*@only@*/struct notification_process *p) {
 	char **a;
 
-	if (p->fd >= 0)
-		(void)close(p->fd);
+	notification_closepipe(p);
 	for (a = p->arguments ; *a != NULL ; a++)
 		free(*a);
 	free(p->causingfile);
@@ -499,10 +506,7 @@ static int catchchildren(void) {
 					p->arguments[0],
 					(int)(WEXITSTATUS(status)));
 		}
-		if (p->fd >= 0) {
-			(void)close(p->fd);
-			p->fd = -1;
-		}
+		notification_closepipe(p);
 		p->child = 0;
 		*pp = p->next;
 		notification_process_free(p);
@@ -511,51 +515,42 @@ static int catchchildren(void) {
 	return returned;
 }
 
-static void feedchildren(bool dowait) {
-	struct notification_process *p;
-	fd_set w;
-	int ret;
-	int number = 0;
-	struct timeval tv = {0, 0};
-
-	FD_ZERO(&w);
-	for (p = processes; p!= NULL ; p = p->next) {
-		if (p->child > 0 && p->fd >= 0 && p->datasent < p->datalen) {
-			FD_SET(p->fd, &w);
-			if (p->fd >= number)
-				number = p->fd + 1;
-		}
-	}
-	if (number == 0)
-		return;
-	ret = select(number, NULL, &w, NULL, dowait?NULL:&tv);
-	if (ret < 0) {
-		// TODO...
-		return;
-	}
-	for (p = processes; p != NULL ; p = p->next) {
-		if (p->child > 0 && p->fd >= 0 && FD_ISSET(p->fd, &w)) {
-			size_t tosent = p->datalen - p->datasent;
-			ssize_t sent;
-
-			if (tosent > (size_t)512)
-				tosent = 512;
-			sent = write(p->fd, p->data+p->datasent, 512);
-			if (sent < 0) {
-				int e = errno;
-				fprintf(stderr,
+/* called by the event loop when the pipe to a notifier can take data */
+static retvalue notification_writable(void *privdata, UNUSED(int fd), UNUSED(int events)) {
+	struct notification_process *p = privdata;
+	size_t tosent = p->datalen - p->datasent;
+	ssize_t sent;
+
+	/* not more than PIPE_BUF, so this does not block */
+	if (tosent > (size_t)512)
+		tosent = 512;
+	sent = write(p->fd, p->data + p->datasent, tosent);
+	if (sent < 0) {
+		int e = errno;
+		if (e == EAGAIN || e == EINTR)
+			return RET_NOTHING;
+		fprintf(stderr,
 "Error '%s' while sending data to '%s', sending SIGABRT to it!\n",
-						strerror(e),
-						p->arguments[0]);
-				(void)kill(p->child, SIGABRT);
-			}
-			p->datasent += sent;
-			if (p->datasent >= p->datalen) {
-				free(p->data);
-				p->data = NULL;
-			}
-		}
+				strerror(e),
+				p->arguments[0]);
+		(void)kill(p->child, SIGABRT);
+		notification_closepipe(p);
+		return RET_ERRNO(e);
+	}
+	p->datasent += sent;
+	if (p->datasent >= p->datalen) {
+		free(p->data);
+		p->data = NULL;
+		notification_closepipe(p);
 	}
+	return RET_OK;
+}
+
+static void feedchildren(bool dowait) {
+	retvalue r = RET_NOTHING;
+
+	/* errors writing were already reported */
+	(void)events_dispatch(dowait ? -1 : 0, &r);
 }
 
 static size_t runningchildren(void) {
@@ -638,62 +633,22 @@ static retvalue startchild(void) {
 	if (child < 0) {
 		int e = errno;
 		fprintf(stderr, "Error forking: %d=%s!\n", e, strerror(e));
-		if (p->fd >= 0) {
-			(void)close(p->fd);
-			p->fd = -1;
-		}
+		notification_closepipe(p);
 		return RET_ERRNO(e);
 	}
 	p->child = child;
-	if (p->datalen > 0) {
-		struct pollfd polldata;
-		ssize_t written;
-
-		polldata.fd = p->fd;
-		polldata.events = POLLOUT;
-		while (poll(&polldata, 1, 0) > 0) {
-			if ((polldata.revents & POLLNVAL) != 0) {
-				p->fd = -1;
-				return RET_ERROR;
-			}
-			if ((polldata.revents & POLLHUP) != 0) {
-				(void)close(p->fd);
-				p->fd = -1;
-				return RET_OK;
-			}
-			if ((polldata.revents & POLLOUT) != 0) {
-				size_t towrite =  p->datalen - p->datasent;
-				if (towrite > (size_t)512)
-					towrite = 512;
-				written = write(p->fd,
-						p->data + p->datasent,
-						towrite);
-				if (written < 0) {
-					int e = errno;
-					fprintf(stderr,
-"Error '%s' while sending data to '%s', sending SIGABRT to it!\n",
-							strerror(e),
-							p->arguments[0]);
-					(void)kill(p->child, SIGABRT);
-					return RET_ERRNO(e);
-				}
-				p->datasent += written;
-				if (p->datasent >= p->datalen) {
-					free(p->data);
-					p->data = NULL;
-					ret = close(p->fd);
-					p->fd = -1;
-					if (ret != 0)
-						return RET_ERRNO(errno);
-					else
-						return RET_OK;
-				}
-				continue;
-			}
-			/* something to write but at the same time not,
-			 * let's better stop here better */
-			return RET_OK;
+	if (p->fd >= 0) {
+		retvalue r;
+
+		/* the data is sent whenever events are dispatched */
+		r = events_watch(p->fd, EVENT_WRITE,
+				notification_writable, p);
+		if (RET_WAS_ERROR(r)) {
+			(void)kill(p->child, SIGABRT);
+			notification_closepipe(p);
+			return r;
 		}
+		feedchildren(false);
 	}
 	return RET_OK;
 }
@@ -946,19 +901,28 @@ static retvalue notificator_enqueue(struct notificator *n, struct target *target
 }
 
 void logger_wait(void) {
+	bool catching;
+
+	/* so waiting is interrupted when a notifier exits */
+	catching = RET_IS_OK(events_catchchildren(true));
 	while (processes != NULL) {
 		catchchildren();
 		if (interrupted())
 			break;
-		feedchildren(true);
 		// TODO: add option to start multiple at the same time
-		if (runningchildren() < 1)
-			startchild();
+		if (runningchildren() < 1) {
+			if (RET_WAS_ERROR(startchild()))
+				break;
+		} else if (catching)
+			feedchildren(true);
 		else {
 			struct timeval tv = { 0, 100 };
+			feedchildren(false);
 			select(0, NULL, NULL, NULL, &tv);
 		}
 	}
+	if (catching)
+		(void)events_catchchildren(false);
 }
 
 void logger_warn_waiting(void) {
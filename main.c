@@ -28,6 +28,7 @@
 #include <malloc.h>
 #include <fcntl.h>
 #include <signal.h>
+#include <dirent.h>
 #include "error.h"
 #define DEFINE_IGNORE_VARIABLES
 #include "ignore.h"
@@ -73,6 +74,7 @@
 #include "uploaderslist.h"
 #include "sizes.h"
 #include "filterlist.h"
+#include "rredpatch.h"
 
 #ifndef STD_BASE_DIR
 #define STD_BASE_DIR "."
@@ -124,6 +126,7 @@ static bool	askforpassphrase = false;
 static bool	guessgpgtty = true;
 static bool	skipold = true;
 static size_t   waitforlock = 0;
+static unsigned int uncompressjobs = 0;
 static enum exportwhen export = EXPORT_CHANGED;
 int		verbose = 0;
 static bool	fast = false;
@@ -138,7 +141,7 @@ static off_t reservedotherspace = 1024*1024;
  * to change something owned by lower owners. */
 enum config_option_owner config_state,
 #define O(x) owner_ ## x = CONFIG_OWNER_DEFAULT
-O(fast), O(x_morguedir), O(x_outdir), O(x_basedir), O(x_distdir), O(x_dbdir), O(x_listdir), O(x_confdir), O(x_logdir), O(x_methoddir), O(x_section), O(x_priority), O(x_component), O(x_architecture), O(x_packagetype), O(nothingiserror), O(nolistsdownload), O(keepunusednew), O(keepunreferenced), O(keeptemporaries), O(keepdirectories), O(askforpassphrase), O(skipold), O(export), O(waitforlock), O(spacecheckmode), O(reserveddbspace), O(reservedotherspace), O(guessgpgtty), O(verbosedatabase), O(gunzip), O(bunzip2), O(unlzma), O(unxz), O(lunzip), O(gnupghome), O(listformat), O(listmax), O(listskip), O(onlysmalldeletes);
+O(fast), O(x_morguedir), O(x_outdir), O(x_basedir), O(x_distdir), O(x_dbdir), O(x_listdir), O(x_confdir), O(x_logdir), O(x_methoddir), O(x_section), O(x_priority), O(x_component), O(x_architecture), O(x_packagetype), O(nothingiserror), O(nolistsdownload), O(keepunusednew), O(keepunreferenced), O(keeptemporaries), O(keepdirectories), O(askforpassphrase), O(skipold), O(export), O(waitforlock), O(spacecheckmode), O(reserveddbspace), O(reservedotherspace), O(guessgpgtty), O(verbosedatabase), O(gunzip), O(bunzip2), O(unlzma), O(unxz), O(lunzip), O(gnupghome), O(listformat), O(listmax), O(listskip), O(onlysmalldeletes), O(exportjobs), O(parallelcompression), O(indexbuffersize), O(compressionthreads), O(checksumjobs), O(dbcachesize), O(uncompressjobs), O(streamlists), O(maxdownloads), O(stalltimeout), O(downloadstats), O(updatejobs), O(metadatacache);
 #undef O
 
 #define CONFIGSET(variable, value) if (owner_ ## variable <= config_state) { \
@@ -311,6 +314,83 @@ ACTION_N(n, n, y, uncompress) {
 	return uncompress_file(argv[2], argv[3], c);
 }
 
+ACTION_N(n, n, y, benchmarkhashes) {
+	unsigned long megabytes = 256;
+	char *e;
+
+	assert (argc == 1 || argc == 2);
+	if (argc == 2) {
+		megabytes = strtoul(argv[1], &e, 10);
+		if (*e != '\0' || megabytes == 0 || megabytes > 1024*1024) {
+			fprintf(stderr,
+"Expected a number of megabytes to hash instead of '%s'!\n",
+					argv[1]);
+			return RET_ERROR;
+		}
+	}
+	return checksums_benchmark(megabytes);
+}
+
+ACTION_N(n, n, y, benchmarkrred) {
+	unsigned long megabytes = 100, hunks = 50;
+	char *e;
+
+	assert (argc >= 2 && argc <= 4);
+	if (argc >= 3) {
+		megabytes = strtoul(argv[2], &e, 10);
+		if (*e != '\0' || megabytes == 0 || megabytes > 1024*1024) {
+			fprintf(stderr,
+"Expected a number of megabytes to generate instead of '%s'!\n",
+					argv[2]);
+			return RET_ERROR;
+		}
+	}
+	if (argc >= 4) {
+		hunks = strtoul(argv[3], &e, 10);
+		if (*e != '\0' || hunks == 0 || hunks > 100000) {
+			fprintf(stderr,
+"Expected a number of hunks instead of '%s'!\n",
+					argv[3]);
+			return RET_ERROR;
+		}
+	}
+	return patch_benchmark(argv[1], megabytes, (int)hunks);
+}
+
+ACTION_N(n, n, y, benchmarkupgradelist) {
+	unsigned long count = 70000;
+	char *e;
+
+	assert (argc >= 1 && argc <= 2);
+	if (argc >= 2) {
+		count = strtoul(argv[1], &e, 10);
+		if (*e != '\0' || count == 0 || count > 100000000) {
+			fprintf(stderr,
+"Expected a number of packages instead of '%s'!\n",
+					argv[1]);
+			return RET_ERROR;
+		}
+	}
+	return upgradelist_benchmark(count);
+}
+
+ACTION_N(n, n, y, benchmarkformula) {
+	unsigned long count = 500000;
+	char *e;
+
+	assert (argc >= 2 && argc <= 3);
+	if (argc >= 3) {
+		count = strtoul(argv[2], &e, 10);
+		if (*e != '\0' || count == 0 || count > 100000000) {
+			fprintf(stderr,
+"Expected a number of packages instead of '%s'!\n",
+					argv[2]);
+			return RET_ERROR;
+		}
+	}
+	return term_benchmark(argv[1], count);
+}
+
 ACTION_N(n, n, y, extractcontrol) {
 	retvalue result;
 	char *control;
@@ -2164,6 +2244,9 @@ ACTION_R(n, n, y, y, rereference) {
 		return result;
 	}
 	result = RET_NOTHING;
+	/* most references will just be recreated, so collect all changes
+	 * first and only write the actual differences */
+	references_startbatch();
 	for (d = alldistributions ; d != NULL ; d = d->next) {
 		if (!d->selected)
 			continue;
@@ -2180,6 +2263,8 @@ ACTION_R(n, n, y, y, rereference) {
 		if (RET_WAS_ERROR(r))
 			break;
 	}
+	r = references_commitbatch();
+	RET_ENDUPDATE(result, r);
 
 	return result;
 }
@@ -2528,11 +2613,100 @@ ACTION_RF(n, n, y, sizes) {
 
 /***********************include******************************************/
 
+static retvalue includedeb_addfile(struct strlist *files, const char *filename, bool isudeb) {
+	if (isudeb) {
+		if (!endswith(filename, ".udeb") && !IGNORING(extension,
+"includeudeb called with file '%s' not ending with '.udeb'\n", filename))
+			return RET_ERROR;
+	} else {
+		if (!endswith(filename, ".deb") && !IGNORING(extension,
+"includedeb called with file '%s' not ending with '.deb'\n", filename))
+			return RET_ERROR;
+	}
+	return strlist_add_dup(files, filename);
+}
+
+static int includedeb_comparenames(const void *a, const void *b) {
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/* all files with the right suffix in a directory, sorted by name */
+static retvalue includedeb_scandirectory(struct strlist *files, const char *directory, bool isudeb) {
+	const char *suffix = isudeb?".udeb":".deb";
+	DIR *dir;
+	struct dirent *ent;
+	int first = files->count;
+	retvalue r;
+
+	dir = opendir(directory);
+	if (dir == NULL) {
+		int e = errno;
+		fprintf(stderr, "Cannot scan '%s': %s\n",
+				directory, strerror(e));
+		return RET_ERRNO(e);
+	}
+	while ((errno = 0, ent = readdir(dir)) != NULL) {
+		char *filename;
+
+		if (ent->d_name[0] == '.' || !endswith(ent->d_name, suffix))
+			continue;
+		filename = calc_dirconcat(directory, ent->d_name);
+		if (FAILEDTOALLOC(filename)) {
+			(void)closedir(dir);
+			return RET_ERROR_OOM;
+		}
+		r = strlist_add(files, filename);
+		if (RET_WAS_ERROR(r)) {
+			(void)closedir(dir);
+			return r;
+		}
+	}
+	if (errno != 0 || closedir(dir) != 0) {
+		int e = errno;
+		fprintf(stderr, "Error scanning '%s': %s\n",
+				directory, strerror(e));
+		return RET_ERRNO(e);
+	}
+	qsort(files->values + first, files->count - first, sizeof(char *),
+			includedeb_comparenames);
+	return RET_OK;
+}
+
+/* one filename per line */
+static retvalue includedeb_readlist(struct strlist *files, bool isudeb) {
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t got;
+	retvalue r;
+
+	while ((got = getline(&line, &size, stdin)) >= 0) {
+		while (got > 0 && (line[got - 1] == '\n' ||
+					line[got - 1] == '\r'))
+			line[--got] = '\0';
+		if (got == 0)
+			continue;
+		r = includedeb_addfile(files, line, isudeb);
+		if (RET_WAS_ERROR(r)) {
+			free(line);
+			return r;
+		}
+	}
+	free(line);
+	if (ferror(stdin)) {
+		int e = errno;
+		fprintf(stderr, "Error %d reading filenames from stdin: %s\n",
+				e, strerror(e));
+		return RET_ERRNO(e);
+	}
+	return RET_OK;
+}
+
 ACTION_D(y, y, y, includedeb) {
 	retvalue result, r;
 	struct distribution *distribution;
 	bool isudeb;
 	trackingdb tracks;
+	struct strlist files;
 	int i = 0;
 	component_t component = atom_unknown;
 
@@ -2573,28 +2747,38 @@ ACTION_D(y, y, y, includedeb) {
 		return RET_ERROR;
 	}
 
+	/* directories stand for the files in them, - for a list in stdin */
+	strlist_init(&files);
 	for (i = 2 ; i < argc ; i++) {
 		const char *filename = argv[i];
 
-		if (isudeb) {
-			if (!endswith(filename, ".udeb") && !IGNORING(extension,
-"includeudeb called with file '%s' not ending with '.udeb'\n", filename))
-				return RET_ERROR;
-		} else {
-			if (!endswith(filename, ".deb") && !IGNORING(extension,
-"includedeb called with file '%s' not ending with '.deb'\n", filename))
-				return RET_ERROR;
+		if (strcmp(filename, "-") == 0)
+			r = includedeb_readlist(&files, isudeb);
+		else if (isdirectory(filename))
+			r = includedeb_scandirectory(&files, filename, isudeb);
+		else
+			r = includedeb_addfile(&files, filename, isudeb);
+		if (RET_WAS_ERROR(r)) {
+			strlist_done(&files);
+			return r;
 		}
 	}
+	if (files.count == 0) {
+		fprintf(stderr, "No files to include given!\n");
+		strlist_done(&files);
+		return RET_ERROR;
+	}
 
 	result = distribution_get(alldistributions, argv[1], true, &distribution);
 	assert (result != RET_NOTHING);
 	if (RET_WAS_ERROR(result)) {
+		strlist_done(&files);
 		return result;
 	}
 	if (distribution->readonly) {
 		fprintf(stderr, "Cannot add packages to read-only distribution '%s'.\n",
 				distribution->codename);
+		strlist_done(&files);
 		return RET_ERROR;
 	}
 
@@ -2605,6 +2789,7 @@ ACTION_D(y, y, y, includedeb) {
 		result = override_read(distribution->deb_override,
 				&distribution->overrides.deb, false);
 	if (RET_WAS_ERROR(result)) {
+		strlist_done(&files);
 		return result;
 	}
 
@@ -2618,33 +2803,36 @@ ACTION_D(y, y, y, includedeb) {
 "Cannot force into the architecture '%s' not available in '%s'!\n",
 				atoms_architectures[missing],
 				distribution->codename);
+			strlist_done(&files);
 			return RET_ERROR;
 		}
 	}
 
 	r = distribution_prepareforwriting(distribution);
 	if (RET_WAS_ERROR(r)) {
+		strlist_done(&files);
 		return RET_ERROR;
 	}
 
 	if (distribution->tracking != dt_NONE) {
 		result = tracking_initialize(&tracks, distribution, false);
 		if (RET_WAS_ERROR(result)) {
+			strlist_done(&files);
 			return result;
 		}
 	} else {
 		tracks = NULL;
 	}
-	result = RET_NOTHING;
-	for (i = 2 ; i < argc ; i++) {
-		const char *filename = argv[i];
-
-		r = deb_add(component, architectures,
+	if (files.count > 1)
+		result = deb_addfiles(component, architectures,
+				section, priority, isudeb?pt_udeb:pt_deb,
+				distribution, &files, delete, tracks);
+	else
+		result = deb_add(component, architectures,
 				section, priority, isudeb?pt_udeb:pt_deb,
-				distribution, filename,
+				distribution, files.values[0],
 				delete, tracks);
-		RET_UPDATE(result, r);
-	}
+	strlist_done(&files);
 
 	distribution_unloadoverrides(distribution);
 
@@ -3390,6 +3578,8 @@ ACTION_D(n, n, n, clearvanished) {
 		references_remove(identifier);
 		/* remove the database */
 		database_droppackages(identifier);
+		(void)database_dropcontentsindex(identifier);
+		(void)database_dropmetadata(identifier);
 	}
 	free(inuse);
 	strlist_done(&identifiers);
@@ -3749,6 +3939,14 @@ static const struct action {
 		0, 0, "__dumpuncompressors"},
 	{"__uncompress",	A_N(uncompress),
 		3, 3, "__uncompress .gz|.bz2|.lzma|.xz|.lz <compressed-filename> <into-filename>"},
+	{"__benchmarkhashes",	A_N(benchmarkhashes),
+		0, 1, "__benchmarkhashes [<megabytes>]"},
+	{"__benchmarkrred",	A_N(benchmarkrred),
+		1, 3, "__benchmarkrred <scratch file> [<megabytes> [<hunks>]]"},
+	{"__benchmarkupgradelist",	A_N(benchmarkupgradelist),
+		0, 1, "__benchmarkupgradelist [<count>]"},
+	{"__benchmarkformula",	A_N(benchmarkformula),
+		1, 2, "__benchmarkformula <formula> [<count>]"},
 	{"__extractsourcesection", A_N(extractsourcesection),
 		1, 1, "__extractsourcesection <.dsc-file>"},
 	{"__extractcontrol",	A_N(extractcontrol),
@@ -3864,9 +4062,9 @@ static const struct action {
 	{"checkpull",		A_B(checkpull)|NEED_RESTRICT,
 		0, -1, "checkpull [<distributions>]"},
 	{"includedeb",		A_Dactsp(includedeb)|NEED_DELNEW,
-		2, -1, "[--delete] includedeb <distribution> <.deb-file>"},
+		2, -1, "[--delete] includedeb <distribution> <.deb-files|directories|->"},
 	{"includeudeb",		A_Dactsp(includedeb)|NEED_DELNEW,
-		2, -1, "[--delete] includeudeb <distribution> <.udeb-file>"},
+		2, -1, "[--delete] includeudeb <distribution> <.udeb-files|directories|->"},
 	{"includedsc",		A_Dactsp(includedsc)|NEED_DELNEW,
 		2, 2, "[--delete] includedsc <distribution> <package>"},
 	{"include",		A_Dactsp(include)|NEED_DELNEW,
@@ -4198,6 +4396,22 @@ LO_CONFDIR,
 LO_METHODDIR,
 LO_VERSION,
 LO_WAITFORLOCK,
+LO_EXPORTJOBS,
+LO_PARALLELCOMPRESSION,
+LO_NOPARALLELCOMPRESSION,
+LO_INDEXBUFFERSIZE,
+LO_COMPRESSIONTHREADS,
+LO_CHECKSUMJOBS,
+LO_DBCACHESIZE,
+LO_UNCOMPRESSJOBS,
+LO_STREAMLISTS,
+LO_NOSTREAMLISTS,
+LO_MAXDOWNLOADS,
+LO_STALLTIMEOUT,
+LO_DOWNLOADSTATS,
+LO_UPDATEJOBS,
+LO_METADATACACHE,
+LO_NOMETADATACACHE,
 LO_SPACECHECK,
 LO_SAFETYMARGIN,
 LO_DBSAFETYMARGIN,
@@ -4309,10 +4523,10 @@ static void handle_option(int c, const char *argument) {
 "       Remove the given package from the specified distribution.\n"
 " include <distribution> <.changes-file>\n"
 "       Include the given upload.\n"
-" includedeb <distribution> <.deb-file>\n"
-"       Include the given binary package.\n"
-" includeudeb <distribution> <.udeb-file>\n"
-"       Include the given installer binary package.\n"
+" includedeb <distribution> <.deb-files>\n"
+"       Include the given binary packages.\n"
+" includeudeb <distribution> <.udeb-files>\n"
+"       Include the given installer binary packages.\n"
 " includedsc <distribution> <.dsc-file>\n"
 "       Include the given source package.\n"
 " list <distribution> <package-name>\n"
@@ -4458,6 +4672,74 @@ static void handle_option(int c, const char *argument) {
 							"--waitforlock",
 							argument, LONG_MAX));
 					break;
+				case LO_EXPORTJOBS:
+					CONFIGGSET(exportjobs, parse_number(
+							"--export-jobs",
+							argument, 1024));
+					break;
+				case LO_PARALLELCOMPRESSION:
+					CONFIGGSET(parallelcompression, true);
+					break;
+				case LO_NOPARALLELCOMPRESSION:
+					CONFIGGSET(parallelcompression, false);
+					break;
+				case LO_INDEXBUFFERSIZE:
+					CONFIGGSET(indexbuffersize, parse_number(
+							"--export-buffer-size",
+							argument, 256*1024*1024));
+					break;
+				case LO_COMPRESSIONTHREADS:
+					CONFIGGSET(compressionthreads, parse_number(
+							"--compression-threads",
+							argument, 1024));
+					break;
+				case LO_CHECKSUMJOBS:
+					CONFIGGSET(checksumjobs, parse_number(
+							"--checksum-jobs",
+							argument, 1024));
+					break;
+				case LO_DBCACHESIZE:
+					CONFIGGSET(dbcachesize, parse_number(
+							"--db-cache-size",
+							argument, SIZE_MAX >> 1));
+					break;
+				case LO_UNCOMPRESSJOBS:
+					CONFIGSET(uncompressjobs, parse_number(
+							"--uncompress-jobs",
+							argument, 1024));
+					break;
+				case LO_STREAMLISTS:
+					CONFIGGSET(streamlists, true);
+					break;
+				case LO_NOSTREAMLISTS:
+					CONFIGGSET(streamlists, false);
+					break;
+				case LO_MAXDOWNLOADS:
+					CONFIGGSET(maxdownloads, parse_number(
+							"--max-downloads",
+							argument, 65536));
+					break;
+				case LO_STALLTIMEOUT:
+					CONFIGGSET(stalltimeout, parse_number(
+							"--stall-timeout",
+							argument, 86400));
+					break;
+				case LO_DOWNLOADSTATS:
+					CONFIGGSET(downloadstats, parse_number(
+							"--download-stats",
+							argument, 86400));
+					break;
+				case LO_UPDATEJOBS:
+					CONFIGGSET(updatejobs, parse_number(
+							"--update-jobs",
+							argument, 1024));
+					break;
+				case LO_METADATACACHE:
+					CONFIGGSET(metadatacache, true);
+					break;
+				case LO_NOMETADATACACHE:
+					CONFIGGSET(metadatacache, false);
+					break;
 				case LO_SPACECHECK:
 					if (strcasecmp(argument, "none") == 0) {
 						CONFIGSET(spacecheckmode, scm_NONE);
@@ -4777,6 +5059,22 @@ int main(int argc, char *argv[]) {
 		{"force", no_argument, NULL, 'f'},
 		{"export", required_argument, &longoption, LO_EXPORT},
 		{"waitforlock", required_argument, &longoption, LO_WAITFORLOCK},
+		{"export-jobs", required_argument, &longoption, LO_EXPORTJOBS},
+		{"export-buffer-size", required_argument, &longoption, LO_INDEXBUFFERSIZE},
+		{"parallel-compression", no_argument, &longoption, LO_PARALLELCOMPRESSION},
+		{"noparallel-compression", no_argument, &longoption, LO_NOPARALLELCOMPRESSION},
+		{"compression-threads", required_argument, &longoption, LO_COMPRESSIONTHREADS},
+		{"checksum-jobs", required_argument, &longoption, LO_CHECKSUMJOBS},
+		{"db-cache-size", required_argument, &longoption, LO_DBCACHESIZE},
+		{"uncompress-jobs", required_argument, &longoption, LO_UNCOMPRESSJOBS},
+		{"stream-lists", no_argument, &longoption, LO_STREAMLISTS},
+		{"nostream-lists", no_argument, &longoption, LO_NOSTREAMLISTS},
+		{"max-downloads", required_argument, &longoption, LO_MAXDOWNLOADS},
+		{"stall-timeout", required_argument, &longoption, LO_STALLTIMEOUT},
+		{"download-stats", required_argument, &longoption, LO_DOWNLOADSTATS},
+		{"update-jobs", required_argument, &longoption, LO_UPDATEJOBS},
+		{"metadata-cache", no_argument, &longoption, LO_METADATACACHE},
+		{"nometadata-cache", no_argument, &longoption, LO_NOMETADATACACHE},
 		{"checkspace", required_argument, &longoption, LO_SPACECHECK},
 		{"spacecheck", required_argument, &longoption, LO_SPACECHECK},
 		{"safetymargin", required_argument, &longoption, LO_SAFETYMARGIN},
@@ -4921,6 +5219,7 @@ int main(int argc, char *argv[]) {
 	if (lunzip != NULL && lunzip[0] == '+')
 		lunzip = expand_plus_prefix(lunzip, "lunzip", "boc", true);
 	uncompressions_check(gunzip, bunzip2, unlzma, unxz, lunzip);
+	uncompress_setjobs(uncompressjobs);
 	free(gunzip);
 	free(bunzip2);
 	free(unlzma);
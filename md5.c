@@ -27,6 +27,7 @@
 
 #include <config.h>
 
+#include <stdint.h>		/* for uintptr_t */
 #include <string.h>		/* for memcpy() */
 #include <sys/types.h>		/* for stupid systems */
 #include <netinet/in.h>		/* for ntohl() */
@@ -97,6 +98,16 @@ MD5Update(struct MD5Context *ctx, md5byte const *buf, unsigned int len)
 	len -= t;
 
 	/* Process data in 64-byte chunks */
+#ifndef WORDS_BIGENDIAN
+	/* no need to copy if it already has the right format */
+	if (((uintptr_t)buf & (sizeof(UWORD32) - 1)) == 0) {
+		while (len >= 64) {
+			MD5Transform(ctx->buf, (UWORD32 const *)buf);
+			buf += 64;
+			len -= 64;
+		}
+	}
+#endif
 	while (len >= 64) {
 		memcpy(ctx->in, buf, 64);
 		byteSwap(ctx->in, 16);
@@ -149,107 +149,94 @@ struct needbuild_data { architecture_t architecture;
 	bool printarch;
 };
 
-static retvalue check_source_needs_build(struct distribution *distribution, struct target *target, const char *sourcename, const char *control, void *data) {
-	struct needbuild_data *d = data;
-	char *sourceversion;
-	struct strlist binary, architectures, filekeys;
-	const char *dscfilename = NULL;
+/* is the architecture in the Architecture field of a source package
+ * (or the source package does not tell) */
+static bool builds_for(architecture_t architecture, /*@null@*/const char *architectures) {
+	const char *p = architectures, *a = atoms_architectures[architecture];
+	size_t alen = strlen(a);
+
+	if (p == NULL)
+		return true;
+	while (*p != '\0') {
+		size_t len;
+
+		while (*p == ' ' || *p == '\t' || *p == '\n')
+			p++;
+		len = strcspn(p, " \t\n");
+		if (len == 0)
+			break;
+		if (architecture != architecture_all &&
+				len == 3 && memcmp(p, "any", 3) == 0)
+			return true;
+		if (len == alen && memcmp(p, a, alen) == 0)
+			return true;
+		p += len;
+	}
+	return false;
+}
+
+static retvalue check_source_needs_build(struct distribution *distribution, struct target_cursor *iterator, const char *sourcename, const struct target_metadata *md, struct needbuild_data *d) {
+	struct strlist binary;
+	const char *control, *dscfilename = NULL;
+	struct trackedpackage *tp;
 	int i;
 	retvalue r;
 
 	if (d->glob != NULL && !globmatch(sourcename, d->glob))
 		return RET_NOTHING;
 
-	r = target->getversion(control, &sourceversion);
-	if (!RET_IS_OK(r))
-		return r;
-	r = chunk_getwordlist(control, "Architecture", &architectures);
-	if (RET_IS_OK(r)) {
-		bool skip = true;
-
-		for (i = 0 ; i < architectures.count ; i++) {
-			const char *a = architectures.values[i];
-			if (d->architecture != architecture_all &&
-					strcmp(a, "any") == 0) {
-				skip = false;
-				break;
-			}
-			if (strcmp(a, atoms_architectures[
-						d->architecture]) == 0) {
-				skip = false;
-				break;
-			}
-		}
-		strlist_done(&architectures);
-		if (skip) {
-			free(sourceversion);
-			return RET_NOTHING;
-		}
-	}
-	r = chunk_getwordlist(control, "Binary", &binary);
-	if (!RET_IS_OK(r)) {
-		free(sourceversion);
-		return r;
-	}
-	r = target->getfilekeys(control, &filekeys);
-	if (!RET_IS_OK(r)) {
-		strlist_done(&binary);
-		free(sourceversion);
-		return r;
-	}
-	for (i = 0 ; i < filekeys.count ; i++) {
-		if (endswith(filekeys.values[i], ".dsc")) {
-			dscfilename = filekeys.values[i];
+	if (!builds_for(d->architecture, md->architectures))
+		return RET_NOTHING;
+	for (i = 0 ; i < md->filekeys->count ; i++) {
+		if (endswith(md->filekeys->values[i], ".dsc")) {
+			dscfilename = md->filekeys->values[i];
 			break;
 		}
 	}
 	if (dscfilename == NULL) {
 		fprintf(stderr,
 "Warning: source package '%s' in '%s' without dsc file!\n",
-				sourcename, target->identifier);
-		free(sourceversion);
-		strlist_done(&binary);
-		strlist_done(&filekeys);
+				sourcename, iterator->target->identifier);
 		return RET_NOTHING;
 	}
 
-	if (d->tracks != NULL) {
-		struct trackedpackage *tp;
+	if (d->tracks == NULL)
+		// TODO: implement without tracking
+		return RET_NOTHING;
 
-		r = tracking_get(d->tracks, sourcename, sourceversion, &tp);
-		if (RET_WAS_ERROR(r)) {
-			free(sourceversion);
-			strlist_done(&binary);
-			strlist_done(&filekeys);
-			return r;
-		}
-		if (RET_IS_OK(r)) {
-			r = tracked_source_needs_build(
-					d->architecture, sourcename,
-					sourceversion, dscfilename,
-					&binary, tp, d->printarch);
-			trackedpackage_free(tp);
-			free(sourceversion);
-			strlist_done(&binary);
-			strlist_done(&filekeys);
-			return r;
-		}
+	r = tracking_get(d->tracks, sourcename, md->version, &tp);
+	if (RET_WAS_ERROR(r))
+		return r;
+	if (r == RET_NOTHING) {
 		fprintf(stderr,
 "Warning: %s's tracking data of %s (%s) is out of date. Run retrack to repair!\n",
 				distribution->codename,
-				sourcename, sourceversion);
+				sourcename, md->version);
+		return RET_NOTHING;
+	}
+	/* only now the Binary field is needed, which is not part of the
+	 * metadata, so look at the control data: */
+	r = target_metadatacontrol(iterator, &control);
+	if (RET_IS_OK(r))
+		r = chunk_getwordlist(control, "Binary", &binary);
+	if (!RET_IS_OK(r)) {
+		trackedpackage_free(tp);
+		return r;
 	}
-	// TODO: implement without tracking
-	free(sourceversion);
+	r = tracked_source_needs_build(
+			d->architecture, sourcename,
+			md->version, dscfilename,
+			&binary, tp, d->printarch);
+	trackedpackage_free(tp);
 	strlist_done(&binary);
-	strlist_done(&filekeys);
-	return RET_NOTHING;
+	return r;
 }
 
 
 retvalue find_needs_build(struct distribution *distribution, architecture_t architecture, const struct atomlist *onlycomponents, const char *glob, bool printarch) {
 	retvalue result, r;
 	struct needbuild_data d;
+	struct target *t;
 
 	d.architecture = architecture;
 	d.glob = glob;
@@ -275,9 +262,37 @@ retvalue find_needs_build(struct distribution *distribution, architecture_t arch
 	} else
 			d.tracks = NULL;
 
-	result = distribution_foreach_package_c(distribution,
-			onlycomponents, architecture_source, pt_dsc,
-			check_source_needs_build, &d);
+	result = RET_NOTHING;
+	for (t = distribution->targets ; t != NULL ; t = t->next) {
+		struct target_cursor iterator;
+		struct target_metadata md;
+		const char *sourcename;
+
+		if (onlycomponents != NULL &&
+				!atomlist_in(onlycomponents, t->component))
+			continue;
+		if (t->packagetype != pt_dsc)
+			continue;
+		r = target_openmetadata(t, READONLY,
+				TMD_VERSION|TMD_ARCHITECTURE|TMD_FILEKEYS,
+				&iterator);
+		RET_UPDATE(result, r);
+		if (RET_WAS_ERROR(r))
+			break;
+		while ((r = target_nextmetadata(&iterator, &sourcename, &md))
+				!= RET_NOTHING) {
+			if (RET_IS_OK(r))
+				r = check_source_needs_build(distribution,
+						&iterator, sourcename, &md, &d);
+			RET_UPDATE(result, r);
+			if (RET_WAS_ERROR(r))
+				break;
+		}
+		r = target_closeiterator(&iterator);
+		RET_ENDUPDATE(result, r);
+		if (RET_WAS_ERROR(result))
+			break;
+	}
 
 	r = tracking_done(d.tracks);
 	RET_ENDUPDATE(result, r);
@@ -92,6 +92,8 @@ static bool forbidden_field_name(bool source, const char *field) {
 			return true;
 		if (strcasecmp(field, "Directory") == 0)
 				return true;
+		if (strcasecmp(field, "Checksums-Sha512") == 0)
+				return true;
 		if (strcasecmp(field, "Checksums-Sha256") == 0)
 				return true;
 		if (strcasecmp(field, "Checksums-Sha1") == 0)
@@ -106,6 +108,8 @@ static bool forbidden_field_name(bool source, const char *field) {
 				return true;
 		if (strcasecmp(field, "SHA256") == 0)
 				return true;
+		if (strcasecmp(field, "SHA512") == 0)
+				return true;
 		if (strcasecmp(field, "Size") == 0)
 				return true;
 		return false;
@@ -32,7 +32,151 @@
 #include "pool.h"
 #include "reference.h"
 
+/* While a batch is active, changes are only recorded here (as filekey and
+ * identifier in one allocation) and applied by references_commitbatch.
+ * Only the last change to each reference matters, so they are numbered */
+struct referencechange {
+	char *filekey;
+	const char *identifier;
+	size_t order;
+	/* reference is to exist (otherwise it is to be removed) */
+	bool present;
+};
+
+static struct referencechange *batch = NULL;
+static size_t batch_count = 0, batch_size = 0;
+static bool batch_active = false;
+
+static retvalue batch_record(const char *needed, const char *neededby, bool present) {
+	struct referencechange *c;
+	size_t neededlen = strlen(needed);
+	size_t neededbylen = strlen(neededby);
+
+	if (batch_count >= batch_size) {
+		size_t newsize = (batch_size == 0)?1024:(2 * batch_size);
+
+		c = realloc(batch, newsize * sizeof(struct referencechange));
+		if (FAILEDTOALLOC(c))
+			return RET_ERROR_OOM;
+		batch = c;
+		batch_size = newsize;
+	}
+	c = &batch[batch_count];
+	c->filekey = malloc(neededlen + neededbylen + 2);
+	if (FAILEDTOALLOC(c->filekey))
+		return RET_ERROR_OOM;
+	memcpy(c->filekey, needed, neededlen + 1);
+	memcpy(c->filekey + neededlen + 1, neededby, neededbylen + 1);
+	c->identifier = c->filekey + neededlen + 1;
+	c->order = batch_count;
+	c->present = present;
+	batch_count++;
+	return RET_OK;
+}
+
+static inline bool identifier_matches(const char *found_by, size_t datalen, const char *neededby, size_t l) {
+	return datalen >= l && strncmp(found_by, neededby, l) == 0 &&
+		    (found_by[l] == '\0' || found_by[l] == ' ');
+}
+
+void references_startbatch(void) {
+	assert (!batch_active);
+	batch_active = true;
+}
+
+static int changecompare(const void *a, const void *b) {
+	const struct referencechange *c1 = a, *c2 = b;
+	int i;
+
+	i = strcmp(c1->filekey, c2->filekey);
+	if (i != 0)
+		return i;
+	return strcmp(c1->identifier, c2->identifier);
+}
+
+static int changeordercompare(const void *a, const void *b) {
+	const struct referencechange *c1 = a, *c2 = b;
+	int i;
+
+	i = changecompare(c1, c2);
+	if (i != 0)
+		return i;
+	if (c1->order < c2->order)
+		return -1;
+	return (c1->order > c2->order);
+}
+
+static void batch_free(void) {
+	size_t i;
+
+	for (i = 0 ; i < batch_count ; i++)
+		free(batch[i].filekey);
+	free(batch);
+	batch = NULL;
+	batch_count = 0;
+	batch_size = 0;
+	batch_active = false;
+}
+
+/* apply the changes recorded since references_startbatch, sorted by
+ * filekey. For each reference only the state after the last change
+ * recorded is written to the database. */
+retvalue references_commitbatch(void) {
+	retvalue result, r;
+	size_t i, j;
+
+	assert (batch_active);
+
+	if (batch_count > 1)
+		qsort(batch, batch_count, sizeof(struct referencechange),
+				changeordercompare);
+
+	result = RET_NOTHING;
+	for (i = 0 ; i < batch_count ; i = j) {
+		const char *filekey = batch[i].filekey;
+		const char *identifier = batch[i].identifier;
+		bool added = batch[i].present;
+
+		for (j = i + 1 ; j < batch_count &&
+				changecompare(&batch[i], &batch[j]) == 0 ;
+				j++)
+			added |= batch[j].present;
+		if (batch[j - 1].present) {
+			r = table_addrecord(rdb_references, filekey,
+					identifier, strlen(identifier), true);
+			if (RET_IS_OK(r) && verbose > 8)
+				printf("Adding reference to '%s' by '%s'\n",
+						filekey, identifier);
+		} else {
+			r = table_removerecord(rdb_references,
+					filekey, identifier);
+			if (RET_WAS_ERROR(r))
+				fprintf(stderr,
+"Error while trying to removing reference to '%s' by '%s'\n",
+						filekey, identifier);
+			else if (RET_IS_OK(r)) {
+				if (verbose > 8)
+					fprintf(stderr,
+"Removed reference to '%s' by '%s'\n",
+						filekey, identifier);
+				r = pool_dereferenced(filekey);
+			} else if (added) {
+				/* added and removed again within the batch,
+				 * so the file might no longer be needed */
+				r = pool_dereferenced(filekey);
+			} else
+				continue;
+		}
+		RET_UPDATE(result, r);
+		if (RET_WAS_ERROR(r))
+			break;
+	}
+	batch_free();
+	return result;
+}
+
 retvalue references_isused( const char *what) {
+	assert (!batch_active);
 	return table_gettemprecord(rdb_references, what, NULL, NULL);
 }
 
@@ -40,6 +184,7 @@ retvalue references_check(const char *referee, const struct strlist *filekeys) {
 	int i;
 	retvalue result, r;
 
+	assert (!batch_active);
 	result = RET_NOTHING;
 	for (i = 0 ; i < filekeys->count ; i++) {
 		r = table_checkrecord(rdb_references,
@@ -58,6 +203,8 @@ retvalue references_check(const char *referee, const struct strlist *filekeys) {
 retvalue references_increment(const char *needed, const char *neededby) {
 	retvalue r;
 
+	if (batch_active)
+		return batch_record(needed, neededby, true);
 	r = table_addrecord(rdb_references, needed,
 			neededby, strlen(neededby), false);
 	if (RET_IS_OK(r) && verbose > 8)
@@ -69,6 +216,8 @@ retvalue references_increment(const char *needed, const char *neededby) {
 retvalue references_decrement(const char *needed, const char *neededby) {
 	retvalue r;
 
+	if (batch_active)
+		return batch_record(needed, neededby, false);
 	r = table_removerecord(rdb_references, needed, neededby);
 	if (r == RET_NOTHING)
 		return r;
@@ -114,6 +263,7 @@ retvalue references_add(const char *identifier, const struct strlist *files) {
 	int i;
 	retvalue r;
 
+	assert (!batch_active);
 	for (i = 0 ; i < files->count ; i++) {
 		const char *filekey = files->values[i];
 		r = table_addrecord(rdb_references, filekey,
@@ -159,12 +309,43 @@ retvalue references_remove(const char *neededby) {
 
 	l = strlen(neededby);
 
+	if (batch_active) {
+		size_t i, count = batch_count;
+
+		/* both references added earlier in this batch and those
+		 * in the database are marked as to be removed */
+		result = RET_NOTHING;
+		for (i = 0 ; i < count ; i++) {
+			if (!batch[i].present || !identifier_matches(
+					batch[i].identifier,
+					strlen(batch[i].identifier),
+					neededby, l))
+				continue;
+			r = batch_record(batch[i].filekey,
+					batch[i].identifier, false);
+			RET_UPDATE(result, r);
+			if (RET_WAS_ERROR(r))
+				break;
+		}
+		while (!RET_WAS_ERROR(result) &&
+				cursor_nexttempdata(rdb_references, cursor,
+					&found_to, &found_by, &datalen)) {
+			if (!identifier_matches(found_by, datalen,
+						neededby, l))
+				continue;
+			r = batch_record(found_to, found_by, false);
+			RET_UPDATE(result, r);
+		}
+		r = cursor_close(rdb_references, cursor);
+		RET_ENDUPDATE(result, r);
+		return result;
+	}
+
 	result = RET_NOTHING;
 	while (cursor_nexttempdata(rdb_references, cursor,
 				&found_to, &found_by, &datalen)) {
 
-		if (datalen >= l && strncmp(found_by, neededby, l) == 0 &&
-		    (found_by[l] == '\0' || found_by[l] == ' ')) {
+		if (identifier_matches(found_by, datalen, neededby, l)) {
 			if (verbose > 8)
 				fprintf(stderr,
 "Removing reference to '%s' by '%s'\n",
@@ -189,6 +370,7 @@ retvalue references_dump(void) {
 	retvalue result, r;
 	const char *found_to, *found_by;
 
+	assert (!batch_active);
 	r = table_newglobalcursor(rdb_references, &cursor);
 	if (!RET_IS_OK(r))
 		return r;
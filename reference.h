@@ -44,6 +44,12 @@ retvalue references_isused(const char *);
 /* check if a reference is found as expected */
 retvalue references_check(const char * /*referee*/, const struct strlist */*what*/);
 
+/* until references_commitbatch is called, only record the changes done by
+ * references_increment, _decrement, _insert, _delete and _remove in memory.
+ * (no other references_ functions may be called in between) */
+void references_startbatch(void);
+retvalue references_commitbatch(void);
+
 /* output all references to stdout */
 retvalue references_dump(void);
 
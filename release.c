@@ -29,10 +29,18 @@
 #include <ctype.h>
 #include <fcntl.h>
 #include <time.h>
+#include <signal.h>
+#include <sys/wait.h>
 #include <zlib.h>
 #ifdef HAVE_LIBBZ2
 #include <bzlib.h>
 #endif
+#ifdef HAVE_LIBLZMA
+#include <lzma.h>
+#endif
+#ifdef HAVE_LIBZSTD
+#include <zstd.h>
+#endif
 #define CHECKSUMS_CONTEXT visible
 #include "error.h"
 #include "ignore.h"
@@ -45,11 +53,16 @@
 #include "names.h"
 #include "signature.h"
 #include "distribution.h"
+#include "jobs.h"
 #include "release.h"
 
-#define INPUT_BUFFER_SIZE 1024
+/* default size of the chunks to checksum and compress data at once */
+#define INPUT_BUFFER_SIZE 65536
 #define GZBUFSIZE 40960
 #define BZBUFSIZE 40960
+#define XZBUFSIZE 40960
+/* zstd's default level, higher ones are too slow to use for every export */
+#define ZSTDLEVEL 3
 
 struct release {
 	/* The base-directory of the distribution we are exporting */
@@ -332,6 +345,114 @@ retvalue release_addold(struct release *release, /*@only@*/char *relfilename) {
 			checksums, NULL, NULL, NULL);
 }
 
+/* When exporting in worker processes (see jobs.c), the entries a worker
+ * added have to be transfered to the parent. They are sent as five
+ * '\0'-terminated strings per entry, an empty string meaning NULL. */
+
+void release_detachentries(struct release *release) {
+	/* the parent process still has them, only forget them here */
+	release->files = NULL;
+}
+
+static inline retvalue sendfield(int fd, /*@null@*/const char *s) {
+	if (s == NULL)
+		return jobs_write(fd, "", 1);
+	assert (s[0] != '\0');
+	return jobs_write(fd, s, strlen(s) + 1);
+}
+
+retvalue release_sendentries(struct release *release, int fd) {
+	struct release_entry *e;
+	retvalue r;
+
+	for (e = release->files ; e != NULL ; e = e->next) {
+		const char *combined = NULL;
+		size_t len;
+
+		if (e->checksums != NULL) {
+			r = checksums_getcombined(e->checksums,
+					&combined, &len);
+			if (RET_WAS_ERROR(r))
+				return r;
+		}
+		r = sendfield(fd, e->relativefilename);
+		if (!RET_WAS_ERROR(r))
+			r = sendfield(fd, combined);
+		if (!RET_WAS_ERROR(r))
+			r = sendfield(fd, e->fullfinalfilename);
+		if (!RET_WAS_ERROR(r))
+			r = sendfield(fd, e->fulltemporaryfilename);
+		if (!RET_WAS_ERROR(r))
+			r = sendfield(fd, e->symlinktarget);
+		if (RET_WAS_ERROR(r))
+			return r;
+	}
+	return RET_OK;
+}
+
+static inline retvalue receivefield(const char **data, const char *end, /*@out@*/char **field_p) {
+	const char *p = *data;
+	size_t l;
+
+	l = strnlen(p, end - p);
+	if (p + l >= end) {
+		fprintf(stderr,
+"Internal Error: Truncated data from export worker process!\n");
+		return RET_ERROR_INTERNAL;
+	}
+	*data = p + l + 1;
+	if (l == 0) {
+		*field_p = NULL;
+		return RET_OK;
+	}
+	*field_p = strndup(p, l);
+	if (FAILEDTOALLOC(*field_p))
+		return RET_ERROR_OOM;
+	return RET_OK;
+}
+
+retvalue release_receiveentries(struct release *release, const char *data, size_t len) {
+	const char *end = data + len;
+	retvalue r;
+
+	while (data < end) {
+		char *relativefilename, *combined, *fullfinalfilename,
+		     *fulltemporaryfilename, *symlinktarget;
+		struct checksums *checksums = NULL;
+
+		relativefilename = NULL; combined = NULL;
+		fullfinalfilename = NULL; fulltemporaryfilename = NULL;
+		symlinktarget = NULL;
+		r = receivefield(&data, end, &relativefilename);
+		if (!RET_WAS_ERROR(r))
+			r = receivefield(&data, end, &combined);
+		if (!RET_WAS_ERROR(r))
+			r = receivefield(&data, end, &fullfinalfilename);
+		if (!RET_WAS_ERROR(r))
+			r = receivefield(&data, end, &fulltemporaryfilename);
+		if (!RET_WAS_ERROR(r))
+			r = receivefield(&data, end, &symlinktarget);
+		if (!RET_WAS_ERROR(r) && combined != NULL)
+			r = checksums_parse(&checksums, combined);
+		free(combined);
+		if (RET_WAS_ERROR(r)) {
+			free(relativefilename);
+			free(fullfinalfilename);
+			free(fulltemporaryfilename);
+			free(symlinktarget);
+			return r;
+		}
+		if (fulltemporaryfilename != NULL)
+			release->new = true;
+		r = newreleaseentry(release, relativefilename, checksums,
+				fullfinalfilename, fulltemporaryfilename,
+				symlinktarget);
+		if (RET_WAS_ERROR(r))
+			return r;
+	}
+	return RET_OK;
+}
+
 static char *calc_compressedname(const char *name, enum indexcompression ic) {
 	switch (ic) {
 		case ic_uncompressed:
@@ -341,6 +462,14 @@ static char *calc_compressedname(const char *name, enum indexcompression ic) {
 #ifdef HAVE_LIBBZ2
 		case ic_bzip2:
 			return calc_addsuffix(name, "bz2");
+#endif
+#ifdef HAVE_LIBLZMA
+		case ic_xz:
+			return calc_addsuffix(name, "xz");
+#endif
+#ifdef HAVE_LIBZSTD
+		case ic_zstd:
+			return calc_addsuffix(name, "zst");
 #endif
 		default:
 			assert ("Huh?" == NULL);
@@ -484,9 +613,15 @@ struct filetorelease {
 		char *fullfinalfilename;
 		char *fulltemporaryfilename;
 		char *symlinkas;
+		/* if compressed by a child process (--parallel-compression),
+		 * the data is written to pipefd and the checksums of the
+		 * result are read from resultfd: */
+		pid_t pid;
+		int pipefd, resultfd;
+		/*@null@*/struct checksums *checksums;
 	} f[ic_count];
 	/* input buffer, to checksum/compress data at once */
-	unsigned char *buffer; size_t waiting_bytes;
+	unsigned char *buffer; size_t buffersize, waiting_bytes;
 	/* output buffer for gzip compression */
 	unsigned char *gzoutputbuffer; size_t gz_waiting_bytes;
 	z_stream gzstream;
@@ -495,17 +630,50 @@ struct filetorelease {
 	char *bzoutputbuffer; size_t bz_waiting_bytes;
 	bz_stream bzstream;
 #endif
+#ifdef HAVE_LIBLZMA
+	/* output buffer for xz compression */
+	unsigned char *xzoutputbuffer; size_t xz_waiting_bytes;
+	lzma_stream xzstream;
+#endif
+#ifdef HAVE_LIBZSTD
+	/* output buffer for zstd compression */
+	unsigned char *zstdoutputbuffer; size_t zstd_waiting_bytes;
+	size_t zstdbuffersize;
+	ZSTD_CCtx *zstdcontext;
+#endif
 };
 
+static void stopcompressor(struct openfile *f) {
+	pid_t c;
+	int status;
+
+	if (f->pipefd >= 0)
+		(void)close(f->pipefd);
+	f->pipefd = -1;
+	if (f->resultfd >= 0)
+		(void)close(f->resultfd);
+	f->resultfd = -1;
+	if (f->pid <= 0)
+		return;
+	(void)kill(f->pid, SIGKILL);
+	do {
+		c = waitpid(f->pid, &status, 0);
+	} while (c < 0 && errno == EINTR);
+	f->pid = 0;
+}
+
 void release_abortfile(struct filetorelease *file) {
 	enum indexcompression i;
 
 	for (i = ic_uncompressed ; i < ic_count ; i++) {
-		if (file->f[i].fd >= 0) {
+		if (file->f[i].fd >= 0)
 			(void)close(file->f[i].fd);
-			if (file->f[i].fulltemporaryfilename != NULL)
-				(void)unlink(file->f[i].fulltemporaryfilename);
-		}
+		stopcompressor(&file->f[i]);
+		/* also if already finished (or given to a compressor that
+		 * already exited), as it will not be released now */
+		if (file->f[i].fulltemporaryfilename != NULL)
+			(void)unlink(file->f[i].fulltemporaryfilename);
+		checksums_free(file->f[i].checksums);
 		free(file->f[i].relativefilename);
 		free(file->f[i].fullfinalfilename);
 		free(file->f[i].fulltemporaryfilename);
@@ -522,20 +690,30 @@ void release_abortfile(struct filetorelease *file) {
 		(void)BZ2_bzCompressEnd(&file->bzstream);
 	}
 #endif
+#ifdef HAVE_LIBLZMA
+	free(file->xzoutputbuffer);
+	/* a no-op if never initialized or already ended */
+	lzma_end(&file->xzstream);
+#endif
+#ifdef HAVE_LIBZSTD
+	free(file->zstdoutputbuffer);
+	ZSTD_freeCCtx(file->zstdcontext);
+#endif
 }
 
 bool release_oldexists(struct filetorelease *file) {
-	if (file->f[ic_uncompressed].fullfinalfilename != NULL) {
-		if (file->f[ic_gzip].fullfinalfilename != NULL) {
-			return isregularfile(file->f[ic_gzip].fullfinalfilename) &&
-			       isregularfile(file->f[ic_uncompressed].fullfinalfilename);
-		} else {
-			return isregularfile(file->f[ic_uncompressed].fullfinalfilename);
-		}
-	} else {
-		assert (file->f[ic_gzip].fullfinalfilename != NULL);
-		return isregularfile(file->f[ic_gzip].fullfinalfilename);
+	enum indexcompression ic;
+	bool found = false;
+
+	for (ic = ic_uncompressed ; ic < ic_count ; ic++) {
+		if (file->f[ic].fullfinalfilename == NULL)
+			continue;
+		if (!isregularfile(file->f[ic].fullfinalfilename))
+			return false;
+		found = true;
 	}
+	assert (found);
+	return found;
 }
 
 static retvalue openfile(const char *dirofdist, struct openfile *f) {
@@ -662,10 +840,84 @@ static retvalue initbzcompression(struct filetorelease *f) {
 }
 #endif
 
+#ifdef HAVE_LIBLZMA
+
+static retvalue initxzcompression(struct filetorelease *f) {
+	lzma_ret lret;
+#ifdef HAVE_LZMA_STREAM_ENCODER_MT
+	lzma_mt mt;
+#endif
+
+	f->xzoutputbuffer = malloc(XZBUFSIZE);
+	if (FAILEDTOALLOC(f->xzoutputbuffer))
+		return RET_ERROR_OOM;
+#ifdef HAVE_LZMA_STREAM_ENCODER_MT
+	/* The multi-threaded encoder splits the data in blocks of a size
+	 * only depending on the preset, so the result does not depend on
+	 * the number of threads used (and is always the same). */
+	memset(&mt, 0, sizeof(mt));
+	mt.threads = (global.compressionthreads > 1)?
+		global.compressionthreads:1;
+	mt.block_size = 0;
+	mt.timeout = 0;
+	mt.preset = LZMA_PRESET_DEFAULT;
+	mt.filters = NULL;
+	mt.check = LZMA_CHECK_CRC64;
+	lret = lzma_stream_encoder_mt(&f->xzstream, &mt);
+#else
+	lret = lzma_easy_encoder(&f->xzstream, LZMA_PRESET_DEFAULT,
+			LZMA_CHECK_CRC64);
+#endif
+	if (lret == LZMA_MEM_ERROR)
+		return RET_ERROR_OOM;
+	if (lret != LZMA_OK) {
+		fprintf(stderr, "Error from liblzma's encoder initialisation: "
+				"%d\n", (int)lret);
+		return RET_ERROR;
+	}
+	return RET_OK;
+}
+#endif
+
+#ifdef HAVE_LIBZSTD
+
+static retvalue initzstdcompression(struct filetorelease *f) {
+	size_t zret;
+
+	f->zstdbuffersize = ZSTD_CStreamOutSize();
+	f->zstdoutputbuffer = malloc(f->zstdbuffersize);
+	if (FAILEDTOALLOC(f->zstdoutputbuffer))
+		return RET_ERROR_OOM;
+	f->zstdcontext = ZSTD_createCCtx();
+	if (FAILEDTOALLOC(f->zstdcontext))
+		return RET_ERROR_OOM;
+	zret = ZSTD_CCtx_setParameter(f->zstdcontext,
+			ZSTD_c_compressionLevel, ZSTDLEVEL);
+	if (ZSTD_isError(zret)) {
+		fprintf(stderr, "Error from libzstd: %s\n",
+				ZSTD_getErrorName(zret));
+		return RET_ERROR;
+	}
+	/* Always use the multi-threaded mode (whose output does not depend
+	 * on the number of workers). This fails if libzstd was built without
+	 * thread support, in which case everything is done in this thread */
+	(void)ZSTD_CCtx_setParameter(f->zstdcontext, ZSTD_c_nbWorkers,
+			(global.compressionthreads > 1)?
+			(int)global.compressionthreads:1);
+	return RET_OK;
+}
+#endif
+
 static const char * const ics[ic_count] = { "", ".gz"
 #ifdef HAVE_LIBBZ2
        	, ".bz2"
 #endif
+#ifdef HAVE_LIBLZMA
+	, ".xz"
+#endif
+#ifdef HAVE_LIBZSTD
+	, ".zst"
+#endif
 };
 
 static inline retvalue setfilename(struct release *release, struct filetorelease *n, const char *relfilename, /*@null@*/const char *symlinkas, enum indexcompression ic) {
@@ -705,6 +957,9 @@ static inline void warnfilename(struct release *release, const char *relfilename
 	free(fullfilename);
 }
 
+static retvalue initcompression(struct filetorelease *, enum indexcompression);
+static retvalue startcompressor(struct filetorelease *, enum indexcompression);
+
 static retvalue startfile(struct release *release, const char *filename, /*@null@*/const char *symlinkas, compressionset compressions, bool usecache, struct filetorelease **file) {
 	struct filetorelease *n;
 	enum indexcompression i;
@@ -721,14 +976,20 @@ static retvalue startfile(struct release *release, const char *filename, /*@null
 	n = zNEW(struct filetorelease);
 	if (FAILEDTOALLOC(n))
 		return RET_ERROR_OOM;
-	n->buffer = malloc(INPUT_BUFFER_SIZE);
+	for (i = ic_uncompressed ; i < ic_count ; i ++) {
+		n->f[i].fd = -1;
+		n->f[i].pipefd = -1;
+		n->f[i].resultfd = -1;
+	}
+	if (global.indexbuffersize > 0)
+		n->buffersize = global.indexbuffersize;
+	else
+		n->buffersize = INPUT_BUFFER_SIZE;
+	n->buffer = malloc(n->buffersize);
 	if (FAILEDTOALLOC(n->buffer)) {
 		release_abortfile(n);
 		return RET_ERROR_OOM;
 	}
-	for (i = ic_uncompressed ; i < ic_count ; i ++) {
-		n->f[i].fd = -1;
-	}
 	if ((compressions & IC_FLAG(ic_uncompressed)) != 0) {
 		retvalue r;
 
@@ -749,43 +1010,28 @@ static retvalue startfile(struct release *release, const char *filename, /*@null
 		}
 	}
 
-	if ((compressions & IC_FLAG(ic_gzip)) != 0) {
+	for (i = ic_uncompressed + 1 ; i < ic_count ; i++) {
 		retvalue r;
 
-		r = setfilename(release, n, filename, symlinkas,
-				ic_gzip);
-		if (!RET_WAS_ERROR(r))
-			r = openfile(release->dirofdist, &n->f[ic_gzip]);
-		if (RET_WAS_ERROR(r)) {
-			release_abortfile(n);
-			return r;
-		}
-		checksumscontext_init(&n->f[ic_gzip].context);
-		r = initgzcompression(n);
-		if (RET_WAS_ERROR(r)) {
-			release_abortfile(n);
-			return r;
-		}
-	}
-#ifdef HAVE_LIBBZ2
-	if ((compressions & IC_FLAG(ic_bzip2)) != 0) {
-		retvalue r;
-		r = setfilename(release, n, filename, symlinkas,
-				ic_bzip2);
+		if ((compressions & IC_FLAG(i)) == 0)
+			continue;
+		r = setfilename(release, n, filename, symlinkas, i);
 		if (!RET_WAS_ERROR(r))
-			r = openfile(release->dirofdist, &n->f[ic_bzip2]);
+			r = openfile(release->dirofdist, &n->f[i]);
 		if (RET_WAS_ERROR(r)) {
 			release_abortfile(n);
 			return r;
 		}
-		checksumscontext_init(&n->f[ic_bzip2].context);
-		r = initbzcompression(n);
+		checksumscontext_init(&n->f[i].context);
+		if (global.parallelcompression)
+			r = startcompressor(n, i);
+		else
+			r = initcompression(n, i);
 		if (RET_WAS_ERROR(r)) {
 			release_abortfile(n);
 			return r;
 		}
 	}
-#endif
 	checksumscontext_init(&n->f[ic_uncompressed].context);
 	*file = n;
 	return RET_OK;
@@ -860,9 +1106,15 @@ static retvalue releasefile(struct release *release, struct openfile *f) {
 		|| (f->fullfinalfilename != NULL
 		  && f->fulltemporaryfilename != NULL));
 
-	r = checksums_from_context(&checksums, &f->context);
-	if (RET_WAS_ERROR(r))
-		return r;
+	if (f->checksums != NULL) {
+		/* already calculated by the compressor process */
+		checksums = f->checksums;
+		f->checksums = NULL;
+	} else {
+		r = checksums_from_context(&checksums, &f->context);
+		if (RET_WAS_ERROR(r))
+			return r;
+	}
 	if (f->symlinkas) {
 		char *symlinktarget = calc_relative_path(f->fullfinalfilename,
 				f->symlinkas);
@@ -885,13 +1137,13 @@ static retvalue releasefile(struct release *release, struct openfile *f) {
 	return r;
 }
 
-static retvalue writegz(struct filetorelease *f) {
+static retvalue writegz(struct filetorelease *f, const unsigned char *data, size_t len) {
 	int zret;
 
 	assert (f->f[ic_gzip].fd >= 0);
 
-	f->gzstream.next_in = f->buffer;
-	f->gzstream.avail_in = INPUT_BUFFER_SIZE;
+	f->gzstream.next_in = (unsigned char *)data;
+	f->gzstream.avail_in = len;
 
 	do {
 		f->gzstream.next_out = f->gzoutputbuffer + f->gz_waiting_bytes;
@@ -937,13 +1189,13 @@ static retvalue writegz(struct filetorelease *f) {
 	return RET_OK;
 }
 
-static retvalue finishgz(struct filetorelease *f) {
+static retvalue finishgz(struct filetorelease *f, const unsigned char *data, size_t len) {
 	int zret;
 
 	assert (f->f[ic_gzip].fd >= 0);
 
-	f->gzstream.next_in = f->buffer;
-	f->gzstream.avail_in = f->waiting_bytes;
+	f->gzstream.next_in = (unsigned char *)data;
+	f->gzstream.avail_in = len;
 
 	do {
 		f->gzstream.next_out = f->gzoutputbuffer + f->gz_waiting_bytes;
@@ -1004,13 +1256,13 @@ static retvalue finishgz(struct filetorelease *f) {
 
 #ifdef HAVE_LIBBZ2
 
-static retvalue writebz(struct filetorelease *f) {
+static retvalue writebz(struct filetorelease *f, const unsigned char *data, size_t len) {
 	int bzret;
 
 	assert (f->f[ic_bzip2].fd >= 0);
 
-	f->bzstream.next_in = (char*)f->buffer;
-	f->bzstream.avail_in = INPUT_BUFFER_SIZE;
+	f->bzstream.next_in = (char*)data;
+	f->bzstream.avail_in = len;
 
 	do {
 		f->bzstream.next_out = f->bzoutputbuffer + f->bz_waiting_bytes;
@@ -1044,13 +1296,13 @@ static retvalue writebz(struct filetorelease *f) {
 	return RET_OK;
 }
 
-static retvalue finishbz(struct filetorelease *f) {
+static retvalue finishbz(struct filetorelease *f, const unsigned char *data, size_t len) {
 	int bzret;
 
 	assert (f->f[ic_bzip2].fd >= 0);
 
-	f->bzstream.next_in = (char*)f->buffer;
-	f->bzstream.avail_in = f->waiting_bytes;
+	f->bzstream.next_in = (char*)data;
+	f->bzstream.avail_in = len;
 
 	do {
 		f->bzstream.next_out = f->bzoutputbuffer + f->bz_waiting_bytes;
@@ -1095,6 +1347,392 @@ static retvalue finishbz(struct filetorelease *f) {
 }
 #endif
 
+#ifdef HAVE_LIBLZMA
+
+static retvalue writexz(struct filetorelease *f, const unsigned char *data, size_t len) {
+	lzma_ret lret;
+
+	assert (f->f[ic_xz].fd >= 0);
+
+	f->xzstream.next_in = data;
+	f->xzstream.avail_in = len;
+
+	do {
+		f->xzstream.next_out = f->xzoutputbuffer + f->xz_waiting_bytes;
+		f->xzstream.avail_out = XZBUFSIZE - f->xz_waiting_bytes;
+
+		lret = lzma_code(&f->xzstream, LZMA_RUN);
+		f->xz_waiting_bytes = XZBUFSIZE - f->xzstream.avail_out;
+
+		if (lret == LZMA_OK &&
+				f->xz_waiting_bytes >= XZBUFSIZE / 2) {
+			retvalue r;
+			r = writetofile(&f->f[ic_xz],
+					f->xzoutputbuffer, f->xz_waiting_bytes);
+			assert (r != RET_NOTHING);
+			if (RET_WAS_ERROR(r))
+				return r;
+			f->xz_waiting_bytes = 0;
+		}
+	} while (lret == LZMA_OK && f->xzstream.avail_in != 0);
+
+	f->xzstream.next_in = NULL;
+	f->xzstream.avail_in = 0;
+
+	if (lret == LZMA_MEM_ERROR)
+		return RET_ERROR_OOM;
+	if (lret != LZMA_OK) {
+		fprintf(stderr, "Error from liblzma's lzma_code: "
+					"%d\n", (int)lret);
+		return RET_ERROR;
+	}
+	return RET_OK;
+}
+
+static retvalue finishxz(struct filetorelease *f, const unsigned char *data, size_t len) {
+	lzma_ret lret;
+
+	assert (f->f[ic_xz].fd >= 0);
+
+	f->xzstream.next_in = data;
+	f->xzstream.avail_in = len;
+
+	do {
+		f->xzstream.next_out = f->xzoutputbuffer + f->xz_waiting_bytes;
+		f->xzstream.avail_out = XZBUFSIZE - f->xz_waiting_bytes;
+
+		lret = lzma_code(&f->xzstream, LZMA_FINISH);
+		f->xz_waiting_bytes = XZBUFSIZE - f->xzstream.avail_out;
+
+		if ((lret == LZMA_OK || lret == LZMA_STREAM_END)
+		    && f->xz_waiting_bytes > 0) {
+			retvalue r;
+			r = writetofile(&f->f[ic_xz],
+					f->xzoutputbuffer, f->xz_waiting_bytes);
+			assert (r != RET_NOTHING);
+			if (RET_WAS_ERROR(r))
+				return r;
+			f->xz_waiting_bytes = 0;
+		}
+	} while (lret == LZMA_OK);
+
+	lzma_end(&f->xzstream);
+
+	if (lret == LZMA_MEM_ERROR)
+		return RET_ERROR_OOM;
+	if (lret != LZMA_STREAM_END) {
+		fprintf(stderr, "Error from liblzma's lzma_code: "
+				"%d\n", (int)lret);
+		return RET_ERROR;
+	}
+	return RET_OK;
+}
+#endif
+
+#ifdef HAVE_LIBZSTD
+
+static retvalue zstdcode(struct filetorelease *f, const unsigned char *data, size_t len, ZSTD_EndDirective mode) {
+	ZSTD_inBuffer in;
+	ZSTD_outBuffer out;
+	size_t zret;
+
+	assert (f->f[ic_zstd].fd >= 0);
+
+	in.src = data;
+	in.size = len;
+	in.pos = 0;
+	do {
+		out.dst = f->zstdoutputbuffer;
+		out.size = f->zstdbuffersize;
+		out.pos = f->zstd_waiting_bytes;
+
+		zret = ZSTD_compressStream2(f->zstdcontext, &out, &in, mode);
+		if (ZSTD_isError(zret)) {
+			fprintf(stderr, "Error from libzstd: %s\n",
+					ZSTD_getErrorName(zret));
+			return RET_ERROR;
+		}
+		f->zstd_waiting_bytes = out.pos;
+
+		if (f->zstd_waiting_bytes >= f->zstdbuffersize / 2 ||
+				(mode == ZSTD_e_end &&
+				 f->zstd_waiting_bytes > 0)) {
+			retvalue r;
+			r = writetofile(&f->f[ic_zstd],
+					f->zstdoutputbuffer,
+					f->zstd_waiting_bytes);
+			assert (r != RET_NOTHING);
+			if (RET_WAS_ERROR(r))
+				return r;
+			f->zstd_waiting_bytes = 0;
+		}
+		/* with ZSTD_e_end zret is the amount of data not yet flushed */
+	} while (in.pos < in.size || (mode == ZSTD_e_end && zret != 0));
+	return RET_OK;
+}
+
+static retvalue writezstd(struct filetorelease *f, const unsigned char *data, size_t len) {
+	return zstdcode(f, data, len, ZSTD_e_continue);
+}
+
+static retvalue finishzstd(struct filetorelease *f, const unsigned char *data, size_t len) {
+	retvalue r;
+
+	r = zstdcode(f, data, len, ZSTD_e_end);
+	ZSTD_freeCCtx(f->zstdcontext);
+	f->zstdcontext = NULL;
+	return r;
+}
+#endif
+
+static retvalue initcompression(struct filetorelease *f, enum indexcompression ic) {
+	switch (ic) {
+		case ic_gzip:
+			return initgzcompression(f);
+#ifdef HAVE_LIBBZ2
+		case ic_bzip2:
+			return initbzcompression(f);
+#endif
+#ifdef HAVE_LIBLZMA
+		case ic_xz:
+			return initxzcompression(f);
+#endif
+#ifdef HAVE_LIBZSTD
+		case ic_zstd:
+			return initzstdcompression(f);
+#endif
+		default:
+			assert ("Huh?" == NULL);
+			return RET_ERROR_INTERNAL;
+	}
+}
+
+static retvalue compressdata(struct filetorelease *f, enum indexcompression ic, const unsigned char *data, size_t len) {
+	switch (ic) {
+		case ic_gzip:
+			return writegz(f, data, len);
+#ifdef HAVE_LIBBZ2
+		case ic_bzip2:
+			return writebz(f, data, len);
+#endif
+#ifdef HAVE_LIBLZMA
+		case ic_xz:
+			return writexz(f, data, len);
+#endif
+#ifdef HAVE_LIBZSTD
+		case ic_zstd:
+			return writezstd(f, data, len);
+#endif
+		default:
+			assert ("Huh?" == NULL);
+			return RET_ERROR_INTERNAL;
+	}
+}
+
+static retvalue finishcompression(struct filetorelease *f, enum indexcompression ic, const unsigned char *data, size_t len) {
+	retvalue r;
+
+	switch (ic) {
+		case ic_gzip:
+			r = finishgz(f, data, len);
+			break;
+#ifdef HAVE_LIBBZ2
+		case ic_bzip2:
+			r = finishbz(f, data, len);
+			break;
+#endif
+#ifdef HAVE_LIBLZMA
+		case ic_xz:
+			r = finishxz(f, data, len);
+			break;
+#endif
+#ifdef HAVE_LIBZSTD
+		case ic_zstd:
+			r = finishzstd(f, data, len);
+			break;
+#endif
+		default:
+			assert ("Huh?" == NULL);
+			return RET_ERROR_INTERNAL;
+	}
+	if (RET_WAS_ERROR(r))
+		return r;
+	if (close(f->f[ic].fd) != 0) {
+		int e = errno;
+		f->f[ic].fd = -1;
+		fprintf(stderr, "Error %d writing to %s: %s\n",
+				e, f->f[ic].fullfinalfilename, strerror(e));
+		return RET_ERRNO(e);
+	}
+	f->f[ic].fd = -1;
+	return RET_OK;
+}
+
+/* With --parallel-compression every compressed file is generated by a child
+ * process reading the uncompressed data from a pipe, so the time needed is
+ * that of the slowest compression instead of the sum of all of them. */
+
+static void compressorchild(struct filetorelease *f, enum indexcompression ic, int infd, int resultfd) NORETURN;
+static void compressorchild(struct filetorelease *f, enum indexcompression ic, int infd, int resultfd) {
+	struct checksums *checksums;
+	const char *combined;
+	size_t len;
+	retvalue r;
+	int in, out, res;
+
+	/* only keep what is needed as 3, 4 and 5, so that no pipe to
+	 * some other compressor is kept open here: */
+	in = fcntl(infd, F_DUPFD, 6);
+	out = fcntl(f->f[ic].fd, F_DUPFD, 6);
+	res = fcntl(resultfd, F_DUPFD, 6);
+	if (in < 0 || out < 0 || res < 0 || dup2(in, 3) < 0 ||
+			dup2(out, 4) < 0 || dup2(res, 5) < 0) {
+		int e = errno;
+		fprintf(stderr, "Error %d moving file descriptors: %s\n",
+				e, strerror(e));
+		_exit(EXIT_FAILURE);
+	}
+	closefrom(6);
+	f->f[ic].fd = 4;
+
+	r = initcompression(f, ic);
+	while (!RET_WAS_ERROR(r)) {
+		ssize_t got = read(3, f->buffer, f->buffersize);
+		if (got < 0) {
+			int e = errno;
+			if (e == EINTR)
+				continue;
+			fprintf(stderr, "Error %d reading from pipe: %s\n",
+					e, strerror(e));
+			r = RET_ERRNO(e);
+		} else if (got == 0)
+			break;
+		else
+			r = compressdata(f, ic, f->buffer, got);
+	}
+	if (!RET_WAS_ERROR(r))
+		r = finishcompression(f, ic, NULL, 0);
+	if (!RET_WAS_ERROR(r))
+		r = checksums_from_context(&checksums, &f->f[ic].context);
+	if (!RET_WAS_ERROR(r))
+		r = checksums_getcombined(checksums, &combined, &len);
+	if (!RET_WAS_ERROR(r))
+		r = jobs_write(5, combined, len + 1);
+	_exit(RET_IS_OK(r)?EXIT_SUCCESS:EXIT_FAILURE);
+}
+
+static retvalue startcompressor(struct filetorelease *f, enum indexcompression ic) {
+	int data[2], result[2];
+	pid_t pid;
+
+	if (pipe(data) != 0) {
+		int e = errno;
+		fprintf(stderr, "Error %d creating pipe: %s!\n",
+				e, strerror(e));
+		return RET_ERRNO(e);
+	}
+	if (pipe(result) != 0) {
+		int e = errno;
+		fprintf(stderr, "Error %d creating pipe: %s!\n",
+				e, strerror(e));
+		(void)close(data[0]);
+		(void)close(data[1]);
+		return RET_ERRNO(e);
+	}
+	(void)fflush(stdout);
+	(void)fflush(stderr);
+	pid = fork();
+	if (pid < 0) {
+		int e = errno;
+		fprintf(stderr, "Error %d forking compressor process: %s\n",
+				e, strerror(e));
+		(void)close(data[0]);
+		(void)close(data[1]);
+		(void)close(result[0]);
+		(void)close(result[1]);
+		return RET_ERRNO(e);
+	}
+	if (pid == 0)
+		compressorchild(f, ic, data[0], result[1]);
+	(void)close(data[0]);
+	(void)close(result[1]);
+	markcloseonexec(data[1]);
+	markcloseonexec(result[0]);
+	/* the child has the file, so the parent no longer needs it */
+	(void)close(f->f[ic].fd);
+	f->f[ic].fd = -1;
+	f->f[ic].pid = pid;
+	f->f[ic].pipefd = data[1];
+	f->f[ic].resultfd = result[0];
+	return RET_OK;
+}
+
+static retvalue writetocompressor(struct openfile *file, const unsigned char *data, size_t len) {
+
+	while (len > 0) {
+		ssize_t written = write(file->pipefd, data, len);
+		if (written >= 0) {
+			len -= written;
+			data += written;
+		} else {
+			int e = errno;
+			if (e == EAGAIN || e == EINTR)
+				continue;
+			fprintf(stderr,
+"Error %d writing to compressor for %s: %s\n",
+					e, file->fullfinalfilename,
+					strerror(e));
+			return RET_ERRNO(e);
+		}
+	}
+	return RET_OK;
+}
+
+static retvalue finishcompressor(struct openfile *file) {
+	char buffer[1024];
+	size_t len = 0;
+	ssize_t got;
+	int status;
+	pid_t c;
+	retvalue r;
+
+	(void)close(file->pipefd);
+	file->pipefd = -1;
+	do {
+		got = read(file->resultfd, buffer + len,
+				sizeof(buffer) - 1 - len);
+		if (got < 0 && errno == EINTR)
+			continue;
+		if (got > 0)
+			len += got;
+	} while (got != 0 && !(got < 0) && len < sizeof(buffer) - 1);
+	if (got < 0) {
+		int e = errno;
+		fprintf(stderr, "Error %d reading from compressor for %s: %s\n",
+				e, file->fullfinalfilename, strerror(e));
+	}
+	(void)close(file->resultfd);
+	file->resultfd = -1;
+	do {
+		c = waitpid(file->pid, &status, 0);
+	} while (c < 0 && errno == EINTR);
+	file->pid = 0;
+	if (c < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		fprintf(stderr, "Compressing '%s' failed!\n",
+				file->fullfinalfilename);
+		return RET_ERROR;
+	}
+	buffer[len] = '\0';
+	if (len == 0 || buffer[len - 1] != '\0') {
+		fprintf(stderr,
+"Internal Error: No checksums from compressor for '%s'!\n",
+				file->fullfinalfilename);
+		return RET_ERROR_INTERNAL;
+	}
+	r = checksums_parse(&file->checksums, buffer);
+	return r;
+}
+
 retvalue release_finishfile(struct release *release, struct filetorelease *file) {
 	retvalue result, r;
 	enum indexcompression i;
@@ -1120,36 +1758,22 @@ retvalue release_finishfile(struct release *release, struct filetorelease *file)
 		}
 		file->f[ic_uncompressed].fd = -1;
 	}
-	if (file->f[ic_gzip].fd >= 0) {
-		r = finishgz(file);
-		if (RET_WAS_ERROR(r)) {
-			release_abortfile(file);
-			return r;
-		}
-		if (close(file->f[ic_gzip].fd) != 0) {
-			int e = errno;
-			file->f[ic_gzip].fd = -1;
-			release_abortfile(file);
-			return RET_ERRNO(e);
-		}
-		file->f[ic_gzip].fd = -1;
-	}
-#ifdef HAVE_LIBBZ2
-	if (file->f[ic_bzip2].fd >= 0) {
-		r = finishbz(file);
+	for (i = ic_uncompressed + 1 ; i < ic_count ; i++) {
+		if (file->f[i].pid > 0) {
+			r = writetocompressor(&file->f[i],
+					file->buffer, file->waiting_bytes);
+			if (!RET_WAS_ERROR(r))
+				r = finishcompressor(&file->f[i]);
+		} else if (file->f[i].fd >= 0)
+			r = finishcompression(file, i,
+					file->buffer, file->waiting_bytes);
+		else
+			continue;
 		if (RET_WAS_ERROR(r)) {
 			release_abortfile(file);
 			return r;
 		}
-		if (close(file->f[ic_bzip2].fd) != 0) {
-			int e = errno;
-			file->f[ic_bzip2].fd = -1;
-			release_abortfile(file);
-			return RET_ERRNO(e);
-		}
-		file->f[ic_bzip2].fd = -1;
 	}
-#endif
 	release->new = true;
 	result = RET_OK;
 
@@ -1165,6 +1789,12 @@ retvalue release_finishfile(struct release *release, struct filetorelease *file)
 	free(file->gzoutputbuffer);
 #ifdef HAVE_LIBBZ2
 	free(file->bzoutputbuffer);
+#endif
+#ifdef HAVE_LIBLZMA
+	free(file->xzoutputbuffer);
+#endif
+#ifdef HAVE_LIBZSTD
+	free(file->zstdoutputbuffer);
 #endif
 	free(file);
 	return result;
@@ -1172,28 +1802,29 @@ retvalue release_finishfile(struct release *release, struct filetorelease *file)
 
 static retvalue release_processbuffer(struct filetorelease *file) {
 	retvalue result, r;
+	enum indexcompression i;
 
 	result = RET_OK;
-	assert (file->waiting_bytes == INPUT_BUFFER_SIZE);
+	assert (file->waiting_bytes == file->buffersize);
 
 	/* always call this - even if there is no uncompressed file
 	 * to generate - so that checksums are calculated */
 	r = writetofile(&file->f[ic_uncompressed],
-			file->buffer, INPUT_BUFFER_SIZE);
+			file->buffer, file->buffersize);
 	RET_UPDATE(result, r);
 
-	if (file->f[ic_gzip].relativefilename != NULL) {
-		r = writegz(file);
-		RET_UPDATE(result, r);
-	}
-	RET_UPDATE(file->state, result);
-#ifdef HAVE_LIBBZ2
-	if (file->f[ic_bzip2].relativefilename != NULL) {
-		r = writebz(file);
+	for (i = ic_uncompressed + 1 ; i < ic_count ; i++) {
+		if (file->f[i].relativefilename == NULL)
+			continue;
+		if (file->f[i].pid > 0)
+			r = writetocompressor(&file->f[i],
+					file->buffer, file->buffersize);
+		else
+			r = compressdata(file, i,
+					file->buffer, file->buffersize);
 		RET_UPDATE(result, r);
 	}
 	RET_UPDATE(file->state, result);
-#endif
 	return result;
 }
 
@@ -1203,11 +1834,11 @@ retvalue release_writedata(struct filetorelease *file, const char *data, size_t
 
 	result = RET_OK;
 	/* move stuff into buffer, so stuff is not processed byte by byte */
-	free_bytes = INPUT_BUFFER_SIZE - file->waiting_bytes;
+	free_bytes = file->buffersize - file->waiting_bytes;
 	if (len < free_bytes) {
 		memcpy(file->buffer + file->waiting_bytes, data, len);
 		file->waiting_bytes += len;
-		assert (file->waiting_bytes < INPUT_BUFFER_SIZE);
+		assert (file->waiting_bytes < file->buffersize);
 		return RET_OK;
 	}
 	memcpy(file->buffer + file->waiting_bytes, data, free_bytes);
@@ -1216,18 +1847,18 @@ retvalue release_writedata(struct filetorelease *file, const char *data, size_t
 	file->waiting_bytes += free_bytes;
 	r = release_processbuffer(file);
 	RET_UPDATE(result, r);
-	while (len >= INPUT_BUFFER_SIZE) {
+	while (len >= file->buffersize) {
 		/* should not hopefully not happen, as all this copying
 		 * is quite slow... */
-		memcpy(file->buffer, data, INPUT_BUFFER_SIZE);
-		len -= INPUT_BUFFER_SIZE;
-		data += INPUT_BUFFER_SIZE;
+		memcpy(file->buffer, data, file->buffersize);
+		len -= file->buffersize;
+		data += file->buffersize;
 		r = release_processbuffer(file);
 		RET_UPDATE(result, r);
 	}
 	memcpy(file->buffer, data, len);
 	file->waiting_bytes = len;
-	assert (file->waiting_bytes < INPUT_BUFFER_SIZE);
+	assert (file->waiting_bytes < file->buffersize);
 	return result;
 }
 
@@ -1322,7 +1953,7 @@ retvalue release_prepare(struct release *release, struct distribution *distribut
 	enum checksumtype cs;
 	int i;
 	static const char * const release_checksum_headers[cs_hashCOUNT] =
-		{ "MD5Sum:\n", "SHA1:\n", "SHA256:\n" };
+		{ "MD5Sum:\n", "SHA1:\n", "SHA256:\n", "SHA512:\n" };
 
 	// TODO: check for existance of Release file here first?
 	if (onlyifneeded && !release->new) {
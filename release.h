@@ -18,6 +18,12 @@ struct release;
 enum indexcompression {ic_uncompressed=0, ic_gzip,
 #ifdef HAVE_LIBBZ2
 			ic_bzip2,
+#endif
+#ifdef HAVE_LIBLZMA
+			ic_xz,
+#endif
+#ifdef HAVE_LIBZSTD
+			ic_zstd,
 #endif
 			ic_count /* fake item to get count */
 };
@@ -58,6 +64,11 @@ struct distribution;
 struct target;
 retvalue release_directorydescription(struct release *, const struct distribution *, const struct target *, const char * /*filename*/, bool /*onlyifneeded*/);
 
+/* for exporting in worker processes: */
+void release_detachentries(struct release *);
+retvalue release_sendentries(struct release *, int /*fd*/);
+retvalue release_receiveentries(struct release *, const char *, size_t);
+
 void release_free(/*@only@*/struct release *);
 retvalue release_prepare(struct release *, struct distribution *, bool /*onlyneeded*/);
 retvalue release_finish(/*@only@*/struct release *, struct distribution *);
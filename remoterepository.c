@@ -66,6 +66,8 @@ struct remote_repository {
 	const char *method;
 	const char *fallback;
 	const struct strlist *config;
+	/* number of method processes to download with */
+	unsigned int workers;
 
 	struct aptmethod *download;
 
@@ -133,6 +135,11 @@ struct remote_index {
 	/* the compression to be tried currently */
 	enum compression compression;
 
+	/* the compressed file read directly (with --stream-lists),
+	 * NULL if the uncompressed file is to be read */
+	char *streamfilename;
+	enum compression streamcompression;
+
 	/* the old uncompressed file, so that it is only deleted
 	 * when needed, to avoid losing it for a patch run */
 	/*@dependant@*/struct cachedlistfile *olduncompressed;
@@ -140,13 +147,22 @@ struct remote_index {
 
 	/* if using pdiffs, the content of the Packages.diff/Index: */
 	struct diffindex *diffindex;
-	/* the last patch queued to be applied */
-	char *patchfilename;
-	/*@dependant@*/const struct diffindex_patch *selectedpatch;
-	bool deletecompressedpatch;
+	/* the patches to get from the old to the current file,
+	 * they are combined and applied at once when all are loaded */
+	struct pendingpatch {
+		struct remote_index *ri;
+		/*@dependant@*/const struct diffindex_patch *patch;
+		char *filename;
+		/*@null@*/struct rred_patch *rred;
+		bool deletecompressed;
+	} *pendingpatches;
+	int pendingcount, loadedcount;
+	/* one of the patches failed, ignore the others */
+	bool difffailed;
 
 	bool queued;
 	bool needed;
+	bool needuncompressed;
 	bool got;
 };
 
@@ -162,11 +178,26 @@ struct cachedlistfile {
 };
 
 
+static void pendingpatches_free(struct remote_index *ri) {
+	int i;
+
+	for (i = 0 ; i < ri->pendingcount ; i++) {
+		free(ri->pendingpatches[i].filename);
+		if (ri->pendingpatches[i].rred != NULL)
+			patch_free(ri->pendingpatches[i].rred);
+	}
+	free(ri->pendingpatches);
+	ri->pendingpatches = NULL;
+	ri->pendingcount = 0;
+	ri->loadedcount = 0;
+}
+
 static void remote_index_free(/*@only@*/struct remote_index *i) {
 	if (i == NULL)
 		return;
 	free(i->cachefilename);
-	free(i->patchfilename);
+	free(i->streamfilename);
+	pendingpatches_free(i);
 	free(i->filename_in_release);
 	diffindex_free(i->diffindex);
 	checksums_free(i->oldchecksums);
@@ -359,7 +390,7 @@ static retvalue cachedlistfile_delete(struct cachedlistfile *old) {
 	return RET_OK;
 }
 
-struct remote_repository *remote_repository_prepare(const char *name, const char *method, const char *fallback, const struct strlist *config) {
+struct remote_repository *remote_repository_prepare(const char *name, const char *method, const char *fallback, const struct strlist *config, unsigned int workers) {
 	struct remote_repository *n;
 
 	/* calling code ensures no two with the same name are created,
@@ -372,6 +403,7 @@ struct remote_repository *remote_repository_prepare(const char *name, const char
 	n->method = method;
 	n->fallback = fallback;
 	n->config = config;
+	n->workers = workers;
 
 	n->next = repositories;
 	if (n->next != NULL)
@@ -465,6 +497,20 @@ char *genlistsfilename(const char *type, unsigned int count, ...) {
 	return result;
 }
 
+/* is name type with the suffix of some compression? */
+static bool compressedname(const char *type, const char *name) {
+	size_t l = strlen(type);
+	enum compression c;
+
+	if (strncmp(type, name, l) != 0)
+		return false;
+	for (c = c_none + 1 ; c < c_COUNT ; c++) {
+		if (strcmp(name + l, uncompression_suffix[c]) == 0)
+			return true;
+	}
+	return false;
+}
+
 void cachedlistfile_need(struct cachedlistfile *list, const char *type, unsigned int count, ...) {
 	struct cachedlistfile *file;
 	const char *fields[count];
@@ -488,7 +534,9 @@ void cachedlistfile_need(struct cachedlistfile *list, const char *type, unsigned
 			i++;
 		if (i < count)
 			continue;
-		if (strcmp(type, file->parts[i]) != 0)
+		if (strcmp(type, file->parts[i]) != 0 &&
+				!(global.streamlists &&
+				  compressedname(type, file->parts[i])))
 			continue;
 		file->needed = true;
 	}
@@ -697,7 +745,7 @@ retvalue remote_startup(struct aptmethodrun *run) {
 
 		r = aptmethod_newmethod(run,
 				rr->method, rr->fallback,
-				rr->config, &rr->download);
+				rr->config, rr->workers, &rr->download);
 		if (RET_WAS_ERROR(r))
 			return r;
 	}
@@ -1105,6 +1153,33 @@ static inline retvalue remove_old_uncompressed(struct remote_index *ri) {
 		return RET_NOTHING;
 }
 
+static retvalue indexfile_mark_got(struct remote_distribution *, struct remote_index *, /*@null@*/const struct checksums *);
+
+/* with --stream-lists compressed index files are not unpacked
+ * but read directly, unless a uncompressed file is needed */
+static inline bool streamable(const struct remote_index *ri) {
+	return global.streamlists && !ri->needuncompressed;
+}
+
+static retvalue indexfile_keepcompressed(struct remote_distribution *rd, struct remote_index *ri, enum compression c, const char *filename) {
+	char *n;
+	retvalue r;
+
+	assert (c != c_none);
+
+	n = strdup(filename);
+	if (FAILEDTOALLOC(n))
+		return RET_ERROR_OOM;
+	free(ri->streamfilename);
+	ri->streamfilename = n;
+	ri->streamcompression = c;
+	r = remove_old_uncompressed(ri);
+	if (RET_WAS_ERROR(r))
+		return r;
+	/* the uncompressed checksums are checked when reading it */
+	return indexfile_mark_got(rd, ri, NULL);
+}
+
 static retvalue queue_next_encoding(struct remote_distribution *rd, struct remote_index *ri);
 
 static inline retvalue queueindex(struct remote_distribution *rd, struct remote_index *ri, bool nodownload, /*@null@*/struct cachedlistfile *oldfiles) {
@@ -1115,6 +1190,18 @@ static inline retvalue queueindex(struct remote_distribution *rd, struct remote_
 	if (rd->ignorerelease) {
 		ri->queued = true;
 		if (nodownload) {
+			if (streamable(ri)) {
+				/* use what is there, there is nothing
+				 * to check it against anyway */
+				remote_index_oldfiles(ri, oldfiles, old);
+				for (c = c_none + 1 ; old[c_none] == NULL &&
+						c < c_COUNT ; c++) {
+					if (old[c] != NULL)
+						return indexfile_keepcompressed(
+							rd, ri, c,
+							old[c]->fullfilename);
+				}
+			}
 			ri->got = true;
 			return RET_OK;
 		}
@@ -1183,6 +1270,12 @@ static inline retvalue queueindex(struct remote_distribution *rd, struct remote_
 				r = RET_NOTHING;
 			if (RET_WAS_ERROR(r))
 				return r;
+			if (RET_IS_OK(r) && streamable(ri)) {
+				/* already there, nothing to do to get it... */
+				ri->queued = true;
+				return indexfile_keepcompressed(rd, ri, c,
+						old[c]->fullfilename);
+			}
 			if (RET_IS_OK(r)) {
 				r = remove_old_uncompressed(ri);
 				if (RET_WAS_ERROR(r))
@@ -1469,8 +1562,25 @@ void cachedlistfile_need_flat_index(struct cachedlistfile *list, const char *rep
 
 const char *remote_index_file(const struct remote_index *ri) {
 	assert (ri->needed && ri->queued && ri->got);
+	if (ri->streamfilename != NULL)
+		return ri->streamfilename;
 	return ri->cachefilename;
 }
+enum compression remote_index_compression(const struct remote_index *ri) {
+	assert (ri->needed && ri->queued && ri->got);
+	if (ri->streamfilename != NULL)
+		return ri->streamcompression;
+	return c_none;
+}
+const struct checksums *remote_index_checksums(const struct remote_index *ri) {
+	assert (ri->needed && ri->queued && ri->got);
+	/* uncompressed files are already checked when unpacking */
+	if (ri->streamfilename == NULL)
+		return NULL;
+	if (ri->from->ignorerelease || ri->ofs[c_none] < 0)
+		return NULL;
+	return ri->from->remotefiles.checksums[ri->ofs[c_none]];
+}
 const char *remote_index_basefile(const struct remote_index *ri) {
 	assert (ri->needed && ri->queued);
 	return ri->cachebasename;
@@ -1486,8 +1596,10 @@ void remote_index_markdone(const struct remote_index *ri, struct markdonefile *d
 	markdone_index(done, ri->cachebasename,
 			ri->from->remotefiles.checksums[ri->ofs[c_none]]);
 }
-void remote_index_needed(struct remote_index *ri) {
+void remote_index_needed(struct remote_index *ri, bool uncompressed) {
 	ri->needed = true;
+	if (uncompressed)
+		ri->needuncompressed = true;
 }
 
 static retvalue indexfile_mark_got(struct remote_distribution *rd, struct remote_index *ri, /*@null@*/const struct checksums *gotchecksums) {
@@ -1680,6 +1792,13 @@ static retvalue index_callback(enum queue_action action, void *privdata, UNUSED(
 		if (RET_WAS_ERROR(r))
 			return r;
 		return RET_OK;
+	} else if (streamable(ri)) {
+		checksums_free(readchecksums);
+		r = copytoplace(gotfilename, wantedfilename, methodname, NULL);
+		if (RET_WAS_ERROR(r))
+			return r;
+		return indexfile_keepcompressed(rd, ri, ri->compression,
+				wantedfilename);
 	} else {
 		checksums_free(readchecksums);
 		r = remove_old_uncompressed(ri);
@@ -1696,16 +1815,33 @@ static retvalue index_callback(enum queue_action action, void *privdata, UNUSED(
 
 static queue_callback diff_got_callback;
 
+static inline char *patchfilename(const struct remote_index *ri, const struct diffindex_patch *p) {
+	char *filename, *c;
+
+	filename = mprintf("%s.diff-%s", ri->cachefilename, p->name);
+	if (FAILEDTOALLOC(filename))
+		return NULL;
+	c = filename + strlen(ri->cachefilename);
+	while (*c != '\0') {
+		if ((*c < '0' || *c > '9')
+				&& (*c < 'A' || *c > 'Z')
+				&& (*c < 'a' || *c > 'z')
+				&& *c != '.' && *c != '-')
+			*c = '_';
+		c++;
+	}
+	return filename;
+}
+
 static retvalue queue_next_diff(struct remote_index *ri) {
 	struct remote_distribution *rd = ri->from;
 	struct remote_repository *rr = rd->repository;
-	int i;
+	int i, j, count;
 	retvalue r;
 
 	for (i = 0 ; i < ri->diffindex->patchcount ; i++) {
 		bool improves;
-		struct diffindex_patch *p = &ri->diffindex->patches[i];
-		char *patchsuffix, *c;
+		const struct diffindex_patch *p = &ri->diffindex->patches[i];
 
 		if (p->done || p->frompackages == NULL)
 			continue;
@@ -1716,80 +1852,90 @@ static retvalue queue_next_diff(struct remote_index *ri) {
 		/* p->frompackages should only have sha1 and oldchecksums
 		 * should definitly list a sha1 hash */
 		assert (!improves);
+		break;
+	}
+	if (i >= ri->diffindex->patchcount) {
+		/* no patch matches, try next possibility... */
+		fprintf(stderr,
+"Error: available '%s' not listed in '%s.diffindex'.\n",
+				ri->cachefilename, ri->cachefilename);
+		return queue_next_encoding(rd, ri);
+	}
+	/* with merged patches this one results in the current file,
+	 * otherwise all patches listed after it are needed, too,
+	 * so get all of them at once */
+	if (ri->diffindex->merged)
+		count = 1;
+	else
+		count = ri->diffindex->patchcount - i;
+	pendingpatches_free(ri);
+	ri->pendingpatches = nzNEW(count, struct pendingpatch);
+	if (FAILEDTOALLOC(ri->pendingpatches))
+		return RET_ERROR_OOM;
+	ri->pendingcount = count;
+	ri->loadedcount = 0;
+	ri->difffailed = false;
+	for (j = 0 ; j < count ; j++) {
+		struct diffindex_patch *p = &ri->diffindex->patches[i + j];
+		struct pendingpatch *pp = &ri->pendingpatches[j];
+		char *patchsuffix;
 
 		p->done = true;
-
-		free(ri->patchfilename);
-		ri->patchfilename = mprintf("%s.diff-%s", ri->cachefilename,
-				p->name);
-		if (FAILEDTOALLOC(ri->patchfilename))
+		pp->ri = ri;
+		pp->patch = p;
+		pp->filename = patchfilename(ri, p);
+		if (FAILEDTOALLOC(pp->filename))
 			return RET_ERROR_OOM;
-		c = ri->patchfilename + strlen(ri->cachefilename);
-		while (*c != '\0') {
-			if ((*c < '0' || *c > '9')
-					&& (*c < 'A' || *c > 'Z')
-					&& (*c < 'a' || *c > 'z')
-					&& *c != '.' && *c != '-')
-				*c = '_';
-			c++;
-		}
-		ri->selectedpatch = p;
 		patchsuffix = mprintf(".diff/%s.gz", p->name);
 		if (FAILEDTOALLOC(patchsuffix))
 			return RET_ERROR_OOM;
-
-		/* found a matching patch, tell the downloader we want it */
 		r = aptmethod_enqueueindex(rr->download, rd->suite_base_dir,
 				ri->filename_in_release,
 				patchsuffix,
-				ri->patchfilename, ".gz",
-				diff_got_callback, ri, p);
+				pp->filename, ".gz",
+				diff_got_callback, ri, pp);
 		free(patchsuffix);
-		return r;
+		if (RET_WAS_ERROR(r))
+			return r;
 	}
-	/* no patch matches, try next possibility... */
-	fprintf(stderr, "Error: available '%s' not listed in '%s.diffindex'.\n",
-			ri->cachefilename, ri->cachefilename);
-	return queue_next_encoding(rd, ri);
+	return RET_OK;
 }
 
-static retvalue diff_uncompressed(void *privdata, const char *compressed, bool failed) {
-	struct remote_index *ri = privdata;
+/* a patch of the chain cannot be used, so ignore the others still coming
+ * and try the next way requested to get the index file */
+static retvalue diff_fallback(struct remote_index *ri, retvalue r) {
+	ri->difffailed = true;
+	if (r == RET_ERROR_OOM || r == RET_ERROR_INTERRUPTED)
+		return r;
+	return queue_next_encoding(ri->from, ri);
+}
+
+/* all patches are loaded, combine them and apply them in one go */
+static retvalue apply_pendingpatches(struct remote_index *ri) {
 	struct remote_distribution *rd = ri->from;
-	const struct diffindex_patch *p = ri->selectedpatch;
+	struct modification *m;
 	char *tempfilename;
-	struct rred_patch *rp;
 	FILE *f;
 	int i;
 	retvalue r;
 	bool dummy;
 
-	if (ri->deletecompressedpatch)
-		(void)unlink(compressed);
-	if (failed)
-		return RET_ERROR;
+	assert (ri->loadedcount == ri->pendingcount && ri->pendingcount > 0);
 
-	r = checksums_test(ri->patchfilename, p->checksums, NULL);
-	if (r == RET_NOTHING) {
-		fprintf(stderr, "Mysteriously vanished file '%s'!\n",
-				ri->patchfilename);
-		r = RET_ERROR_MISSING;
+	m = patch_getmodifications(ri->pendingpatches[0].rred);
+	for (i = 1 ; i < ri->pendingcount ; i++) {
+		r = combine_patches(&m, m, patch_getmodifications(
+					ri->pendingpatches[i].rred));
+		if (RET_WAS_ERROR(r)) {
+			pendingpatches_free(ri);
+			return diff_fallback(ri, r);
+		}
 	}
-	if (r == RET_ERROR_WRONG_MD5)
-		fprintf(stderr, "Corrupted package diff '%s'!\n",
-				ri->patchfilename);
-	if (RET_WAS_ERROR(r))
-		return r;
-
-	r = patch_load(ri->patchfilename,
-			checksums_getfilesize(p->checksums), &rp);
-	ASSERT_NOT_NOTHING(r);
-	if (RET_WAS_ERROR(r))
-		return r;
 
 	tempfilename = calc_addsuffix(ri->cachefilename, "tmp");
 	if (FAILEDTOALLOC(tempfilename)) {
-		patch_free(rp);
+		modification_freelist(m);
+		pendingpatches_free(ri);
 		return RET_ERROR_OOM;
 	}
 	(void)unlink(tempfilename);
@@ -1800,7 +1946,8 @@ static retvalue diff_uncompressed(void *privdata, const char *compressed, bool f
 				e, ri->cachefilename, tempfilename,
 				strerror(e));
 		free(tempfilename);
-		patch_free(rp);
+		modification_freelist(m);
+		pendingpatches_free(ri);
 		return RET_ERRNO(e);
 	}
 	f = fopen(ri->cachefilename, "w");
@@ -1812,21 +1959,20 @@ static retvalue diff_uncompressed(void *privdata, const char *compressed, bool f
 		ri->olduncompressed->deleted = true;
 		ri->olduncompressed = NULL;
 		free(tempfilename);
-		patch_free(rp);
+		modification_freelist(m);
+		pendingpatches_free(ri);
 		return RET_ERRNO(e);
 	}
-	r = patch_file(f, tempfilename, patch_getconstmodifications(rp));
+	r = patch_file(f, tempfilename, m);
 	(void)unlink(tempfilename);
-	(void)unlink(ri->patchfilename);
-	free(ri->patchfilename);
-	ri->patchfilename = NULL;
 	free(tempfilename);
-	patch_free(rp);
+	modification_freelist(m);
+	/* the modifications point into the loaded patches */
+	pendingpatches_free(ri);
 	if (RET_WAS_ERROR(r)) {
 		(void)fclose(f);
 		remove_old_uncompressed(ri);
-		// TODO: fall back to downloading at once?
-		return r;
+		return diff_fallback(ri, r);
 	}
 	i = ferror(f);
 	if (i != 0) {
@@ -1863,22 +2009,78 @@ static retvalue diff_uncompressed(void *privdata, const char *compressed, bool f
 		/* we have a winner */
 		return indexfile_mark_got(rd, ri, ri->oldchecksums);
 	}
-	/* let's see what patch we need next */
-	return queue_next_diff(ri);
+	fprintf(stderr,
+"Error: '%s' does not have the expected content after applying the patches from '%s.diffindex'.\n",
+			ri->cachefilename, ri->cachefilename);
+	r = remove_old_uncompressed(ri);
+	if (RET_WAS_ERROR(r))
+		return r;
+	/* try next possibility... */
+	return queue_next_encoding(rd, ri);
 }
 
-static retvalue diff_got_callback(enum queue_action action, void *privdata, UNUSED(void *privdata2), UNUSED(const char *uri), const char *gotfilename, const char *wantedfilename, UNUSED(/*@null@*/const struct checksums *gotchecksums), UNUSED(const char *methodname)) {
+static retvalue diff_uncompressed(void *privdata, const char *compressed, bool failed) {
+	struct pendingpatch *pp = privdata;
+	struct remote_index *ri = pp->ri;
+	const struct diffindex_patch *p = pp->patch;
+	retvalue r;
+
+	if (pp->deletecompressed)
+		(void)unlink(compressed);
+	if (ri->difffailed) {
+		(void)unlink(pp->filename);
+		return RET_OK;
+	}
+	if (failed)
+		return diff_fallback(ri, RET_ERROR);
+
+	r = checksums_test(pp->filename, p->checksums, NULL);
+	if (r == RET_NOTHING) {
+		fprintf(stderr, "Mysteriously vanished file '%s'!\n",
+				pp->filename);
+		r = RET_ERROR_MISSING;
+	}
+	if (r == RET_ERROR_WRONG_MD5)
+		fprintf(stderr, "Corrupted package diff '%s'!\n",
+				pp->filename);
+	if (RET_WAS_ERROR(r)) {
+		(void)unlink(pp->filename);
+		return diff_fallback(ri, r);
+	}
+
+	r = patch_load(pp->filename,
+			checksums_getfilesize(p->checksums), &pp->rred);
+	ASSERT_NOT_NOTHING(r);
+	/* the patch is mapped into memory now, so the file is no longer
+	 * needed */
+	(void)unlink(pp->filename);
+	if (RET_WAS_ERROR(r))
+		return diff_fallback(ri, r);
+	ri->loadedcount++;
+	if (ri->loadedcount < ri->pendingcount)
+		return RET_OK;
+	return apply_pendingpatches(ri);
+}
+
+static retvalue diff_got_callback(enum queue_action action, void *privdata, void *privdata2, UNUSED(const char *uri), const char *gotfilename, const char *wantedfilename, UNUSED(/*@null@*/const struct checksums *gotchecksums), UNUSED(const char *methodname)) {
 	struct remote_index *ri = privdata;
+	struct pendingpatch *pp = privdata2;
 	retvalue r;
 
+	if (ri->difffailed) {
+		/* another patch of this chain already failed */
+		if (action == qa_got && strcmp(gotfilename, wantedfilename) == 0)
+			(void)unlink(gotfilename);
+		return RET_OK;
+	}
 	if (action == qa_error)
-		return queue_next_encoding(ri->from, ri);
+		return diff_fallback(ri, RET_ERROR);
 	if (action != qa_got)
 		return RET_ERROR;
 
-	ri->deletecompressedpatch = strcmp(gotfilename, wantedfilename) == 0;
-	r = uncompress_queue_file(gotfilename, ri->patchfilename,
-			c_gzip, diff_uncompressed, ri);
+	pp->deletecompressed = strcmp(gotfilename, wantedfilename) == 0;
+	r = uncompress_queue_file(gotfilename, pp->filename,
+			c_gzip, diff_uncompressed, pp);
 	if (RET_WAS_ERROR(r))
 		(void)unlink(gotfilename);
 	return r;
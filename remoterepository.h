@@ -20,7 +20,7 @@ struct remote_distribution;
 struct remote_index;
 
 /* register repository, strings as stored by reference */
-struct remote_repository *remote_repository_prepare(const char * /*name*/, const char * /*method*/, const char * /*fallback*/, const struct strlist * /*config*/);
+struct remote_repository *remote_repository_prepare(const char * /*name*/, const char * /*method*/, const char * /*fallback*/, const struct strlist * /*config*/, unsigned int /*workers*/);
 
 /* register remote distribution of the given repository */
 retvalue remote_distribution_prepare(struct remote_repository *, const char * /*suite*/, bool /*ignorerelease*/, const char * /*verifyrelease*/, bool /*flat*/, bool * /*ignorehashes*/, /*@out@*/struct remote_distribution **);
@@ -47,13 +47,18 @@ struct encoding_preferences {
 struct remote_index *remote_index(struct remote_distribution *, const char * /*architecture*/, const char * /*component*/, packagetype_t, const struct encoding_preferences *);
 struct remote_index *remote_flat_index(struct remote_distribution *, packagetype_t, const struct encoding_preferences *);
 
-/* returns the name of the prepared uncompressed file */
+/* returns the name of the prepared file, which is uncompressed unless
+ * it is kept compressed because of --stream-lists */
 /*@observer@*/const char *remote_index_file(const struct remote_index *);
+enum compression remote_index_compression(const struct remote_index *);
+/* the checksums of the uncompressed content, if they still need checking */
+/*@null@*/const struct checksums *remote_index_checksums(const struct remote_index *);
 /*@observer@*/const char *remote_index_basefile(const struct remote_index *);
 /*@observer@*/struct aptmethod *remote_aptmethod(const struct remote_distribution *);
 
 bool remote_index_isnew(const struct remote_index *, struct donefile *);
-void remote_index_needed(struct remote_index *);
+/* uncompressed: a uncompressed file is needed (e.g. for list hooks) */
+void remote_index_needed(struct remote_index *, bool /*uncompressed*/);
 void remote_index_markdone(const struct remote_index *, struct markdonefile *);
 
 char *genlistsfilename(/*@null@*/const char * /*type*/, unsigned int /*count*/, ...) __attribute__((sentinel));
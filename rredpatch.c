@@ -26,7 +26,9 @@
 #include <malloc.h>
 #include <string.h>
 #include <assert.h>
+#include <sys/time.h>
 #include "error.h"
+#include "mprintf.h"
 #include "rredpatch.h"
 
 struct modification {
@@ -584,7 +586,114 @@ retvalue combine_patches(struct modification **result_p, /*@only@*/struct modifi
 	return RET_OK;
 }
 
+static retvalue write_range(FILE *o, const char *data, size_t len) {
+	if (len > 0 && fwrite(data, len, 1, o) != 1) {
+		int e = errno;
+		fprintf(stderr, "Error %d writing patched file: %s\n",
+				e, strerror(e));
+		return RET_ERRNO(e);
+	}
+	return RET_OK;
+}
+
+/* map the whole file into memory, returns RET_NOTHING for empty files */
+static retvalue map_source(const char *source, /*@out@*/int *fd_p, /*@out@*/const char **data_p, /*@out@*/size_t *len_p) {
+	struct stat s;
+	void *data;
+	int fd, e;
+
+	fd = open(source, O_NOCTTY|O_RDONLY);
+	if (fd < 0) {
+		e = errno;
+		fprintf(stderr, "Error %d opening %s: %s\n",
+				e, source, strerror(e));
+		return RET_ERRNO(e);
+	}
+	if (fstat(fd, &s) != 0) {
+		e = errno;
+		fprintf(stderr, "Error %d reading %s: %s\n",
+				e, source, strerror(e));
+		(void)close(fd);
+		return RET_ERRNO(e);
+	}
+	if (s.st_size == 0) {
+		*fd_p = fd;
+		*data_p = NULL;
+		*len_p = 0;
+		return RET_NOTHING;
+	}
+	data = mmap(NULL, s.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (data == MAP_FAILED) {
+		e = errno;
+		fprintf(stderr,
+"Error %d mapping '%s' into memory: %s\n", e, source, strerror(e));
+		(void)close(fd);
+		return RET_ERRNO(e);
+	}
+	(void)madvise(data, s.st_size, MADV_SEQUENTIAL);
+	*fd_p = fd;
+	*data_p = data;
+	*len_p = s.st_size;
+	return RET_OK;
+}
+
+/* Write source with the modifications applied to o.
+ * Unchanged lines are only looked at to count them (with memchr)
+ * and are written out in as large blocks as possible. */
 retvalue patch_file(FILE *o, const char *source, const struct modification *patch) {
+	const char *data, *p, *e, *nl, *unchanged;
+	size_t len;
+	int currentline, ignore, fd;
+	retvalue r;
+
+	r = map_source(source, &fd, &data, &len);
+	if (RET_WAS_ERROR(r))
+		return r;
+	assert (patch == NULL || patch->oldlinestart > 0);
+	p = data;
+	e = data + len;
+	currentline = 1;
+	r = RET_OK;
+	for (; patch != NULL ; patch = patch->next) {
+		assert (patch->oldlinestart >= currentline);
+		unchanged = p;
+		while (currentline < patch->oldlinestart) {
+			nl = (p < e)?memchr(p, '\n', e - p):NULL;
+			if (nl == NULL) {
+				fprintf(stderr,
+"Error patching '%s', file shorter than expected by patches!\n",
+					source);
+				r = RET_ERROR;
+				break;
+			}
+			p = nl + 1;
+			currentline++;
+		}
+		if (RET_WAS_ERROR(r))
+			break;
+		r = write_range(o, unchanged, p - unchanged);
+		if (RET_WAS_ERROR(r))
+			break;
+		r = write_range(o, patch->content, patch->len);
+		if (RET_WAS_ERROR(r))
+			break;
+		for (ignore = patch->oldlinecount ; ignore > 0 ; ignore--) {
+			nl = (p < e)?memchr(p, '\n', e - p):NULL;
+			p = (nl == NULL)?e:nl + 1;
+			currentline++;
+		}
+	}
+	if (!RET_WAS_ERROR(r))
+		r = write_range(o, p, e - p);
+	if (data != NULL)
+		(void)munmap((void*)data, len);
+	(void)close(fd);
+	return r;
+}
+
+/* the old character by character implementation, only kept to compare
+ * it with the new one in patch_benchmark */
+static retvalue patch_file_bychar(FILE *o, const char *source, const struct modification *patch) {
 	FILE *i;
 	int currentline, ignore, c;
 
@@ -771,3 +880,160 @@ retvalue modification_addstuff(const char *source, struct modification **patch_p
 	return RET_OK;
 }
 
+
+static double timedpatch(retvalue (*f)(FILE *, const char *, const struct modification *), const char *source, const char *destination, const struct modification *m, retvalue *r_p) {
+	struct timeval start, end;
+	FILE *o;
+	retvalue r;
+
+	gettimeofday(&start, NULL);
+	o = fopen(destination, "w");
+	if (o == NULL) {
+		int e = errno;
+		fprintf(stderr, "Error %d creating '%s': %s\n",
+				e, destination, strerror(e));
+		*r_p = RET_ERRNO(e);
+		return 0;
+	}
+	r = f(o, source, m);
+	if (ferror(o) != 0) {
+		fprintf(stderr, "Error writing to '%s'!\n", destination);
+		RET_UPDATE(r, RET_ERROR);
+	}
+	if (fclose(o) != 0) {
+		int e = errno;
+		fprintf(stderr, "Error %d writing to '%s': %s\n",
+				e, destination, strerror(e));
+		RET_UPDATE(r, RET_ERRNO(e));
+	}
+	gettimeofday(&end, NULL);
+	*r_p = r;
+	return (end.tv_sec - start.tv_sec)
+		+ (end.tv_usec - start.tv_usec) / 1000000.0;
+}
+
+static retvalue samecontent(const char *a, const char *b) {
+	const char *da, *db;
+	size_t la, lb;
+	int fa, fb;
+	retvalue r;
+
+	r = map_source(a, &fa, &da, &la);
+	if (RET_WAS_ERROR(r))
+		return r;
+	r = map_source(b, &fb, &db, &lb);
+	if (!RET_WAS_ERROR(r)) {
+		if (la != lb || (la > 0 && memcmp(da, db, la) != 0)) {
+			fprintf(stderr, "'%s' and '%s' differ!\n", a, b);
+			r = RET_ERROR;
+		} else
+			r = RET_OK;
+		if (db != NULL)
+			(void)munmap((void*)db, lb);
+		(void)close(fb);
+	}
+	if (da != NULL)
+		(void)munmap((void*)da, la);
+	(void)close(fa);
+	return r;
+}
+
+/* create a Packages like file of the given size at filename and apply a
+ * patch with the given number of hunks with both implementations */
+retvalue patch_benchmark(const char *filename, unsigned long megabytes, int hunks) {
+	static const char replacement[] =
+		"Version: 2.0-1\nDescription: patched\n";
+	struct modification *first = NULL, *last = NULL, *m;
+	unsigned long long wanted, size = 0;
+	char *oldname, *newname;
+	double oldsecs, newsecs;
+	int lines = 0, k;
+	FILE *f;
+	retvalue r;
+
+	assert (hunks > 0);
+	f = fopen(filename, "w");
+	if (f == NULL) {
+		int e = errno;
+		fprintf(stderr, "Error %d creating '%s': %s\n",
+				e, filename, strerror(e));
+		return RET_ERRNO(e);
+	}
+	wanted = ((unsigned long long)megabytes) << 20;
+	for (k = 0 ; size < wanted ; k++) {
+		int len = fprintf(f,
+"Package: package%d\n"
+"Version: 1.%d-1\n"
+"Architecture: amd64\n"
+"Maintainer: Some One <someone@example.org>\n"
+"Installed-Size: %d\n"
+"Filename: pool/main/p/package%d/package%d_1.%d-1_amd64.deb\n"
+"Size: %d\n"
+"SHA256: %064x\n"
+"Description: benchmark package number %d\n\n",
+				k, k, k % 1000, k, k, k, 1000 + k,
+				(unsigned int)k * 2654435761U, k);
+		if (len < 0)
+			break;
+		size += len;
+		lines += 10;
+	}
+	if (ferror(f) != 0 || fclose(f) != 0) {
+		int e = errno;
+		fprintf(stderr, "Error %d writing to '%s': %s\n",
+				e, filename, strerror(e));
+		(void)unlink(filename);
+		return RET_ERRNO(e);
+	}
+	/* replace the version and description of evenly spread packages */
+	if (hunks > lines / 10)
+		hunks = lines / 10;
+	for (k = 1 ; k <= hunks ; k++) {
+		int stanza = (int)(((long long)lines / 10) * k / (hunks + 1));
+
+		m = zNEW(struct modification);
+		if (FAILEDTOALLOC(m)) {
+			modification_freelist(first);
+			(void)unlink(filename);
+			return RET_ERROR_OOM;
+		}
+		m->oldlinestart = stanza * 10 + 2;
+		m->oldlinecount = 8;
+		m->newlinecount = 2;
+		m->content = replacement;
+		m->len = sizeof(replacement) - 1;
+		m->previous = last;
+		if (last == NULL)
+			first = m;
+		else
+			last->next = m;
+		last = m;
+	}
+	oldname = mprintf("%s.old", filename);
+	newname = mprintf("%s.new", filename);
+	if (FAILEDTOALLOC(oldname) || FAILEDTOALLOC(newname)) {
+		free(oldname);
+		free(newname);
+		modification_freelist(first);
+		(void)unlink(filename);
+		return RET_ERROR_OOM;
+	}
+	printf("%llu bytes, %d lines, %d hunks\n", size, lines, hunks);
+	oldsecs = timedpatch(patch_file_bychar, filename, oldname, first, &r);
+	if (!RET_WAS_ERROR(r)) {
+		newsecs = timedpatch(patch_file, filename, newname, first, &r);
+		if (!RET_WAS_ERROR(r))
+			r = samecontent(oldname, newname);
+		if (!RET_WAS_ERROR(r)) {
+			printf("character by character: %.3f s\n", oldsecs);
+			printf("block based: %.3f s\n", newsecs);
+		}
+	}
+	(void)unlink(filename);
+	(void)unlink(oldname);
+	(void)unlink(newname);
+	free(oldname);
+	free(newname);
+	modification_freelist(first);
+	return r;
+}
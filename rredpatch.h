@@ -15,5 +15,6 @@ retvalue combine_patches(/*@out@*/struct modification **, /*@only@*/struct modif
 void modification_printaspatch(void *, const struct modification *, void (const void *, size_t, void *));
 retvalue modification_addstuff(const char *source, struct modification **patch_p, /*@out@*/char **line_p);
 retvalue patch_file(FILE *, const char *, const struct modification *);
+retvalue patch_benchmark(const char *, unsigned long /*megabytes*/, int /*hunks*/);
 
 #endif
@@ -59,7 +59,9 @@ use WORDS_BIGENDIAN instead of endian.h
 #include <string.h>
 #include <assert.h>
 
+#include "globals.h"
 #include "sha1.h"
+#include "shaext.h"
 
 static void SHA1_Transform(uint32_t state[5], const uint8_t buffer[64]);
 
@@ -144,6 +146,22 @@ void SHA1Init(struct SHA1_Context *context)
 }
 
 
+/* Process all complete blocks, returns the number of bytes processed */
+static size_t SHA1_Blocks(uint32_t state[5], const uint8_t *data, size_t len)
+{
+    size_t i;
+
+    if (shaext_usable()) {
+        shaext_sha1blocks(state, data, len / 64);
+        return len & ~(size_t)63;
+    }
+    for (i = 0 ; len >= i + 64 ; i += 64) {
+        SHA1_Transform(state, data + i);
+    }
+    return i;
+}
+
+
 /* Run your data through this. */
 void SHA1Update(struct SHA1_Context *context, const uint8_t* data, const size_t len)
 {
@@ -152,16 +170,12 @@ void SHA1Update(struct SHA1_Context *context, const uint8_t* data, const size_t
     j = context->count & 63;
     context->count += len;
     if (j == 0) {
-        for (i = 0 ; len >= i + 64 ; i += 64) {
-            SHA1_Transform(context->state, data + i);
-        }
+        i = SHA1_Blocks(context->state, data, len);
         j = 0;
     } else if ((j + len) >= 64) {
         memcpy(&context->buffer[j], data, (i = 64-j));
-        SHA1_Transform(context->state, context->buffer);
-        for (; len >= i + 64 ; i += 64) {
-            SHA1_Transform(context->state, data + i);
-        }
+        SHA1_Blocks(context->state, context->buffer, 64);
+        i += SHA1_Blocks(context->state, data + i, len - i);
         j = 0;
     }
     else i = 0;
@@ -14,7 +14,9 @@
 #include <sys/param.h>
 #include <sys/types.h>
 
+#include "globals.h"
 #include "sha256.h"
+#include "shaext.h"
 
 #ifndef WORDS_BIGENDIAN
 # define SWAP(n) \
@@ -72,6 +74,12 @@ sha256_process_block (const void *buffer, size_t len, struct SHA256_Context *ctx
      number of bytes. */
   ctx->total += len;
 
+  if (shaext_usable())
+    {
+      shaext_sha256blocks(ctx->H, buffer, len / 64);
+      return;
+    }
+
   /* Process all bytes in the buffer with 64 bytes in each round of
      the loop.  */
   while (nwords > 0)
@@ -0,0 +1,191 @@
+/*  This file is part of "reprepro"
+ *  Copyright (C) 2026 agent
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+#include <config.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "globals.h"
+#include "shaext.h"
+
+#ifdef HAVE_X86_SHA_INTRINSICS
+#include <cpuid.h>
+#include <immintrin.h>
+
+/* The instructions are only used after checking with cpuid that the
+ * processor has them, so only the functions using them are compiled
+ * for those extensions. */
+#define SHAEXT __attribute__((target("sha,sse4.1,ssse3")))
+
+static int usable = -1;
+
+static bool detect(void) {
+	unsigned int eax, ebx, ecx, edx;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return false;
+	/* SSSE3 and SSE4.1 */
+	if ((ecx & (1 << 9)) == 0 || (ecx & (1 << 19)) == 0)
+		return false;
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+		return false;
+	/* SHA */
+	return (ebx & (1 << 29)) != 0;
+}
+
+bool shaext_usable(void) {
+	if (usable < 0)
+		usable = detect()?1:0;
+	return usable > 0;
+}
+
+void shaext_enable(bool enable) {
+	usable = (enable && detect())?1:0;
+}
+
+/* four rounds, the E to use is e, next gets the E for the next ones */
+#define SHA1ROUNDS(e, next, w, f) \
+	e = _mm_sha1nexte_epu32(e, w); \
+	next = abcd; \
+	abcd = _mm_sha1rnds4_epu32(abcd, e, f)
+/* the next four message words from the last 16 */
+#define SHA1SCHEDULE(w0, w1, w2, w3) \
+	w0 = _mm_sha1msg2_epu32(_mm_xor_si128(_mm_sha1msg1_epu32(w0, w1), \
+				w2), w3)
+
+SHAEXT void shaext_sha1blocks(uint32_t state[5], const uint8_t *data, size_t blocks) {
+	const __m128i mask = _mm_set_epi64x(0x0001020304050607ULL,
+			0x08090a0b0c0d0e0fULL);
+	__m128i abcd, e0, e1, m0, m1, m2, m3, abcd_save, e_save;
+
+	abcd = _mm_loadu_si128((const __m128i *)state);
+	abcd = _mm_shuffle_epi32(abcd, 0x1B);
+	e0 = _mm_set_epi32(state[4], 0, 0, 0);
+
+	while (blocks-- > 0) {
+		abcd_save = abcd;
+		e_save = e0;
+
+		m0 = _mm_shuffle_epi8(_mm_loadu_si128(
+					(const __m128i *)data), mask);
+		e0 = _mm_add_epi32(e0, m0);
+		e1 = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+		m1 = _mm_shuffle_epi8(_mm_loadu_si128(
+					(const __m128i *)(data + 16)), mask);
+		SHA1ROUNDS(e1, e0, m1, 0);
+		m2 = _mm_shuffle_epi8(_mm_loadu_si128(
+					(const __m128i *)(data + 32)), mask);
+		SHA1ROUNDS(e0, e1, m2, 0);
+		m3 = _mm_shuffle_epi8(_mm_loadu_si128(
+					(const __m128i *)(data + 48)), mask);
+		SHA1ROUNDS(e1, e0, m3, 0);
+		SHA1SCHEDULE(m0, m1, m2, m3); SHA1ROUNDS(e0, e1, m0, 0);
+		SHA1SCHEDULE(m1, m2, m3, m0); SHA1ROUNDS(e1, e0, m1, 1);
+		SHA1SCHEDULE(m2, m3, m0, m1); SHA1ROUNDS(e0, e1, m2, 1);
+		SHA1SCHEDULE(m3, m0, m1, m2); SHA1ROUNDS(e1, e0, m3, 1);
+		SHA1SCHEDULE(m0, m1, m2, m3); SHA1ROUNDS(e0, e1, m0, 1);
+		SHA1SCHEDULE(m1, m2, m3, m0); SHA1ROUNDS(e1, e0, m1, 1);
+		SHA1SCHEDULE(m2, m3, m0, m1); SHA1ROUNDS(e0, e1, m2, 2);
+		SHA1SCHEDULE(m3, m0, m1, m2); SHA1ROUNDS(e1, e0, m3, 2);
+		SHA1SCHEDULE(m0, m1, m2, m3); SHA1ROUNDS(e0, e1, m0, 2);
+		SHA1SCHEDULE(m1, m2, m3, m0); SHA1ROUNDS(e1, e0, m1, 2);
+		SHA1SCHEDULE(m2, m3, m0, m1); SHA1ROUNDS(e0, e1, m2, 2);
+		SHA1SCHEDULE(m3, m0, m1, m2); SHA1ROUNDS(e1, e0, m3, 3);
+		SHA1SCHEDULE(m0, m1, m2, m3); SHA1ROUNDS(e0, e1, m0, 3);
+		SHA1SCHEDULE(m1, m2, m3, m0); SHA1ROUNDS(e1, e0, m1, 3);
+		SHA1SCHEDULE(m2, m3, m0, m1); SHA1ROUNDS(e0, e1, m2, 3);
+		SHA1SCHEDULE(m3, m0, m1, m2); SHA1ROUNDS(e1, e0, m3, 3);
+
+		e0 = _mm_sha1nexte_epu32(e0, e_save);
+		abcd = _mm_add_epi32(abcd, abcd_save);
+		data += 64;
+	}
+	abcd = _mm_shuffle_epi32(abcd, 0x1B);
+	_mm_storeu_si128((__m128i *)state, abcd);
+	state[4] = _mm_extract_epi32(e0, 3);
+}
+
+static const uint32_t K256[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+SHAEXT void shaext_sha256blocks(uint32_t state[8], const uint8_t *data, size_t blocks) {
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+			0x0405060700010203ULL);
+	__m128i state0, state1, msg, tmp, w[4], abef_save, cdgh_save;
+	int i;
+
+	/* the instructions want the state as ABEF and CDGH */
+	tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state),
+			0xB1);
+	state1 = _mm_shuffle_epi32(_mm_loadu_si128(
+				(const __m128i *)(state + 4)), 0x1B);
+	state0 = _mm_alignr_epi8(tmp, state1, 8);
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+	while (blocks-- > 0) {
+		abef_save = state0;
+		cdgh_save = state1;
+
+		for (i = 0 ; i < 16 ; i++) {
+			if (i < 4)
+				w[i] = _mm_shuffle_epi8(_mm_loadu_si128(
+					(const __m128i *)(data + 16 * i)),
+					mask);
+			else
+				w[i & 3] = _mm_sha256msg2_epu32(
+					_mm_add_epi32(
+						_mm_sha256msg1_epu32(
+							w[i & 3],
+							w[(i + 1) & 3]),
+						_mm_alignr_epi8(
+							w[(i + 3) & 3],
+							w[(i + 2) & 3], 4)),
+					w[(i + 3) & 3]);
+			msg = _mm_add_epi32(w[i & 3], _mm_loadu_si128(
+					(const __m128i *)(K256 + 4 * i)));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			msg = _mm_shuffle_epi32(msg, 0x0E);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+		}
+
+		state0 = _mm_add_epi32(state0, abef_save);
+		state1 = _mm_add_epi32(state1, cdgh_save);
+		data += 64;
+	}
+	tmp = _mm_shuffle_epi32(state0, 0x1B);
+	state1 = _mm_shuffle_epi32(state1, 0xB1);
+	state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+	state1 = _mm_alignr_epi8(state1, tmp, 8);
+	_mm_storeu_si128((__m128i *)state, state0);
+	_mm_storeu_si128((__m128i *)(state + 4), state1);
+}
+#endif
@@ -0,0 +1,22 @@
+#ifndef REPREPRO_SHAEXT_H
+#define REPREPRO_SHAEXT_H
+
+#ifndef REPREPRO_GLOBALS_H
+#include "globals.h"
+#endif
+
+/* SHA1 and SHA256 using the SHA extensions of x86 processors,
+ * the block functions may only be called if shaext_usable() */
+
+#ifdef HAVE_X86_SHA_INTRINSICS
+bool shaext_usable(void);
+/* to compare with the generic implementation */
+void shaext_enable(bool);
+void shaext_sha1blocks(uint32_t /*state*/[5], const uint8_t *, size_t /*blocks*/);
+void shaext_sha256blocks(uint32_t /*state*/[8], const uint8_t *, size_t /*blocks*/);
+#else
+#define shaext_usable() false
+#define shaext_enable(b) do {} while (0)
+#endif
+
+#endif
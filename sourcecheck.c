@@ -70,27 +70,33 @@ static retvalue collect_source_versions(struct distribution *d, struct info_sour
 	struct info_source *root = NULL, *last = NULL;
 	struct target *t;
 	struct target_cursor target_cursor = TARGET_CURSOR_ZERO;
-	const char *name, *chunk;
+	struct target_metadata md;
+	const char *name;
 	retvalue result = RET_NOTHING, r;
 
 	for (t = d->targets ; t != NULL ; t = t->next) {
 		if (t->architecture != architecture_source)
 			continue;
-		r = target_openiterator(t, true, &target_cursor);
+		r = target_openmetadata(t, true, TMD_VERSION, &target_cursor);
 		if (RET_WAS_ERROR(r)) {
 			RET_UPDATE(result, r);
 			break;
 		}
-		while (target_nextpackage(&target_cursor, &name, &chunk)) {
+		while ((r = target_nextmetadata(&target_cursor, &name, &md))
+				!= RET_NOTHING) {
 			char *version;
 			struct info_source **into = NULL;
 			struct info_source_version *v;
 
-			r = t->getversion(chunk, &version);
 			if (!RET_IS_OK(r)) {
 				RET_UPDATE(result, r);
 				continue;
 			}
+			version = strdup(md.version);
+			if (FAILEDTOALLOC(version)) {
+				result = RET_ERROR_OOM;
+				break;
+			}
 			if (last != NULL) {
 				int c;
 				c = strcmp(name, last->name);
@@ -182,35 +188,45 @@ static retvalue collect_source_versions(struct distribution *d, struct info_sour
 	return result;
 }
 
-static retvalue process_binaries(struct distribution *d, struct info_source *sources, retvalue (*action)(struct distribution *, struct target *, const char *, const char *, const char *, const char *, void *), void *privdata) {
+static retvalue process_binaries(struct distribution *d, struct info_source *sources, retvalue (*action)(struct distribution *, struct target *, const char *, const struct target_metadata *, void *), int actionfields, void *privdata) {
 	struct target *t;
 	struct target_cursor target_cursor = TARGET_CURSOR_ZERO;
-	const char *name, *chunk;
+	struct target_metadata md;
+	const char *name;
 	retvalue result = RET_NOTHING, r;
 
 	for (t = d->targets ; t != NULL ; t = t->next) {
+		/* binaries of the same source are mostly next to each other */
+		struct info_source *last = NULL;
+
 		if (t->architecture == architecture_source)
 			continue;
-		r = target_openiterator(t, true, &target_cursor);
+		r = target_openmetadata(t, true, TMD_SOURCE|actionfields,
+				&target_cursor);
 		if (RET_WAS_ERROR(r)) {
 			RET_UPDATE(result, r);
 			break;
 		}
-		while (target_nextpackage(&target_cursor, &name, &chunk)) {
-			char *source, *version;
+		while ((r = target_nextmetadata(&target_cursor, &name, &md))
+				!= RET_NOTHING) {
+			const char *source = md.source;
+			const char *version = md.sourceversion;
 			struct info_source *s;
 			struct info_source_version *v;
 
-			r = t->getsourceandversion(chunk, name,
-					&source, &version);
 			if (!RET_IS_OK(r)) {
 				RET_UPDATE(result, r);
 				continue;
 			}
-			s = sources;
+			if (last != NULL && strcmp(last->name, source) <= 0)
+				s = last;
+			else
+				s = sources;
 			while (s != NULL && strcmp(s->name, source) < 0) {
 				s = s->next;
 			}
+			if (s != NULL)
+				last = s;
 			if (s != NULL && strcmp(source, s->name) == 0) {
 				v = &s->version;
 				while (v != NULL && strcmp(version, v->version) != 0)
@@ -220,12 +236,9 @@ static retvalue process_binaries(struct distribution *d, struct info_source *sou
 			if (v != NULL) {
 				v->used = true;
 			} else if (action != NULL) {
-				r = action(d, t,
-						name, source, version, chunk,
-						privdata);
+				r = action(d, t, name, &md, privdata);
 				RET_UPDATE(result, r);
 			}
-			free(source); free(version);
 		}
 		r = target_closeiterator(&target_cursor);
 		if (RET_WAS_ERROR(r)) {
@@ -282,7 +295,7 @@ retvalue unusedsources(struct distribution *alldistributions) {
 		if (!RET_IS_OK(r))
 			continue;
 
-		r = process_binaries(d, sources, NULL, NULL);
+		r = process_binaries(d, sources, NULL, 0, NULL);
 		RET_UPDATE(result, r);
 		for (s = sources ; s != NULL ; s = s->next) {
 			for (v = &s->version ; v != NULL ; v = v->next) {
@@ -326,16 +339,10 @@ static retvalue listsourcemissing(struct distribution *d, const struct trackedpa
 	return RET_NOTHING;
 }
 
-static retvalue listmissing(struct distribution *d, struct target *t, UNUSED(const char *name), const char *source, const char *version, const char *chunk, UNUSED(void*data)) {
-	retvalue r;
-	struct strlist list;
-
-	r = t->getfilekeys(chunk, &list);
-	if (!RET_IS_OK(r))
-		return r;
-	assert (list.count == 1);
-	printf("%s %s %s %s\n", d->codename, source, version, list.values[0]);
-	strlist_done(&list);
+static retvalue listmissing(struct distribution *d, UNUSED(struct target *t), UNUSED(const char *name), const struct target_metadata *md, UNUSED(void*data)) {
+	assert (md->filekeys->count == 1);
+	printf("%s %s %s %s\n", d->codename, md->source, md->sourceversion,
+			md->filekeys->values[0]);
 	return RET_OK;
 }
 
@@ -365,7 +372,8 @@ retvalue sourcemissing(struct distribution *alldistributions) {
 			if (!RET_IS_OK(r))
 				continue;
 
-			r = process_binaries(d, sources, listmissing, NULL);
+			r = process_binaries(d, sources, listmissing,
+					TMD_FILEKEYS, NULL);
 			RET_UPDATE(result, r);
 			free_source_info(sources);
 		}
@@ -400,8 +408,9 @@ static retvalue listcruft(struct distribution *d, const struct trackedpackage *p
 	return RET_NOTHING;
 }
 
-static retvalue listmissingonce(struct distribution *d, UNUSED(struct target *t), UNUSED(const char *name), const char *source, const char *version, UNUSED(const char *chunk), void *data) {
+static retvalue listmissingonce(struct distribution *d, UNUSED(struct target *t), UNUSED(const char *name), const struct target_metadata *md, void *data) {
 	struct info_source **already = data;
+	const char *source = md->source, *version = md->sourceversion;
 	struct info_source *s;
 
 	for (s = *already ; s != NULL ; s = s->next) {
@@ -460,7 +469,7 @@ retvalue reportcruft(struct distribution *alldistributions) {
 			continue;
 
 		r = process_binaries( d, sources,
-				listmissingonce, &list);
+				listmissingonce, 0, &list);
 		RET_UPDATE(result, r);
 		for (s = sources ; s != NULL ; s = s->next) {
 			for (v = &s->version ; v != NULL ; v = v->next) {
@@ -562,7 +562,7 @@ retvalue sources_complete(const struct dsc_headers *dsc, const char *directory,
 	struct fieldtoadd *name;
 	struct fieldtoadd *replace;
 	char *newchunk, *newchunk2;
-	char *newfilelines, *newsha1lines, *newsha256lines;
+	char *newfilelines, *newsha1lines, *newsha256lines, *newsha512lines;
 
 	assert(section != NULL && priority != NULL);
 
@@ -579,13 +579,17 @@ retvalue sources_complete(const struct dsc_headers *dsc, const char *directory,
 		return RET_ERROR_OOM;
 
 	r = checksumsarray_genfilelist(&dsc->files,
-			&newfilelines, &newsha1lines, &newsha256lines);
+			&newfilelines, &newsha1lines, &newsha256lines,
+			&newsha512lines);
 	if (RET_WAS_ERROR(r)) {
 		free(newchunk2);
 		return r;
 	}
 	assert (newfilelines != NULL);
-	replace = aodfield_new("Checksums-Sha256", newsha256lines, NULL);
+	replace = aodfield_new("Checksums-Sha512", newsha512lines, NULL);
+	if (!FAILEDTOALLOC(replace))
+		replace = aodfield_new("Checksums-Sha256", newsha256lines,
+				replace);
 	if (!FAILEDTOALLOC(replace))
 		replace = aodfield_new("Checksums-Sha1", newsha1lines, replace);
 	if (!FAILEDTOALLOC(replace))
@@ -601,6 +605,7 @@ retvalue sources_complete(const struct dsc_headers *dsc, const char *directory,
 	if (!FAILEDTOALLOC(replace))
 		replace = override_addreplacefields(override, replace);
 	if (FAILEDTOALLOC(replace)) {
+		free(newsha512lines);
 		free(newsha256lines);
 		free(newsha1lines);
 		free(newfilelines);
@@ -609,6 +614,7 @@ retvalue sources_complete(const struct dsc_headers *dsc, const char *directory,
 	}
 
 	newchunk  = chunk_replacefields(newchunk2, replace, "Files", false);
+	free(newsha512lines);
 	free(newsha256lines);
 	free(newsha1lines);
 	free(newfilelines);
@@ -627,7 +633,7 @@ retvalue sources_complete(const struct dsc_headers *dsc, const char *directory,
 retvalue sources_complete_checksums(const char *chunk, const struct strlist *filekeys, struct checksums **c, char **out) {
 	struct fieldtoadd *replace;
 	char *newchunk;
-	char *newfilelines, *newsha1lines, *newsha256lines;
+	char *newfilelines, *newsha1lines, *newsha256lines, *newsha512lines;
 	struct checksumsarray checksums;
 	retvalue r;
 	int i;
@@ -644,23 +650,29 @@ retvalue sources_complete_checksums(const char *chunk, const struct strlist *fil
 	}
 
 	r = checksumsarray_genfilelist(&checksums,
-			&newfilelines, &newsha1lines, &newsha256lines);
+			&newfilelines, &newsha1lines, &newsha256lines,
+			&newsha512lines);
 	free(checksums.names.values);
 	if (RET_WAS_ERROR(r))
 		return r;
 	assert (newfilelines != NULL);
-	replace = aodfield_new("Checksums-Sha256", newsha256lines, NULL);
+	replace = aodfield_new("Checksums-Sha512", newsha512lines, NULL);
+	if (!FAILEDTOALLOC(replace))
+		replace = aodfield_new("Checksums-Sha256", newsha256lines,
+				replace);
 	if (!FAILEDTOALLOC(replace))
 		replace = aodfield_new("Checksums-Sha1", newsha1lines, replace);
 	if (!FAILEDTOALLOC(replace))
 		replace = addfield_new("Files", newfilelines, replace);
 	if (FAILEDTOALLOC(replace)) {
+		free(newsha512lines);
 		free(newsha256lines);
 		free(newsha1lines);
 		free(newfilelines);
 		return RET_ERROR_OOM;
 	}
 	newchunk = chunk_replacefields(chunk, replace, "Files", false);
+	free(newsha512lines);
 	free(newsha256lines);
 	free(newsha1lines);
 	free(newfilelines);
@@ -41,6 +41,7 @@
 #include "tracking.h"
 #include "log.h"
 #include "files.h"
+#include "contents.h"
 #include "target.h"
 
 static char *calc_identifier(const char *codename, component_t component, architecture_t architecture, packagetype_t packagetype) {
@@ -175,6 +176,7 @@ retvalue target_free(struct target *target) {
 				target->identifier);
 	}
 
+	contents_freechanges(target);
 	target->distribution = NULL;
 	free(target->identifier);
 	free(target->relativedirectory);
@@ -182,6 +184,437 @@ retvalue target_free(struct target *target) {
 	return result;
 }
 
+/* The metadata table of a target (in metadata.db) maps every package name
+ * to "version\0source\0sourceversion\0architecture\0" followed by all its
+ * filekeys (each 0-terminated), architecture being the Architecture field
+ * for source packages (empty if there is none, " " if it is empty).
+ * The empty key (containing the format) marks the table as up to date.
+ * It is removed before the first change in a run and only added again
+ * when the packages database is closed, so a table not kept in sync
+ * (because of errors, interruptions or not running with --metadata-cache)
+ * is regenerated the next time the target is opened for writing with
+ * --metadata-cache. */
+
+static const char metadatakey[] = "";
+static const char metadataformat[] = "2";
+
+#define TMD_ALL (TMD_VERSION|TMD_SOURCE|TMD_ARCHITECTURE|TMD_FILEKEYS)
+
+static void freeparsedmetadata(struct target_cursor *tc) {
+	free(tc->version);
+	tc->version = NULL;
+	free(tc->source);
+	tc->source = NULL;
+	free(tc->sourceversion);
+	tc->sourceversion = NULL;
+	free(tc->architectures);
+	tc->architectures = NULL;
+	strlist_done(&tc->filekeys);
+	strlist_init(&tc->filekeys);
+}
+
+void target_metadatadone(struct target_cursor *tc) {
+	if (tc->inmetadata) {
+		/* only the array is ours, the values are in the database */
+		free(tc->filekeys.values);
+		strlist_init(&tc->filekeys);
+	} else
+		freeparsedmetadata(tc);
+}
+
+static retvalue parsemetadata(struct target_cursor *tc, const char *name, const char *control, /*@out@*/struct target_metadata *md) {
+	struct target *target = tc->target;
+	retvalue r;
+
+	freeparsedmetadata(tc);
+	memset(md, 0, sizeof(struct target_metadata));
+	if (ISSET(tc->fields, TMD_VERSION)) {
+		r = target->getversion(control, &tc->version);
+		if (!RET_IS_OK(r)) {
+			tc->version = NULL;
+			return (r == RET_NOTHING)?RET_ERROR:r;
+		}
+		md->version = tc->version;
+	}
+	if (ISSET(tc->fields, TMD_SOURCE)) {
+		r = target->getsourceandversion(control, name,
+				&tc->source, &tc->sourceversion);
+		if (!RET_IS_OK(r)) {
+			tc->source = NULL;
+			tc->sourceversion = NULL;
+			return (r == RET_NOTHING)?RET_ERROR:r;
+		}
+		md->source = tc->source;
+		md->sourceversion = tc->sourceversion;
+	}
+	if (ISSET(tc->fields, TMD_ARCHITECTURE)) {
+		if (target->packagetype == pt_dsc) {
+			md->architecture = architecture_source;
+			r = chunk_getvalue(control, "Architecture",
+					&tc->architectures);
+			if (!RET_IS_OK(r))
+				tc->architectures = NULL;
+			if (RET_WAS_ERROR(r))
+				return r;
+			md->architectures = tc->architectures;
+		} else {
+			r = target->getarchitecture(control,
+					&md->architecture);
+			if (!RET_IS_OK(r))
+				return (r == RET_NOTHING)?RET_ERROR:r;
+		}
+	}
+	if (ISSET(tc->fields, TMD_FILEKEYS)) {
+		r = target->getfilekeys(control, &tc->filekeys);
+		if (!RET_IS_OK(r)) {
+			strlist_init(&tc->filekeys);
+			return (r == RET_NOTHING)?RET_ERROR:r;
+		}
+		md->filekeys = &tc->filekeys;
+	}
+	return RET_OK;
+}
+
+static retvalue decodemetadata(struct target_cursor *tc, const char *name, const char *data, size_t len, /*@out@*/struct target_metadata *md) {
+	const struct target *target = tc->target;
+	const char *end = data + len + 1, *p = data, *parts[4];
+	int i;
+
+	for (i = 0 ; i < 4 ; i++) {
+		if (p >= end) {
+			fprintf(stderr,
+"Corrupted entry for '%s' in the metadata of '%s'!\n",
+					name, target->identifier);
+			return RET_ERROR;
+		}
+		parts[i] = p;
+		p += strlen(p) + 1;
+	}
+	md->version = parts[0];
+	md->source = parts[1];
+	md->sourceversion = parts[2];
+	if (target->packagetype == pt_dsc) {
+		md->architecture = architecture_source;
+		md->architectures = (parts[3][0] == '\0')?NULL:parts[3];
+	} else {
+		md->architectures = NULL;
+		md->architecture = architecture_find(parts[3]);
+		if (ISSET(tc->fields, TMD_ARCHITECTURE) &&
+				!atom_defined(md->architecture)) {
+			fprintf(stderr,
+"Unexpected architecture '%s' of '%s' in '%s'!\n",
+					parts[3], name, target->identifier);
+			return RET_ERROR;
+		}
+	}
+	md->filekeys = NULL;
+	if (!ISSET(tc->fields, TMD_FILEKEYS))
+		return RET_OK;
+	tc->filekeys.count = 0;
+	while (p < end) {
+		if (tc->filekeys.count >= tc->filekeys.size) {
+			int newsize = tc->filekeys.size + 8;
+			char **n = realloc(tc->filekeys.values,
+					newsize * sizeof(char *));
+			if (FAILEDTOALLOC(n))
+				return RET_ERROR_OOM;
+			tc->filekeys.values = n;
+			tc->filekeys.size = newsize;
+		}
+		/* not modified, only the strlist has no const */
+		tc->filekeys.values[tc->filekeys.count++] = (char *)p;
+		p += strlen(p) + 1;
+	}
+	md->filekeys = &tc->filekeys;
+	return RET_OK;
+}
+
+static retvalue encodemetadata(const struct target *target, const struct target_metadata *md, /*@out@*/char **data_p, /*@out@*/size_t *len_p) {
+	const char *architecture;
+	size_t len, l;
+	char *data, *p;
+	int i;
+
+	if (target->packagetype == pt_dsc) {
+		/* an empty field builds for nothing, a missing for all */
+		if (md->architectures == NULL)
+			architecture = "";
+		else if (md->architectures[0] == '\0')
+			architecture = " ";
+		else
+			architecture = md->architectures;
+	} else
+		architecture = atoms_architectures[md->architecture];
+	len = strlen(md->version) + strlen(md->source)
+		+ strlen(md->sourceversion) + strlen(architecture) + 4;
+	for (i = 0 ; i < md->filekeys->count ; i++)
+		len += strlen(md->filekeys->values[i]) + 1;
+	data = malloc(len);
+	if (FAILEDTOALLOC(data))
+		return RET_ERROR_OOM;
+	p = data;
+#define ADD(s) l = strlen(s) + 1; memcpy(p, s, l); p += l;
+	ADD(md->version);
+	ADD(md->source);
+	ADD(md->sourceversion);
+	ADD(architecture);
+	for (i = 0 ; i < md->filekeys->count ; i++) {
+		ADD(md->filekeys->values[i]);
+	}
+#undef ADD
+	assert (p == data + len);
+	*data_p = data;
+	*len_p = len;
+	return RET_OK;
+}
+
+static retvalue putmetadata(struct target *target, struct table *table, const char *name, const char *control) {
+	struct target_cursor tc = TARGET_CURSOR_ZERO;
+	struct target_metadata md;
+	char *data;
+	size_t len;
+	retvalue r;
+
+	tc.target = target;
+	tc.fields = TMD_ALL;
+	r = parsemetadata(&tc, name, control, &md);
+	if (!RET_IS_OK(r)) {
+		freeparsedmetadata(&tc);
+		return r;
+	}
+	r = encodemetadata(target, &md, &data, &len);
+	freeparsedmetadata(&tc);
+	if (!RET_IS_OK(r))
+		return r;
+	r = table_adduniqsizedrecord(table, name, data, len, true, false);
+	free(data);
+	return r;
+}
+
+static retvalue regeneratemetadata(struct target *target) {
+	struct table *table;
+	struct cursor *cursor;
+	const char *name, *control;
+	retvalue r, r2;
+
+	if (verbose > 2)
+		printf(" regenerating the metadata of '%s'...\n",
+				target->identifier);
+	r = database_dropmetadata(target->identifier);
+	if (RET_WAS_ERROR(r))
+		return r;
+	r = database_openmetadata(target->identifier, false, true, &table);
+	if (RET_WAS_ERROR(r))
+		return r;
+	r = table_newglobalcursor(target->packages, &cursor);
+	if (RET_WAS_ERROR(r)) {
+		(void)table_close(table);
+		return r;
+	}
+	r = RET_OK;
+	while (cursor_nexttemp(target->packages, cursor, &name, &control)) {
+		r = putmetadata(target, table, name, control);
+		if (RET_WAS_ERROR(r))
+			break;
+	}
+	r2 = cursor_close(target->packages, cursor);
+	RET_ENDUPDATE(r, r2);
+	if (RET_IS_OK(r))
+		r = table_adduniqsizedrecord(table, metadatakey,
+				metadataformat, sizeof(metadataformat),
+				true, false);
+	if (RET_WAS_ERROR(r)) {
+		(void)table_close(table);
+		if (r == RET_ERROR_OOM)
+			return r;
+		/* not marked as up to date, so nothing uses it */
+		fprintf(stderr,
+"Could not generate the metadata of '%s', continuing without it.\n",
+				target->identifier);
+		return RET_NOTHING;
+	}
+	target->metadata = table;
+	target->metadatachanged = false;
+	return RET_OK;
+}
+
+/* open the metadata table if it is up to date (or regenerate it if not
+ * readonly) */
+static retvalue openmetadata(struct target *target, bool readonly) {
+	struct table *table;
+	const char *data;
+	size_t len;
+	retvalue r;
+
+	assert (target->metadata == NULL);
+	r = database_openmetadata(target->identifier, readonly, !readonly,
+			&table);
+	if (!RET_IS_OK(r))
+		return r;
+	r = table_gettemprecord(table, metadatakey, &data, &len);
+	if (RET_IS_OK(r) && len + 1 == sizeof(metadataformat) &&
+			memcmp(data, metadataformat, len) == 0) {
+		target->metadata = table;
+		target->metadatachanged = false;
+		return RET_OK;
+	}
+	if (RET_WAS_ERROR(r)) {
+		(void)table_close(table);
+		return r;
+	}
+	r = table_close(table);
+	if (RET_WAS_ERROR(r) || readonly)
+		return r;
+	return regeneratemetadata(target);
+}
+
+/* without --metadata-cache changes are not recorded, so an existing
+ * table can no longer be trusted */
+static retvalue unmarkmetadata(struct target *target) {
+	struct table *table;
+	retvalue r, r2;
+
+	r = database_openmetadata(target->identifier, false, false, &table);
+	if (!RET_IS_OK(r))
+		return r;
+	r = table_deleterecord(table, metadatakey, true);
+	r2 = table_close(table);
+	RET_ENDUPDATE(r, r2);
+	return r;
+}
+
+static retvalue closemetadata(struct target *target) {
+	retvalue r = RET_OK, r2;
+
+	if (target->metadata == NULL)
+		return RET_OK;
+	if (target->metadatachanged)
+		r = table_adduniqsizedrecord(target->metadata, metadatakey,
+				metadataformat, sizeof(metadataformat),
+				true, false);
+	r2 = table_close(target->metadata);
+	RET_ENDUPDATE(r, r2);
+	target->metadata = NULL;
+	target->metadatachanged = false;
+	return r;
+}
+
+/* called after the package was added (control != NULL) or removed
+ * from target->packages */
+static retvalue recordmetadata(struct target *target, const char *name, /*@null@*/const char *control) {
+	retvalue r;
+
+	if (target->metadata == NULL)
+		return RET_NOTHING;
+	if (!target->metadatachanged) {
+		r = table_deleterecord(target->metadata, metadatakey, true);
+		if (RET_WAS_ERROR(r))
+			return r;
+		target->metadatachanged = true;
+	}
+	if (control == NULL)
+		r = table_deleterecord(target->metadata, name, true);
+	else
+		r = putmetadata(target, target->metadata, name, control);
+	if (RET_WAS_ERROR(r)) {
+		/* not marked as up to date, so it is regenerated next time */
+		(void)table_close(target->metadata);
+		target->metadata = NULL;
+		target->metadatachanged = false;
+		if (r != RET_ERROR_OOM)
+			return RET_OK;
+	}
+	return r;
+}
+
+retvalue target_openmetadata(struct target *target, bool readonly, int fields, struct target_cursor *tc) {
+	struct cursor *c;
+	retvalue r, r2;
+
+	assert (fields != 0);
+	r = target_initpackagesdb(target, readonly);
+	assert (r != RET_NOTHING);
+	if (RET_WAS_ERROR(r))
+		return r;
+	/* when opened for writing, that already opened it if possible */
+	if (readonly && global.metadatacache) {
+		r = openmetadata(target, true);
+		if (RET_WAS_ERROR(r)) {
+			r2 = target_closepackagesdb(target);
+			RET_UPDATE(r, r2);
+			return r;
+		}
+	}
+	r = table_newglobalcursor((target->metadata != NULL)?
+			target->metadata:target->packages, &c);
+	assert (r != RET_NOTHING);
+	if (RET_WAS_ERROR(r)) {
+		r2 = target_closepackagesdb(target);
+		RET_UPDATE(r, r2);
+		return r;
+	}
+	tc->target = target;
+	tc->cursor = c;
+	tc->lastname = NULL;
+	tc->lastcontrol = NULL;
+	tc->fields = fields;
+	tc->inmetadata = target->metadata != NULL;
+	tc->version = NULL;
+	tc->source = NULL;
+	tc->sourceversion = NULL;
+	tc->architectures = NULL;
+	strlist_init(&tc->filekeys);
+	return RET_OK;
+}
+
+retvalue target_nextmetadata(struct target_cursor *tc, const char **name_p, struct target_metadata *md) {
+	const char *name, *data;
+	size_t len;
+
+	assert (tc->fields != 0);
+	tc->lastname = NULL;
+	tc->lastcontrol = NULL;
+	if (!tc->inmetadata) {
+		if (!cursor_nexttemp(tc->target->packages, tc->cursor,
+					&name, &data))
+			return RET_NOTHING;
+		tc->lastname = name;
+		tc->lastcontrol = data;
+		*name_p = name;
+		return parsemetadata(tc, name, data, md);
+	}
+	do {
+		if (!cursor_nexttempdata(tc->target->metadata, tc->cursor,
+					&name, &data, &len))
+			return RET_NOTHING;
+	} while (name[0] == '\0');
+	tc->lastname = name;
+	*name_p = name;
+	return decodemetadata(tc, name, data, len, md);
+}
+
+retvalue target_metadatacontrol(struct target_cursor *tc, const char **control_p) {
+	retvalue r;
+
+	assert (tc->lastname != NULL);
+	if (tc->lastcontrol == NULL) {
+		r = table_gettemprecord(tc->target->packages, tc->lastname,
+				&tc->lastcontrol, NULL);
+		if (r == RET_NOTHING) {
+			fprintf(stderr,
+"Package '%s' is in the metadata of '%s' but not in its packages!\n",
+					tc->lastname, tc->target->identifier);
+			r = RET_ERROR_MISSING;
+		}
+		if (RET_WAS_ERROR(r)) {
+			tc->lastcontrol = NULL;
+			return r;
+		}
+	}
+	*control_p = tc->lastcontrol;
+	return RET_OK;
+}
+
 /* This opens up the database, if db != NULL, *db will be set to it.. */
 retvalue target_initpackagesdb(struct target *target, bool readonly) {
 	retvalue r;
@@ -204,18 +637,31 @@ retvalue target_initpackagesdb(struct target *target, bool readonly) {
 		target->packages = NULL;
 		return r;
 	}
-	return r;
+	if (!readonly) {
+		if (global.metadatacache)
+			r = openmetadata(target, false);
+		else
+			r = unmarkmetadata(target);
+		if (RET_WAS_ERROR(r)) {
+			(void)table_close(target->packages);
+			target->packages = NULL;
+			return r;
+		}
+	}
+	return RET_OK;
 }
 
 /* this closes databases... */
 retvalue target_closepackagesdb(struct target *target) {
-	retvalue r;
+	retvalue r, r2;
 
 	if (target->packages == NULL) {
 		fprintf(stderr, "Internal Warning: Double close!\n");
 		r = RET_OK;
 	} else {
-		r = table_close(target->packages);
+		r = closemetadata(target);
+		r2 = table_close(target->packages);
+		RET_ENDUPDATE(r, r2);
 		target->packages = NULL;
 	}
 	return r;
@@ -272,6 +718,10 @@ retvalue target_removereadpackage(struct target *target, struct logger *logger,
 					NULL, NULL);
 		r = references_delete(target->identifier, &files, NULL);
 		RET_UPDATE(result, r);
+		r = contents_recordchange(target, name, oldcontrol, NULL);
+		RET_UPDATE(result, r);
+		r = recordmetadata(target, name, NULL);
+		RET_UPDATE(result, r);
 	}
 	strlist_done(&files);
 	free(oldpversion);
@@ -305,15 +755,26 @@ retvalue target_removepackage(struct target *target, struct logger *logger, cons
 /* Like target_removepackage, but delete the package record by cursor */
 retvalue target_removepackage_by_cursor(struct target_cursor *tc, struct logger *logger, struct trackingdata *trackingdata) {
 	struct target * const target = tc->target;
-	const char * const name = tc->lastname;
-	const char * const control = tc->lastcontrol;
+	char *name, *control;
 	char *oldpversion = NULL;
 	struct strlist files;
 	retvalue result, r;
 	char *oldsource, *oldsversion;
 
 	assert (target != NULL && target->packages != NULL);
-	assert (name != NULL && control != NULL);
+	assert (tc->lastname != NULL && tc->lastcontrol != NULL);
+	assert (tc->fields == 0);
+
+	/* deleting the record makes the cursor's data invalid */
+	name = strdup(tc->lastname);
+	control = strdup(tc->lastcontrol);
+	if (FAILEDTOALLOC(name) || FAILEDTOALLOC(control)) {
+		free(name);
+		free(control);
+		return RET_ERROR_OOM;
+	}
+	tc->lastname = NULL;
+	tc->lastcontrol = NULL;
 
 	if (logger != NULL) {
 		/* need to get the version for logging, if not available */
@@ -324,6 +785,8 @@ retvalue target_removepackage_by_cursor(struct target_cursor *tc, struct logger
 	r = target->getfilekeys(control, &files);
 	if (RET_WAS_ERROR(r)) {
 		free(oldpversion);
+		free(name);
+		free(control);
 		return r;
 	}
 	if (trackingdata != NULL) {
@@ -338,7 +801,7 @@ retvalue target_removepackage_by_cursor(struct target_cursor *tc, struct logger
 	if (verbose > 0)
 		printf("removing '%s' from '%s'...\n",
 				name, target->identifier);
-	result = cursor_delete(target->packages, tc->cursor, tc->lastname, NULL);
+	result = cursor_delete(target->packages, tc->cursor, name, NULL);
 	if (RET_IS_OK(result)) {
 		target->wasmodified = true;
 		if (oldsource != NULL && oldsversion != NULL) {
@@ -356,9 +819,15 @@ retvalue target_removepackage_by_cursor(struct target_cursor *tc, struct logger
 					NULL, NULL);
 		r = references_delete(target->identifier, &files, NULL);
 		RET_UPDATE(result, r);
+		r = contents_recordchange(target, name, control, NULL);
+		RET_UPDATE(result, r);
+		r = recordmetadata(target, name, NULL);
+		RET_UPDATE(result, r);
 	}
 	strlist_done(&files);
 	free(oldpversion);
+	free(name);
+	free(control);
 	return result;
 }
 
@@ -402,6 +871,12 @@ static retvalue addpackages(struct target *target, const char *packagename, cons
 		return result;
 	}
 
+	r = contents_recordchange(target, packagename,
+			oldcontrolchunk, controlchunk);
+	RET_UPDATE(result, r);
+	r = recordmetadata(target, packagename, controlchunk);
+	RET_UPDATE(result, r);
+
 	if (logger != NULL)
 		logger_log(logger, target, packagename,
 				version, oldversion,
@@ -643,7 +1118,8 @@ retvalue target_checkaddpackage(struct target *target, const char *name, const c
 retvalue target_rereference(struct target *target) {
 	retvalue result, r;
 	struct target_cursor iterator;
-	const char *package, *control;
+	struct target_metadata md;
+	const char *package;
 
 	if (verbose > 1) {
 		if (verbose > 2)
@@ -658,25 +1134,22 @@ retvalue target_rereference(struct target *target) {
 	if (verbose > 2)
 		printf("Referencing %s...\n", target->identifier);
 
-	r = target_openiterator(target, READONLY, &iterator);
+	r = target_openmetadata(target, READONLY, TMD_FILEKEYS, &iterator);
 	assert (r != RET_NOTHING);
 	if (RET_WAS_ERROR(r))
 		return r;
-	while (target_nextpackage(&iterator, &package, &control)) {
-		struct strlist filekeys;
-
-		r = target->getfilekeys(control, &filekeys);
+	while ((r = target_nextmetadata(&iterator, &package, &md))
+			!= RET_NOTHING) {
 		RET_UPDATE(result, r);
 		if (!RET_IS_OK(r))
 			continue;
 		if (verbose > 10) {
 			fprintf(stderr, "adding references to '%s' for '%s': ",
 					target->identifier, package);
-			(void)strlist_fprint(stderr, &filekeys);
+			(void)strlist_fprint(stderr, md.filekeys);
 			(void)putc('\n', stderr);
 		}
-		r = references_insert(target->identifier, &filekeys, NULL);
-		strlist_done(&filekeys);
+		r = references_insert(target->identifier, md.filekeys, NULL);
 		RET_UPDATE(result, r);
 	}
 	r = target_closeiterator(&iterator);
@@ -830,6 +1303,10 @@ retvalue target_reoverride(struct target *target, struct distribution *distribut
 		if (RET_IS_OK(r)) {
 			r = cursor_replace(target->packages, iterator.cursor,
 				newcontrolchunk, strlen(newcontrolchunk));
+			if (!RET_WAS_ERROR(r))
+				/* the section might have changed */
+				r = contents_recordchange(target, package,
+						controlchunk, newcontrolchunk);
 			free(newcontrolchunk);
 			if (RET_WAS_ERROR(r)) {
 				result = r;
@@ -908,8 +1385,7 @@ retvalue target_redochecksums(struct target *target, struct distribution *distri
 
 /* export a database */
 
-retvalue target_export(struct target *target, bool onlyneeded, bool snapshot, struct release *release) {
-	retvalue result;
+retvalue target_exportfiles(struct target *target, bool onlyneeded, struct release *release, const char **status_p) {
 	bool onlymissing;
 
 	if (verbose > 5) {
@@ -923,10 +1399,17 @@ retvalue target_export(struct target *target, bool onlyneeded, bool snapshot, st
 	/* not exporting if file is already there? */
 	onlymissing = onlyneeded && !target->wasmodified;
 
-	result = export_target(target->relativedirectory, target,
-			target->exportmode, release, onlymissing, snapshot);
+	return export_targetfiles(target->relativedirectory, target,
+			target->exportmode, release, onlymissing, status_p);
+}
+
+retvalue target_exportdone(struct target *target, struct release *release, const char *status) {
+	retvalue result;
+
+	result = export_targethooks(target->relativedirectory,
+			target->exportmode, release, status);
 
-	if (!RET_WAS_ERROR(result) && !snapshot) {
+	if (!RET_WAS_ERROR(result)) {
 		target->saved_wasmodified =
 			target->saved_wasmodified || target->wasmodified;
 		target->wasmodified = false;
@@ -934,6 +1417,16 @@ retvalue target_export(struct target *target, bool onlyneeded, bool snapshot, st
 	return result;
 }
 
+retvalue target_export(struct target *target, bool onlyneeded, bool snapshot, struct release *release) {
+	retvalue result;
+	const char *status;
+
+	result = target_exportfiles(target, onlyneeded, release, &status);
+	if (RET_WAS_ERROR(result) || snapshot)
+		return result;
+	return target_exportdone(target, release, status);
+}
+
 retvalue package_rerunnotifiers(struct distribution *distribution, struct target *target, const char *package, const char *chunk, UNUSED(void *data)) {
 	struct logger *logger = distribution->logger;
 	struct strlist filekeys;
@@ -25,6 +25,7 @@
 
 struct target;
 struct alloverrides;
+struct contentschange;
 
 typedef retvalue get_version(const char *, /*@out@*/char **);
 typedef retvalue get_architecture(const char *, /*@out@*/architecture_t *);
@@ -71,6 +72,18 @@ struct target {
 	/* was updated without tracking data (no problem when distribution
 	 * has no tracking, otherwise cause warning later) */
 	bool staletracking;
+	/* state of the index incremental Contents generation uses:
+	 * untouched: not modified in this run (valid if still marked as such)
+	 * changed: was valid, the changes since are in contentschanges
+	 * invalid: needs to be regenerated */
+	enum { cis_untouched = 0, cis_changed, cis_invalid } contentsindex;
+	/*@null@*/struct contentschange *contentschanges;
+	/* the up to date table of the metadata of the packages
+	 * (see target_openmetadata), open together with packages */
+	/*@null@*/struct table *metadata;
+	/* changes were written to it (so it is marked up to date again
+	 * when closing it) */
+	bool metadatachanged;
 };
 
 retvalue target_initialize_ubinary(/*@dependant@*/struct distribution *, component_t, architecture_t, /*@dependent@*/const struct exportmode *, bool /*readonly*/, /*@NULL@*/const char *fakecomponentprefix, /*@out@*/struct target **);
@@ -79,6 +92,10 @@ retvalue target_initialize_source(/*@dependant@*/struct distribution *, componen
 retvalue target_free(struct target *);
 
 retvalue target_export(struct target *, bool /*onlyneeded*/, bool /*snapshot*/, struct release *);
+/* target_export split in writing the files (can be done in a worker process)
+ * and calling the export hooks and marking as exported */
+retvalue target_exportfiles(struct target *, bool /*onlyneeded*/, struct release *, /*@out@*/const char ** /*status_p*/);
+retvalue target_exportdone(struct target *, struct release *, const char * /*status*/);
 
 /* This opens up the database, if db != NULL, *db will be set to it.. */
 retvalue target_initpackagesdb(struct target *, bool /*readonly*/);
@@ -90,8 +107,15 @@ struct target_cursor {
 	struct cursor *cursor;
 	const char *lastname;
 	const char *lastcontrol;
+	/* only for target_openmetadata: the fields to return,
+	 * if the cursor is in target->metadata (otherwise the fields
+	 * are parsed from the control data and stored here) */
+	int fields;
+	bool inmetadata;
+	/*@null@*/char *version, *source, *sourceversion, *architectures;
+	struct strlist filekeys;
 };
-#define TARGET_CURSOR_ZERO {NULL, NULL, NULL, NULL}
+#define TARGET_CURSOR_ZERO {NULL, NULL, NULL, NULL, 0, false, NULL, NULL, NULL, NULL, {NULL, 0, 0}}
 /* wrapper around initpackagesdb and table_newglobalcursor */
 static inline retvalue target_openiterator(struct target *t, bool readonly, /*@out@*/struct target_cursor *tc) {
 	retvalue r, r2;
@@ -110,6 +134,8 @@ static inline retvalue target_openiterator(struct target *t, bool readonly, /*@o
 	}
 	tc->target = t;
 	tc->cursor = c;
+	tc->fields = 0;
+	tc->inmetadata = false;
 	return RET_OK;
 }
 /* wrapper around cursor_nexttemp */
@@ -133,11 +159,41 @@ static inline bool target_nextpackage_len(struct target_cursor *tc, /*@out@*//*@
 	return cursor_nexttempdata(tc->target->packages, tc->cursor,
 			packagename_p, chunk_p, len_p);
 }
+
+/* What scans over all packages of a target usually need, read from a
+ * table kept beside the packages (with --metadata-cache) instead of
+ * parsing the control data. Only the fields asked for are set: */
+#define TMD_VERSION 1
+/* source and sourceversion */
+#define TMD_SOURCE 2
+/* architecture and (only for source packages) architectures */
+#define TMD_ARCHITECTURE 4
+#define TMD_FILEKEYS 8
+struct target_metadata {
+	const char *version, *source, *sourceversion;
+	architecture_t architecture;
+	/* the Architecture field of a source package (NULL if none,
+	 * empty or only spaces if it is empty) */
+	/*@null@*/const char *architectures;
+	const struct strlist *filekeys;
+};
+/* like target_openiterator, closed with target_closeiterator */
+retvalue target_openmetadata(struct target *, bool /*readonly*/, int /*fields*/, /*@out@*/struct target_cursor *);
+/* returns RET_NOTHING at the end, errors only affect this package,
+ * everything returned is only valid until the next call */
+retvalue target_nextmetadata(struct target_cursor *, /*@out@*/const char ** /*packagename*/, /*@out@*/struct target_metadata *);
+/* the control data of the package last returned by target_nextmetadata */
+retvalue target_metadatacontrol(struct target_cursor *, /*@out@*/const char **);
+void target_metadatadone(struct target_cursor *);
+
 /* wrapper around cursor_close and target_closepackagesdb */
 static inline retvalue target_closeiterator(struct target_cursor *tc) {
 	retvalue result, r;
 
-	result = cursor_close(tc->target->packages, tc->cursor);
+	if (tc->fields != 0)
+		target_metadatadone(tc);
+	result = cursor_close(tc->inmetadata ? tc->target->metadata :
+			tc->target->packages, tc->cursor);
 	r = target_closepackagesdb(tc->target);
 	RET_UPDATE(result, r);
 	return result;
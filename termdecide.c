@@ -23,6 +23,7 @@
 #include <ctype.h>
 #include <string.h>
 #include <malloc.h>
+#include <sys/time.h>
 #include "error.h"
 #include "mprintf.h"
 #include "strlist.h"
@@ -30,9 +31,25 @@
 #include "chunks.h"
 #include "globmatch.h"
 #include "dpkgversions.h"
+#include "binaries.h"
 #include "terms.h"
 #include "termdecide.h"
 
+static inline bool check_order(enum term_comparison c, int i) {
+	if (i < 0)
+		return c == tc_strictless
+			|| c == tc_lessorequal
+			|| c == tc_notequal;
+	else if (i > 0)
+		return  c == tc_strictmore
+			|| c == tc_moreorequal
+			|| c == tc_notequal;
+	else
+		return c == tc_lessorequal
+			|| c == tc_moreorequal
+			|| c == tc_equal;
+}
+
 static inline bool check_field(enum term_comparison c, const char *value, const char *with) {
 	if (c == tc_none) {
 		return true;
@@ -41,47 +58,76 @@ static inline bool check_field(enum term_comparison c, const char *value, const
 	} else if (c == tc_notglobmatch) {
 		return !globmatch(value, with);
 	} else {
+		return check_order(c, strcmp(value, with));
+	}
+}
+
+/* the same as check_field, but for a value not '\0' terminated */
+static inline bool check_value(const struct term_atom *atom, const char *value, size_t len) {
+	enum term_comparison c = atom->comparison;
+
+	if (c == tc_none) {
+		return true;
+	} else if (c == tc_globmatch) {
+		return globpattern_match(atom->generic.glob, value, len);
+	} else if (c == tc_notglobmatch) {
+		return !globpattern_match(atom->generic.glob, value, len);
+	} else {
+		const char *with = atom->generic.comparewith;
+		size_t withlen = strlen(with);
 		int i;
-		i = strcmp(value, with);
-		if (i < 0)
-			return c == tc_strictless
-				|| c == tc_lessorequal
-				|| c == tc_notequal;
-		else if (i > 0)
-			return  c == tc_strictmore
-				|| c == tc_moreorequal
-				|| c == tc_notequal;
-		else
-			return c == tc_lessorequal
-				|| c == tc_moreorequal
-				|| c == tc_equal;
+
+		i = memcmp(value, with, (len < withlen)?len:withlen);
+		if (i == 0)
+			i = (len < withlen)?-1:((len > withlen)?1:0);
+		return check_order(c, i);
 	}
 }
 
 retvalue term_decidechunk(const term *condition, const char *controlchunk, const void *privdata) {
-	const struct term_atom *atom = condition;
+	const struct term_atom *atom;
+	struct chunkvalue values[(condition == NULL)?1:
+					(condition->fieldcount + 1)];
+	const char *position = controlchunk;
+
+	if (condition == NULL)
+		return RET_OK;
+	/* the fields are only searched for when needed, but all
+	 * in the same pass, without copying them */
+	for (atom = condition ; atom != NULL ; atom = atom->next) {
+		struct chunkvalue *v;
 
+		if (atom->isspecial)
+			continue;
+		v = &values[atom->generic.field];
+		v->name = atom->generic.key;
+		v->namelen = atom->generic.keylen;
+		v->first = atom->generic.key[0] | 0x20;
+		v->value = NULL;
+	}
+
+	atom = condition;
 	while (atom != NULL) {
-		bool correct; char *value;
+		bool correct;
 		enum term_comparison c = atom->comparison;
-		retvalue r;
 
 		if (atom->isspecial) {
 			correct = atom->special.type->compare(c,
 					&atom->special.comparewith,
 					controlchunk, privdata);
 		} else {
-			r = chunk_getvalue(controlchunk,
-					atom->generic.key, &value);
-			if (RET_WAS_ERROR(r))
-				return r;
-			if (r == RET_NOTHING) {
+			const struct chunkvalue *v =
+				&values[atom->generic.field];
+
+			if (v->value == NULL && *position != '\0')
+				chunk_findvalues(&position, values,
+						condition->fieldcount,
+						atom->generic.field);
+			if (v->value == NULL) {
 				correct = (c == tc_notequal
 						|| c == tc_notglobmatch);
 			} else {
-				correct = check_field(c, value,
-						atom->generic.comparewith);
-				free(value);
+				correct = check_value(atom, v->value, v->len);
 			}
 		}
 		if (atom->negated)
@@ -114,8 +160,38 @@ static retvalue parsestring(enum term_comparison c, const char *value, size_t le
 		return RET_ERROR_OOM;
 	return RET_OK;
 }
-// TODO: check for well-formed versions
-#define parseversion parsestring
+
+/* versions to compare with are only parsed once */
+struct versionparameter {
+	/* if false, the error is shown whenever it is used */
+	bool valid;
+	struct dpkgversion parsed;
+	char string[];
+};
+
+// TODO: reject malformed versions already here
+static retvalue parseversion(enum term_comparison c, const char *value, size_t len, struct compare_with *v) {
+	struct versionparameter *p;
+
+	if (c == tc_none) {
+		fprintf(stderr,
+"Error: Special formula predicates (those starting with '$') are always\n"
+"defined, thus specifying them without parameter to compare against\n"
+"makes not sense!\n");
+		return RET_ERROR;
+	}
+	p = malloc(sizeof(struct versionparameter) + len + 1);
+	if (FAILEDTOALLOC(p))
+		return RET_ERROR_OOM;
+	memcpy(p->string, value, len);
+	p->string[len] = '\0';
+	p->valid = false;
+	if (c != tc_globmatch && c != tc_notglobmatch)
+		/* do not complain yet, in case it is never used */
+		p->valid = dpkgversion_split(&p->parsed, p->string) == NULL;
+	v->pointer = p;
+	return RET_OK;
+}
 
 static bool comparesource(enum term_comparison c, const struct compare_with *v, const void *d1, const void *d2) {
 	const char *control = d1;
@@ -138,29 +214,25 @@ static bool comparesource(enum term_comparison c, const struct compare_with *v,
 	return matches;
 }
 
-static inline bool compare_dpkgversions(enum term_comparison c, const char *version, const char *param) {
+static inline bool compare_dpkgversions(enum term_comparison c, const char *version, const struct versionparameter *param) {
 	if (c != tc_globmatch && c != tc_notglobmatch) {
 		int cmp;
 		retvalue r;
 
-		r = dpkgversions_cmp(version, param, &cmp);
-		if (RET_IS_OK(r)) {
-			if (cmp < 0)
-				return c == tc_strictless
-					|| c == tc_lessorequal
-					|| c == tc_notequal;
-			else if (cmp > 0)
-				return c == tc_strictmore
-					|| c == tc_moreorequal
-					|| c == tc_notequal;
-			else
-				return c == tc_lessorequal
-					|| c == tc_moreorequal
-					|| c == tc_equal;
+		if (param->valid) {
+			struct dpkgversion parsed;
+
+			r = dpkgversion_parse(&parsed, version);
+			if (RET_IS_OK(r))
+				cmp = dpkgversion_cmp(&parsed, &param->parsed);
 		} else
+			r = dpkgversions_cmp(version, param->string, &cmp);
+		if (RET_IS_OK(r))
+			return check_order(c, cmp);
+		else
 			return false;
 	} else
-		return check_field(c, version, param);
+		return check_field(c, version, param->string);
 }
 
 static bool compareversion(enum term_comparison c, const struct compare_with *v, const void *d1, const void *d2) {
@@ -329,3 +401,187 @@ retvalue term_compilefortargetdecision(term **term_p, const char *formula) {
 retvalue term_decidechunktarget(const term *condition, const char *controlchunk, const struct target *target) {
 	return term_decidechunk(condition, controlchunk, target);
 }
+
+/* how formulas were evaluated before they were compiled (copying every
+ * field looked at and interpreting glob patterns), to compare with */
+static retvalue benchmark_decidefieldbyfield(const term *condition, const char *controlchunk, const void *privdata) {
+	const struct term_atom *atom = condition;
+
+	while (atom != NULL) {
+		bool correct; char *value;
+		enum term_comparison c = atom->comparison;
+		retvalue r;
+
+		if (atom->isspecial) {
+			correct = atom->special.type->compare(c,
+					&atom->special.comparewith,
+					controlchunk, privdata);
+		} else {
+			r = chunk_getvalue(controlchunk,
+					atom->generic.key, &value);
+			if (RET_WAS_ERROR(r))
+				return r;
+			if (r == RET_NOTHING) {
+				correct = (c == tc_notequal
+						|| c == tc_notglobmatch);
+			} else {
+				correct = check_field(c, value,
+						atom->generic.comparewith);
+				free(value);
+			}
+		}
+		if (atom->negated)
+			correct = !correct;
+		if (correct) {
+			atom = atom->nextiftrue;
+		} else {
+			atom = atom->nextiffalse;
+			if (atom == NULL)
+				return RET_NOTHING;
+		}
+	}
+	return RET_OK;
+}
+
+/* something looking like a Packages file */
+static char *benchmark_chunk(unsigned long i) {
+	static const char * const sections[] = {
+		"libs", "devel", "utils", "net", "python", "admin", "doc",
+		"web"
+	};
+	static const char * const priorities[] = {
+		"optional", "optional", "optional", "extra", "important"
+	};
+	static const char * const kinds[] = {
+		"lib%s%lu", "%s%lu-dev", "python3-%s%lu", "%s%lu", "%s%lu-doc"
+	};
+	static const char * const words[] = {
+		"foo", "bar", "baz", "qux", "quux", "corge", "grault", "garply"
+	};
+	const char *section = sections[i % 8];
+	const char *arch = (i % 7 == 0)?"all":"amd64";
+	char *name, *source, *chunk;
+	unsigned long major = i % 13, minor = i % 17, revision = 1 + i % 3;
+
+	name = mprintf(kinds[i % 5], words[(i / 5) % 8], i / 40);
+	if (FAILEDTOALLOC(name))
+		return NULL;
+	if (i % 3 == 0)
+		source = mprintf("Source: %s%lu\n", words[(i / 5) % 8], i / 40);
+	else
+		source = strdup("");
+	if (FAILEDTOALLOC(source)) {
+		free(name);
+		return NULL;
+	}
+	chunk = mprintf(
+"Package: %s\n"
+"%s"
+"Version: %lu.%lu-%lu\n"
+"Installed-Size: %lu\n"
+"Maintainer: Maintainer %lu <maintainer%lu@example.org>\n"
+"Architecture: %s\n"
+"Depends: libc6 (>= 2.14), libfoo%lu (>= %lu.%lu)\n"
+"Description: package number %lu\n"
+" This is the long description of the package,\n"
+" about as long as usual.\n"
+"Section: %s\n"
+"Priority: %s\n"
+"Filename: pool/main/%c/%s/%s_%lu.%lu-%lu_%s.deb\n"
+"Size: %lu\n"
+"MD5sum: %032lx\n"
+"SHA256: %064lx",
+			name, source, major, minor, revision,
+			10 + i % 1000, i % 100, i % 100, arch,
+			i % 10, major, minor, i,
+			section, priorities[i % 5],
+			name[0], name, name, major, minor, revision, arch,
+			1000 + i % 100000, i, i);
+	free(source);
+	free(name);
+	return chunk;
+}
+
+retvalue term_benchmark(const char *formula, unsigned long count) {
+	struct target target;
+	term *condition;
+	char **chunks;
+	unsigned long i, matching = 0;
+	struct timeval start, middle, end;
+	double fieldsecs = 0, compiledsecs = 0;
+	bool *results;
+	retvalue r;
+	int round;
+
+	memset(&target, 0, sizeof(target));
+	target.identifier = (char*)"benchmark";
+	target.packagetype = pt_deb;
+	target.architecture = architecture_all;
+	target.getversion = binaries_getversion;
+	target.getarchitecture = binaries_getarchitecture;
+	target.getsourceandversion = binaries_getsourceandversion;
+
+	r = term_compilefortargetdecision(&condition, formula);
+	if (RET_WAS_ERROR(r))
+		return r;
+	chunks = nzNEW(count, char *);
+	results = nzNEW(count, bool);
+	if (FAILEDTOALLOC(chunks) || FAILEDTOALLOC(results)) {
+		free(chunks);
+		free(results);
+		term_free(condition);
+		return RET_ERROR_OOM;
+	}
+	for (i = 0 ; i < count ; i++) {
+		chunks[i] = benchmark_chunk(i);
+		if (FAILEDTOALLOC(chunks[i])) {
+			r = RET_ERROR_OOM;
+			break;
+		}
+	}
+	/* taking the best of some rounds, as the times vary a lot */
+	for (round = 0 ; round < 3 && !RET_WAS_ERROR(r) ; round++) {
+		double secs;
+
+		matching = 0;
+		gettimeofday(&start, NULL);
+		for (i = 0 ; i < count && !RET_WAS_ERROR(r) ; i++) {
+			r = benchmark_decidefieldbyfield(condition, chunks[i],
+					&target);
+			results[i] = RET_IS_OK(r);
+		}
+		gettimeofday(&middle, NULL);
+		for (i = 0 ; i < count && !RET_WAS_ERROR(r) ; i++) {
+			r = term_decidechunk(condition, chunks[i], &target);
+			if (RET_IS_OK(r) != results[i]) {
+				fprintf(stderr,
+"Internal error: compiled formula decides differently for:\n%s\n",
+						chunks[i]);
+				r = RET_ERROR_INTERNAL;
+			}
+			if (RET_IS_OK(r))
+				matching++;
+		}
+		gettimeofday(&end, NULL);
+		secs = (middle.tv_sec - start.tv_sec)
+			+ (middle.tv_usec - start.tv_usec) / 1000000.0;
+		if (round == 0 || secs < fieldsecs)
+			fieldsecs = secs;
+		secs = (end.tv_sec - middle.tv_sec)
+			+ (end.tv_usec - middle.tv_usec) / 1000000.0;
+		if (round == 0 || secs < compiledsecs)
+			compiledsecs = secs;
+	}
+	if (!RET_WAS_ERROR(r)) {
+		printf("%lu packages, %lu matching\n", count, matching);
+		printf("field by field: %.3f s\n", fieldsecs);
+		printf("compiled: %.3f s\n", compiledsecs);
+		r = RET_OK;
+	}
+	for (i = 0 ; i < count ; i++)
+		free(chunks[i]);
+	free(chunks);
+	free(results);
+	term_free(condition);
+	return r;
+}
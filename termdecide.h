@@ -14,6 +14,10 @@ retvalue term_decidechunk(const term *, const char *, /*@null@*/const void *);
 retvalue term_compilefortargetdecision(/*@out@*/term **, const char *);
 retvalue term_decidechunktarget(const term *, const char *, const struct target *);
 
+/* evaluate formula for count generated packages, compiled and the way
+ * it was done before (for __benchmarkformula) */
+retvalue term_benchmark(const char * /*formula*/, unsigned long /*count*/);
+
 
 
 #endif
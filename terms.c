@@ -43,6 +43,7 @@ void term_free(term *t) {
 		} else {
 			free(t->generic.key);
 			free(t->generic.comparewith);
+			globpattern_free(t->generic.glob);
 		}
 		strlist_done(&t->architectures);
 		free(t);
@@ -203,6 +204,7 @@ static retvalue parseatom(const char **formula, /*@out@*/struct term_atom **atom
 			term_free(a);
 			return RET_ERROR_OOM;
 		}
+		a->generic.keylen = keyend - keystart;
 		if (comparison != tc_none) {
 			if (valueend - valuestart > 2048 &&
 					(comparison == tc_globmatch ||
@@ -219,6 +221,17 @@ static retvalue parseatom(const char **formula, /*@out@*/struct term_atom **atom
 				term_free(a);
 				return RET_ERROR_OOM;
 			}
+			if (comparison == tc_globmatch ||
+					comparison == tc_notglobmatch) {
+				retvalue r;
+
+				r = globpattern_compile(&a->generic.glob,
+						a->generic.comparewith);
+				if (RET_WAS_ERROR(r)) {
+					term_free(a);
+					return r;
+				}
+			}
 		}
 	}
 	//TODO: here architectures, too
@@ -381,6 +394,22 @@ retvalue term_compile(term **term_p, const char *origformula, int options, const
 		term_free(first);
 		return RET_ERROR;
 	}
+	/* number the different keys, so all can be extracted at once */
+	for (atom = first ; atom != NULL ; atom = atom->next) {
+		const struct term_atom *a;
+
+		if (atom->isspecial)
+			continue;
+		for (a = first ; a != atom ; a = a->next) {
+			if (!a->isspecial && strcasecmp(a->generic.key,
+						atom->generic.key) == 0)
+				break;
+		}
+		if (a != atom)
+			atom->generic.field = a->generic.field;
+		else
+			atom->generic.field = first->fieldcount++;
+	}
 	*term_p = first;
 	return RET_OK;
 }
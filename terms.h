@@ -20,12 +20,19 @@ typedef struct term_atom {
 	struct strlist architectures;
 	/* version/value requirement */
 	enum term_comparison comparison;
+	/* only set in the first atom: the number of different keys */
+	int fieldcount;
 	union {
 		struct {
 			/* package-name or key */
 			char *key;
+			size_t keylen;
 			/* version/value requirement */
 			char *comparewith;
+			/* index among the different keys of the term */
+			int field;
+			/* for tc_globmatch and tc_notglobmatch */
+			/*@null@*/struct globpattern *glob;
 		} generic;
 		struct {
 			const struct term_special *type;
@@ -156,34 +156,42 @@ number_skipped=0
 number_failed=0
 
 runtest() {
+	# $1: name of the test, $2: optional additional reprepro options
 	if ! test -f "$SRCDIR/tests/$1.test" ; then
 		echo "Cannot find $SRCDIR/tests/$1.test!" >&2
 		number_missing="$(( $number_missing + 1 ))"
 		return
 	fi
 	number_tests="$(( $number_tests + 1 ))"
-	echo "Running test '$1'.."
-	TESTNAME=" $1"
-	mkdir "dir_$1"
+	name="$1"
+	if test -n "${2:-}" ; then
+		name="$1$(echo "$2" | sed -e 's/[^a-z0-9]\{1,\}/_/g')"
+		echo "Running test '$1' with '$2'.."
+	else
+		echo "Running test '$1'.."
+	fi
+	TESTNAME=" $name"
+	mkdir "dir_$name"
 	rc=0
-	( cd "dir_$1" || exit 1
+	( cd "dir_$name" || exit 1
+	  REPREPROOPTIONS="$REPREPROOPTIONS ${2:-}"
 	  export TESTNAME
 	  export SRCDIR TESTSDIR
 	  export TESTTOOL RREDTOOL REPREPRO
 	  export TRACKINGTESTOPTIONS TESTOPTIONS REPREPROOPTIONS verbosity
-  	  WORKDIR="$WORKDIR/dir_$1" CALLEDFROMTESTSUITE=true dash "$SRCDIR/tests/$1.test"
-	) > "log_$1" 2>&1 || rc=$?
+  	  WORKDIR="$WORKDIR/dir_$name" CALLEDFROMTESTSUITE=true dash "$SRCDIR/tests/$1.test"
+	) > "log_$name" 2>&1 || rc=$?
 	if test "$rc" -ne 0 ; then
 		number_failed="$(( $number_failed + 1 ))"
-		echo "test '$1' failed (see $WORKDIR/log_$1 for details)!" >&2
-	elif grep -q -s '^SKIPPED: ' "log_$1" ; then
+		echo "test '$name' failed (see $WORKDIR/log_$name for details)!" >&2
+	elif grep -q -s '^SKIPPED: ' "log_$name" ; then
 		number_skipped="$(( $number_skipped + 1 ))"
-		echo "test '$1' skipped:"
-		sed -n -e 's/^SKIPPED://p' "log_$1"
-		rm -r "dir_$1" "log_$1"
+		echo "test '$name' skipped:"
+		sed -n -e 's/^SKIPPED://p' "log_$name"
+		rm -r "dir_$name" "log_$name"
 	else
 		number_success="$(( $number_success + 1 ))"
-		rm -r "dir_$1" "log_$1"
+		rm -r "dir_$name" "log_$name"
 	fi
 }
 
@@ -205,10 +213,13 @@ else
 	runtest layeredupdate2
 	runtest uncompress
 	runtest check
+	runtest check "--checksum-jobs 3"
 	runtest flat
 	runtest subcomponents
 	runtest snapshotcopyrestore
 	runtest various1
+	# the Contents tests again, with parallel file list reading:
+	runtest various1 "--export-jobs 3"
 	runtest various2
 	runtest various3
 	runtest copy
@@ -217,6 +228,19 @@ else
 	runtest diffgeneration
 	runtest onlysmalldeletes
 	runtest override
+	runtest parallelupdate
+	runtest parallelupdate "--db-cache-size 1048576"
+	runtest metadatacache
+	runtest includedebs
+	runtest includedebs "--db-cache-size 1048576"
+	runtest exportcompression
+	runtest incrementalcontents
+	runtest rereference
+	runtest streamlists
+	runtest listfilter
+	runtest versioncompare
+	runtest includecontents
+	runtest parallelcompression
 fi
 echo "$number_tests tests, $number_success succeded, $number_failed failed, $number_skipped skipped, $number_missing missing"
 exit 0
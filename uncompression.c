@@ -31,6 +31,9 @@
 #ifdef HAVE_LIBBZ2
 #include <bzlib.h>
 #endif
+#ifdef HAVE_LIBLZMA
+#include <lzma.h>
+#endif
 
 #include "globals.h"
 #include "error.h"
@@ -52,6 +55,13 @@ const char * const uncompression_config[c_COUNT] = {
 /*@null@*/ char *extern_uncompressors[c_COUNT] = {
 	NULL, NULL, NULL, NULL, NULL};
 
+/* number of files to uncompress at the same time */
+static unsigned int maxjobs = 1;
+
+void uncompress_setjobs(unsigned int count) {
+	maxjobs = (count == 0)?1:count;
+}
+
 /*@null@*/ static struct uncompress_task {
 	struct uncompress_task *next;
 	enum compression compression;
@@ -62,8 +72,26 @@ const char * const uncompression_config[c_COUNT] = {
 	/*@null@*/void *privdata;
 	/* if already started, the pid > 0 */
 	pid_t pid;
+	/* uncompressed by a child running builtin_uncompress */
+	bool builtin;
 } *tasks = NULL;
 
+/* The formats liblzma can read are only uncompressed with it if there is
+ * no external program for them (gzip and bzip2 always use the built-in
+ * code if available) */
+static inline bool builtin_allowed(enum compression c) {
+	if (!uncompression_builtin(c))
+		return false;
+	return !uncompression_builtin_lzma(c) || extern_uncompressors[c] == NULL;
+}
+
+static inline const char *uncompressor_name(const struct uncompress_task *t) {
+	if (t->builtin)
+		return "built-in uncompressor";
+	else
+		return extern_uncompressors[t->compression];
+}
+
 static void uncompress_task_free(/*@only@*/struct uncompress_task *t) {
 	free(t->compressedfilename);
 	free(t->uncompressedfilename);
@@ -152,55 +180,92 @@ static retvalue startpipeinoutchild(enum compression c, /*@out@*/int *infd, /*@o
 	return r;
 }
 
+static inline retvalue builtin_uncompress(const char *compressed, const char *destination, enum compression compression);
+
+/* like startchild, but the child uncompresses using the builtin code */
+static retvalue startbuiltinchild(struct uncompress_task *t) {
+	int e;
+	pid_t pid;
+
+	/* do not duplicate buffered output */
+	(void)fflush(stdout);
+	(void)fflush(stderr);
+	pid = fork();
+	if (pid < 0) {
+		e = errno;
+		fprintf(stderr, "Error %d forking: %s\n", e, strerror(e));
+		return RET_ERRNO(e);
+	}
+	if (pid == 0) {
+		retvalue r;
+
+		r = builtin_uncompress(t->compressedfilename,
+				t->uncompressedfilename, t->compression);
+		(void)fflush(stdout);
+		(void)fflush(stderr);
+		_exit(RET_IS_OK(r)?EXIT_SUCCESS:EXIT_FAILURE);
+	}
+	t->pid = pid;
+	return RET_OK;
+}
+
 static void uncompress_start_queued(void) {
 	struct uncompress_task *t;
-	int running_count = 0;
+	unsigned int running_count = 0;
 	int e, stdinfd, stdoutfd;
 
 	for (t = tasks ; t != NULL ; t = t->next) {
 		if (t->pid > 0)
 			running_count++;
 	}
-	// TODO: make the maximum number configurable,
-	// until that 1 is the best guess...
-	if (running_count >= 1)
-		return;
-	t = tasks;
-	while (t != NULL && t->pid > 0)
-		t = t->next;
-	if (t == NULL)
-		/* nothing to do... */
-		return;
-	if (verbose > 1) {
-		fprintf(stderr, "Uncompress '%s' into '%s' using '%s'...\n",
-				t->compressedfilename,
-				t->uncompressedfilename,
-				extern_uncompressors[t->compression]);
-	}
-	stdinfd = open(t->compressedfilename, O_RDONLY|O_NOCTTY);
-	if (stdinfd < 0) {
-		e = errno;
-		fprintf(stderr, "Error %d opening %s: %s\n",
-				e, t->compressedfilename,
-				strerror(e));
-		return ; // RET_ERRNO(e);
-	}
-	stdoutfd = open(t->uncompressedfilename,
-			O_WRONLY|O_CREAT|O_EXCL|O_NOFOLLOW, 0666);
-	if (stdoutfd < 0) {
-		close(stdinfd);
-		e = errno;
-		fprintf(stderr, "Error %d creating %s: %s\n",
-				e, t->uncompressedfilename,
-				strerror(e));
-		return ; // RET_ERRNO(e);
+	for (t = tasks ; t != NULL && running_count < maxjobs ;
+			t = t->next) {
+		if (t->pid > 0)
+			continue;
+		if (t->builtin) {
+			if (verbose > 1) {
+				fprintf(stderr,
+"Uncompress '%s' into '%s'...\n",
+						t->compressedfilename,
+						t->uncompressedfilename);
+			}
+			if (RET_WAS_ERROR(startbuiltinchild(t)))
+				return;
+			running_count++;
+			continue;
+		}
+		if (verbose > 1) {
+			fprintf(stderr,
+"Uncompress '%s' into '%s' using '%s'...\n",
+					t->compressedfilename,
+					t->uncompressedfilename,
+					extern_uncompressors[t->compression]);
+		}
+		stdinfd = open(t->compressedfilename, O_RDONLY|O_NOCTTY);
+		if (stdinfd < 0) {
+			e = errno;
+			fprintf(stderr, "Error %d opening %s: %s\n",
+					e, t->compressedfilename,
+					strerror(e));
+			return ; // RET_ERRNO(e);
+		}
+		stdoutfd = open(t->uncompressedfilename,
+				O_WRONLY|O_CREAT|O_EXCL|O_NOFOLLOW, 0666);
+		if (stdoutfd < 0) {
+			close(stdinfd);
+			e = errno;
+			fprintf(stderr, "Error %d creating %s: %s\n",
+					e, t->uncompressedfilename,
+					strerror(e));
+			return ; // RET_ERRNO(e);
+		}
+		if (RET_WAS_ERROR(startchild(t->compression,
+						stdinfd, stdoutfd, &t->pid)))
+			return;
+		running_count++;
 	}
-	// return
-	startchild(t->compression, stdinfd, stdoutfd, &t->pid);
 }
 
-static inline retvalue builtin_uncompress(const char *compressed, const char *destination, enum compression compression);
-
 /* we got an pid, check if it is a uncompressor we care for */
 retvalue uncompress_checkpid(pid_t pid, int status) {
 	struct uncompress_task *t, **t_p;
@@ -220,7 +285,7 @@ retvalue uncompress_checkpid(pid_t pid, int status) {
 		if (WEXITSTATUS(status) != 0) {
 			fprintf(stderr,
 "'%s' < %s > %s exited with errorcode %d!\n",
-					extern_uncompressors[t->compression],
+					uncompressor_name(t),
 					t->compressedfilename,
 					t->uncompressedfilename,
 					(int)(WEXITSTATUS(status)));
@@ -229,14 +294,14 @@ retvalue uncompress_checkpid(pid_t pid, int status) {
 	} else if (WIFSIGNALED(status)) {
 		if (WTERMSIG(status) != SIGUSR2)
 			fprintf(stderr, "'%s' < %s > %s killed by signal %d!\n",
-					extern_uncompressors[t->compression],
+					uncompressor_name(t),
 					t->compressedfilename,
 					t->uncompressedfilename,
 					(int)(WTERMSIG(status)));
 		error = true;
 	} else {
 		fprintf(stderr, "'%s' < %s > %s terminated abnormally!\n",
-				extern_uncompressors[t->compression],
+				uncompressor_name(t),
 					t->compressedfilename,
 					t->uncompressedfilename);
 		error = true;
@@ -247,10 +312,10 @@ retvalue uncompress_checkpid(pid_t pid, int status) {
 	}
 	if (!error && verbose > 10)
 		printf("'%s' < %s > %s finished successfully!\n",
-				extern_uncompressors[t->compression],
+				uncompressor_name(t),
 					t->compressedfilename,
 					t->uncompressedfilename);
-	if (error && uncompression_builtin(t->compression)) {
+	if (error && !t->builtin && builtin_allowed(t->compression)) {
 		/* try builtin method instead */
 		r = builtin_uncompress(t->compressedfilename,
 				t->uncompressedfilename, t->compression);
@@ -403,7 +468,7 @@ static inline retvalue builtin_uncompress(const char *compressed, const char *de
 	return RET_OK;
 }
 
-static retvalue uncompress_queue_external(enum compression compression, const char *compressed, const char *uncompressed, /*@null@*/finishaction *action, /*@null@*/void *privdata) {
+static retvalue uncompress_queue(enum compression compression, const char *compressed, const char *uncompressed, bool builtin, /*@null@*/finishaction *action, /*@null@*/void *privdata) {
 	struct uncompress_task *t, **t_p;
 
 	t_p = &tasks;
@@ -422,6 +487,7 @@ static retvalue uncompress_queue_external(enum compression compression, const ch
 		return RET_ERROR_OOM;
 	}
 	t->compression = compression;
+	t->builtin = builtin;
 	t->callback = action;
 	t->privdata = privdata;
 	*t_p = t;
@@ -434,25 +500,18 @@ retvalue uncompress_queue_file(const char *compressed, const char *destination,
 
 	(void)unlink(destination);
 	if (extern_uncompressors[compression] != NULL) {
-		r = uncompress_queue_external(compression, compressed,
-				destination, action, privdata);
+		r = uncompress_queue(compression, compressed,
+				destination, false, action, privdata);
 		if (r != RET_NOTHING) {
 			return r;
 		}
 		if (!uncompression_builtin(compression))
 			return RET_ERROR;
 	}
-	if (verbose > 1) {
-		fprintf(stderr, "Uncompress '%s' into '%s'...\n",
-				compressed, destination);
-	}
 	assert (uncompression_builtin(compression));
-	r = builtin_uncompress(compressed, destination, compression);
-	if (RET_WAS_ERROR(r)) {
-		(void)unlink(destination);
-		return r;
-	}
-	return action(privdata, compressed, false);
+	/* also done in a child, so it can run while downloading */
+	return uncompress_queue(compression, compressed,
+			destination, true, action, privdata);
 }
 
 retvalue uncompress_file(const char *compressed, const char *destination, enum compression compression) {
@@ -462,15 +521,15 @@ retvalue uncompress_file(const char *compressed, const char *destination, enum c
 	assert (tasks == NULL);
 
 	(void)unlink(destination);
-	if (uncompression_builtin(compression)) {
+	if (builtin_allowed(compression)) {
 		if (verbose > 1) {
 			fprintf(stderr, "Uncompress '%s' into '%s'...\n",
 					compressed, destination);
 		}
 		r = builtin_uncompress(compressed, destination, compression);
 	} else if (extern_uncompressors[compression] != NULL) {
-		r = uncompress_queue_external(compression,
-				compressed, destination, NULL, NULL);
+		r = uncompress_queue(compression,
+				compressed, destination, false, NULL, NULL);
 		if (r == RET_NOTHING)
 			r = RET_ERROR;
 		if (RET_IS_OK(r)) {
@@ -512,6 +571,23 @@ retvalue uncompress_file(const char *compressed, const char *destination, enum c
 	return RET_OK;
 }
 
+#ifdef HAVE_LIBLZMA
+#ifdef HAVE_LZMA_LZIP_DECODER
+#define case_liblzma case c_lzma: case c_xz: case c_lunzip
+#else
+#define case_liblzma case c_lzma: case c_xz
+#endif
+
+#define LZMAINPUTSIZE 65536
+struct lzmafile {
+	lzma_stream stream;
+	/* LZMA_OK or the error that occurred */
+	lzma_ret error;
+	bool inputdone, finished;
+	unsigned char input[LZMAINPUTSIZE];
+};
+#endif
+
 struct compressedfile {
 	char *filename;
 	enum compression compression;
@@ -528,10 +604,111 @@ struct compressedfile {
 		gzFile gz;
 #ifdef HAVE_LIBBZ2
 		BZFILE *bz;
+#endif
+#ifdef HAVE_LIBLZMA
+		struct lzmafile *lz;
 #endif
 	};
 };
 
+#ifdef HAVE_LIBLZMA
+/* liblzma has no file interface, so read file->fd (at most file->len bytes,
+ * if that is not negative) ourself and feed it to the decoder */
+
+static retvalue lzmafile_init(struct compressedfile *f) {
+	lzma_ret lret;
+
+	f->lz = zNEW(struct lzmafile);
+	if (FAILEDTOALLOC(f->lz))
+		return RET_ERROR_OOM;
+	switch (f->compression) {
+		case c_lzma:
+			lret = lzma_alone_decoder(&f->lz->stream, UINT64_MAX);
+			break;
+#ifdef HAVE_LZMA_LZIP_DECODER
+		case c_lunzip:
+			lret = lzma_lzip_decoder(&f->lz->stream, UINT64_MAX,
+					LZMA_CONCATENATED);
+			break;
+#endif
+		default:
+			assert (f->compression == c_xz);
+			lret = lzma_stream_decoder(&f->lz->stream, UINT64_MAX,
+					LZMA_CONCATENATED);
+			break;
+	}
+	if (lret != LZMA_OK) {
+		free(f->lz);
+		f->lz = NULL;
+		if (lret == LZMA_MEM_ERROR)
+			return RET_ERROR_OOM;
+		fprintf(stderr,
+"Error %d from liblzma's decoder initialisation!\n",
+				(int)lret);
+		return RET_ERROR;
+	}
+	return RET_OK;
+}
+
+static int lzmafile_read(struct compressedfile *f, void *buffer, int size) {
+	struct lzmafile *lz = f->lz;
+	lzma_ret lret;
+
+	if (lz->finished)
+		return 0;
+	if (lz->error != LZMA_OK)
+		return -1;
+	lz->stream.next_out = buffer;
+	lz->stream.avail_out = size;
+	while (lz->stream.avail_out > 0) {
+		if (lz->stream.avail_in == 0 && !lz->inputdone) {
+			ssize_t got;
+			size_t toread = LZMAINPUTSIZE;
+
+			if (f->len >= 0 && (off_t)toread > f->len)
+				toread = f->len;
+			if (toread == 0)
+				got = 0;
+			else
+				got = read(f->fd, lz->input, toread);
+			if (got < 0) {
+				if (errno == EINTR)
+					continue;
+				f->error = errno;
+				return -1;
+			}
+			if (got == 0)
+				lz->inputdone = true;
+			if (f->len >= 0)
+				f->len -= got;
+			lz->stream.next_in = lz->input;
+			lz->stream.avail_in = got;
+		}
+		lret = lzma_code(&lz->stream,
+				lz->inputdone?LZMA_FINISH:LZMA_RUN);
+		if (lret == LZMA_STREAM_END) {
+			lz->finished = true;
+			break;
+		}
+		if (lret != LZMA_OK) {
+			lz->error = lret;
+			if (lz->stream.avail_out == (size_t)size)
+				return -1;
+			break;
+		}
+	}
+	return size - lz->stream.avail_out;
+}
+
+static void lzmafile_free(struct compressedfile *f) {
+	if (f->lz == NULL)
+		return;
+	lzma_end(&f->lz->stream);
+	free(f->lz);
+	f->lz = NULL;
+}
+#endif
+
 retvalue uncompress_open(/*@out@*/struct compressedfile **file_p, const char *filename, enum compression compression) {
 	struct compressedfile *f;
 	int fd, e;
@@ -591,10 +768,34 @@ retvalue uncompress_open(/*@out@*/struct compressedfile **file_p, const char *fi
 			}
 			*file_p = f;
 			return RET_OK;
+#endif
+#ifdef HAVE_LIBLZMA
+		case_liblzma:
+			if (!builtin_allowed(compression))
+				break;
+			f->fd = open(filename, O_RDONLY|O_NOCTTY);
+			if (f->fd < 0) {
+				e = errno;
+				fprintf(stderr, "Error %d opening '%s': %s!\n",
+						e, filename, strerror(e));
+				free(f->filename);
+				free(f);
+				return RET_ERRNO(e);
+			}
+			r = lzmafile_init(f);
+			if (RET_WAS_ERROR(r)) {
+				(void)close(f->fd);
+				free(f->filename);
+				free(f);
+				return r;
+			}
+			*file_p = f;
+			return RET_OK;
 #endif
 		default:
-			assert (extern_uncompressors[compression] != NULL);
+			break;
 	}
+	assert (extern_uncompressors[compression] != NULL);
 	/* call external helper instead */
 	fd = open(f->filename, O_RDONLY|O_NOCTTY);
 	if (fd < 0) {
@@ -662,6 +863,23 @@ retvalue uncompress_fdopen(struct compressedfile **file_p, int fd, off_t len, en
 			}
 			break;
 #endif
+#ifdef HAVE_LIBLZMA
+		case_liblzma:
+			if (builtin_allowed(compression)) {
+				f->fd = fd;
+				f->infd = -1;
+				r = lzmafile_init(f);
+				if (RET_WAS_ERROR(r)) {
+					*errno_p = -EINVAL;
+					*msg_p =
+"Error starting liblzma uncompression";
+					free(f);
+					return r;
+				}
+				break;
+			}
+#endif
+			/* fall through */
 		default:
 			if (intermediate_size == 0) {
 				/* pipes are guaranteed to swallow a full
@@ -813,6 +1031,12 @@ int uncompress_read(struct compressedfile *file, void *buffer, int size) {
 			file->error = errno;
 			return i;
 #endif
+#ifdef HAVE_LIBLZMA
+		case_liblzma:
+			if (file->lz != NULL)
+				return lzmafile_read(file, buffer, size);
+#endif
+			/* fall through */
 		default:
 			if (file->pipeinfd != -1) {
 				/* things more complicated, as perhaps
@@ -893,8 +1117,30 @@ static retvalue uncompress_commonclose(struct compressedfile *file, int *errno_p
 			/* no return value? does this mean no checksums? */
 			BZ2_bzclose(file->bz);
 			return RET_OK;
+#endif
+#ifdef HAVE_LIBLZMA
+		case_liblzma:
+			if (file->lz == NULL)
+				goto external;
+			zerror = file->lz->error;
+			lzmafile_free(file);
+			if (file->error != 0) {
+				*errno_p = file->error;
+				*msg_p = strerror(file->error);
+				return RET_ERRNO(file->error);
+			} else if (zerror != LZMA_OK) {
+				*errno_p = -EINVAL;
+				snprintf(errorbuffer, ERRORBUFFERSIZE,
+						"liblzma error %d", zerror);
+				*msg_p = errorbuffer;
+				return RET_ERROR;
+			}
+			return RET_OK;
 #endif
 		default:
+#ifdef HAVE_LIBLZMA
+		external:
+#endif
 			(void)close(file->fd);
 			if (file->pipeinfd != -1)
 				(void)close(file->pipeinfd);
@@ -989,8 +1235,25 @@ retvalue uncompress_error(struct compressedfile *file) {
 				return RET_ERROR_BZ2;
 			} else
 				return RET_OK;
+#endif
+#ifdef HAVE_LIBLZMA
+		case_liblzma:
+			if (file->lz == NULL)
+				goto external;
+			if (file->error != 0)
+				break;
+			if (file->lz->error == LZMA_OK)
+				return RET_OK;
+			fprintf(stderr,
+"liblzma error %d uncompressing file '%s'\n",
+					(int)file->lz->error,
+					file->filename);
+			return RET_ERROR;
 #endif
 		default:
+#ifdef HAVE_LIBLZMA
+		external:
+#endif
 			if (file->error != 0)
 				break;
 			if (file->pid <= 0)
@@ -1064,8 +1327,20 @@ void uncompress_abort(struct compressedfile *file) {
 		case c_bzip2:
 			BZ2_bzclose(file->bz);
 			break;
+#endif
+#ifdef HAVE_LIBLZMA
+		case_liblzma:
+			if (file->lz == NULL)
+				goto external;
+			lzmafile_free(file);
+			if (file->fd >= 0 && file->filename != NULL)
+				(void)close(file->fd);
+			break;
 #endif
 		default:
+#ifdef HAVE_LIBLZMA
+		external:
+#endif
 			/* kill before closing, to avoid it getting
 			 * a sigpipe */
 			if (file->pid > 0)
@@ -13,13 +13,26 @@ extern const char * const uncompression_config[c_COUNT];
  * controled by aptmethods */
 
 #ifdef HAVE_LIBBZ2
-#define uncompression_builtin(c) ((c) == c_bzip2 || (c) == c_gzip)
+#define uncompression_builtin_bz2(c) ((c) == c_bzip2)
 #else
-#define uncompression_builtin(c) ((c) == c_gzip)
+#define uncompression_builtin_bz2(c) false
 #endif
+#ifdef HAVE_LIBLZMA
+#ifdef HAVE_LZMA_LZIP_DECODER
+#define uncompression_builtin_lzma(c) ((c) == c_xz || (c) == c_lzma || \
+		(c) == c_lunzip)
+#else
+#define uncompression_builtin_lzma(c) ((c) == c_xz || (c) == c_lzma)
+#endif
+#else
+#define uncompression_builtin_lzma(c) false
+#endif
+#define uncompression_builtin(c) ((c) == c_gzip || \
+		uncompression_builtin_bz2(c) || \
+		uncompression_builtin_lzma(c))
 #define uncompression_supported(c) ((c) == c_none || \
 		uncompression_builtin(c) || \
-		extern_uncompressors[c] != NULL)
+		((c) < c_COUNT && extern_uncompressors[c] != NULL))
 
 enum compression compression_by_suffix(const char *, size_t *);
 
@@ -29,6 +42,8 @@ enum compression compression_by_suffix(const char *, size_t *);
 retvalue uncompress_checkpid(pid_t, int);
 /* still waiting for a client to exit */
 bool uncompress_running(void);
+/* how many files to uncompress at the same time (0 = 1) */
+void uncompress_setjobs(unsigned int);
 
 typedef retvalue finishaction(void *, const char *, bool /*failed*/);
 /* uncompress and call action when finished */
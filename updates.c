@@ -84,6 +84,7 @@
 #include "filecntl.h"
 #include "remoterepository.h"
 #include "uncompression.h"
+#include "jobs.h"
 
 /* The data structures of this one: ("u_" is short for "update_")
 
@@ -141,6 +142,8 @@ struct update_pattern {
 	/*@null@*/ char *fallback; // can be other server or dir, but must be same method
 	//e.g. "Config: Dir=/"
 	struct strlist config;
+	//e.g. "DownloadWorkers: 4" (0 means not set, i.e. 1)
+	unsigned int downloadworkers;
 	//e.g. "Suite: woody" or "Suite: <asterix>/updates" (NULL means "*")
 	/*@null@*/char *suite_from;
 	//e.g. "VerifyRelease: B629A24C38C6029A" (NULL means not check)
@@ -426,6 +429,18 @@ CFUSETPROC(update_pattern, downloadlistsas) {
 	return RET_OK;
 }
 
+CFUSETPROC(update_pattern, downloadworkers) {
+	CFSETPROCVAR(update_pattern, this);
+	long long workers;
+	retvalue r;
+
+	r = config_getnumber(iter, "DownloadWorkers", &workers, 1, 64);
+	if (RET_WAS_ERROR(r))
+		return r;
+	this->downloadworkers = workers;
+	return RET_OK;
+}
+
 CFUSETPROC(update_pattern, components) {
 	CFSETPROCVAR(update_pattern, this);
 	retvalue r;
@@ -520,6 +535,7 @@ static const struct configfield updateconfigfields[] = {
 	CF("Method", update_pattern, method),
 	CF("Fallback", update_pattern, fallback),
 	CF("Config", update_pattern, config),
+	CF("DownloadWorkers", update_pattern, downloadworkers),
 	CF("Suite", update_pattern, suite_from),
 	CF("Architectures", update_pattern, architectures),
 	CF("Components", update_pattern, components),
@@ -582,6 +598,13 @@ CFfinishparse(update_pattern) {
 				config_line(iter));
 			return RET_ERROR;
 		}
+		if (n->from != NULL && n->downloadworkers != 0) {
+			fprintf(stderr,
+"%s:%u to %u: Update pattern may not contain From: and DownloadWorkers: fields ad the same time.\n",
+				config_filename(iter), config_firstline(iter),
+				config_line(iter));
+			return RET_ERROR;
+		}
 		if (n->suite_from != NULL && strcmp(n->suite_from, "*") != 0 &&
 				strncmp(n->suite_from, "*/", 2) != 0 &&
 				strchr(n->suite_from, '*') != NULL) {
@@ -782,7 +805,8 @@ static retvalue instance_pattern(struct update_pattern *pattern, const struct di
 			declaration->repository = remote_repository_prepare(
 					declaration->name, declaration->method,
 					declaration->fallback,
-					&declaration->config);
+					&declaration->config,
+					declaration->downloadworkers);
 		if (FAILEDTOALLOC(declaration->repository)) {
 			free(update->suite_from);
 			free(update);
@@ -1536,6 +1560,15 @@ static retvalue callshellhook(struct update_target *ut, struct update_index_conn
 	return RET_OK;
 }
 
+/* the pattern whose ListHook or ListShellHook is used for this index */
+static /*@null@*/const struct update_pattern *listhookpattern(const struct update_index_connector *uindex) {
+	const struct update_pattern *p = uindex->origin->pattern;
+
+	while (p != NULL && p->listhook == NULL && p->shellhook == NULL)
+		p = p->pattern_from;
+	return p;
+}
+
 static retvalue calllisthooks(struct update_distribution *d) {
 	retvalue result, r;
 	struct update_target *target;
@@ -1555,10 +1588,7 @@ static retvalue calllisthooks(struct update_distribution *d) {
 				continue;
 			if (uindex->failed)
 				continue;
-			p = uindex->origin->pattern;
-			while (p != NULL && p->listhook == NULL
-			                 && p->shellhook == NULL)
-				p = p->pattern_from;
+			p = listhookpattern(uindex);
 			if (p == NULL)
 				continue;
 			if (p->listhook != NULL)
@@ -1780,6 +1810,8 @@ static inline retvalue searchformissing(/*@null@*/FILE *out, struct update_targe
 
 	for (uindex = u->indices ; uindex != NULL ; uindex = uindex->next) {
 		const char *filename;
+		enum compression compression = c_none;
+		const struct checksums *checksums = NULL;
 
 		if (uindex->origin == NULL) {
 			if (verbose > 4 && out != NULL)
@@ -1797,8 +1829,11 @@ static inline retvalue searchformissing(/*@null@*/FILE *out, struct update_targe
 
 		if (uindex->afterhookfilename != NULL)
 			filename = uindex->afterhookfilename;
-		else
+		else {
 			filename = remote_index_file(uindex->remote);
+			compression = remote_index_compression(uindex->remote);
+			checksums = remote_index_checksums(uindex->remote);
+		}
 
 		if (uindex->failed || uindex->origin->failed) {
 			if (verbose >= 1)
@@ -1812,7 +1847,7 @@ static inline retvalue searchformissing(/*@null@*/FILE *out, struct update_targe
 		if (verbose > 4 && out != NULL)
 			fprintf(out, "  reading '%s'\n", filename);
 		r = upgradelist_update(u->upgradelist, uindex,
-				filename,
+				filename, compression, checksums,
 				ud_decide_by_pattern,
 				(void*)uindex->origin->pattern,
 				uindex->ignorewrongarchitecture);
@@ -1828,10 +1863,162 @@ static inline retvalue searchformissing(/*@null@*/FILE *out, struct update_targe
 	return result;
 }
 
+/* With --update-jobs, the indices of the targets are read (and all
+ * the decisions what to take done) in worker processes, which send
+ * their messages for out and the resulting upgradelist back to the
+ * parent, so the messages are printed in the order of the targets. */
+
+struct readjobs {
+	FILE *out;
+	struct update_target **targets;
+	/* the next target to print the messages of */
+	struct update_target *next;
+};
+
+struct readjob_status {
+	retvalue result;
+	bool incomplete, ignoredelete, haslist;
+	size_t reportlen;
+};
+
+static retvalue readjob_run(void *data, size_t i, int fd) {
+	struct readjobs *jobs = data;
+	struct update_target *u = jobs->targets[i];
+	struct readjob_status status;
+	char *report = NULL;
+	size_t reportlen = 0;
+	FILE *out = NULL;
+	retvalue r;
+
+	if (jobs->out != NULL) {
+		out = open_memstream(&report, &reportlen);
+		if (out == NULL) {
+			int e = errno;
+			fprintf(stderr, "Error %d creating memory stream: %s\n",
+					e, strerror(e));
+			return RET_ERRNO(e);
+		}
+	}
+	memset(&status, 0, sizeof(status));
+	status.result = searchformissing(out, u);
+	status.incomplete = u->incomplete;
+	status.ignoredelete = u->ignoredelete;
+	status.haslist = u->upgradelist != NULL;
+	if (out != NULL && fclose(out) != 0) {
+		int e = errno;
+		fprintf(stderr, "Error %d writing to memory stream: %s\n",
+				e, strerror(e));
+		free(report);
+		return RET_ERRNO(e);
+	}
+	status.reportlen = reportlen;
+	r = jobs_write(fd, &status, sizeof(status));
+	if (RET_IS_OK(r) && reportlen > 0)
+		r = jobs_write(fd, report, reportlen);
+	free(report);
+	if (RET_IS_OK(r) && status.haslist)
+		r = upgradelist_send(u->upgradelist, fd);
+	return r;
+}
+
+/* targets with nothing new are not given to workers, so print their
+ * messages when the targets before them are reached */
+static retvalue readjobs_reportuntil(struct readjobs *jobs, /*@null@*/const struct update_target *until) {
+	retvalue result = RET_NOTHING, r;
+
+	while (jobs->next != until) {
+		assert (jobs->next != NULL && jobs->next->nothingnew);
+		r = searchformissing(jobs->out, jobs->next);
+		RET_UPDATE(result, r);
+		jobs->next = jobs->next->next;
+	}
+	return result;
+}
+
+static retvalue readjob_done(void *data, size_t i, const char *output, size_t len) {
+	struct readjobs *jobs = data;
+	struct update_target *u = jobs->targets[i];
+	struct readjob_status status;
+	retvalue r;
+
+	if (len >= sizeof(status))
+		memcpy(&status, output, sizeof(status));
+	if (len < sizeof(status) || len - sizeof(status) < status.reportlen) {
+		fprintf(stderr,
+"Internal Error: malformed output of worker process reading indices for '%s'!\n",
+				u->target->identifier);
+		u->incomplete = true;
+		return RET_ERROR_INTERNAL;
+	}
+	output += sizeof(status);
+	len -= sizeof(status);
+	r = readjobs_reportuntil(jobs, u);
+	assert (!RET_WAS_ERROR(r));
+	if (jobs->out != NULL && status.reportlen > 0)
+		(void)fwrite(output, 1, status.reportlen, jobs->out);
+	jobs->next = u->next;
+	output += status.reportlen;
+	len -= status.reportlen;
+	u->incomplete = status.incomplete;
+	u->ignoredelete = status.ignoredelete;
+	if (status.haslist) {
+		r = upgradelist_receive(&u->upgradelist, u->target,
+				output, len);
+		if (RET_WAS_ERROR(r)) {
+			u->incomplete = true;
+			return r;
+		}
+	}
+	if (RET_WAS_ERROR(status.result))
+		u->incomplete = true;
+	return status.result;
+}
+
+static retvalue readindicesinworkers(/*@null@*/FILE *out, struct update_distribution *d) {
+	struct readjobs jobs;
+	struct update_target *u;
+	size_t count;
+	retvalue result, r;
+
+	result = RET_NOTHING;
+	count = 0;
+	for (u = d->targets ; u != NULL ; u = u->next) {
+		/* nothing to read for those */
+		if (!u->nothingnew)
+			count++;
+	}
+	jobs.out = out;
+	jobs.next = d->targets;
+	if (count == 0)
+		return readjobs_reportuntil(&jobs, NULL);
+	jobs.targets = nNEW(count, struct update_target *);
+	if (FAILEDTOALLOC(jobs.targets))
+		return RET_ERROR_OOM;
+	count = 0;
+	for (u = d->targets ; u != NULL ; u = u->next) {
+		if (!u->nothingnew)
+			jobs.targets[count++] = u;
+	}
+	if (out != NULL)
+		(void)fflush(out);
+	r = jobs_run(global.updatejobs, count,
+			readjob_run, readjob_done, &jobs);
+	free(jobs.targets);
+	RET_UPDATE(result, r);
+	if (!RET_WAS_ERROR(r)) {
+		r = readjobs_reportuntil(&jobs, NULL);
+		RET_UPDATE(result, r);
+	}
+	return result;
+}
+
 static retvalue updates_readindices(/*@null@*/FILE *out, struct update_distribution *d) {
 	retvalue result, r;
 	struct update_target *u;
 
+	if (global.updatejobs > 1)
+		return readindicesinworkers(out, d);
+
 	result = RET_NOTHING;
 	for (u=d->targets ; u != NULL ; u=u->next) {
 		r = searchformissing(out, u);
@@ -2044,7 +2231,9 @@ static retvalue updates_preparelists(struct aptmethodrun *run, struct update_dis
 			for (ui = ut->indices ; ui != NULL ; ui = ui->next) {
 				if (ui->remote == NULL)
 					continue;
-				remote_index_needed(ui->remote);
+				/* hooks get the uncompressed file */
+				remote_index_needed(ui->remote,
+						listhookpattern(ui) != NULL);
 				*anythingtodo = true;
 			}
 		}
@@ -21,6 +21,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <limits.h>
+#include <search.h>
+#include <sys/time.h>
 
 #include "error.h"
 #include "ignore.h"
@@ -29,6 +32,8 @@
 #include "dpkgversions.h"
 #include "target.h"
 #include "files.h"
+#include "mprintf.h"
+#include "jobs.h"
 #include "upgradelist.h"
 
 struct package_data {
@@ -66,13 +71,21 @@ struct package_data {
 
 struct upgradelist {
 	/*@dependent@*/struct target *target;
+	/* all packages, sorted by name: */
 	struct package_data *list;
-	/* package the next package will most probably be after.
-	 * (NULL=before start of list) */
-	/*@null@*//*@dependent@*/struct package_data *last;
-	/* internal...*/
+	/* a <search.h> tree of all packages (in list or pending) */
+	void *packages;
+	/* new packages not yet sorted into list (in no special order) */
+	/*@null@*/struct package_data *pending;
+	size_t pendingcount;
 };
 
+static int package_data_compare(const void *a, const void *b) {
+	const struct package_data *p1 = a, *p2 = b;
+
+	return strcmp(p1->name, p2->name);
+}
+
 static void package_data_free(/*@only@*/struct package_data *data){
 	if (data == NULL)
 		return;
@@ -86,17 +99,63 @@ static void package_data_free(/*@only@*/struct package_data *data){
 	free(data);
 }
 
+static void package_data_free_node(void *data) {
+	package_data_free(data);
+}
+
+static struct package_data *mergepackages(/*@null@*/struct package_data *a, /*@null@*/struct package_data *b) {
+	struct package_data *merged = NULL, **last_p = &merged;
+
+	while (a != NULL && b != NULL) {
+		if (strcmp(a->name, b->name) < 0) {
+			*last_p = a;
+			a = a->next;
+		} else {
+			*last_p = b;
+			b = b->next;
+		}
+		last_p = &(*last_p)->next;
+	}
+	*last_p = (a != NULL) ? a : b;
+	return merged;
+}
+
+static struct package_data *sortpackages(/*@null@*/struct package_data *list, size_t count) {
+	struct package_data *second, **pp;
+	size_t i;
+
+	if (count <= 1)
+		return list;
+	pp = &list;
+	for (i = 0 ; i < count / 2 ; i++)
+		pp = &(*pp)->next;
+	second = *pp;
+	*pp = NULL;
+	return mergepackages(sortpackages(list, count / 2),
+			sortpackages(second, count - count / 2));
+}
+
+/* new packages are only collected while reading a source,
+ * as input is not necessarily sorted, and put in place afterwards */
+static void upgradelist_sortin(struct upgradelist *upgrade) {
+	if (upgrade->pending == NULL)
+		return;
+	upgrade->list = mergepackages(upgrade->list,
+			sortpackages(upgrade->pending, upgrade->pendingcount));
+	upgrade->pending = NULL;
+	upgrade->pendingcount = 0;
+}
+
 /* This is called before any package lists are read for any package we already
- * have in this target. upgrade->list points to the first in the sorted list,
- * upgrade->last to the last one inserted */
-static retvalue save_package_version(struct upgradelist *upgrade, const char *packagename, const char *chunk) {
+ * have in this target, with last pointing to the last one inserted */
+static retvalue save_package_version(struct upgradelist *upgrade, struct package_data **last_p, const char *packagename, const char *packageversion) {
 	char *version;
-	retvalue r;
 	struct package_data *package;
+	void *node;
 
-	r = upgrade->target->getversion(chunk, &version);
-	if (RET_WAS_ERROR(r))
-		return r;
+	version = strdup(packageversion);
+	if (FAILEDTOALLOC(version))
+		return RET_ERROR_OOM;
 
 	package = zNEW(struct package_data);
 	if (FAILEDTOALLOC(package)) {
@@ -115,32 +174,35 @@ static retvalue save_package_version(struct upgradelist *upgrade, const char *pa
 	version = NULL; // just to be sure...
 	package->version = package->version_in_use;
 
-	if (upgrade->list == NULL) {
+	if (*last_p != NULL && strcmp(packagename, (*last_p)->name) <= 0) {
+		/* this should only happen if the underlying
+		 * database-method get changed, so just throwing
+		 * out here */
+		fprintf(stderr, "Package database is not sorted!!!\n");
+		assert(false);
+		exit(EXIT_FAILURE);
+	}
+	node = tsearch(package, &upgrade->packages, package_data_compare);
+	if (FAILEDTOALLOC(node)) {
+		package_data_free(package);
+		return RET_ERROR_OOM;
+	}
+	if (*last_p == NULL)
 		/* first chunk to add: */
 		upgrade->list = package;
-		upgrade->last = package;
-	} else {
-		if (strcmp(packagename, upgrade->last->name) > 0) {
-			upgrade->last->next = package;
-			upgrade->last = package;
-		} else {
-			/* this should only happen if the underlying
-			 * database-method get changed, so just throwing
-			 * out here */
-			fprintf(stderr, "Package database is not sorted!!!\n");
-			assert(false);
-			exit(EXIT_FAILURE);
-		}
-	}
-
+	else
+		(*last_p)->next = package;
+	*last_p = package;
 	return RET_OK;
 }
 
 retvalue upgradelist_initialize(struct upgradelist **ul, struct target *t) {
 	struct upgradelist *upgrade;
 	retvalue r, r2;
-	const char *packagename, *controlchunk;
+	const char *packagename;
+	struct target_metadata md;
 	struct target_cursor iterator;
+	struct package_data *last = NULL;
 
 	upgrade = zNEW(struct upgradelist);
 	if (FAILEDTOALLOC(upgrade))
@@ -150,13 +212,16 @@ retvalue upgradelist_initialize(struct upgradelist **ul, struct target *t) {
 
 	/* Beginn with the packages currently in the archive */
 
-	r = target_openiterator(t, READONLY, &iterator);
+	r = target_openmetadata(t, READONLY, TMD_VERSION, &iterator);
 	if (RET_WAS_ERROR(r)) {
 		upgradelist_free(upgrade);
 		return r;
 	}
-	while (target_nextpackage(&iterator, &packagename, &controlchunk)) {
-		r2 = save_package_version(upgrade, packagename, controlchunk);
+	while ((r2 = target_nextmetadata(&iterator, &packagename, &md))
+			!= RET_NOTHING) {
+		if (RET_IS_OK(r2))
+			r2 = save_package_version(upgrade, &last,
+					packagename, md.version);
 		RET_UPDATE(r, r2);
 		if (RET_WAS_ERROR(r2))
 			break;
@@ -169,25 +234,16 @@ retvalue upgradelist_initialize(struct upgradelist **ul, struct target *t) {
 		return r;
 	}
 
-	upgrade->last = NULL;
-
 	*ul = upgrade;
 	return RET_OK;
 }
 
 void upgradelist_free(struct upgradelist *upgrade) {
-	struct package_data *l;
-
 	if (upgrade == NULL)
 		return;
 
-	l = upgrade->list;
-	while (l != NULL) {
-		struct package_data *n = l->next;
-		package_data_free(l);
-		l = n;
-	}
-
+	/* the tree contains everything in list and pending */
+	tdestroy(upgrade->packages, package_data_free_node);
 	free(upgrade);
 	return;
 }
@@ -195,7 +251,7 @@ void upgradelist_free(struct upgradelist *upgrade) {
 static retvalue upgradelist_trypackage(struct upgradelist *upgrade, void *privdata, upgrade_decide_function *predecide, void *predecide_data, const char *packagename_const, /*@null@*//*@only@*/char *packagename, const char *sourcename, /*@only@*/char *version, const char *sourceversion, architecture_t architecture, const char *chunk) {
 	retvalue r;
 	upgrade_decision decision;
-	struct package_data *current, *insertafter;
+	struct package_data key, *current, **found;
 
 	if (architecture == architecture_all) {
 		if (upgrade->target->packagetype == pt_dsc) {
@@ -206,83 +262,22 @@ static retvalue upgradelist_trypackage(struct upgradelist *upgrade, void *privda
 		}
 	}
 
-	/* insertafter = NULL will mean insert before list */
-	insertafter = upgrade->last;
-	/* the next one to test, current = NULL will mean not found */
-	if (insertafter != NULL)
-		current = insertafter->next;
-	else
-		current = upgrade->list;
-
-	/* the algorithm assumes almost all packages are feed in
-	 * alphabetically. So the next package will likely be quite
-	 * after the last one. Otherwise we walk down the long list
-	 * again and again... and again... and even some more...*/
-
-	while (true) {
-		int cmp;
+	key.name = (char*)packagename_const;
+	found = tfind(&key, &upgrade->packages, package_data_compare);
+	/* current = NULL will mean not found */
+	current = (found != NULL) ? *found : NULL;
 
-		assert (insertafter == NULL || insertafter->next == current);
-		assert (insertafter != NULL || current == upgrade->list);
-
-		if (current == NULL)
-			cmp = -1; /* every package is before the end of list */
-		else
-			cmp = strcmp(packagename_const, current->name);
-
-		if (cmp == 0)
-			break;
-
-		if (cmp < 0) {
-			int precmp;
-
-			if (insertafter == NULL) {
-				/* if we are before the first
-				 * package, add us there...*/
-				current = NULL;
-				break;
-			}
-			// I only hope noone creates indices anti-sorted:
-			precmp = strcmp(packagename_const, insertafter->name);
-			if (precmp == 0) {
-				current = insertafter;
-				break;
-			} else if (precmp < 0) {
-				/* restart at the beginning: */
-				current = upgrade->list;
-				insertafter = NULL;
-				if (verbose > 10) {
-					fprintf(stderr, "restarting search...");
-				}
-				continue;
-			} else { // precmp > 0
-				/* insert after insertafter: */
-				current = NULL;
-				break;
-			}
-			assert ("This is not reached" == NULL);
-		}
-		/* cmp > 0 : may come later... */
-		assert (current != NULL);
-		insertafter = current;
-		current = current->next;
-		if (current == NULL) {
-			/* add behind insertafter at end of list */
-			break;
-		}
-		/* otherwise repeat until place found */
-	}
 	if (current == NULL) {
 		/* adding a package not yet known */
 		struct package_data *new;
 		char *newcontrol;
+		void *node;
 
 		decision = predecide(predecide_data, upgrade->target,
 				packagename_const, sourcename,
 				NULL, version, sourceversion,
 				chunk);
 		if (decision != UD_UPGRADE) {
-			upgrade->last = insertafter;
 			if (decision == UD_LOUDNO)
 				fprintf(stderr,
 "Loudly rejecting '%s' '%s' to enter '%s'!\n",
@@ -336,42 +331,48 @@ static retvalue upgradelist_trypackage(struct upgradelist *upgrade, void *privda
 			free(new->new_control);
 			new->new_control = newcontrol;
 		}
-		if (insertafter != NULL) {
-			new->next = insertafter->next;
-			insertafter->next = new;
-		} else {
-			new->next = upgrade->list;
-			upgrade->list = new;
+		node = tsearch(new, &upgrade->packages, package_data_compare);
+		if (FAILEDTOALLOC(node)) {
+			package_data_free(new);
+			return RET_ERROR_OOM;
 		}
-		upgrade->last = new;
+		new->next = upgrade->pending;
+		upgrade->pending = new;
+		upgrade->pendingcount++;
 	} else {
 		/* The package already exists: */
 		char *control, *newcontrol;
 		struct strlist files;
 		struct checksumsarray origfiles;
 		int versioncmp;
+		struct dpkgversion parsed, parsedcurrent;
 
-		upgrade->last = current;
-
-		r = dpkgversions_cmp(version, current->version, &versioncmp);
+		/* parsed only once, as it might be compared multiple times */
+		r = dpkgversion_parse(&parsed, version);
+		if (!RET_WAS_ERROR(r))
+			r = dpkgversion_parse(&parsedcurrent,
+					current->version);
 		if (RET_WAS_ERROR(r)) {
 			free(packagename);
 			free(version);
 			return r;
 		}
+		versioncmp = dpkgversion_cmp(&parsed, &parsedcurrent);
 		if (versioncmp <= 0 && !current->deleted) {
 			/* there already is a newer version, so
 			 * doing nothing but perhaps updating what
 			 * versions are around, when we are newer
 			 * than yet known candidates... */
 			int c = 0;
+			struct dpkgversion parsednew;
 
 			if (current->new_version == current->version)
 				c =versioncmp;
 			else if (current->new_version == NULL)
 				c = 1;
-			else (void)dpkgversions_cmp(version,
-					       current->new_version, &c);
+			else if (RET_IS_OK(dpkgversion_parse(&parsednew,
+						current->new_version)))
+				c = dpkgversion_cmp(&parsed, &parsednew);
 
 			if (c > 0) {
 				free(current->new_version);
@@ -432,8 +433,11 @@ static retvalue upgradelist_trypackage(struct upgradelist *upgrade, void *privda
 			 * So we get to the question: it is also not the same
 			 * like the version we already have? */
 			int vcmp = 1;
-			(void)dpkgversions_cmp(version,
-					current->version_in_use, &vcmp);
+			struct dpkgversion parsedinuse;
+
+			if (RET_IS_OK(dpkgversion_parse(&parsedinuse,
+						current->version_in_use)))
+				vcmp = dpkgversion_cmp(&parsed, &parsedinuse);
 			if (vcmp == 0) {
 				current->version = current->version_in_use;
 				if (current->deleted) {
@@ -489,19 +493,18 @@ static retvalue upgradelist_trypackage(struct upgradelist *upgrade, void *privda
 	return RET_OK;
 }
 
-retvalue upgradelist_update(struct upgradelist *upgrade, void *privdata, const char *filename, upgrade_decide_function *decide, void *decide_data, bool ignorewrongarchitecture) {
+retvalue upgradelist_update(struct upgradelist *upgrade, void *privdata, const char *filename, enum compression compression, const struct checksums *checksums, upgrade_decide_function *decide, void *decide_data, bool ignorewrongarchitecture) {
 	struct indexfile *i;
 	char *packagename, *version, *sourcename, *sourceversion;
 	const char *control;
 	retvalue result, r;
 	architecture_t package_architecture;
 
-	r = indexfile_open(&i, filename, c_none);
+	r = indexfile_open(&i, filename, compression, checksums);
 	if (!RET_IS_OK(r))
 		return r;
 
 	result = RET_NOTHING;
-	upgrade->last = NULL;
 	while (indexfile_getnext(i, &packagename, &version, &control,
 				&package_architecture,
 				upgrade->target, ignorewrongarchitecture)) {
@@ -528,6 +531,7 @@ retvalue upgradelist_update(struct upgradelist *upgrade, void *privdata, const c
 			break;
 		}
 	}
+	upgradelist_sortin(upgrade);
 	r = indexfile_close(i);
 	RET_ENDUPDATE(result, r);
 	return result;
@@ -538,7 +542,6 @@ retvalue upgradelist_pull(struct upgradelist *upgrade, struct target *source, up
 	const char *package, *control;
 	struct target_cursor iterator;
 
-	upgrade->last = NULL;
 	r = target_openiterator(source, READONLY, &iterator);
 	if (RET_WAS_ERROR(r))
 		return r;
@@ -606,11 +609,289 @@ retvalue upgradelist_pull(struct upgradelist *upgrade, struct target *source, up
 			break;
 		}
 	}
+	upgradelist_sortin(upgrade);
 	r = target_closeiterator(&iterator);
 	RET_ENDUPDATE(result, r);
 	return result;
 }
 
+/* To pass an upgradelist from a worker process to its parent,
+ * every package is written as flags, privdata and architecture,
+ * followed by '\0' terminated strings (name, the versions and control
+ * that are there, count and filekeys, count and origfiles with their
+ * combined checksums). privdata is a pointer into the parent's memory,
+ * as the worker is a fork of it. */
+
+#define PD_HAS_VERSION_IN_USE 1
+#define PD_HAS_NEW_VERSION 2
+#define PD_VERSION_IS_NEW 4
+#define PD_DELETED 8
+#define PD_HAS_CONTROL 16
+
+struct writebuffer {
+	int fd;
+	size_t len;
+	char data[65536];
+};
+
+static retvalue buffer_add(struct writebuffer *b, const void *data, size_t len) {
+	retvalue r;
+
+	if (b->len + len > sizeof(b->data)) {
+		r = jobs_write(b->fd, b->data, b->len);
+		if (RET_WAS_ERROR(r))
+			return r;
+		b->len = 0;
+		if (len > sizeof(b->data))
+			return jobs_write(b->fd, data, len);
+	}
+	memcpy(b->data + b->len, data, len);
+	b->len += len;
+	return RET_OK;
+}
+
+static inline retvalue buffer_addstring(struct writebuffer *b, const char *s) {
+	return buffer_add(b, s, strlen(s) + 1);
+}
+
+static retvalue write_package(struct writebuffer *b, const struct package_data *pkg) {
+	unsigned char flags = 0;
+	const struct checksumsarray *o = &pkg->new_origfiles;
+	char count[20];
+	retvalue r;
+	int i;
+
+	if (pkg->version_in_use != NULL)
+		flags |= PD_HAS_VERSION_IN_USE;
+	if (pkg->new_version != NULL)
+		flags |= PD_HAS_NEW_VERSION;
+	if (pkg->version == pkg->new_version && pkg->new_version != NULL)
+		flags |= PD_VERSION_IS_NEW;
+	if (pkg->deleted)
+		flags |= PD_DELETED;
+	if (pkg->new_control != NULL)
+		flags |= PD_HAS_CONTROL;
+	r = buffer_add(b, &flags, 1);
+	if (!RET_WAS_ERROR(r))
+		r = buffer_add(b, &pkg->privdata, sizeof(pkg->privdata));
+	if (!RET_WAS_ERROR(r))
+		r = buffer_add(b, &pkg->architecture,
+				sizeof(pkg->architecture));
+	if (!RET_WAS_ERROR(r))
+		r = buffer_addstring(b, pkg->name);
+	if (!RET_WAS_ERROR(r) && pkg->version_in_use != NULL)
+		r = buffer_addstring(b, pkg->version_in_use);
+	if (!RET_WAS_ERROR(r) && pkg->new_version != NULL)
+		r = buffer_addstring(b, pkg->new_version);
+	if (!RET_WAS_ERROR(r) && pkg->new_control != NULL)
+		r = buffer_addstring(b, pkg->new_control);
+	if (RET_WAS_ERROR(r))
+		return r;
+	snprintf(count, sizeof(count), "%d", pkg->new_filekeys.count);
+	r = buffer_addstring(b, count);
+	for (i = 0 ; !RET_WAS_ERROR(r) && i < pkg->new_filekeys.count ; i++)
+		r = buffer_addstring(b, pkg->new_filekeys.values[i]);
+	if (RET_WAS_ERROR(r))
+		return r;
+	snprintf(count, sizeof(count), "%d", o->names.count);
+	r = buffer_addstring(b, count);
+	for (i = 0 ; !RET_WAS_ERROR(r) && i < o->names.count ; i++) {
+		const char *combined;
+		size_t len;
+
+		r = buffer_addstring(b, o->names.values[i]);
+		if (RET_WAS_ERROR(r))
+			break;
+		r = checksums_getcombined(o->checksums[i], &combined, &len);
+		if (RET_WAS_ERROR(r))
+			break;
+		r = buffer_addstring(b, combined);
+	}
+	return r;
+}
+
+retvalue upgradelist_send(const struct upgradelist *upgrade, int fd) {
+	struct writebuffer *b;
+	const struct package_data *pkg;
+	retvalue r = RET_OK;
+
+	assert (upgrade->pending == NULL);
+
+	b = malloc(sizeof(struct writebuffer));
+	if (FAILEDTOALLOC(b))
+		return RET_ERROR_OOM;
+	b->fd = fd;
+	b->len = 0;
+	for (pkg = upgrade->list ; pkg != NULL ; pkg = pkg->next) {
+		r = write_package(b, pkg);
+		if (RET_WAS_ERROR(r))
+			break;
+	}
+	if (!RET_WAS_ERROR(r) && b->len > 0)
+		r = jobs_write(fd, b->data, b->len);
+	free(b);
+	return r;
+}
+
+/* get the next '\0' terminated string, NULL if there is none */
+static const char *nextstring(const char **p, const char *end) {
+	const char *s = *p, *e;
+
+	e = memchr(s, '\0', end - s);
+	if (e == NULL)
+		return NULL;
+	*p = e + 1;
+	return s;
+}
+
+static retvalue read_strings(struct strlist *list, const char **p, const char *end, bool withchecksums, /*@null@*/ownedchecksums **checksums_p) {
+	const char *s;
+	char *e;
+	long count;
+	int i;
+	retvalue r;
+
+	s = nextstring(p, end);
+	if (s == NULL)
+		return RET_ERROR;
+	count = strtol(s, &e, 10);
+	if (*e != '\0' || count < 0 || count > INT_MAX / 2)
+		return RET_ERROR;
+	r = strlist_init_n(count + 1, list);
+	if (RET_WAS_ERROR(r))
+		return r;
+	/* checksumsarray_done expects no array for no files */
+	if (withchecksums && count > 0) {
+		*checksums_p = nzNEW(count, ownedchecksums);
+		if (FAILEDTOALLOC(*checksums_p))
+			return RET_ERROR_OOM;
+	}
+	for (i = 0 ; i < count ; i++) {
+		s = nextstring(p, end);
+		if (s == NULL)
+			return RET_ERROR;
+		r = strlist_add_dup(list, s);
+		if (RET_WAS_ERROR(r))
+			return r;
+		if (!withchecksums)
+			continue;
+		s = nextstring(p, end);
+		if (s == NULL)
+			return RET_ERROR;
+		r = checksums_parse(&(*checksums_p)[i], s);
+		if (RET_WAS_ERROR(r))
+			return r;
+	}
+	return RET_OK;
+}
+
+static retvalue read_package(struct package_data *pkg, const char **p, const char *end) {
+	unsigned char flags;
+	const char *s;
+	retvalue r;
+
+	if ((size_t)(end - *p) < 1 + sizeof(pkg->privdata)
+			+ sizeof(pkg->architecture))
+		return RET_ERROR;
+	flags = **p;
+	(*p)++;
+	memcpy(&pkg->privdata, *p, sizeof(pkg->privdata));
+	*p += sizeof(pkg->privdata);
+	memcpy(&pkg->architecture, *p, sizeof(pkg->architecture));
+	*p += sizeof(pkg->architecture);
+	pkg->deleted = (flags & PD_DELETED) != 0;
+	s = nextstring(p, end);
+	if (s == NULL)
+		return RET_ERROR;
+	pkg->name = strdup(s);
+	if (FAILEDTOALLOC(pkg->name))
+		return RET_ERROR_OOM;
+	if ((flags & PD_HAS_VERSION_IN_USE) != 0) {
+		s = nextstring(p, end);
+		if (s == NULL)
+			return RET_ERROR;
+		pkg->version_in_use = strdup(s);
+		if (FAILEDTOALLOC(pkg->version_in_use))
+			return RET_ERROR_OOM;
+	}
+	if ((flags & PD_HAS_NEW_VERSION) != 0) {
+		s = nextstring(p, end);
+		if (s == NULL)
+			return RET_ERROR;
+		pkg->new_version = strdup(s);
+		if (FAILEDTOALLOC(pkg->new_version))
+			return RET_ERROR_OOM;
+	}
+	if ((flags & PD_VERSION_IS_NEW) != 0)
+		pkg->version = pkg->new_version;
+	else
+		pkg->version = pkg->version_in_use;
+	if (pkg->version == NULL)
+		return RET_ERROR;
+	if ((flags & PD_HAS_CONTROL) != 0) {
+		s = nextstring(p, end);
+		if (s == NULL)
+			return RET_ERROR;
+		pkg->new_control = strdup(s);
+		if (FAILEDTOALLOC(pkg->new_control))
+			return RET_ERROR_OOM;
+	}
+	r = read_strings(&pkg->new_filekeys, p, end, false, NULL);
+	if (RET_WAS_ERROR(r))
+		return r;
+	return read_strings(&pkg->new_origfiles.names, p, end, true,
+			&pkg->new_origfiles.checksums);
+}
+
+retvalue upgradelist_receive(struct upgradelist **ul, struct target *t, const char *data, size_t len) {
+	struct upgradelist *upgrade;
+	struct package_data *pkg, *last = NULL;
+	const char *end = data + len;
+	void *node;
+	retvalue r = RET_OK;
+
+	upgrade = zNEW(struct upgradelist);
+	if (FAILEDTOALLOC(upgrade))
+		return RET_ERROR_OOM;
+	upgrade->target = t;
+	while (data < end) {
+		pkg = zNEW(struct package_data);
+		if (FAILEDTOALLOC(pkg)) {
+			r = RET_ERROR_OOM;
+			break;
+		}
+		r = read_package(pkg, &data, end);
+		if (!RET_WAS_ERROR(r) && last != NULL &&
+				strcmp(last->name, pkg->name) >= 0)
+			r = RET_ERROR;
+		if (RET_WAS_ERROR(r)) {
+			package_data_free(pkg);
+			break;
+		}
+		node = tsearch(pkg, &upgrade->packages, package_data_compare);
+		if (FAILEDTOALLOC(node)) {
+			package_data_free(pkg);
+			r = RET_ERROR_OOM;
+			break;
+		}
+		if (last == NULL)
+			upgrade->list = pkg;
+		else
+			last->next = pkg;
+		last = pkg;
+	}
+	if (RET_WAS_ERROR(r)) {
+		if (r == RET_ERROR)
+			fprintf(stderr,
+"Internal Error: malformed package list from worker process for '%s'!\n",
+					t->identifier);
+		upgradelist_free(upgrade);
+		return r;
+	}
+	*ul = upgrade;
+	return RET_OK;
+}
+
 /* mark all packages as deleted, so they will vanis unless readded or reholded */
 retvalue upgradelist_deleteall(struct upgradelist *upgrade) {
 	struct package_data *pkg;
@@ -794,3 +1075,137 @@ void upgradelist_dump(struct upgradelist *upgrade, dumpaction action){
 					pkg->privdata);
 	}
 }
+
+/* everything needed to feed an upgradelist without any database */
+
+static retvalue benchmark_getversion(const char *chunk, char **version) {
+	*version = strdup(chunk);
+	if (FAILEDTOALLOC(*version))
+		return RET_ERROR_OOM;
+	return RET_OK;
+}
+
+static retvalue benchmark_getinstalldata(UNUSED(const struct target *t), UNUSED(const char *packagename), UNUSED(const char *version), UNUSED(architecture_t architecture), const char *chunk, char **control, struct strlist *filekeys, struct checksumsarray *origfiles) {
+	*control = strdup(chunk);
+	if (FAILEDTOALLOC(*control))
+		return RET_ERROR_OOM;
+	strlist_init(filekeys);
+	memset(origfiles, 0, sizeof(struct checksumsarray));
+	return RET_OK;
+}
+
+static retvalue benchmark_doreoverride(UNUSED(const struct target *t), UNUSED(const char *packagename), UNUSED(const char *controlchunk), UNUSED(char **newcontrol)) {
+	return RET_NOTHING;
+}
+
+static upgrade_decision benchmark_decide(UNUSED(void *privdata), UNUSED(const struct target *t), UNUSED(const char *package), UNUSED(const char *source), UNUSED(const char *old_version), UNUSED(const char *new_version), UNUSED(const char *new_src_version), UNUSED(const char *newcontrolchunk)) {
+	return UD_UPGRADE;
+}
+
+/* a target with every second of the packages, getting all of them
+ * (the ones already there in a newer version) in the given order */
+static retvalue benchmark_feed(struct target *target, char **names, const size_t *order, size_t count, /*@out@*/double *seconds) {
+	struct upgradelist *upgrade;
+	struct package_data *last = NULL, *pkg;
+	struct timeval start, end;
+	retvalue r = RET_OK;
+	size_t i;
+
+	upgrade = zNEW(struct upgradelist);
+	if (FAILEDTOALLOC(upgrade))
+		return RET_ERROR_OOM;
+	upgrade->target = target;
+	for (i = 0 ; i < count && !RET_WAS_ERROR(r) ; i += 2)
+		r = save_package_version(upgrade, &last, names[i], "1");
+	gettimeofday(&start, NULL);
+	for (i = 0 ; i < count && !RET_WAS_ERROR(r) ; i++) {
+		char *version = strdup("2");
+
+		if (FAILEDTOALLOC(version)) {
+			r = RET_ERROR_OOM;
+			break;
+		}
+		r = upgradelist_trypackage(upgrade, NULL,
+				benchmark_decide, NULL,
+				names[order[i]], NULL, names[order[i]],
+				version, "2", architecture_all, "2");
+	}
+	upgradelist_sortin(upgrade);
+	gettimeofday(&end, NULL);
+	*seconds = (end.tv_sec - start.tv_sec)
+		+ (end.tv_usec - start.tv_usec) / 1000000.0;
+	if (!RET_WAS_ERROR(r)) {
+		i = 0;
+		for (pkg = upgrade->list ; pkg != NULL ; pkg = pkg->next) {
+			if (i >= count || strcmp(pkg->name, names[i]) != 0)
+				break;
+			i++;
+		}
+		if (pkg != NULL || i != count) {
+			fprintf(stderr,
+"Internal error: upgradelist has wrong content or order!\n");
+			r = RET_ERROR_INTERNAL;
+		}
+	}
+	upgradelist_free(upgrade);
+	return r;
+}
+
+retvalue upgradelist_benchmark(unsigned long count) {
+	struct target target;
+	char **names;
+	size_t *order;
+	unsigned long long seed = 42;
+	double sortedsecs, shuffledsecs;
+	size_t i;
+	retvalue r;
+
+	memset(&target, 0, sizeof(target));
+	target.identifier = (char*)"benchmark";
+	target.packagetype = pt_deb;
+	target.architecture = architecture_all;
+	target.getversion = benchmark_getversion;
+	target.getinstalldata = benchmark_getinstalldata;
+	target.doreoverride = benchmark_doreoverride;
+
+	names = nzNEW(count, char *);
+	order = nzNEW(count, size_t);
+	if (FAILEDTOALLOC(names) || FAILEDTOALLOC(order)) {
+		free(names);
+		free(order);
+		return RET_ERROR_OOM;
+	}
+	r = RET_OK;
+	for (i = 0 ; i < count ; i++) {
+		/* sorted alphabetically by number */
+		names[i] = mprintf("package%09lu", (unsigned long)i);
+		if (FAILEDTOALLOC(names[i])) {
+			r = RET_ERROR_OOM;
+			break;
+		}
+		order[i] = i;
+	}
+	if (!RET_WAS_ERROR(r))
+		r = benchmark_feed(&target, names, order, count, &sortedsecs);
+	/* Fisher-Yates shuffle with a fixed seed, to get comparable runs */
+	for (i = count ; i > 1 ; i--) {
+		size_t j, h;
+
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		j = (size_t)((seed >> 33) % i);
+		h = order[i - 1]; order[i - 1] = order[j]; order[j] = h;
+	}
+	if (!RET_WAS_ERROR(r))
+		r = benchmark_feed(&target, names, order, count, &shuffledsecs);
+	if (!RET_WAS_ERROR(r)) {
+		printf("%lu packages (%lu already in the target)\n",
+				count, (count + 1) / 2);
+		printf("sorted input: %.3f s\n", sortedsecs);
+		printf("shuffled input: %.3f s\n", shuffledsecs);
+	}
+	for (i = 0 ; i < count ; i++)
+		free(names[i]);
+	free(names);
+	free(order);
+	return r;
+}
@@ -12,6 +12,7 @@ typedef upgrade_decision upgrade_decide_function(void *privdata, const struct ta
 struct target;
 struct logger;
 struct upgradelist;
+struct checksums;
 
 retvalue upgradelist_initialize(struct upgradelist **, /*@dependent@*/struct target *);
 void upgradelist_free(/*@only@*/struct upgradelist *);
@@ -20,12 +21,18 @@ typedef void dumpaction(const char */*packagename*/, /*@null@*/const char */*old
 
 void upgradelist_dump(struct upgradelist *, dumpaction *);
 
-/* Take all items in 'filename' into account, and remember them coming from 'method' */
-retvalue upgradelist_update(struct upgradelist *, /*@dependent@*/void *, const char * /*filename*/, upgrade_decide_function *, void *, bool /*ignorewrongarchitecture*/);
+/* Take all items in 'filename' into account, and remember them coming from 'method'
+ * (if checksums are given, the uncompressed file must have those) */
+retvalue upgradelist_update(struct upgradelist *, /*@dependent@*/void *, const char * /*filename*/, enum compression, /*@null@*/const struct checksums *, upgrade_decide_function *, void *, bool /*ignorewrongarchitecture*/);
 
 /* Take all items in source into account */
 retvalue upgradelist_pull(struct upgradelist *, struct target *, upgrade_decide_function *, void *, void *);
 
+/* send the list to the parent of a worker process (see jobs.h)
+ * and create it there again */
+retvalue upgradelist_send(const struct upgradelist *, int /*fd*/);
+retvalue upgradelist_receive(/*@out@*/struct upgradelist **, /*@dependent@*/struct target *, const char *, size_t);
+
 /* mark all packages as deleted, so they will vanis unless readded or reholded */
 retvalue upgradelist_deleteall(struct upgradelist *);
 
@@ -41,4 +48,7 @@ retvalue upgradelist_install(struct upgradelist *, /*@null@*/struct logger *, bo
 /* remove all packages that would either be removed or upgraded by an upgrade */
 retvalue upgradelist_predelete(struct upgradelist *, /*@null@*/struct logger *);
 
+/* time feeding that many packages sorted and shuffled */
+retvalue upgradelist_benchmark(unsigned long /*count*/);
+
 #endif